@@ -1,19 +1,39 @@
-cbuffer ubo : register(b0)
+// Per-view, updated once a frame, see ViewConstants in Renderer.h
+cbuffer view : register(b0)
 {
-    row_major float4x4 ubo_projectionMatrix : packoffset(c0);
-    row_major float4x4 ubo_modelMatrix : packoffset(c4);
-    row_major float4x4 ubo_viewMatrix : packoffset(c8);
+    row_major float4x4 view_viewProjectionMatrix : packoffset(c0);
 };
 
+#if COMPACT_VERTICES
+// Per-mesh root constants, see MeshConstants in Renderer.h. Compact
+// positions are 16 bit unorms relative to the mesh's bounds.
+cbuffer mesh : register(b1)
+{
+    float4 mesh_positionScale : packoffset(c0);
+    float4 mesh_positionOffset : packoffset(c1);
+};
+#endif
+
 static float4 gl_Position;
 static float3 outColor;
 static float3 inColor;
 static float3 inPos;
+static float4x4 inModelMatrix;
 
 struct SPIRV_Cross_Input
 {
+#if COMPACT_VERTICES
+    float4 inPos : POSITION;
+    float4 inColor : COLOR;
+#else
     float3 inPos : POSITION;
     float3 inColor : COLOR;
+#endif
+    // Per-object, the model matrix an instance at a time
+    float4 inModel0 : MODEL0;
+    float4 inModel1 : MODEL1;
+    float4 inModel2 : MODEL2;
+    float4 inModel3 : MODEL3;
 };
 
 struct SPIRV_Cross_Output
@@ -25,13 +45,19 @@ struct SPIRV_Cross_Output
 void vert_main()
 {
     outColor = inColor;
-    gl_Position = mul(float4(inPos, 1.0f), mul(ubo_modelMatrix, mul(ubo_viewMatrix, ubo_projectionMatrix)));
+    gl_Position = mul(mul(float4(inPos, 1.0f), inModelMatrix), view_viewProjectionMatrix);
 }
 
 SPIRV_Cross_Output main(SPIRV_Cross_Input stage_input)
 {
+#if COMPACT_VERTICES
+    inColor = stage_input.inColor.rgb;
+    inPos = stage_input.inPos.xyz * mesh_positionScale.xyz + mesh_positionOffset.xyz;
+#else
     inColor = stage_input.inColor;
     inPos = stage_input.inPos;
+#endif
+    inModelMatrix = float4x4(stage_input.inModel0, stage_input.inModel1, stage_input.inModel2, stage_input.inModel3);
     vert_main();
     SPIRV_Cross_Output stage_output;
     stage_output.gl_Position = gl_Position;
@@ -0,0 +1,286 @@
+#include "../src/Hash.h"
+#include "../src/MeshCooker.h"
+#include "../src/MeshFile.h"
+#include "../src/ShaderCache.h"
+#include "Benchmark.h"
+#include "Workloads.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32) && !defined(XGFX_NOOP)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Asset Benchmarks
+// Loading what the renderer needs from disk: shaders looked up in the
+// bytecode cache, missing, hit in memory and hit in the file of an earlier
+// run, meshes cooked from their source, and cooked meshes mapped cold, read
+// from the disk rather than the OS's file cache, and warm.
+
+namespace
+{
+// Stands in for the real compiler, so lookups are measured on their own and
+// run the same on every backend
+class SyntheticShaderCompiler : public ShaderCompiler
+{
+  public:
+    const char* getId() const override { return "Synthetic"; }
+
+    bool compile(const ShaderDesc& desc, std::vector<uint8_t>& bytecode,
+                 std::string& errors) override
+    {
+        // As much bytecode as a small shader, derived from its description
+        uint64_t hash = kHashBasis;
+        hashString(hash, desc.path);
+        for (const auto& define : desc.defines)
+        {
+            hashString(hash, define.second);
+        }
+        BenchmarkRandom random(hash);
+        bytecode.resize(4096);
+        for (uint8_t& byte : bytecode)
+        {
+            byte = (uint8_t)random.next();
+        }
+        return true;
+    }
+};
+
+void writeText(const std::string& path, const std::string& text)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << text;
+    if (!file)
+    {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
+
+void benchmarkShaderCache(BenchmarkContext& context)
+{
+    const uint32_t sourceCount = 16;
+    const uint32_t variantCount = 4;
+
+    // Sources of a couple of kilobytes sharing an include, each compiled in
+    // a few variants
+    std::string common;
+    for (uint32_t i = 0; i < 32; ++i)
+    {
+        common += "float4 helper" + std::to_string(i) +
+                  "(float4 v) { return v * " + std::to_string(i) + ".0; }\n";
+    }
+    writeText(context.getScratchPath("common.hlsli"), common);
+
+    std::vector<ShaderDesc> descs;
+    for (uint32_t source = 0; source < sourceCount; ++source)
+    {
+        std::string text = "#include \"common.hlsli\"\n";
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            text += "static const float4 constant" + std::to_string(i) +
+                    " = float4(" + std::to_string(source) + ", " +
+                    std::to_string(i) + ", 0, 1);\n";
+        }
+        text += "float4 main(float4 p : POSITION) : SV_Position\n"
+                "{\n    return helper1(p) + constant0 * VARIANT;\n}\n";
+        const std::string path =
+            context.getScratchPath("shader" + std::to_string(source) + ".hlsl");
+        writeText(path, text);
+
+        for (uint32_t variant = 0; variant < variantCount; ++variant)
+        {
+            ShaderDesc desc;
+            desc.path = path;
+            desc.target = "vs_5_0";
+            desc.defines.push_back({"VARIANT", std::to_string(variant)});
+            descs.push_back(desc);
+        }
+    }
+
+    SyntheticShaderCompiler compiler;
+    const std::string cachePath = context.getScratchPath("shaders.cache");
+    auto lookUpAll = [&](ShaderCache& cache) {
+        for (const ShaderDesc& desc : descs)
+        {
+            cache.getShader(desc);
+        }
+    };
+    auto addResult = [&](const char* cache, double time) {
+        context.add(BenchmarkResult("shader_cache/lookup")
+                        .param("cache", cache)
+                        .param("shaders", (double)descs.size())
+                        .metric("ms", time)
+                        .metric("us_per_lookup", 1e3 * time / descs.size()));
+    };
+
+    // Every shader misses and is compiled into a new file
+    addResult("cold", context.measure([&]() {
+        std::remove(cachePath.c_str());
+        ShaderCache cache(cachePath, compiler);
+        lookUpAll(cache);
+        cache.save();
+    }));
+
+    // Hits in memory still hash the source and its includes
+    {
+        ShaderCache cache(cachePath, compiler);
+        addResult("memory", context.measure([&]() { lookUpAll(cache); }));
+    }
+
+    // A later run, every shader is in the file it maps
+    addResult("file", context.measure([&]() {
+        ShaderCache cache(cachePath, compiler);
+        lookUpAll(cache);
+    }));
+}
+
+// Read a byte of every page, the way uploading the data would touch it
+uint64_t touchPages(const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t sum = 0;
+    for (size_t offset = 0; offset < size; offset += 4096)
+    {
+        sum += bytes[offset];
+    }
+    return sum;
+}
+
+// Drop a file's pages from the OS's file cache, so the next read of it goes
+// to the disk
+void evictFromFileCache(const std::string& path)
+{
+#if defined(_WIN32) && !defined(XGFX_NOOP)
+    // Opening it unbuffered discards the cached pages of a file nothing else
+    // has open
+    const HANDLE file =
+        CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                    OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("failed to evict " + path);
+    }
+    CloseHandle(file);
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        throw std::runtime_error("failed to evict " + path);
+    }
+
+    // Dirty pages are kept, so they're written out first
+    const bool evicted =
+        fsync(file) == 0 &&
+        posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(file);
+    if (!evicted)
+    {
+        throw std::runtime_error("failed to evict " + path);
+    }
+#endif
+}
+
+// The source of the mesh benchmarks, returns its triangle count
+size_t writeSphere(BenchmarkContext& context, std::string& sourcePath)
+{
+    BenchmarkRandom random = context.getRandom(15);
+    CookedMesh mesh;
+    makeSphere(random, 128, 256, 0.02f, mesh);
+    sourcePath = context.getScratchPath("sphere.obj");
+    writeObj(sourcePath, mesh);
+    return mesh.indices.size() / 3;
+}
+
+void cookSphere(const std::string& sourcePath, const std::string& cookedPath)
+{
+    std::string errors;
+    if (!cookMesh(sourcePath, cookedPath, MeshCookOptions(), errors))
+    {
+        throw std::runtime_error("failed to cook mesh! " + errors);
+    }
+}
+
+uint64_t getFileBytes(const std::string& cookedPath)
+{
+    MeshFile file;
+    if (!file.open(cookedPath))
+    {
+        throw std::runtime_error("failed to open " + cookedPath);
+    }
+    return file.getHeader().fileSize;
+}
+
+// Like the first run after a mesh or the format changes
+void benchmarkMeshCook(BenchmarkContext& context)
+{
+    std::string sourcePath;
+    const size_t triangles = writeSphere(context, sourcePath);
+    const std::string cookedPath = getCookedMeshPath(sourcePath);
+    const double time = context.measure([&]() {
+        std::remove(cookedPath.c_str());
+        cookSphere(sourcePath, cookedPath);
+    });
+
+    context.add(BenchmarkResult("mesh/cook")
+                    .param("triangles", (double)triangles)
+                    .metric("ms", time)
+                    .metric("file_bytes", (double)getFileBytes(cookedPath)));
+}
+
+void benchmarkMeshLoad(BenchmarkContext& context)
+{
+    std::string sourcePath;
+    const size_t triangles = writeSphere(context, sourcePath);
+    const std::string cookedPath = getCookedMeshPath(sourcePath);
+    cookSphere(sourcePath, cookedPath);
+    const uint64_t fileBytes = getFileBytes(cookedPath);
+
+    MeshFile file;
+
+    // Volatile, so the reads aren't optimized away
+    volatile uint64_t checksum = 0;
+    auto load = [&]() {
+        if (!file.open(cookedPath))
+        {
+            throw std::runtime_error("failed to open " + cookedPath);
+        }
+        checksum += touchPages(file.getVertexData(), file.getVertexDataSize());
+        checksum += touchPages(file.getIndexData(), file.getIndexDataSize());
+        file.close();
+    };
+
+    // Cold loads read the same cooked file from the disk every time.
+    // Evicting it costs little beside the reads once its first fsync has
+    // left it clean.
+    const double coldTime = context.measure([&]() {
+        evictFromFileCache(cookedPath);
+        load();
+    });
+    const double warmTime = context.measure(load);
+
+    for (const bool cold : {true, false})
+    {
+        const double time = cold ? coldTime : warmTime;
+        context.add(BenchmarkResult("mesh/load")
+                        .param("cache", cold ? "cold" : "warm")
+                        .param("triangles", (double)triangles)
+                        .metric("ms", time)
+                        .metric("file_bytes", (double)fileBytes)
+                        .metric("mb_per_s", (double)fileBytes / time / 1e3));
+    }
+}
+} // namespace
+
+void addAssetBenchmarks(BenchmarkSuite& suite)
+{
+    suite.add("shader_cache/lookup", benchmarkShaderCache);
+    suite.add("mesh/cook", benchmarkMeshCook);
+    suite.add("mesh/load", benchmarkMeshLoad);
+}
@@ -0,0 +1,311 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+// JSON has no infinities or NaNs, they're written as null
+std::string formatJsonNumber(double value)
+{
+    if (!std::isfinite(value))
+    {
+        return "null";
+    }
+    std::ostringstream out;
+    out.precision(9);
+    out << value;
+    return out.str();
+}
+
+void makeDirectory(const std::string& path)
+{
+#if defined(_WIN32)
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+} // namespace
+
+BenchmarkRandom::BenchmarkRandom(uint64_t seed)
+    : mState(seed != 0 ? seed : 0x9e3779b97f4a7c15ull)
+{
+}
+
+uint64_t BenchmarkRandom::next()
+{
+    mState ^= mState >> 12;
+    mState ^= mState << 25;
+    mState ^= mState >> 27;
+    return mState * 0x2545f4914f6cdd1dull;
+}
+
+uint32_t BenchmarkRandom::below(uint32_t count)
+{
+    return count == 0 ? 0 : (uint32_t)((next() >> 32) % count);
+}
+
+float BenchmarkRandom::range(float minimum, float maximum)
+{
+    // The top 24 bits, which a float holds exactly
+    const float unit = (float)(next() >> 40) / (float)(1 << 24);
+    return minimum + (maximum - minimum) * unit;
+}
+
+BenchmarkResult::BenchmarkResult(const std::string& name) : mName(name) {}
+
+BenchmarkResult& BenchmarkResult::param(const std::string& key, double value)
+{
+    mParams.emplace_back(key, formatJsonNumber(value));
+    return *this;
+}
+
+BenchmarkResult& BenchmarkResult::param(const std::string& key,
+                                        const std::string& value)
+{
+    std::ostringstream out;
+    writeJsonString(out, value);
+    mParams.emplace_back(key, out.str());
+    return *this;
+}
+
+BenchmarkResult& BenchmarkResult::metric(const std::string& key, double value)
+{
+    mMetrics.emplace_back(key, value);
+    return *this;
+}
+
+const std::string& BenchmarkResult::getName() const { return mName; }
+
+void BenchmarkResult::writeJson(std::ostream& out) const
+{
+    out << "{\"name\":";
+    writeJsonString(out, mName);
+    out << ",\"params\":{";
+    for (size_t i = 0; i < mParams.size(); ++i)
+    {
+        out << (i > 0 ? "," : "");
+        writeJsonString(out, mParams[i].first);
+        out << ":" << mParams[i].second;
+    }
+    out << "},\"metrics\":{";
+    for (size_t i = 0; i < mMetrics.size(); ++i)
+    {
+        out << (i > 0 ? "," : "");
+        writeJsonString(out, mMetrics[i].first);
+        out << ":" << formatJsonNumber(mMetrics[i].second);
+    }
+    out << "}}";
+}
+
+BenchmarkContext::BenchmarkContext(const BenchmarkOptions& options)
+    : mOptions(options), mScratchCreated(false), mDevice(nullptr),
+      mQueue(nullptr), mFence(nullptr), mFenceEvent(nullptr), mFenceValue(0)
+{
+    mOptions.repeats = std::max(mOptions.repeats, 1u);
+}
+
+BenchmarkContext::~BenchmarkContext()
+{
+    if (mQueue)
+    {
+        waitForGpu();
+        mQueue->Release();
+        mQueue = nullptr;
+    }
+    if (mFence)
+    {
+        mFence->Release();
+        mFence = nullptr;
+    }
+    if (mFenceEvent)
+    {
+        CloseHandle(mFenceEvent);
+        mFenceEvent = nullptr;
+    }
+    if (mDevice)
+    {
+        mDevice->Release();
+        mDevice = nullptr;
+    }
+}
+
+const BenchmarkOptions& BenchmarkContext::getOptions() const
+{
+    return mOptions;
+}
+
+BenchmarkRandom BenchmarkContext::getRandom(uint64_t stream) const
+{
+    // Mix the stream in so neighbouring streams don't start out alike
+    BenchmarkRandom random(mOptions.seed ^ (stream * 0x9e3779b97f4a7c15ull));
+    random.next();
+    return random;
+}
+
+double BenchmarkContext::measure(const std::function<void()>& fn) const
+{
+    fn();
+    std::vector<double> times;
+    for (unsigned i = 0; i < mOptions.repeats; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        times.push_back(std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+std::string BenchmarkContext::getScratchPath(const std::string& name)
+{
+    if (!mScratchCreated)
+    {
+        makeDirectory(mOptions.scratchDirectory);
+        mScratchCreated = true;
+    }
+    return mOptions.scratchDirectory + "/" + name;
+}
+
+ID3D12Device* BenchmarkContext::getDevice()
+{
+    if (mDevice == nullptr)
+    {
+        // The default adapter, benchmarks compare runs on one machine
+        ThrowIfFailed(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0,
+                                        IID_PPV_ARGS(&mDevice)));
+    }
+    return mDevice;
+}
+
+ID3D12CommandQueue* BenchmarkContext::getQueue()
+{
+    if (mQueue == nullptr)
+    {
+        D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+        queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+        queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+        ThrowIfFailed(getDevice()->CreateCommandQueue(
+            &queueDesc, IID_PPV_ARGS(&mQueue)));
+
+        ThrowIfFailed(getDevice()->CreateFence(
+            mFenceValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+        mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        if (mFenceEvent == nullptr)
+        {
+            ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+        }
+    }
+    return mQueue;
+}
+
+UINT64 BenchmarkContext::waitForGpu()
+{
+    const UINT64 fence = ++mFenceValue;
+    ThrowIfFailed(getQueue()->Signal(mFence, fence));
+    if (mFence->GetCompletedValue() < fence)
+    {
+        ThrowIfFailed(mFence->SetEventOnCompletion(fence, mFenceEvent));
+        WaitForSingleObject(mFenceEvent, INFINITE);
+    }
+    return fence;
+}
+
+void BenchmarkContext::add(const BenchmarkResult& result)
+{
+    mResults.push_back(result);
+}
+
+const std::vector<BenchmarkResult>& BenchmarkContext::getResults() const
+{
+    return mResults;
+}
+
+void BenchmarkSuite::add(const std::string& name,
+                         const BenchmarkFunction& benchmark)
+{
+    mNames.push_back(name);
+    mBenchmarks.push_back(benchmark);
+}
+
+const std::vector<std::string>& BenchmarkSuite::getNames() const
+{
+    return mNames;
+}
+
+std::vector<std::string> BenchmarkSuite::run(BenchmarkContext& context) const
+{
+    std::vector<std::string> failures;
+    const std::string& filter = context.getOptions().filter;
+    for (size_t i = 0; i < mBenchmarks.size(); ++i)
+    {
+        if (!filter.empty() && mNames[i].find(filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        // One benchmark failing, such as a missing asset, shouldn't lose
+        // the results of the rest
+        std::cerr << mNames[i] << "... " << std::flush;
+        const auto start = std::chrono::steady_clock::now();
+        try
+        {
+            mBenchmarks[i](context);
+            std::cerr << std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count()
+                      << " s\n";
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "failed: " << e.what() << "\n";
+            failures.push_back(mNames[i]);
+        }
+    }
+    return failures;
+}
+
+const char* getBenchmarkBackend()
+{
+#if defined(XGFX_NOOP)
+    return "NOOP";
+#else
+    return "DIRECTX12";
+#endif
+}
+
+void writeJsonString(std::ostream& out, const std::string& text)
+{
+    static const char kHex[] = "0123456789abcdef";
+    out << '"';
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            out << "\\u00" << kHex[(c >> 4) & 0xf] << kHex[c & 0xf];
+        }
+        else
+        {
+            out << c;
+        }
+    }
+    out << '"';
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "../src/Backend/Backend.h"
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Benchmark
+// The harness the benchmark suite runs on. Workloads are synthetic and built
+// from a fixed seed, so every run of a commit measures the same work, and
+// each measurement is the median of several timed repeats after an untimed
+// warm-up. Results are a name, the parameters of the workload and the
+// metrics measured on it, written out together as JSON so runs can be
+// compared across commits and machines.
+
+// xorshift64*, which gives the same sequence on every platform and standard
+// library, unlike the distributions of <random>
+class BenchmarkRandom
+{
+  public:
+    BenchmarkRandom(uint64_t seed);
+
+    uint64_t next();
+
+    // Uniform in [0, count)
+    uint32_t below(uint32_t count);
+
+    // Uniform in [minimum, maximum)
+    float range(float minimum, float maximum);
+
+  protected:
+    uint64_t mState;
+};
+
+struct BenchmarkOptions
+{
+    uint64_t seed = 1;
+
+    // Timed runs of every measurement, after one untimed warm-up run
+    unsigned repeats = 5;
+
+    // Only benchmarks whose name contains it are run
+    std::string filter;
+
+    // Directory files written by benchmarks go to, such as caches and meshes
+    std::string scratchDirectory = "bench-scratch";
+};
+
+class BenchmarkResult
+{
+  public:
+    BenchmarkResult(const std::string& name);
+
+    // Both return the result, so calls can be chained
+    BenchmarkResult& param(const std::string& key, double value);
+    BenchmarkResult& param(const std::string& key, const std::string& value);
+
+    BenchmarkResult& metric(const std::string& key, double value);
+
+    const std::string& getName() const;
+
+    void writeJson(std::ostream& out) const;
+
+  protected:
+    std::string mName;
+
+    // Parameter values are kept as JSON, numbers and strings alike
+    std::vector<std::pair<std::string, std::string>> mParams;
+    std::vector<std::pair<std::string, double>> mMetrics;
+};
+
+class BenchmarkContext
+{
+  public:
+    BenchmarkContext(const BenchmarkOptions& options);
+
+    // Waits for the GPU before releasing the device
+    ~BenchmarkContext();
+
+    const BenchmarkOptions& getOptions() const;
+
+    // A generator for one workload, seeded from the suite's seed and a
+    // stream of its own so adding a workload doesn't change the others
+    BenchmarkRandom getRandom(uint64_t stream) const;
+
+    // Median time of fn over the repeats, in milliseconds
+    double measure(const std::function<void()>& fn) const;
+
+    // A file in the scratch directory, which is created on first use
+    std::string getScratchPath(const std::string& name);
+
+    // The device and its direct queue are created when first asked for, so
+    // benchmarks that don't need them run without one
+    ID3D12Device* getDevice();
+
+    ID3D12CommandQueue* getQueue();
+
+    // Block until the queue has executed everything submitted to it, returns
+    // the fence value it reached
+    UINT64 waitForGpu();
+
+    void add(const BenchmarkResult& result);
+
+    const std::vector<BenchmarkResult>& getResults() const;
+
+  protected:
+    BenchmarkOptions mOptions;
+    bool mScratchCreated;
+
+    ID3D12Device* mDevice;
+    ID3D12CommandQueue* mQueue;
+    ID3D12Fence* mFence;
+    HANDLE mFenceEvent;
+    UINT64 mFenceValue;
+
+    std::vector<BenchmarkResult> mResults;
+};
+
+typedef std::function<void(BenchmarkContext& context)> BenchmarkFunction;
+
+class BenchmarkSuite
+{
+  public:
+    void add(const std::string& name, const BenchmarkFunction& benchmark);
+
+    const std::vector<std::string>& getNames() const;
+
+    // Run every benchmark matching the filter, with progress on stderr.
+    // Returns the names of those that threw.
+    std::vector<std::string> run(BenchmarkContext& context) const;
+
+  protected:
+    std::vector<std::string> mNames;
+    std::vector<BenchmarkFunction> mBenchmarks;
+};
+
+// Name of the graphics backend benchmarks were built against
+const char* getBenchmarkBackend();
+
+// Write a string as a quoted and escaped JSON string
+void writeJsonString(std::ostream& out, const std::string& text);
+
+// Benchmarks of each part of the renderer, in the file of the same name
+void addUploadBenchmarks(BenchmarkSuite& suite);
+void addRecordingBenchmarks(BenchmarkSuite& suite);
+void addSceneBenchmarks(BenchmarkSuite& suite);
+void addAssetBenchmarks(BenchmarkSuite& suite);
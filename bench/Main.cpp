@@ -0,0 +1,119 @@
+#include "Benchmark.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Benchmark Suite
+// Times the renderer's CPU hot paths on fixed-seed synthetic workloads and
+// writes the results as JSON:
+//
+//   DirectX12SeedBench [--seed=1] [--repeats=5] [--filter=name]
+//                      [--output=results.json] [--scratch=directory]
+//                      [--list=1]
+//
+// Results go to stdout unless --output names a file, progress always goes
+// to stderr. --filter runs only the benchmarks whose name contains it. Built
+// against the NOOP backend it needs no GPU or window system, and the
+// renderer benchmark loads the app's assets from the working directory.
+
+namespace
+{
+// Returns the value of a `--name=value` command line argument
+std::string getArgument(int argc, const char** argv, const std::string& name,
+                        const std::string& defaultValue)
+{
+    const std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+        {
+            return arg.substr(prefix.size());
+        }
+    }
+    return defaultValue;
+}
+
+unsigned long long getArgument(int argc, const char** argv,
+                               const std::string& name,
+                               unsigned long long defaultValue)
+{
+    const std::string value = getArgument(argc, argv, name, std::string());
+    return value.empty() ? defaultValue : std::stoull(value);
+}
+
+void writeResults(std::ostream& out, const BenchmarkContext& context,
+                  const std::vector<std::string>& failures)
+{
+    const BenchmarkOptions& options = context.getOptions();
+    out << "{\n\"suite\":\"DirectX12SeedBench\",\n\"backend\":";
+    writeJsonString(out, getBenchmarkBackend());
+    out << ",\n\"seed\":" << options.seed << ",\n\"repeats\":"
+        << options.repeats << ",\n\"results\":[";
+    const std::vector<BenchmarkResult>& results = context.getResults();
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        out << (i > 0 ? ",\n" : "\n");
+        results[i].writeJson(out);
+    }
+    out << "\n],\n\"failures\":[";
+    for (size_t i = 0; i < failures.size(); ++i)
+    {
+        out << (i > 0 ? "," : "");
+        writeJsonString(out, failures[i]);
+    }
+    out << "]\n}\n";
+}
+} // namespace
+
+int main(int argc, const char** argv)
+{
+    BenchmarkSuite suite;
+    addUploadBenchmarks(suite);
+    addRecordingBenchmarks(suite);
+    addSceneBenchmarks(suite);
+    addAssetBenchmarks(suite);
+
+    if (getArgument(argc, argv, "list", 0) != 0)
+    {
+        for (const std::string& name : suite.getNames())
+        {
+            std::cout << name << "\n";
+        }
+        return 0;
+    }
+
+    BenchmarkOptions options;
+    options.seed = getArgument(argc, argv, "seed", options.seed);
+    options.repeats =
+        (unsigned)getArgument(argc, argv, "repeats", options.repeats);
+    options.filter = getArgument(argc, argv, "filter", options.filter);
+    options.scratchDirectory =
+        getArgument(argc, argv, "scratch", options.scratchDirectory);
+    const std::string outputPath =
+        getArgument(argc, argv, "output", std::string());
+
+    std::vector<std::string> failures;
+    {
+        // The context owns the device, which goes before results are written
+        BenchmarkContext context(options);
+        failures = suite.run(context);
+
+        if (outputPath.empty())
+        {
+            writeResults(std::cout, context, failures);
+        }
+        else
+        {
+            std::ofstream file(outputPath, std::ios::trunc);
+            writeResults(file, context, failures);
+            if (!file)
+            {
+                std::cerr << "failed to write " << outputPath << "\n";
+                return 1;
+            }
+        }
+    }
+    return failures.empty() ? 0 : 1;
+}
@@ -0,0 +1,537 @@
+#include "../src/CommandRecorder.h"
+#include "../src/DescriptorAllocator.h"
+#include "../src/DrawBatcher.h"
+#include "../src/GpuAllocator.h"
+#include "../src/JobSystem.h"
+#include "../src/RenderGraph.h"
+#include "../src/RenderThread.h"
+#include "../src/Renderer.h"
+#include "../src/RootSignatureCache.h"
+#include "../src/TransformSystem.h"
+#include "../src/UploadRing.h"
+#include "Benchmark.h"
+#include "Workloads.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Recording Benchmarks
+// Command lists recorded through the command recorder, on whichever backend
+// the suite was built with: how recording scales with threads, how many
+// objects a frame can draw with and without instancing, and what binding
+// per-draw data costs through a table, a root CBV or root constants. Render
+// graphs are compiled on their own, and whole frames are rendered offscreen
+// through the render thread.
+
+namespace
+{
+// Draws each command list records, like the renderer's default
+const uint32_t kDrawsPerBatch = 256;
+
+enum class Binding
+{
+    Table,
+    RootDescriptor,
+    RootConstants
+};
+
+const char* getBindingName(Binding binding)
+{
+    switch (binding)
+    {
+    case Binding::Table:
+        return "table";
+    case Binding::RootDescriptor:
+        return "root_cbv";
+    default:
+        return "root_constants";
+    }
+}
+
+// View constants as a root CBV, and per-draw data as the binding asks
+RootSignatureDesc getRootSignatureDesc(Binding binding)
+{
+    RootSignatureDesc desc;
+    desc.flags = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
+    desc.addConstantBuffer(0, D3D12_SHADER_VISIBILITY_VERTEX);
+    switch (binding)
+    {
+    case Binding::Table:
+        desc.addTable({{D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1}},
+                      D3D12_SHADER_VISIBILITY_VERTEX);
+        break;
+    case Binding::RootDescriptor:
+        desc.addConstantBuffer(1, D3D12_SHADER_VISIBILITY_VERTEX);
+        break;
+    case Binding::RootConstants:
+        desc.addConstants(1, sizeof(glm::mat4) / 4,
+                          D3D12_SHADER_VISIBILITY_VERTEX);
+        break;
+    }
+    return desc;
+}
+
+// What every list sets before drawing, since state doesn't carry over
+void setCommonState(ID3D12GraphicsCommandList* commandList,
+                    ID3D12RootSignature* rootSignature,
+                    D3D12_GPU_VIRTUAL_ADDRESS viewConstants)
+{
+    D3D12_VIEWPORT viewport = {};
+    viewport.Width = (float)kBenchmarkViewWidth;
+    viewport.Height = (float)kBenchmarkViewHeight;
+    viewport.MaxDepth = 1.0f;
+    D3D12_RECT scissor = {};
+    scissor.right = (LONG)kBenchmarkViewWidth;
+    scissor.bottom = (LONG)kBenchmarkViewHeight;
+
+    commandList->SetGraphicsRootSignature(rootSignature);
+    commandList->RSSetViewports(1, &viewport);
+    commandList->RSSetScissorRects(1, &scissor);
+    commandList->SetGraphicsRootConstantBufferView(0, viewConstants);
+    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+uint32_t getBatchCount(uint32_t drawCount)
+{
+    return std::max((drawCount + kDrawsPerBatch - 1) / kDrawsPerBatch, 1u);
+}
+
+std::vector<glm::mat4> makeMatrices(BenchmarkContext& context,
+                                    uint64_t stream, size_t count)
+{
+    BenchmarkRandom random = context.getRandom(stream);
+    std::vector<glm::mat4> matrices(count);
+    for (glm::mat4& matrix : matrices)
+    {
+        for (unsigned column = 0; column < 4; ++column)
+        {
+            matrix[column] =
+                glm::vec4(random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f),
+                          random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f));
+        }
+    }
+    return matrices;
+}
+
+void benchmarkThreadScaling(BenchmarkContext& context)
+{
+    const uint32_t drawCount = 100000;
+    ID3D12Device* device = context.getDevice();
+    RootSignatureCache rootSignatures(
+        device, context.getScratchPath("rootsignatures.cache"));
+    ID3D12RootSignature* rootSignature =
+        rootSignatures.get(getRootSignatureDesc(Binding::RootConstants))
+            .signature;
+    const std::vector<glm::mat4> matrices = makeMatrices(context, 9, 1024);
+
+    // Powers of two up to every hardware thread, and two at least
+    const unsigned hardwareThreads =
+        std::max(std::thread::hardware_concurrency(), 2u);
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < hardwareThreads; threads *= 2)
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardwareThreads);
+
+    double singleThreadTime = 0.0;
+    for (const unsigned threads : threadCounts)
+    {
+        JobSystem jobSystem(threads - 1);
+        CommandRecorder recorder(device, jobSystem, 2);
+        unsigned frame = 0;
+        const double time = context.measure([&]() {
+            recorder.beginFrame(frame++ % 2);
+            recorder.record(
+                getBatchCount(drawCount), nullptr,
+                [&](ID3D12GraphicsCommandList* commandList, uint32_t batch) {
+                    setCommonState(commandList, rootSignature, 0);
+                    const uint32_t first = batch * kDrawsPerBatch;
+                    const uint32_t last =
+                        std::min(first + kDrawsPerBatch, drawCount);
+                    for (uint32_t i = first; i < last; ++i)
+                    {
+                        setRootConstants(commandList, 1, matrices[i % 1024]);
+                        commandList->DrawIndexedInstanced(36, 1, 0, 0, 0);
+                    }
+                });
+            recorder.submit(context.getQueue());
+            context.waitForGpu();
+        });
+        if (threads == 1)
+        {
+            singleThreadTime = time;
+        }
+
+        context.add(BenchmarkResult("record/thread_scaling")
+                        .param("threads", threads)
+                        .param("draws", drawCount)
+                        .metric("frame_ms", time)
+                        .metric("draws_per_ms", drawCount / time)
+                        .metric("speedup", singleThreadTime / time));
+    }
+}
+
+void benchmarkDrawThroughput(BenchmarkContext& context)
+{
+    const uint32_t meshCount = 64;
+    ID3D12Device* device = context.getDevice();
+    const std::vector<MeshRange> meshes = makeBoxMeshes(meshCount);
+    RootSignatureCache rootSignatures(
+        device, context.getScratchPath("rootsignatures.cache"));
+    ID3D12RootSignature* rootSignature =
+        rootSignatures.get(getRootSignatureDesc(Binding::RootConstants))
+            .signature;
+
+    GpuAllocator allocator(device);
+    UploadRing ring(&allocator, 32 * 1024 * 1024);
+    JobSystem jobSystem(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    CommandRecorder recorder(device, jobSystem, 2);
+    DrawBatcher batcher;
+
+    for (const size_t objectCount : {1000, 10000, 100000})
+    {
+        BenchmarkRandom random = context.getRandom(11);
+        const std::vector<DrawItem> items =
+            makeScene(random, objectCount, 256.0f, meshCount, 1);
+
+        for (const bool instancing : {false, true})
+        {
+            // Batched, instance data written, recorded and submitted, the
+            // way the renderer draws a frame once culling is done
+            unsigned frame = 0;
+            auto render = [&]() {
+                batcher.build(items, instancing);
+                const UINT64 instanceBytes =
+                    batcher.getInstanceCount() * sizeof(glm::mat4);
+                const UploadAllocation instances =
+                    ring.allocate(instanceBytes);
+                batcher.writeInstances(items, (glm::mat4*)instances.cpuAddress);
+                D3D12_VERTEX_BUFFER_VIEW instanceView = {};
+                instanceView.BufferLocation = instances.gpuAddress;
+                instanceView.SizeInBytes = (UINT)instanceBytes;
+                instanceView.StrideInBytes = sizeof(glm::mat4);
+
+                const std::vector<InstancedDraw>& draws = batcher.getDraws();
+                const uint32_t drawCount = (uint32_t)draws.size();
+                recorder.beginFrame(frame++ % 2);
+                recorder.record(
+                    getBatchCount(drawCount), nullptr,
+                    [&](ID3D12GraphicsCommandList* commandList,
+                        uint32_t batch) {
+                        setCommonState(commandList, rootSignature, 0);
+                        commandList->IASetVertexBuffers(1, 1, &instanceView);
+                        const uint32_t first = batch * kDrawsPerBatch;
+                        const uint32_t last =
+                            std::min(first + kDrawsPerBatch, drawCount);
+                        for (uint32_t i = first; i < last; ++i)
+                        {
+                            const MeshRange& mesh = meshes[draws[i].mesh];
+                            commandList->DrawIndexedInstanced(
+                                mesh.indexCount, draws[i].instanceCount,
+                                mesh.firstIndex, mesh.baseVertex,
+                                draws[i].firstInstance);
+                        }
+                    });
+                recorder.submit(context.getQueue());
+                const UINT64 fence = context.waitForGpu();
+                ring.finishFrame(fence);
+                ring.retire(fence);
+            };
+            const double time = context.measure(render);
+
+            BenchmarkResult result("record/draws");
+            result.param("objects", (double)objectCount)
+                .param("instancing", instancing ? 1.0 : 0.0)
+                .metric("frame_ms", time)
+                .metric("objects_per_ms", objectCount / time)
+                .metric("draws", (double)batcher.getDraws().size());
+#if defined(XGFX_NOOP)
+            // The calls a frame makes, which the NOOP device counts
+            noopStats().reset();
+            render();
+            result.metric("api_calls", (double)noopStats().totalCalls());
+#endif
+            context.add(result);
+        }
+    }
+}
+
+void benchmarkBindingCost(BenchmarkContext& context)
+{
+    const uint32_t drawCount = 10000;
+    const UINT64 constantsSize = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+    ID3D12Device* device = context.getDevice();
+    RootSignatureCache rootSignatures(
+        device, context.getScratchPath("rootsignatures.cache"));
+    const std::vector<glm::mat4> matrices =
+        makeMatrices(context, 22, drawCount);
+
+    // Every draw's constants are already in memory, in an upload buffer for
+    // root CBVs and behind a view of their own for tables, so only binding
+    // them is measured
+    GpuAllocator allocator(device);
+    GpuAllocation* constants = allocator.createBuffer(
+        D3D12_HEAP_TYPE_UPLOAD, drawCount * constantsSize,
+        D3D12_RESOURCE_STATE_GENERIC_READ);
+    UINT8* constantsData = nullptr;
+    ThrowIfFailed(constants->resource->Map(
+        0, nullptr, reinterpret_cast<void**>(&constantsData)));
+    const D3D12_GPU_VIRTUAL_ADDRESS constantsAddress =
+        constants->resource->GetGPUVirtualAddress();
+
+    DescriptorAllocatorDesc descriptorDesc;
+    descriptorDesc.shaderVisibleDescriptors =
+        descriptorDesc.bindlessDescriptors + 4 * drawCount;
+    DescriptorAllocator descriptors(device, descriptorDesc);
+    std::vector<StagingDescriptor> views(drawCount);
+    for (uint32_t i = 0; i < drawCount; ++i)
+    {
+        memcpy(constantsData + i * constantsSize, &matrices[i],
+               sizeof(glm::mat4));
+        views[i] =
+            descriptors.allocateStaging(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        D3D12_CONSTANT_BUFFER_VIEW_DESC viewDesc = {};
+        viewDesc.BufferLocation = constantsAddress + i * constantsSize;
+        viewDesc.SizeInBytes = (UINT)constantsSize;
+        device->CreateConstantBufferView(&viewDesc, views[i].cpu);
+    }
+
+    // One thread, so the cost per draw isn't hidden by parallelism
+    JobSystem jobSystem(0);
+    CommandRecorder recorder(device, jobSystem, 2);
+    for (const Binding binding :
+         {Binding::Table, Binding::RootDescriptor, Binding::RootConstants})
+    {
+        ID3D12RootSignature* rootSignature =
+            rootSignatures.get(getRootSignatureDesc(binding)).signature;
+        unsigned frame = 0;
+        auto render = [&]() {
+            recorder.beginFrame(frame++ % 2);
+            recorder.record(
+                getBatchCount(drawCount), nullptr,
+                [&](ID3D12GraphicsCommandList* commandList, uint32_t batch) {
+                    setCommonState(commandList, rootSignature,
+                                   constantsAddress);
+                    if (binding == Binding::Table)
+                    {
+                        descriptors.setHeaps(commandList);
+                    }
+                    const uint32_t first = batch * kDrawsPerBatch;
+                    const uint32_t last =
+                        std::min(first + kDrawsPerBatch, drawCount);
+                    for (uint32_t i = first; i < last; ++i)
+                    {
+                        switch (binding)
+                        {
+                        case Binding::Table:
+                            commandList->SetGraphicsRootDescriptorTable(
+                                1, descriptors.bindTable(&views[i].cpu, 1));
+                            break;
+                        case Binding::RootDescriptor:
+                            commandList->SetGraphicsRootConstantBufferView(
+                                1, constantsAddress + i * constantsSize);
+                            break;
+                        case Binding::RootConstants:
+                            setRootConstants(commandList, 1, matrices[i]);
+                            break;
+                        }
+                        commandList->DrawIndexedInstanced(36, 1, 0, 0, 0);
+                    }
+                });
+            descriptors.flush();
+            recorder.submit(context.getQueue());
+            const UINT64 fence = context.waitForGpu();
+            descriptors.finishFrame(fence);
+            descriptors.retire(fence);
+        };
+        const double time = context.measure(render);
+
+        BenchmarkResult result("record/binding");
+        result.param("binding", getBindingName(binding))
+            .param("draws", drawCount)
+            .metric("frame_ms", time)
+            .metric("ns_per_draw", 1e6 * time / drawCount);
+#if defined(XGFX_NOOP)
+        noopStats().reset();
+        render();
+        result.metric("api_calls", (double)noopStats().totalCalls());
+#endif
+        context.add(result);
+    }
+
+    for (const StagingDescriptor& view : views)
+    {
+        descriptors.freeStaging(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, view);
+    }
+    constants->resource->Unmap(0, nullptr);
+    allocator.release(constants);
+}
+
+// A pass of a synthetic graph, writing a transient of its own
+struct SyntheticPass
+{
+    UINT64 size;
+    std::vector<uint32_t> reads;
+};
+
+void benchmarkRenderGraph(BenchmarkContext& context)
+{
+    for (const uint32_t passCount : {16u, 64u, 256u})
+    {
+        // Passes read up to two of the eight passes before them, so some
+        // outputs are never read and their passes get culled
+        BenchmarkRandom random = context.getRandom(20 + passCount);
+        std::vector<SyntheticPass> passes(passCount);
+        for (uint32_t i = 0; i < passCount; ++i)
+        {
+            passes[i].size = (UINT64)(1 + random.below(16)) * 1024 * 1024;
+            const uint32_t readCount = i == 0 ? 0 : 1 + random.below(2);
+            for (uint32_t read = 0; read < readCount; ++read)
+            {
+                passes[i].reads.push_back(
+                    i - 1 - random.below(std::min(i, 8u)));
+            }
+        }
+
+        D3D12_RESOURCE_DESC targetDesc = {};
+        targetDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        targetDesc.Width = kBenchmarkViewWidth;
+        targetDesc.Height = kBenchmarkViewHeight;
+        targetDesc.DepthOrArraySize = 1;
+        targetDesc.MipLevels = 1;
+        targetDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        targetDesc.SampleDesc.Count = 1;
+        targetDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+        // Declared and compiled every frame, like the renderer's graph.
+        // Without a device, transient sizes are given up front.
+        RenderGraph graph;
+        const RecordBatchFunction record = [](ID3D12GraphicsCommandList*,
+                                              uint32_t) {};
+        auto compile = [&]() {
+            graph.reset();
+            const RenderGraphResource backBuffer = graph.importResource(
+                "Back Buffer", nullptr, D3D12_RESOURCE_STATE_PRESENT);
+            std::vector<RenderGraphResource> outputs;
+            for (uint32_t i = 0; i < passCount; ++i)
+            {
+                const RenderGraphPass pass =
+                    graph.addPass("Pass", 1, nullptr, record);
+                for (const uint32_t read : passes[i].reads)
+                {
+                    graph.read(pass, outputs[read],
+                               D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+                }
+                outputs.push_back(graph.createTransient(
+                    "Target", targetDesc, nullptr, passes[i].size,
+                    D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+                graph.write(pass, outputs.back(),
+                            D3D12_RESOURCE_STATE_RENDER_TARGET);
+            }
+            const RenderGraphPass present =
+                graph.addPass("Present", 1, nullptr, record);
+            graph.read(present, outputs.back(),
+                       D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+            graph.write(present, backBuffer,
+                        D3D12_RESOURCE_STATE_RENDER_TARGET);
+            graph.compile();
+        };
+        const double time = context.measure(compile);
+        graph.resetStats();
+        compile();
+        const RenderGraphStats& stats = graph.getStats();
+
+        context.add(
+            BenchmarkResult("render_graph/compile")
+                .param("passes", passCount + 1)
+                .metric("compile_ms", time)
+                .metric("culled_passes", (double)stats.culledPasses)
+                .metric("barriers", (double)stats.barriers)
+                .metric("barrier_batches", (double)stats.barrierBatches)
+                .metric("transient_bytes", (double)stats.transientBytes)
+                .metric("heap_bytes", (double)stats.heapBytes)
+                .metric("aliasing_savings",
+                        stats.transientBytes > 0
+                            ? 1.0 - (double)stats.heapBytes /
+                                        (double)stats.transientBytes
+                            : 0.0));
+    }
+}
+
+void benchmarkOffscreenFrames(BenchmarkContext& context)
+{
+    // The app's scene, its assets loaded from the working directory
+    const size_t drawCount = 10000;
+    const uint64_t frameCount = 60;
+    Renderer renderer(kBenchmarkViewWidth, kBenchmarkViewHeight);
+    RenderThread renderThread(renderer);
+
+    TransformSystem transforms;
+    const size_t gridSize = (size_t)std::ceil(std::sqrt((double)drawCount));
+    for (size_t i = 0; i < drawCount; ++i)
+    {
+        const float column = (float)(i % gridSize) - (float)(gridSize - 1) / 2;
+        const float row = (float)(i / gridSize);
+        transforms.add(glm::vec3(column * 3.0f, 0.0f, row * 3.0f));
+    }
+
+    uint64_t submitted = 0;
+    auto render = [&]() {
+        for (uint64_t frame = 0; frame < frameCount; ++frame)
+        {
+            FramePacket* packet = renderThread.beginPacket();
+            transforms.rotateAll(
+                glm::angleAxis(0.01f, glm::vec3(0.0f, 1.0f, 0.0f)));
+            packet->projectionMatrix = getBenchmarkProjection();
+            packet->viewMatrix = glm::translate(glm::identity<glm::mat4>(),
+                                                glm::vec3(0.0f, 0.0f, 2.5f));
+            packet->draws.resize(drawCount);
+            transforms.computeMatrices(&packet->draws[0].modelMatrix,
+                                       sizeof(DrawItem));
+            renderThread.submitPacket(packet);
+            submitted++;
+        }
+
+        // Every frame counts once it's rendered, not when it's handed over
+        while (renderThread.getRenderedFrames() < submitted)
+        {
+            std::this_thread::yield();
+        }
+    };
+    const double time = context.measure(render);
+    renderThread.resetStats();
+    profiler().reset();
+    render();
+    renderThread.stop();
+    const RenderThreadStats stats = renderThread.getStats();
+    const FrameTimeStats frameTimes = profiler().getFrameStats();
+
+    context.add(BenchmarkResult("renderer/offscreen")
+                    .param("draws", drawCount)
+                    .param("frames", (double)frameCount)
+                    .param("width", kBenchmarkViewWidth)
+                    .param("height", kBenchmarkViewHeight)
+                    .metric("fps", 1e3 * frameCount / time)
+                    .metric("frame_ms", time / frameCount)
+                    .metric("cpu_frame_p50_ms", frameTimes.cpuFrame.p50)
+                    .metric("cpu_frame_p95_ms", frameTimes.cpuFrame.p95)
+                    .metric("cpu_frame_p99_ms", frameTimes.cpuFrame.p99)
+                    .metric("handoff_mean_ms", stats.handoffMean)
+                    .metric("handoff_max_ms", stats.handoffMax)
+                    .metric("producer_stalls", (double)stats.producerStalls)
+                    .metric("packet_growths", (double)stats.packetGrowths));
+}
+} // namespace
+
+void addRecordingBenchmarks(BenchmarkSuite& suite)
+{
+    suite.add("record/thread_scaling", benchmarkThreadScaling);
+    suite.add("record/draws", benchmarkDrawThroughput);
+    suite.add("record/binding", benchmarkBindingCost);
+    suite.add("render_graph/compile", benchmarkRenderGraph);
+    suite.add("renderer/offscreen", benchmarkOffscreenFrames);
+}
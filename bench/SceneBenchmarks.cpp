@@ -0,0 +1,209 @@
+#include "../src/ClusterCuller.h"
+#include "../src/CullingSystem.h"
+#include "../src/DrawBatcher.h"
+#include "../src/JobSystem.h"
+#include "../src/LodSelector.h"
+#include "../src/TransformSystem.h"
+#include "Benchmark.h"
+#include "Workloads.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Scene Benchmarks
+// The CPU work between a frame packet and recording: computing object
+// matrices with each transform kernel, frustum culling objects against the
+// BVH, culling the meshlets of large meshes, and selecting levels of detail.
+
+namespace
+{
+unsigned getWorkerCount()
+{
+    return std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+// Matches what the renderer hands the LOD selector
+float getProjectionScale()
+{
+    return getBenchmarkProjection()[1][1] * (float)kBenchmarkViewHeight * 0.5f;
+}
+
+void benchmarkTransforms(BenchmarkContext& context)
+{
+    const size_t objectCount = 100000;
+    const glm::mat4 viewProjection =
+        getBenchmarkProjection() * getBenchmarkView();
+    std::vector<DrawItem> items(objectCount);
+
+    double scalarTime = 0.0;
+    for (const TransformKernel kernel :
+         {TransformKernel::Scalar, TransformKernel::Sse, TransformKernel::Avx2})
+    {
+        // Unsupported kernels would fall back to another one
+        TransformSystem transforms(kernel);
+        if (transforms.getKernel() != kernel)
+        {
+            continue;
+        }
+        BenchmarkRandom random = context.getRandom(12);
+        for (size_t i = 0; i < objectCount; ++i)
+        {
+            const glm::vec3 position(random.range(-500.0f, 500.0f),
+                                     random.range(-50.0f, 50.0f),
+                                     random.range(-500.0f, 500.0f));
+            const glm::quat rotation = glm::normalize(glm::quat(
+                random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f),
+                random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f)));
+            transforms.add(position, rotation,
+                           glm::vec3(random.range(0.5f, 2.0f)));
+        }
+
+        const double time = context.measure([&]() {
+            transforms.computeMatrices(&items[0].modelMatrix, sizeof(DrawItem),
+                                       &viewProjection);
+        });
+        if (kernel == TransformKernel::Scalar)
+        {
+            scalarTime = time;
+        }
+
+        context.add(BenchmarkResult("transforms/matrices")
+                        .param("kernel", getTransformKernelName(kernel))
+                        .param("objects", objectCount)
+                        .metric("ms", time)
+                        .metric("matrices_per_ms", objectCount / time)
+                        .metric("ns_per_matrix", 1e6 * time / objectCount)
+                        .metric("speedup", scalarTime / time));
+    }
+}
+
+void benchmarkFrustumCulling(BenchmarkContext& context)
+{
+    const uint32_t meshCount = 16;
+    const std::vector<MeshRange> meshes = makeBoxMeshes(meshCount);
+    const glm::mat4 viewProjection =
+        getBenchmarkProjection() * getBenchmarkView();
+    JobSystem jobSystem(getWorkerCount());
+
+    for (const size_t objectCount : {100000, 1000000})
+    {
+        BenchmarkRandom random = context.getRandom(14);
+        const std::vector<DrawItem> items =
+            makeScene(random, objectCount, 1000.0f, meshCount, 1);
+
+        // The first cull builds the BVH, later ones only refit it
+        CullingSystem culling(jobSystem);
+        culling.cull(items, meshes, viewProjection);
+        const double buildTime = culling.getStats().buildTime;
+
+        const double time = context.measure(
+            [&]() { culling.cull(items, meshes, viewProjection); });
+        culling.resetStats();
+        culling.cull(items, meshes, viewProjection);
+        const CullingStats& stats = culling.getStats();
+
+        context.add(BenchmarkResult("culling/frustum")
+                        .param("objects", (double)objectCount)
+                        .param("threads", jobSystem.getThreadCount())
+                        .metric("frame_ms", time)
+                        .metric("objects_per_ms", objectCount / time)
+                        .metric("build_ms", buildTime)
+                        .metric("refit_ms", stats.refitTime)
+                        .metric("cull_ms", stats.cullTime)
+                        .metric("rejection_rate", stats.rejectionRate()));
+    }
+}
+
+void benchmarkClusterCulling(BenchmarkContext& context)
+{
+    const size_t objectCount = 1000;
+    BenchmarkRandom random = context.getRandom(18);
+    CookedMesh mesh;
+    makeSphere(random, 64, 128, 0.05f, mesh);
+    cookInMemory(mesh);
+    const std::vector<MeshRange> meshes = getMeshRanges(mesh);
+
+    // Every object is a draw of its own, which is what gets split into
+    // meshlets
+    const std::vector<DrawItem> items =
+        makeScene(random, objectCount, 64.0f, 1, 1);
+    const glm::mat4 viewProjection =
+        getBenchmarkProjection() * getBenchmarkView();
+    const glm::vec3 cameraPosition(0.0f);
+    DrawBatcher batcher;
+    batcher.build(items, false);
+
+    for (const bool backfaceCulling : {false, true})
+    {
+        ClusterCuller culler;
+        culler.setMeshlets(mesh.meshlets.data(),
+                           (uint32_t)mesh.meshlets.size());
+        const double time = context.measure([&]() {
+            culler.build(batcher, items, meshes, viewProjection,
+                         cameraPosition, true, backfaceCulling);
+        });
+        culler.resetStats();
+        culler.build(batcher, items, meshes, viewProjection, cameraPosition,
+                     true, backfaceCulling);
+        const ClusterCullingStats& stats = culler.getStats();
+
+        context.add(
+            BenchmarkResult("culling/clusters")
+                .param("objects", objectCount)
+                .param("meshlets_per_object", meshes[0].meshletCount)
+                .param("backface_culling", backfaceCulling ? 1.0 : 0.0)
+                .metric("frame_ms", time)
+                .metric("triangles_culled_per_ms",
+                        stats.trianglesCulledPerMillisecond())
+                .metric("triangles", (double)stats.triangles)
+                .metric("triangles_culled", (double)stats.trianglesCulled)
+                .metric("draws", (double)culler.getDraws().size()));
+    }
+}
+
+void benchmarkLodSelection(BenchmarkContext& context)
+{
+    const size_t objectCount = 100000;
+    BenchmarkRandom random = context.getRandom(19);
+    CookedMesh mesh;
+    makeSphere(random, 64, 128, 0.02f, mesh);
+    cookInMemory(mesh);
+    const std::vector<MeshRange> meshes = getMeshRanges(mesh);
+    const std::vector<DrawItem> items =
+        makeScene(random, objectCount, 1000.0f, 1, 1);
+
+    JobSystem jobSystem(getWorkerCount());
+    LodSelector selector(jobSystem);
+    const glm::vec3 cameraPosition(0.0f);
+    for (const float pixelError : {1.0f, 4.0f})
+    {
+        auto select = [&]() {
+            selector.select(items, meshes, nullptr, cameraPosition,
+                            getProjectionScale(), pixelError);
+        };
+        const double time = context.measure(select);
+        selector.resetStats();
+        select();
+        const LodStats& stats = selector.getStats();
+
+        context.add(BenchmarkResult("lod/select")
+                        .param("objects", objectCount)
+                        .param("levels", meshes[0].lodCount + 1)
+                        .param("pixel_error", pixelError)
+                        .metric("select_ms", time)
+                        .metric("ns_per_object", 1e6 * time / objectCount)
+                        .metric("triangle_reduction", stats.triangleReduction())
+                        .metric("full_triangles", (double)stats.fullTriangles)
+                        .metric("triangles", (double)stats.triangles));
+    }
+}
+} // namespace
+
+void addSceneBenchmarks(BenchmarkSuite& suite)
+{
+    suite.add("transforms/matrices", benchmarkTransforms);
+    suite.add("culling/frustum", benchmarkFrustumCulling);
+    suite.add("culling/clusters", benchmarkClusterCulling);
+    suite.add("lod/select", benchmarkLodSelection);
+}
@@ -0,0 +1,220 @@
+#include "../src/GeometryUploader.h"
+#include "../src/GpuAllocator.h"
+#include "../src/UploadRing.h"
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Upload Benchmarks
+// Per-frame constants written into the upload ring, static geometry copied
+// into default heaps through the copy queue, and placed resources against
+// committed ones.
+
+namespace
+{
+D3D12_RESOURCE_DESC getBufferDesc(UINT64 size)
+{
+    D3D12_RESOURCE_DESC desc = {};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    desc.Width = size;
+    desc.Height = 1;
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Format = DXGI_FORMAT_UNKNOWN;
+    desc.SampleDesc.Count = 1;
+    desc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+    return desc;
+}
+
+// Sizes from 64KB up to the maximum, in 4KB steps
+std::vector<UINT64> makeBufferSizes(BenchmarkRandom& random, size_t count,
+                                    UINT64 maximum)
+{
+    std::vector<UINT64> sizes(count);
+    for (UINT64& size : sizes)
+    {
+        size = 64 * 1024 + 4096 * (UINT64)random.below(
+                                      (uint32_t)((maximum - 64 * 1024) / 4096));
+    }
+    return sizes;
+}
+
+void benchmarkUniformUpload(BenchmarkContext& context)
+{
+    // A frame's worth of constants, such as one block per draw
+    const uint32_t uploadsPerFrame = 10000;
+    GpuAllocator allocator(context.getDevice());
+    UploadRing ring(&allocator, 32 * 1024 * 1024);
+
+    BenchmarkRandom random = context.getRandom(1);
+    std::vector<uint8_t> source(64 * 1024);
+    for (uint8_t& byte : source)
+    {
+        byte = (uint8_t)random.next();
+    }
+
+    for (const UINT64 size : {(UINT64)64, (UINT64)1024})
+    {
+        // Nothing is submitted, so every frame retires as soon as it's done
+        UINT64 frame = 0;
+        const double time = context.measure([&]() {
+            for (uint32_t i = 0; i < uploadsPerFrame; ++i)
+            {
+                const UploadAllocation allocation = ring.allocate(size);
+                memcpy(allocation.cpuAddress,
+                       &source[(i * size) % (source.size() - size)], size);
+            }
+            ring.finishFrame(++frame);
+            ring.retire(frame);
+        });
+
+        context.add(BenchmarkResult("upload_ring/constants")
+                        .param("bytes", (double)size)
+                        .param("uploads", uploadsPerFrame)
+                        .metric("frame_ms", time)
+                        .metric("uploads_per_ms", uploadsPerFrame / time)
+                        .metric("ns_per_upload", 1e6 * time / uploadsPerFrame)
+                        .metric("mb_per_s",
+                                (double)(size * uploadsPerFrame) / time /
+                                    1e3));
+    }
+}
+
+void benchmarkGeometryUpload(BenchmarkContext& context)
+{
+    const size_t bufferCount = 64;
+    ID3D12Device* device = context.getDevice();
+    GpuAllocator allocator(device);
+    GeometryUploader uploader(device, &allocator);
+
+    BenchmarkRandom random = context.getRandom(2);
+    const std::vector<UINT64> sizes =
+        makeBufferSizes(random, bufferCount, 2 * 1024 * 1024);
+    std::vector<uint8_t> data(2 * 1024 * 1024);
+    for (uint8_t& byte : data)
+    {
+        byte = (uint8_t)random.next();
+    }
+    UINT64 totalBytes = 0;
+    for (const UINT64 size : sizes)
+    {
+        totalBytes += size;
+    }
+
+    // Meshes are created, copied over in one batch and waited for, the way
+    // the renderer loads them
+    UINT64 frame = 0;
+    std::vector<GpuAllocation*> buffers;
+    auto upload = [&]() {
+        for (const UINT64 size : sizes)
+        {
+            buffers.push_back(uploader.createBuffer(data.data(), size));
+        }
+        uploader.waitForBatch(uploader.flush());
+        uploader.retire();
+        for (GpuAllocation* buffer : buffers)
+        {
+            allocator.release(buffer);
+        }
+        buffers.clear();
+        allocator.finishFrame(++frame);
+        allocator.retire(frame);
+    };
+    const double time = context.measure(upload);
+    uploader.resetStats();
+    upload();
+    const GeometryUploadStats& stats = uploader.getStats();
+
+    context.add(BenchmarkResult("geometry_upload/buffers")
+                    .param("buffers", bufferCount)
+                    .param("bytes", (double)totalBytes)
+                    .metric("upload_ms", time)
+                    .metric("mb_per_s", (double)totalBytes / time / 1e3)
+                    .metric("copies", (double)stats.copies)
+                    .metric("batches", (double)stats.batches)
+                    .metric("staging_stalls", (double)stats.stagingStalls)
+                    .metric("latency_max_ms", stats.latencyMax));
+}
+
+void benchmarkResourcePlacement(BenchmarkContext& context)
+{
+    const size_t bufferCount = 256;
+    ID3D12Device* device = context.getDevice();
+    BenchmarkRandom random = context.getRandom(3);
+    const std::vector<UINT64> sizes =
+        makeBufferSizes(random, bufferCount, 4 * 1024 * 1024);
+
+    // Placed in pooled heaps, released a frame later like the renderer does
+    GpuAllocator allocator(device);
+    UINT64 frame = 0;
+    std::vector<GpuAllocation*> placed;
+    const double placedTime = context.measure([&]() {
+        for (const UINT64 size : sizes)
+        {
+            placed.push_back(allocator.createBuffer(
+                D3D12_HEAP_TYPE_DEFAULT, size, D3D12_RESOURCE_STATE_COMMON));
+        }
+        for (GpuAllocation* buffer : placed)
+        {
+            allocator.release(buffer);
+        }
+        placed.clear();
+        allocator.finishFrame(++frame);
+        allocator.retire(frame);
+    });
+
+    // A heap of their own each
+    D3D12_HEAP_PROPERTIES heapProperties = {};
+    heapProperties.Type = D3D12_HEAP_TYPE_DEFAULT;
+    heapProperties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heapProperties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    heapProperties.CreationNodeMask = 1;
+    heapProperties.VisibleNodeMask = 1;
+    std::vector<ID3D12Resource*> committed;
+    const double committedTime = context.measure([&]() {
+        for (const UINT64 size : sizes)
+        {
+            const D3D12_RESOURCE_DESC desc = getBufferDesc(size);
+            ID3D12Resource* resource = nullptr;
+            ThrowIfFailed(device->CreateCommittedResource(
+                &heapProperties, D3D12_HEAP_FLAG_NONE, &desc,
+                D3D12_RESOURCE_STATE_COMMON, nullptr,
+                IID_PPV_ARGS(&resource)));
+            committed.push_back(resource);
+        }
+        for (ID3D12Resource* resource : committed)
+        {
+            resource->Release();
+        }
+        committed.clear();
+    });
+
+    // Empty heaps are freed at the end of every run, and created again by
+    // the next one, the warm-up included
+    const double runs = context.getOptions().repeats + 1.0;
+    context.add(BenchmarkResult("gpu_allocator/create_release")
+                    .param("placement", "placed")
+                    .param("buffers", bufferCount)
+                    .metric("ms", placedTime)
+                    .metric("us_per_buffer", 1e3 * placedTime / bufferCount)
+                    .metric("heaps_per_run",
+                            allocator.getStats().heapsCreated / runs));
+    context.add(BenchmarkResult("gpu_allocator/create_release")
+                    .param("placement", "committed")
+                    .param("buffers", bufferCount)
+                    .metric("ms", committedTime)
+                    .metric("us_per_buffer",
+                            1e3 * committedTime / bufferCount)
+                    .metric("heaps_per_run", bufferCount));
+}
+} // namespace
+
+void addUploadBenchmarks(BenchmarkSuite& suite)
+{
+    suite.add("upload_ring/constants", benchmarkUniformUpload);
+    suite.add("geometry_upload/buffers", benchmarkGeometryUpload);
+    suite.add("gpu_allocator/create_release", benchmarkResourcePlacement);
+}
@@ -0,0 +1,197 @@
+#include "Workloads.h"
+
+#include "../src/MeshOptimizer.h"
+#include "../src/MeshSimplifier.h"
+#include "../src/MeshletBuilder.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+void makeSphere(BenchmarkRandom& random, uint32_t rings, uint32_t segments,
+                float roughness, CookedMesh& mesh)
+{
+    mesh = CookedMesh();
+    const float pi = 3.14159265358979f;
+
+    // Every ring has a seam vertex of its own, so the grid needs no wrapping
+    for (uint32_t ring = 0; ring <= rings; ++ring)
+    {
+        const float polar = pi * (float)ring / (float)rings;
+        for (uint32_t segment = 0; segment <= segments; ++segment)
+        {
+            const float azimuth = 2.0f * pi * (float)segment / (float)segments;
+            const float normal[3] = {std::sin(polar) * std::cos(azimuth),
+                                     std::cos(polar),
+                                     std::sin(polar) * std::sin(azimuth)};
+            const float radius = 1.0f + random.range(-roughness, roughness);
+
+            MeshVertex vertex;
+            for (unsigned axis = 0; axis < 3; ++axis)
+            {
+                vertex.position[axis] = normal[axis] * radius;
+                vertex.normal[axis] = normal[axis];
+                vertex.color[axis] = 0.5f + 0.5f * normal[axis];
+            }
+            mesh.vertices.push_back(vertex);
+        }
+    }
+
+    const uint32_t stride = segments + 1;
+    for (uint32_t ring = 0; ring < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            const uint32_t corner = ring * stride + segment;
+            const uint32_t quad[6] = {corner,     corner + 1,
+                                      corner + stride, corner + 1,
+                                      corner + stride + 1, corner + stride};
+            mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+        }
+    }
+
+    MeshSubmesh submesh = {};
+    submesh.indexCount = (uint32_t)mesh.indices.size();
+    mesh.submeshes.push_back(submesh);
+}
+
+void cookInMemory(CookedMesh& mesh)
+{
+    optimizeMesh(mesh);
+    generateLods(mesh, true);
+    buildMeshlets(mesh);
+    computeSubmeshBounds(mesh);
+}
+
+void writeObj(const std::string& path, const CookedMesh& mesh)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error("failed to open " + path);
+    }
+    for (const MeshVertex& vertex : mesh.vertices)
+    {
+        file << "v " << vertex.position[0] << " " << vertex.position[1] << " "
+             << vertex.position[2] << "\n";
+    }
+    for (const MeshVertex& vertex : mesh.vertices)
+    {
+        file << "vn " << vertex.normal[0] << " " << vertex.normal[1] << " "
+             << vertex.normal[2] << "\n";
+    }
+
+    // OBJ indices count from 1
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        file << "f";
+        for (size_t corner = i; corner < i + 3; ++corner)
+        {
+            const uint32_t index = mesh.indices[corner] + 1;
+            file << " " << index << "//" << index;
+        }
+        file << "\n";
+    }
+    if (!file)
+    {
+        throw std::runtime_error("failed to write " + path);
+    }
+}
+
+std::vector<MeshRange> getMeshRanges(const CookedMesh& mesh)
+{
+    std::vector<MeshRange> meshes;
+    const uint32_t submeshCount = (uint32_t)mesh.submeshes.size();
+    for (const MeshSubmesh& submesh : mesh.submeshes)
+    {
+        MeshRange range;
+        range.indexCount = submesh.indexCount;
+        range.firstIndex = submesh.firstIndex;
+        range.baseVertex = submesh.baseVertex;
+        std::copy(submesh.boundsMin, submesh.boundsMin + 3, range.boundsMin);
+        std::copy(submesh.boundsMax, submesh.boundsMax + 3, range.boundsMax);
+        range.firstMeshlet = submesh.firstMeshlet;
+        range.meshletCount = submesh.meshletCount;
+        range.firstLod = submeshCount + submesh.firstLod;
+        range.lodCount = submesh.lodCount;
+        range.error = 0.0f;
+        meshes.push_back(range);
+    }
+    for (uint32_t i = 0; i < submeshCount; ++i)
+    {
+        const MeshSubmesh& submesh = mesh.submeshes[i];
+        for (uint32_t level = 0; level < submesh.lodCount; ++level)
+        {
+            const MeshLod& lod = mesh.lods[submesh.firstLod + level];
+            MeshRange range = meshes[i];
+            range.indexCount = lod.indexCount;
+            range.firstIndex = lod.firstIndex;
+            range.firstMeshlet = lod.firstMeshlet;
+            range.meshletCount = lod.meshletCount;
+            range.firstLod = 0;
+            range.lodCount = 0;
+            range.error = lod.error;
+            meshes.push_back(range);
+        }
+    }
+    return meshes;
+}
+
+std::vector<MeshRange> makeBoxMeshes(uint32_t count)
+{
+    std::vector<MeshRange> meshes(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        MeshRange& mesh = meshes[i];
+        mesh.indexCount = 36;
+        mesh.firstIndex = 36 * i;
+        mesh.baseVertex = 0;
+        std::fill(mesh.boundsMin, mesh.boundsMin + 3, -0.5f);
+        std::fill(mesh.boundsMax, mesh.boundsMax + 3, 0.5f);
+        mesh.firstMeshlet = 0;
+        mesh.meshletCount = 0;
+        mesh.firstLod = 0;
+        mesh.lodCount = 0;
+        mesh.error = 0.0f;
+    }
+    return meshes;
+}
+
+std::vector<DrawItem> makeScene(BenchmarkRandom& random, size_t count,
+                                float extent, uint32_t meshCount,
+                                uint32_t pipelineCount)
+{
+    std::vector<DrawItem> items(count);
+    for (DrawItem& item : items)
+    {
+        const glm::vec3 position(random.range(-extent, extent),
+                                 random.range(-extent, extent) * 0.125f,
+                                 random.range(-extent, extent));
+        const glm::vec3 axis = glm::normalize(
+            glm::vec3(random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f),
+                      random.range(-1.0f, 1.0f)) +
+            glm::vec3(0.0f, 1e-3f, 0.0f));
+        const glm::quat rotation =
+            glm::angleAxis(random.range(0.0f, 6.2831853f), axis);
+        item.modelMatrix = glm::translate(glm::identity<glm::mat4>(),
+                                          position) *
+                           glm::mat4_cast(rotation);
+        item.mesh = random.below(meshCount);
+        item.pipeline = random.below(pipelineCount);
+    }
+    return items;
+}
+
+glm::mat4 getBenchmarkProjection()
+{
+    return glm::perspective(45.0f,
+                            (float)kBenchmarkViewWidth /
+                                (float)kBenchmarkViewHeight,
+                            0.01f, 1024.0f);
+}
+
+glm::mat4 getBenchmarkView() { return glm::identity<glm::mat4>(); }
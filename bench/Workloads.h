@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../src/DrawBatcher.h"
+#include "../src/FramePacket.h"
+#include "../src/MeshCooker.h"
+#include "Benchmark.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Synthetic Workloads
+// Scenes and meshes for the benchmarks, built from a seeded generator so
+// they're the same on every run. Meshes are lumpy spheres, which have
+// triangles facing every way for cluster culling and smooth curvature for
+// simplification, and scenes are objects scattered around a camera at the
+// origin looking down +z, drawn with the app's projection.
+
+// Width and height of the view scenes are looked at with
+const unsigned kBenchmarkViewWidth = 1920;
+const unsigned kBenchmarkViewHeight = 1080;
+
+// A unit sphere of rings by segments quads, its radius jittered by up to
+// roughness, as one submesh
+void makeSphere(BenchmarkRandom& random, uint32_t rings, uint32_t segments,
+                float roughness, CookedMesh& mesh);
+
+// Run the cooker's stages on a mesh: optimize it, generate its levels of
+// detail, split it into meshlets and compute its bounds
+void cookInMemory(CookedMesh& mesh);
+
+// Write a mesh as an OBJ file the cooker can load, throws if it can't
+void writeObj(const std::string& path, const CookedMesh& mesh);
+
+// The meshes the renderer would make of a cooked mesh: every submesh, then
+// every level of detail
+std::vector<MeshRange> getMeshRanges(const CookedMesh& mesh);
+
+// Unit cubes without meshlets or levels of detail, each 36 indices further
+// along the index buffer
+std::vector<MeshRange> makeBoxMeshes(uint32_t count);
+
+// Objects scattered around the camera in a box of the given half extent,
+// an eighth as tall as it's wide, with random rotations and meshes and
+// pipelines below the counts
+std::vector<DrawItem> makeScene(BenchmarkRandom& random, size_t count,
+                                float extent, uint32_t meshCount,
+                                uint32_t pipelineCount);
+
+glm::mat4 getBenchmarkProjection();
+
+// The camera sits at the origin, looking down +z
+glm::mat4 getBenchmarkView();
@@ -0,0 +1,22 @@
+#pragma once
+
+// Graphics Backend
+// Selects which implementation of the DirectX 12 API the renderer is compiled
+// against. XGFX_NOOP swaps in a headless recording device so the renderer can
+// be profiled on machines without a GPU.
+
+#if defined(XGFX_NOOP)
+#include "Noop.h"
+#else
+#include "CrossWindow/Graphics.h"
+#endif
+
+#include <exception>
+
+inline void ThrowIfFailed(HRESULT hr)
+{
+    if (FAILED(hr))
+    {
+        throw std::exception();
+    }
+}
@@ -0,0 +1,1703 @@
+#include "Noop.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <thread>
+
+// Helpers
+
+namespace
+{
+// Fake GPU virtual address space, every resource gets a unique range
+std::atomic<UINT64> gNextGpuAddress(0x100000000ull);
+
+// Identifies serialized NOOP pipeline libraries
+const uint32_t kPipelineLibraryMagic = 0x424c504e;
+
+// Fake descriptor address space shared by every descriptor heap
+std::atomic<UINT64> gNextDescriptor(0x10000ull);
+
+const UINT kDescriptorSize = 32;
+
+// Every live descriptor heap by the start of its range, so copies can be
+// checked against the heaps they touch
+struct DescriptorHeapRange
+{
+    UINT64 end;
+    D3D12_DESCRIPTOR_HEAP_TYPE type;
+    bool shaderVisible;
+};
+
+std::mutex gDescriptorHeapMutex;
+std::map<UINT64, DescriptorHeapRange> gDescriptorHeaps;
+
+// Whether count descriptors from start lie in one live heap of the type
+bool isDescriptorRange(SIZE_T start, UINT64 count,
+                       D3D12_DESCRIPTOR_HEAP_TYPE type, bool shaderVisible)
+{
+    std::lock_guard<std::mutex> lock(gDescriptorHeapMutex);
+    auto heap = gDescriptorHeaps.upper_bound((UINT64)start);
+    if (heap == gDescriptorHeaps.begin())
+    {
+        return false;
+    }
+    --heap;
+    return heap->second.type == type &&
+           (shaderVisible || !heap->second.shaderVisible) &&
+           (UINT64)start + count * kDescriptorSize <= heap->second.end;
+}
+
+UINT64 alignUp(UINT64 value, UINT64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+UINT64 allocateGpuAddressRange(UINT64 size)
+{
+    // Committed resources are always 64KB aligned
+    return gNextGpuAddress.fetch_add(alignUp(size ? size : 1, 65536));
+}
+
+// Bytes a resource occupies, textures are assumed to be 4 bytes per texel
+// and their mips are ignored
+UINT64 resourceFootprint(const D3D12_RESOURCE_DESC& desc)
+{
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        return desc.Width;
+    }
+    return desc.Width * desc.Height * desc.DepthOrArraySize * 4 *
+           std::max(desc.SampleDesc.Count, 1u);
+}
+
+struct NoopEvent
+{
+    ID3D12Fence* fence = nullptr;
+    UINT64 value = 0;
+};
+}
+
+// Stats
+
+NoopStats::NoopStats() { reset(); }
+
+void NoopStats::reset()
+{
+    for (unsigned i = 0; i < (unsigned)NoopApiCall::Count; ++i)
+    {
+        calls[i] = 0;
+        nanoseconds[i] = 0;
+    }
+    allocations = 0;
+    allocatedBytes = 0;
+    copiedBytes = 0;
+    copiedDescriptors = 0;
+    validationErrors = 0;
+}
+
+UINT64 NoopStats::totalCalls() const
+{
+    UINT64 total = 0;
+    for (unsigned i = 0; i < (unsigned)NoopApiCall::Count; ++i)
+    {
+        total += calls[i];
+    }
+    return total;
+}
+
+UINT64 NoopStats::totalNanoseconds() const
+{
+    UINT64 total = 0;
+    for (unsigned i = 0; i < (unsigned)NoopApiCall::Count; ++i)
+    {
+        total += nanoseconds[i];
+    }
+    return total;
+}
+
+void NoopStats::report(std::ostream& out, UINT64 frames) const
+{
+    const UINT64 presented = calls[(unsigned)NoopApiCall::Present];
+    if (frames == 0)
+    {
+        frames = presented;
+    }
+    const double perFrame = frames > 0 ? 1.0 / (double)frames : 0.0;
+
+    out << "NOOP backend: " << totalCalls() << " calls, " << frames
+        << " frames, " << presented << " presented\n";
+    out << std::left << std::setw(40) << "call" << std::right << std::setw(12)
+        << "count" << std::setw(14) << "per frame" << std::setw(14)
+        << "total us" << "\n";
+
+    for (unsigned i = 0; i < (unsigned)NoopApiCall::Count; ++i)
+    {
+        if (calls[i] == 0)
+        {
+            continue;
+        }
+        out << std::left << std::setw(40) << noopApiCallName((NoopApiCall)i)
+            << std::right << std::setw(12) << calls[i] << std::setw(14)
+            << std::fixed << std::setprecision(2)
+            << (double)calls[i] * perFrame << std::setw(14)
+            << (double)nanoseconds[i] / 1000.0 << "\n";
+    }
+
+    out << "allocations: " << allocations << " (" << allocatedBytes
+        << " bytes), live resources: " << liveResources << "\n";
+    out << "copied bytes: " << copiedBytes
+        << ", copied descriptors: " << copiedDescriptors
+        << ", validation errors: " << validationErrors << "\n";
+}
+
+NoopStats& noopStats()
+{
+    static NoopStats stats;
+    return stats;
+}
+
+NoopConfig& noopConfig()
+{
+    static NoopConfig config;
+    return config;
+}
+
+const char* noopApiCallName(NoopApiCall call)
+{
+    static const char* names[] = {
+#define NOOP_API_CALL_NAME(name) #name,
+        NOOP_API_CALLS(NOOP_API_CALL_NAME)
+#undef NOOP_API_CALL_NAME
+    };
+    return call < NoopApiCall::Count ? names[(unsigned)call] : "Unknown";
+}
+
+NoopCallScope::NoopCallScope(NoopApiCall call)
+    : mCall(call), mStart(std::chrono::steady_clock::now())
+{
+}
+
+NoopCallScope::~NoopCallScope()
+{
+    const auto elapsed = std::chrono::steady_clock::now() - mStart;
+    NoopStats& stats = noopStats();
+    stats.calls[(unsigned)mCall].fetch_add(1, std::memory_order_relaxed);
+    stats.nanoseconds[(unsigned)mCall].fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+        std::memory_order_relaxed);
+}
+
+// Win32
+
+HANDLE CreateEvent(void* attributes, BOOL manualReset, BOOL initialState,
+                   LPCWSTR name)
+{
+    return new NoopEvent();
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+    delete static_cast<NoopEvent*>(handle);
+    return TRUE;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds)
+{
+    NOOP_CALL(WaitForSingleObject);
+    NoopEvent* event = static_cast<NoopEvent*>(handle);
+    if (event != nullptr && event->fence != nullptr)
+    {
+        // Sleep like a real wait would until the simulated GPU gets there
+        const auto completionTime = event->fence->getCompletionTime(event->value);
+        if (completionTime == std::chrono::steady_clock::time_point::max())
+        {
+            return WAIT_TIMEOUT;
+        }
+        std::this_thread::sleep_until(completionTime);
+        event->fence = nullptr;
+    }
+    return WAIT_OBJECT_0;
+}
+
+DWORD WaitForSingleObjectEx(HANDLE handle, DWORD milliseconds, BOOL alertable)
+{
+    return WaitForSingleObject(handle, milliseconds);
+}
+
+DWORD GetLastError() { return 0; }
+
+// COM
+
+ULONG IUnknown::AddRef() { return ++mRefCount; }
+
+ULONG IUnknown::Release()
+{
+    const ULONG count = --mRefCount;
+    if (count == 0)
+    {
+        delete this;
+    }
+    return count;
+}
+
+HRESULT IUnknown::QueryInterface(REFIID riid, void** ppvObject)
+{
+    if (ppvObject == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    AddRef();
+    *ppvObject = this;
+    return S_OK;
+}
+
+ID3DBlob::ID3DBlob(const void* data, SIZE_T size)
+    : mData((const uint8_t*)data, (const uint8_t*)data + size)
+{
+}
+
+void* ID3DBlob::GetBufferPointer() { return mData.data(); }
+
+SIZE_T ID3DBlob::GetBufferSize() { return mData.size(); }
+
+HRESULT ID3D12Object::SetName(LPCWSTR name)
+{
+    mName = name != nullptr ? name : L"";
+    return S_OK;
+}
+
+// Resources
+
+ID3D12Heap::ID3D12Heap(const D3D12_HEAP_DESC& desc)
+    : mDesc(desc), mData(new uint8_t[(size_t)desc.SizeInBytes])
+{
+    mAddress = allocateGpuAddressRange(desc.SizeInBytes);
+
+    NoopStats& stats = noopStats();
+    stats.allocations++;
+    stats.allocatedBytes += desc.SizeInBytes;
+}
+
+ID3D12Heap::~ID3D12Heap() {}
+
+D3D12_HEAP_DESC ID3D12Heap::GetDesc() { return mDesc; }
+
+uint8_t* ID3D12Heap::getData() { return mData.get(); }
+
+D3D12_GPU_VIRTUAL_ADDRESS ID3D12Heap::getGpuAddress() const { return mAddress; }
+
+ID3D12Resource::ID3D12Resource(const D3D12_HEAP_PROPERTIES& heapProperties,
+                               const D3D12_RESOURCE_DESC& desc,
+                               D3D12_RESOURCE_STATES state)
+    : mHeapProperties(heapProperties), mDesc(desc), mData(nullptr),
+      mHeap(nullptr), mState(state), mPromoted(false)
+{
+    // Textures are never mapped, so only their footprint is tracked
+    mSize = resourceFootprint(desc);
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        mStorage.resize((size_t)mSize);
+        mData = mStorage.empty() ? nullptr : mStorage.data();
+    }
+    mAddress = allocateGpuAddressRange(mSize);
+
+    NoopStats& stats = noopStats();
+    stats.allocations++;
+    stats.allocatedBytes += mSize;
+    stats.liveResources++;
+}
+
+ID3D12Resource::ID3D12Resource(ID3D12Heap* heap, UINT64 heapOffset,
+                               const D3D12_RESOURCE_DESC& desc,
+                               D3D12_RESOURCE_STATES state)
+    : mHeapProperties(heap->GetDesc().Properties), mDesc(desc),
+      mData(nullptr), mHeap(heap), mState(state), mPromoted(false)
+{
+    // Placed resources are no allocation of their own
+    mHeap->AddRef();
+    mSize = resourceFootprint(desc);
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        mData = mHeap->getData() + heapOffset;
+    }
+    mAddress = mHeap->getGpuAddress() + heapOffset;
+    noopStats().liveResources++;
+}
+
+ID3D12Resource::~ID3D12Resource()
+{
+    if (mHeap)
+    {
+        mHeap->Release();
+    }
+    noopStats().liveResources--;
+}
+
+HRESULT ID3D12Resource::Map(UINT subresource, const D3D12_RANGE* pReadRange,
+                            void** ppData)
+{
+    NOOP_CALL(Map);
+    if (mData == nullptr || mHeapProperties.Type == D3D12_HEAP_TYPE_DEFAULT)
+    {
+        return E_INVALIDARG;
+    }
+    if (ppData != nullptr)
+    {
+        *ppData = mData;
+    }
+    return S_OK;
+}
+
+void ID3D12Resource::Unmap(UINT subresource, const D3D12_RANGE* pWrittenRange)
+{
+    NOOP_CALL(Unmap);
+}
+
+D3D12_GPU_VIRTUAL_ADDRESS ID3D12Resource::GetGPUVirtualAddress()
+{
+    NOOP_CALL(GetGPUVirtualAddress);
+    return mDesc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? mAddress : 0;
+}
+
+D3D12_RESOURCE_DESC ID3D12Resource::GetDesc() { return mDesc; }
+
+uint8_t* ID3D12Resource::getData() { return mData; }
+
+UINT64 ID3D12Resource::getSize() const { return mSize; }
+
+D3D12_RESOURCE_STATES ID3D12Resource::getState() const { return mState; }
+
+ID3D12DescriptorHeap::ID3D12DescriptorHeap(
+    const D3D12_DESCRIPTOR_HEAP_DESC& desc)
+    : mDesc(desc)
+{
+    mStart = gNextDescriptor.fetch_add(
+        alignUp((UINT64)desc.NumDescriptors * kDescriptorSize + 1, 4096));
+
+    std::lock_guard<std::mutex> lock(gDescriptorHeapMutex);
+    DescriptorHeapRange& range = gDescriptorHeaps[mStart];
+    range.end = mStart + (UINT64)desc.NumDescriptors * kDescriptorSize;
+    range.type = desc.Type;
+    range.shaderVisible =
+        (desc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE) != 0;
+}
+
+ID3D12DescriptorHeap::~ID3D12DescriptorHeap()
+{
+    std::lock_guard<std::mutex> lock(gDescriptorHeapMutex);
+    gDescriptorHeaps.erase(mStart);
+}
+
+D3D12_DESCRIPTOR_HEAP_DESC ID3D12DescriptorHeap::GetDesc() { return mDesc; }
+
+D3D12_CPU_DESCRIPTOR_HANDLE
+ID3D12DescriptorHeap::GetCPUDescriptorHandleForHeapStart()
+{
+    NOOP_CALL(GetCPUDescriptorHandleForHeapStart);
+    D3D12_CPU_DESCRIPTOR_HANDLE handle;
+    handle.ptr = (SIZE_T)mStart;
+    return handle;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE
+ID3D12DescriptorHeap::GetGPUDescriptorHandleForHeapStart()
+{
+    NOOP_CALL(GetGPUDescriptorHandleForHeapStart);
+    D3D12_GPU_DESCRIPTOR_HANDLE handle;
+    handle.ptr =
+        mDesc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE ? mStart : 0;
+    return handle;
+}
+
+ID3D12RootSignature::ID3D12RootSignature(
+    std::vector<D3D12_ROOT_PARAMETER_TYPE> parameterTypes,
+    std::vector<UINT> constantCounts)
+    : mParameterTypes(std::move(parameterTypes)),
+      mConstantCounts(std::move(constantCounts))
+{
+}
+
+bool ID3D12RootSignature::checkParameter(UINT index,
+                                         D3D12_ROOT_PARAMETER_TYPE type,
+                                         UINT num32BitValues) const
+{
+    return index < mParameterTypes.size() && mParameterTypes[index] == type &&
+           num32BitValues <= mConstantCounts[index];
+}
+
+// Pipeline Library
+
+HRESULT ID3D12PipelineLibrary::StorePipeline(LPCWSTR pName,
+                                             ID3D12PipelineState* pPipeline)
+{
+    NOOP_CALL(StorePipeline);
+    if (pName == nullptr || pPipeline == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (std::find(mNames.begin(), mNames.end(), pName) != mNames.end())
+    {
+        return E_INVALIDARG;
+    }
+    mNames.push_back(pName);
+    return S_OK;
+}
+
+HRESULT ID3D12PipelineLibrary::LoadGraphicsPipeline(
+    LPCWSTR pName, const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc,
+    REFIID riid, void** ppPipelineState)
+{
+    NOOP_CALL(LoadGraphicsPipeline);
+    if (pName == nullptr || pDesc == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (std::find(mNames.begin(), mNames.end(), pName) == mNames.end())
+    {
+        return E_INVALIDARG;
+    }
+    *ppPipelineState = new ID3D12PipelineState();
+    return S_OK;
+}
+
+SIZE_T ID3D12PipelineLibrary::GetSerializedSize()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    SIZE_T size = 2 * sizeof(uint32_t);
+    for (const std::wstring& name : mNames)
+    {
+        size += (1 + name.size()) * sizeof(uint32_t);
+    }
+    return size;
+}
+
+HRESULT ID3D12PipelineLibrary::Serialize(void* pData, SIZE_T dataSizeInBytes)
+{
+    NOOP_CALL(SerializePipelineLibrary);
+    if (pData == nullptr || dataSizeInBytes < GetSerializedSize())
+    {
+        return E_INVALIDARG;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    uint32_t* out = static_cast<uint32_t*>(pData);
+    *out++ = kPipelineLibraryMagic;
+    *out++ = (uint32_t)mNames.size();
+    for (const std::wstring& name : mNames)
+    {
+        *out++ = (uint32_t)name.size();
+        for (wchar_t c : name)
+        {
+            *out++ = (uint32_t)c;
+        }
+    }
+    return S_OK;
+}
+
+// Commands
+
+ID3D12CommandSignature::ID3D12CommandSignature(UINT byteStride)
+    : mByteStride(byteStride)
+{
+}
+
+UINT ID3D12CommandSignature::getByteStride() const { return mByteStride; }
+
+ID3D12QueryHeap::ID3D12QueryHeap(const D3D12_QUERY_HEAP_DESC& desc)
+    : mDesc(desc), mValues(desc.Count, 0)
+{
+}
+
+D3D12_QUERY_HEAP_DESC ID3D12QueryHeap::getDesc() const { return mDesc; }
+
+UINT64* ID3D12QueryHeap::getValues() { return mValues.data(); }
+
+HRESULT ID3D12CommandAllocator::Reset()
+{
+    NOOP_CALL(CommandAllocatorReset);
+    return S_OK;
+}
+
+ID3D12Fence::ID3D12Fence(UINT64 initialValue) : mCompletedValue(initialValue)
+{
+}
+
+UINT64 ID3D12Fence::GetCompletedValue()
+{
+    NOOP_CALL(GetCompletedValue);
+    std::lock_guard<std::mutex> lock(mMutex);
+    return updateCompletedValue();
+}
+
+UINT64 ID3D12Fence::updateCompletedValue()
+{
+    const auto now = std::chrono::steady_clock::now();
+    while (!mPending.empty() && mPending.front().second <= now)
+    {
+        mCompletedValue = std::max(mCompletedValue, mPending.front().first);
+        mPending.pop_front();
+    }
+    return mCompletedValue;
+}
+
+std::chrono::steady_clock::time_point
+ID3D12Fence::getCompletionTime(UINT64 value)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (updateCompletedValue() >= value)
+    {
+        return std::chrono::steady_clock::time_point::min();
+    }
+    for (const auto& pending : mPending)
+    {
+        if (pending.first >= value)
+        {
+            return pending.second;
+        }
+    }
+    return std::chrono::steady_clock::time_point::max();
+}
+
+HRESULT ID3D12Fence::SetEventOnCompletion(UINT64 value, HANDLE hEvent)
+{
+    NOOP_CALL(SetEventOnCompletion);
+    NoopEvent* event = static_cast<NoopEvent*>(hEvent);
+    if (event == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    event->fence = this;
+    event->value = value;
+    return S_OK;
+}
+
+HRESULT ID3D12Fence::Signal(UINT64 value)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPending.clear();
+    mCompletedValue = value;
+    return S_OK;
+}
+
+ID3D12CommandList::ID3D12CommandList(D3D12_COMMAND_LIST_TYPE type)
+    : mType(type), mRecordedCommands(0), mClosed(false)
+{
+}
+
+D3D12_COMMAND_LIST_TYPE ID3D12CommandList::GetType() { return mType; }
+
+UINT64 ID3D12CommandList::getRecordedCommandCount() const
+{
+    return mRecordedCommands;
+}
+
+ID3D12GraphicsCommandList::ID3D12GraphicsCommandList(
+    D3D12_COMMAND_LIST_TYPE type)
+    : ID3D12CommandList(type), mRootSignature(nullptr)
+{
+}
+
+HRESULT ID3D12GraphicsCommandList::Close()
+{
+    NOOP_CALL(CommandListClose);
+    if (mClosed)
+    {
+        return E_FAIL;
+    }
+    mClosed = true;
+    return S_OK;
+}
+
+HRESULT ID3D12GraphicsCommandList::Reset(ID3D12CommandAllocator* pAllocator,
+                                         ID3D12PipelineState* pInitialState)
+{
+    NOOP_CALL(CommandListReset);
+    if (!mClosed || pAllocator == nullptr)
+    {
+        return E_FAIL;
+    }
+    mClosed = false;
+    mRecordedCommands = 0;
+    mCopies.clear();
+    mTransitions.clear();
+    mQueries.clear();
+    mRootSignature = nullptr;
+    return S_OK;
+}
+
+void ID3D12GraphicsCommandList::ClearState(ID3D12PipelineState* pPipelineState)
+{
+    NOOP_CALL(ClearState);
+    mRecordedCommands++;
+    mRootSignature = nullptr;
+}
+
+void ID3D12GraphicsCommandList::SetPipelineState(
+    ID3D12PipelineState* pPipelineState)
+{
+    NOOP_CALL(SetPipelineState);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::SetGraphicsRootSignature(
+    ID3D12RootSignature* pRootSignature)
+{
+    NOOP_CALL(SetGraphicsRootSignature);
+    mRecordedCommands++;
+    mRootSignature = pRootSignature;
+}
+
+void ID3D12GraphicsCommandList::RSSetViewports(UINT numViewports,
+                                               const D3D12_VIEWPORT* pViewports)
+{
+    NOOP_CALL(RSSetViewports);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::RSSetScissorRects(UINT numRects,
+                                                  const D3D12_RECT* pRects)
+{
+    NOOP_CALL(RSSetScissorRects);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::SetDescriptorHeaps(
+    UINT numDescriptorHeaps, ID3D12DescriptorHeap* const* ppDescriptorHeaps)
+{
+    NOOP_CALL(SetDescriptorHeaps);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::SetGraphicsRootDescriptorTable(
+    UINT rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor)
+{
+    NOOP_CALL(SetGraphicsRootDescriptorTable);
+    mRecordedCommands++;
+    checkRootParameter(rootParameterIndex,
+                       D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE);
+}
+
+void ID3D12GraphicsCommandList::SetGraphicsRootConstantBufferView(
+    UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation)
+{
+    NOOP_CALL(SetGraphicsRootConstantBufferView);
+    mRecordedCommands++;
+    checkRootParameter(rootParameterIndex, D3D12_ROOT_PARAMETER_TYPE_CBV);
+}
+
+void ID3D12GraphicsCommandList::SetGraphicsRoot32BitConstants(
+    UINT rootParameterIndex, UINT num32BitValuesToSet, const void* pSrcData,
+    UINT destOffsetIn32BitValues)
+{
+    NOOP_CALL(SetGraphicsRoot32BitConstants);
+    mRecordedCommands++;
+    checkRootParameter(rootParameterIndex,
+                       D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS,
+                       destOffsetIn32BitValues + num32BitValuesToSet);
+}
+
+void ID3D12GraphicsCommandList::ResourceBarrier(
+    UINT numBarriers, const D3D12_RESOURCE_BARRIER* pBarriers)
+{
+    NOOP_CALL(ResourceBarrier);
+    mRecordedCommands++;
+
+    for (UINT i = 0; i < numBarriers; ++i)
+    {
+        const D3D12_RESOURCE_BARRIER& barrier = pBarriers[i];
+        ID3D12Resource* resource = barrier.Transition.pResource;
+        if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION &&
+            resource != nullptr &&
+            resource->GetDesc().Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+        {
+            mTransitions.push_back({resource, barrier.Transition.StateBefore,
+                                    barrier.Transition.StateAfter,
+                                    mCopies.size()});
+        }
+    }
+}
+
+void ID3D12GraphicsCommandList::OMSetRenderTargets(
+    UINT numRenderTargetDescriptors,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* pRenderTargetDescriptors,
+    BOOL rtsSingleHandleToDescriptorRange,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* pDepthStencilDescriptor)
+{
+    NOOP_CALL(OMSetRenderTargets);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::ClearRenderTargetView(
+    D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView, const FLOAT colorRGBA[4],
+    UINT numRects, const D3D12_RECT* pRects)
+{
+    NOOP_CALL(ClearRenderTargetView);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::IASetPrimitiveTopology(
+    D3D_PRIMITIVE_TOPOLOGY primitiveTopology)
+{
+    NOOP_CALL(IASetPrimitiveTopology);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::IASetVertexBuffers(
+    UINT startSlot, UINT numViews, const D3D12_VERTEX_BUFFER_VIEW* pViews)
+{
+    NOOP_CALL(IASetVertexBuffers);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::IASetIndexBuffer(
+    const D3D12_INDEX_BUFFER_VIEW* pView)
+{
+    NOOP_CALL(IASetIndexBuffer);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::DrawIndexedInstanced(
+    UINT indexCountPerInstance, UINT instanceCount, UINT startIndexLocation,
+    INT baseVertexLocation, UINT startInstanceLocation)
+{
+    NOOP_CALL(DrawIndexedInstanced);
+    mRecordedCommands++;
+}
+
+void ID3D12GraphicsCommandList::ExecuteIndirect(
+    ID3D12CommandSignature* pCommandSignature, UINT maxCommandCount,
+    ID3D12Resource* pArgumentBuffer, UINT64 argumentBufferOffset,
+    ID3D12Resource* pCountBuffer, UINT64 countBufferOffset)
+{
+    NOOP_CALL(ExecuteIndirect);
+    mRecordedCommands += maxCommandCount;
+
+    if (pCommandSignature == nullptr || pArgumentBuffer == nullptr ||
+        argumentBufferOffset +
+                (UINT64)maxCommandCount * pCommandSignature->getByteStride() >
+            pArgumentBuffer->getSize())
+    {
+        noopStats().validationErrors++;
+    }
+}
+
+void ID3D12GraphicsCommandList::CopyBufferRegion(ID3D12Resource* pDstBuffer,
+                                                 UINT64 dstOffset,
+                                                 ID3D12Resource* pSrcBuffer,
+                                                 UINT64 srcOffset,
+                                                 UINT64 numBytes)
+{
+    NOOP_CALL(CopyBufferRegion);
+    mRecordedCommands++;
+
+    if (pDstBuffer == nullptr || pSrcBuffer == nullptr ||
+        pDstBuffer->getData() == nullptr || pSrcBuffer->getData() == nullptr ||
+        dstOffset + numBytes > pDstBuffer->getSize() ||
+        srcOffset + numBytes > pSrcBuffer->getSize())
+    {
+        noopStats().validationErrors++;
+        return;
+    }
+    mCopies.push_back({pDstBuffer, dstOffset, pSrcBuffer, srcOffset, numBytes});
+}
+
+void ID3D12GraphicsCommandList::EndQuery(ID3D12QueryHeap* pQueryHeap,
+                                         D3D12_QUERY_TYPE type, UINT index)
+{
+    NOOP_CALL(EndQuery);
+    mRecordedCommands++;
+
+    if (pQueryHeap == nullptr || type != D3D12_QUERY_TYPE_TIMESTAMP ||
+        pQueryHeap->getDesc().Type != D3D12_QUERY_HEAP_TYPE_TIMESTAMP ||
+        index >= pQueryHeap->getDesc().Count)
+    {
+        noopStats().validationErrors++;
+        return;
+    }
+    mQueries.push_back({pQueryHeap, index, 1, nullptr, 0, mRecordedCommands});
+}
+
+void ID3D12GraphicsCommandList::ResolveQueryData(
+    ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE type, UINT startIndex,
+    UINT numQueries, ID3D12Resource* pDestinationBuffer,
+    UINT64 alignedDestinationBufferOffset)
+{
+    NOOP_CALL(ResolveQueryData);
+    mRecordedCommands++;
+
+    if (pQueryHeap == nullptr || type != D3D12_QUERY_TYPE_TIMESTAMP ||
+        (UINT64)startIndex + numQueries > pQueryHeap->getDesc().Count ||
+        pDestinationBuffer == nullptr ||
+        pDestinationBuffer->getData() == nullptr ||
+        alignedDestinationBufferOffset % 8 != 0 ||
+        alignedDestinationBufferOffset + numQueries * sizeof(UINT64) >
+            pDestinationBuffer->getSize())
+    {
+        noopStats().validationErrors++;
+        return;
+    }
+    mQueries.push_back({pQueryHeap, startIndex, numQueries, pDestinationBuffer,
+                        alignedDestinationBufferOffset, mRecordedCommands});
+}
+
+void ID3D12GraphicsCommandList::checkRootParameter(
+    UINT index, D3D12_ROOT_PARAMETER_TYPE type, UINT num32BitValues)
+{
+    if (mRootSignature == nullptr ||
+        !mRootSignature->checkParameter(index, type, num32BitValues))
+    {
+        noopStats().validationErrors++;
+    }
+}
+
+ID3D12CommandQueue::ID3D12CommandQueue(const D3D12_COMMAND_QUEUE_DESC& desc)
+    : mDesc(desc), mGpuIdleTime(std::chrono::steady_clock::now())
+{
+}
+
+D3D12_COMMAND_QUEUE_DESC ID3D12CommandQueue::GetDesc() { return mDesc; }
+
+void ID3D12CommandQueue::ExecuteCommandLists(
+    UINT numCommandLists, ID3D12CommandList* const* ppCommandLists)
+{
+    NOOP_CALL(ExecuteCommandLists);
+    const NoopConfig& config = noopConfig();
+
+    UINT64 commandCount = 0;
+    UINT64 copiedBytes = 0;
+    bool queries = false;
+
+    // Buffers in the common state are promoted by a copy using them, and
+    // decay back once these lists finish, anything else has to have been
+    // transitioned
+    std::vector<ID3D12Resource*> promoted;
+    auto useForCopy = [&](ID3D12Resource* buffer,
+                          D3D12_RESOURCE_STATES state) {
+        if ((buffer->mState & state) == state)
+        {
+            return;
+        }
+        if (buffer->mState != D3D12_RESOURCE_STATE_COMMON &&
+            !buffer->mPromoted)
+        {
+            noopStats().validationErrors++;
+            return;
+        }
+        if (!buffer->mPromoted)
+        {
+            buffer->mPromoted = true;
+            promoted.push_back(buffer);
+        }
+        buffer->mState = (D3D12_RESOURCE_STATES)(buffer->mState | state);
+    };
+    auto transition = [&](const ID3D12CommandList::BufferTransition& t) {
+        if (t.resource->mState != t.before)
+        {
+            noopStats().validationErrors++;
+        }
+        t.resource->mState = t.after;
+        t.resource->mPromoted = false;
+    };
+
+    for (UINT i = 0; i < numCommandLists; ++i)
+    {
+        ID3D12CommandList* commandList = ppCommandLists[i];
+        if (!commandList->mClosed)
+        {
+            noopStats().validationErrors++;
+        }
+        commandCount += commandList->getRecordedCommandCount();
+
+        // Copies land immediately, callers still have to wait on a fence
+        // before relying on them like they would on a real GPU
+        const auto& transitions = commandList->mTransitions;
+        size_t nextTransition = 0;
+        for (size_t c = 0; c < commandList->mCopies.size(); ++c)
+        {
+            for (; nextTransition < transitions.size() &&
+                   transitions[nextTransition].copyIndex <= c;
+                 ++nextTransition)
+            {
+                transition(transitions[nextTransition]);
+            }
+            const auto& copy = commandList->mCopies[c];
+            useForCopy(copy.src, D3D12_RESOURCE_STATE_COPY_SOURCE);
+            useForCopy(copy.dst, D3D12_RESOURCE_STATE_COPY_DEST);
+            memmove(copy.dst->getData() + copy.dstOffset,
+                    copy.src->getData() + copy.srcOffset,
+                    (size_t)copy.numBytes);
+            copiedBytes += copy.numBytes;
+        }
+        for (; nextTransition < transitions.size(); ++nextTransition)
+        {
+            transition(transitions[nextTransition]);
+        }
+        queries = queries || !commandList->mQueries.empty();
+    }
+    for (ID3D12Resource* buffer : promoted)
+    {
+        if (buffer->mPromoted)
+        {
+            buffer->mState = D3D12_RESOURCE_STATE_COMMON;
+            buffer->mPromoted = false;
+        }
+    }
+    noopStats().copiedBytes += copiedBytes;
+
+    auto cost = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        config.gpuSubmitLatency + config.gpuCommandCost * commandCount);
+    if (config.gpuCopyBytesPerSecond > 0.0)
+    {
+        cost += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>((double)copiedBytes /
+                                          config.gpuCopyBytesPerSecond));
+    }
+
+    // Work starts once the GPU is idle and runs for the simulated cost
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto start = std::max(mGpuIdleTime, std::chrono::steady_clock::now());
+    mGpuIdleTime = start + cost;
+    if (!queries)
+    {
+        return;
+    }
+
+    // Commands run at an even pace after the submit latency, copies are
+    // assumed to finish with the last command
+    const auto startTicks =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            start.time_since_epoch() + config.gpuSubmitLatency)
+            .count();
+    const auto commandCost =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            config.gpuCommandCost)
+            .count();
+    UINT64 commandsBefore = 0;
+    for (UINT i = 0; i < numCommandLists; ++i)
+    {
+        ID3D12CommandList* commandList = ppCommandLists[i];
+        for (const auto& query : commandList->mQueries)
+        {
+            UINT64* values = query.heap->getValues() + query.index;
+            if (query.dst == nullptr)
+            {
+                *values = (UINT64)startTicks +
+                          (commandsBefore + query.commandIndex) * commandCost;
+            }
+            else
+            {
+                memcpy(query.dst->getData() + query.dstOffset, values,
+                       query.count * sizeof(UINT64));
+            }
+        }
+        commandsBefore += commandList->getRecordedCommandCount();
+    }
+}
+
+HRESULT ID3D12CommandQueue::Signal(ID3D12Fence* pFence, UINT64 value)
+{
+    NOOP_CALL(QueueSignal);
+    if (pFence == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    // The fence completes once the simulated GPU drains everything before it
+    std::lock_guard<std::mutex> queueLock(mMutex);
+    std::lock_guard<std::mutex> fenceLock(pFence->mMutex);
+    pFence->mPending.emplace_back(value, mGpuIdleTime);
+    return S_OK;
+}
+
+HRESULT ID3D12CommandQueue::GetTimestampFrequency(UINT64* pFrequency)
+{
+    NOOP_CALL(GetTimestampFrequency);
+    if (pFrequency == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    *pFrequency = 1000000000;
+    return S_OK;
+}
+
+HRESULT ID3D12CommandQueue::GetClockCalibration(UINT64* pGpuTimestamp,
+                                                UINT64* pCpuTimestamp)
+{
+    NOOP_CALL(GetClockCalibration);
+    if (pGpuTimestamp == nullptr || pCpuTimestamp == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    // Both clocks are the steady clock
+    *pGpuTimestamp = *pCpuTimestamp =
+        (UINT64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    return S_OK;
+}
+
+HRESULT ID3D12CommandQueue::Wait(ID3D12Fence* pFence, UINT64 value)
+{
+    NOOP_CALL(QueueWait);
+    if (pFence == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    // A wait on a value nobody has signaled yet would hang a real queue
+    const auto completionTime = pFence->getCompletionTime(value);
+    if (completionTime == std::chrono::steady_clock::time_point::max())
+    {
+        noopStats().validationErrors++;
+        return S_OK;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mGpuIdleTime = std::max(mGpuIdleTime, completionTime);
+    return S_OK;
+}
+
+// Device
+
+HRESULT ID3D12Device::CreateCommandQueue(const D3D12_COMMAND_QUEUE_DESC* pDesc,
+                                         REFIID riid, void** ppCommandQueue)
+{
+    NOOP_CALL(CreateCommandQueue);
+    *ppCommandQueue = new ID3D12CommandQueue(*pDesc);
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE type,
+                                             REFIID riid,
+                                             void** ppCommandAllocator)
+{
+    NOOP_CALL(CreateCommandAllocator);
+    *ppCommandAllocator = new ID3D12CommandAllocator();
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateCommandList(UINT nodeMask,
+                                        D3D12_COMMAND_LIST_TYPE type,
+                                        ID3D12CommandAllocator* pCommandAllocator,
+                                        ID3D12PipelineState* pInitialState,
+                                        REFIID riid, void** ppCommandList)
+{
+    NOOP_CALL(CreateCommandList);
+    if (pCommandAllocator == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    *ppCommandList = new ID3D12GraphicsCommandList(type);
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateFence(UINT64 initialValue, D3D12_FENCE_FLAGS flags,
+                                  REFIID riid, void** ppFence)
+{
+    NOOP_CALL(CreateFence);
+    *ppFence = new ID3D12Fence(initialValue);
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC* pDesc,
+                                           REFIID riid, void** ppHeap)
+{
+    NOOP_CALL(CreateDescriptorHeap);
+    if (pDesc == nullptr || pDesc->NumDescriptors == 0)
+    {
+        return E_INVALIDARG;
+    }
+    *ppHeap = new ID3D12DescriptorHeap(*pDesc);
+    return S_OK;
+}
+
+UINT ID3D12Device::GetDescriptorHandleIncrementSize(
+    D3D12_DESCRIPTOR_HEAP_TYPE descriptorHeapType)
+{
+    NOOP_CALL(GetDescriptorHandleIncrementSize);
+    return kDescriptorSize;
+}
+
+void ID3D12Device::CreateRenderTargetView(
+    ID3D12Resource* pResource, const void* pDesc,
+    D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor)
+{
+    NOOP_CALL(CreateRenderTargetView);
+    if (!isDescriptorRange(destDescriptor.ptr, 1,
+                           D3D12_DESCRIPTOR_HEAP_TYPE_RTV, false))
+    {
+        noopStats().validationErrors++;
+    }
+}
+
+void ID3D12Device::CreateConstantBufferView(
+    const D3D12_CONSTANT_BUFFER_VIEW_DESC* pDesc,
+    D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor)
+{
+    NOOP_CALL(CreateConstantBufferView);
+    if (!isDescriptorRange(destDescriptor.ptr, 1,
+                           D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true))
+    {
+        noopStats().validationErrors++;
+    }
+}
+
+void ID3D12Device::CopyDescriptors(
+    UINT numDestDescriptorRanges,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* pDestRangeStarts,
+    const UINT* pDestRangeSizes, UINT numSrcDescriptorRanges,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* pSrcRangeStarts,
+    const UINT* pSrcRangeSizes, D3D12_DESCRIPTOR_HEAP_TYPE descriptorHeapsType)
+{
+    NOOP_CALL(CopyDescriptors);
+
+    UINT64 destCount = 0;
+    bool valid = true;
+    for (UINT i = 0; i < numDestDescriptorRanges; ++i)
+    {
+        const UINT size = pDestRangeSizes != nullptr ? pDestRangeSizes[i] : 1;
+        valid = valid && isDescriptorRange(pDestRangeStarts[i].ptr, size,
+                                           descriptorHeapsType, true);
+        destCount += size;
+    }
+    UINT64 srcCount = 0;
+    for (UINT i = 0; i < numSrcDescriptorRanges; ++i)
+    {
+        const UINT size = pSrcRangeSizes != nullptr ? pSrcRangeSizes[i] : 1;
+        valid = valid && isDescriptorRange(pSrcRangeStarts[i].ptr, size,
+                                           descriptorHeapsType, false);
+        srcCount += size;
+    }
+
+    if (!valid || destCount != srcCount)
+    {
+        noopStats().validationErrors++;
+        return;
+    }
+    noopStats().copiedDescriptors += destCount;
+}
+
+void ID3D12Device::CopyDescriptorsSimple(
+    UINT numDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE destRangeStart,
+    D3D12_CPU_DESCRIPTOR_HANDLE srcRangeStart,
+    D3D12_DESCRIPTOR_HEAP_TYPE descriptorHeapsType)
+{
+    NOOP_CALL(CopyDescriptorsSimple);
+
+    if (!isDescriptorRange(destRangeStart.ptr, numDescriptors,
+                           descriptorHeapsType, true) ||
+        !isDescriptorRange(srcRangeStart.ptr, numDescriptors,
+                           descriptorHeapsType, false))
+    {
+        noopStats().validationErrors++;
+        return;
+    }
+    noopStats().copiedDescriptors += numDescriptors;
+}
+
+HRESULT ID3D12Device::CheckFeatureSupport(D3D12_FEATURE feature,
+                                          void* pFeatureSupportData,
+                                          UINT featureSupportDataSize)
+{
+    NOOP_CALL(CheckFeatureSupport);
+    if (feature == D3D12_FEATURE_ROOT_SIGNATURE &&
+        featureSupportDataSize == sizeof(D3D12_FEATURE_DATA_ROOT_SIGNATURE))
+    {
+        static_cast<D3D12_FEATURE_DATA_ROOT_SIGNATURE*>(pFeatureSupportData)
+            ->HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+        return S_OK;
+    }
+    return E_INVALIDARG;
+}
+
+HRESULT ID3D12Device::CreateRootSignature(UINT nodeMask,
+                                          const void* pBlobWithRootSignature,
+                                          SIZE_T blobLengthInBytes, REFIID riid,
+                                          void** ppvRootSignature)
+{
+    NOOP_CALL(CreateRootSignature);
+    if (pBlobWithRootSignature == nullptr || blobLengthInBytes == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    // Walk the layout D3D12SerializeVersionedRootSignature wrote
+    const uint32_t* data = (const uint32_t*)pBlobWithRootSignature;
+    const size_t size = blobLengthInBytes / sizeof(uint32_t);
+    size_t i = 3;
+    if (size < i)
+    {
+        return E_INVALIDARG;
+    }
+    std::vector<D3D12_ROOT_PARAMETER_TYPE> parameterTypes;
+    std::vector<UINT> constantCounts;
+    for (uint32_t parameter = 0; parameter < data[2]; ++parameter)
+    {
+        if (i + 2 > size)
+        {
+            return E_INVALIDARG;
+        }
+        const D3D12_ROOT_PARAMETER_TYPE type =
+            (D3D12_ROOT_PARAMETER_TYPE)data[i];
+        i += 2;
+        const size_t fields =
+            type == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE
+                ? (i < size ? 1 + 5 * (size_t)data[i] : 1)
+                : 3;
+        if (i + fields > size)
+        {
+            return E_INVALIDARG;
+        }
+        parameterTypes.push_back(type);
+        constantCounts.push_back(
+            type == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS ? data[i + 2]
+                                                              : 0);
+        i += fields;
+    }
+    *ppvRootSignature = new ID3D12RootSignature(std::move(parameterTypes),
+                                                std::move(constantCounts));
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateGraphicsPipelineState(
+    const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc, REFIID riid,
+    void** ppPipelineState)
+{
+    NOOP_CALL(CreateGraphicsPipelineState);
+    if (pDesc == nullptr || pDesc->pRootSignature == nullptr ||
+        pDesc->VS.pShaderBytecode == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    std::this_thread::sleep_for(noopConfig().pipelineCompileTime);
+    *ppPipelineState = new ID3D12PipelineState();
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateQueryHeap(const D3D12_QUERY_HEAP_DESC* pDesc,
+                                      REFIID riid, void** ppvHeap)
+{
+    NOOP_CALL(CreateQueryHeap);
+    if (pDesc == nullptr || pDesc->Count == 0 ||
+        pDesc->Type != D3D12_QUERY_HEAP_TYPE_TIMESTAMP)
+    {
+        return E_INVALIDARG;
+    }
+    *ppvHeap = new ID3D12QueryHeap(*pDesc);
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateCommandSignature(
+    const D3D12_COMMAND_SIGNATURE_DESC* pDesc,
+    ID3D12RootSignature* pRootSignature, REFIID riid,
+    void** ppvCommandSignature)
+{
+    NOOP_CALL(CreateCommandSignature);
+    if (pDesc == nullptr || pDesc->NumArgumentDescs == 0 ||
+        pDesc->pArgumentDescs == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    // Only signatures made of a single draw are supported, and the arguments
+    // have to fit in the stride
+    const D3D12_INDIRECT_ARGUMENT_DESC& last =
+        pDesc->pArgumentDescs[pDesc->NumArgumentDescs - 1];
+    if (pDesc->NumArgumentDescs != 1 ||
+        (last.Type == D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED &&
+         pDesc->ByteStride < sizeof(D3D12_DRAW_INDEXED_ARGUMENTS)) ||
+        (last.Type != D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED &&
+         last.Type != D3D12_INDIRECT_ARGUMENT_TYPE_DRAW))
+    {
+        return E_INVALIDARG;
+    }
+    *ppvCommandSignature = new ID3D12CommandSignature(pDesc->ByteStride);
+    return S_OK;
+}
+
+HRESULT ID3D12Device1::CreatePipelineLibrary(const void* pLibraryBlob,
+                                             SIZE_T blobLength, REFIID riid,
+                                             void** ppPipelineLibrary)
+{
+    NOOP_CALL(CreatePipelineLibrary);
+    ID3D12PipelineLibrary* library = new ID3D12PipelineLibrary();
+
+    // An empty blob creates an empty library
+    const uint8_t* data = static_cast<const uint8_t*>(pLibraryBlob);
+    SIZE_T offset = 0;
+    auto read = [&](uint32_t& value) {
+        if (offset + sizeof(value) > blobLength)
+        {
+            return false;
+        }
+        memcpy(&value, data + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    };
+
+    uint32_t magic = 0;
+    uint32_t count = 0;
+    if (blobLength > 0 &&
+        (!read(magic) || magic != kPipelineLibraryMagic || !read(count)))
+    {
+        library->Release();
+        return D3D12_ERROR_DRIVER_VERSION_MISMATCH;
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t length = 0;
+        std::wstring name;
+        bool valid = read(length);
+        for (uint32_t c = 0; valid && c < length; ++c)
+        {
+            uint32_t character = 0;
+            valid = read(character);
+            name += (wchar_t)character;
+        }
+        if (!valid)
+        {
+            library->Release();
+            return E_INVALIDARG;
+        }
+        library->mNames.push_back(name);
+    }
+
+    *ppPipelineLibrary = library;
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateCommittedResource(
+    const D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS heapFlags,
+    const D3D12_RESOURCE_DESC* pDesc, D3D12_RESOURCE_STATES initialResourceState,
+    const D3D12_CLEAR_VALUE* pOptimizedClearValue, REFIID riidResource,
+    void** ppvResource)
+{
+    NOOP_CALL(CreateCommittedResource);
+    if (pHeapProperties == nullptr || pDesc == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+    *ppvResource =
+        new ID3D12Resource(*pHeapProperties, *pDesc, initialResourceState);
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreateHeap(const D3D12_HEAP_DESC* pDesc, REFIID riid,
+                                 void** ppvHeap)
+{
+    NOOP_CALL(CreateHeap);
+    if (pDesc == nullptr || pDesc->SizeInBytes == 0)
+    {
+        return E_INVALIDARG;
+    }
+    *ppvHeap = new ID3D12Heap(*pDesc);
+    return S_OK;
+}
+
+HRESULT ID3D12Device::CreatePlacedResource(
+    ID3D12Heap* pHeap, UINT64 heapOffset, const D3D12_RESOURCE_DESC* pDesc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* pOptimizedClearValue, REFIID riid,
+    void** ppvResource)
+{
+    NOOP_CALL(CreatePlacedResource);
+    if (pHeap == nullptr || pDesc == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    // The resource has to lie within the heap at its placement alignment
+    const D3D12_RESOURCE_ALLOCATION_INFO info =
+        GetResourceAllocationInfo(0, 1, pDesc);
+    if (heapOffset % info.Alignment != 0 ||
+        heapOffset + info.SizeInBytes > pHeap->GetDesc().SizeInBytes)
+    {
+        noopStats().validationErrors++;
+        return E_INVALIDARG;
+    }
+    *ppvResource = new ID3D12Resource(pHeap, heapOffset, *pDesc, initialState);
+    return S_OK;
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO ID3D12Device::GetResourceAllocationInfo(
+    UINT visibleMask, UINT numResourceDescs,
+    const D3D12_RESOURCE_DESC* pResourceDescs)
+{
+    NOOP_CALL(GetResourceAllocationInfo);
+    D3D12_RESOURCE_ALLOCATION_INFO info = {0, 1};
+    for (UINT i = 0; i < numResourceDescs; ++i)
+    {
+        const D3D12_RESOURCE_DESC& desc = pResourceDescs[i];
+        const UINT64 footprint = resourceFootprint(desc);
+
+        // Small textures may ask for 4KB placement, like real drivers allow
+        // when the whole texture fits in 64KB
+        UINT64 alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        if (desc.SampleDesc.Count > 1)
+        {
+            alignment = D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT;
+        }
+        else if (desc.Dimension != D3D12_RESOURCE_DIMENSION_BUFFER &&
+                 desc.Alignment == D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT &&
+                 !(desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
+                                 D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) &&
+                 footprint <= D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT)
+        {
+            alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+        }
+
+        info.SizeInBytes = alignUp(info.SizeInBytes, alignment) +
+                           alignUp(footprint ? footprint : 1, alignment);
+        info.Alignment = std::max(info.Alignment, alignment);
+    }
+    return info;
+}
+
+// DXGI
+
+HRESULT IDXGIAdapter1::GetDesc1(DXGI_ADAPTER_DESC1* pDesc)
+{
+    NOOP_CALL(GetDesc1);
+    *pDesc = {};
+    const wchar_t name[] = L"NOOP Adapter";
+    std::copy(std::begin(name), std::end(name), pDesc->Description);
+    return S_OK;
+}
+
+IDXGISwapChain1::IDXGISwapChain1(const DXGI_SWAP_CHAIN_DESC1& desc)
+    : mDesc(desc), mCurrentBuffer(0)
+{
+    createBuffers();
+}
+
+IDXGISwapChain1::~IDXGISwapChain1() { releaseBuffers(); }
+
+void IDXGISwapChain1::createBuffers()
+{
+    D3D12_HEAP_PROPERTIES heapProps = {};
+    heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+
+    D3D12_RESOURCE_DESC bufferDesc = {};
+    bufferDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    bufferDesc.Width = mDesc.Width;
+    bufferDesc.Height = mDesc.Height;
+    bufferDesc.DepthOrArraySize = 1;
+    bufferDesc.MipLevels = 1;
+    bufferDesc.Format = mDesc.Format;
+    bufferDesc.SampleDesc.Count = 1;
+    bufferDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+    for (UINT i = 0; i < mDesc.BufferCount; ++i)
+    {
+        mBuffers.push_back(new ID3D12Resource(heapProps, bufferDesc));
+    }
+    mCurrentBuffer = 0;
+}
+
+void IDXGISwapChain1::releaseBuffers()
+{
+    for (ID3D12Resource* buffer : mBuffers)
+    {
+        buffer->Release();
+    }
+    mBuffers.clear();
+}
+
+HRESULT IDXGISwapChain1::GetBuffer(UINT buffer, REFIID riid, void** ppSurface)
+{
+    NOOP_CALL(GetBuffer);
+    if (buffer >= mBuffers.size())
+    {
+        return E_INVALIDARG;
+    }
+    mBuffers[buffer]->AddRef();
+    *ppSurface = mBuffers[buffer];
+    return S_OK;
+}
+
+HRESULT IDXGISwapChain1::Present(UINT syncInterval, UINT flags)
+{
+    NOOP_CALL(Present);
+    mCurrentBuffer = (mCurrentBuffer + 1) % (UINT)mBuffers.size();
+    return S_OK;
+}
+
+HRESULT IDXGISwapChain1::ResizeBuffers(UINT bufferCount, UINT width,
+                                       UINT height, DXGI_FORMAT newFormat,
+                                       UINT swapChainFlags)
+{
+    NOOP_CALL(ResizeBuffers);
+    if (bufferCount > 0)
+    {
+        mDesc.BufferCount = bufferCount;
+    }
+    mDesc.Width = width;
+    mDesc.Height = height;
+    if (newFormat != DXGI_FORMAT_UNKNOWN)
+    {
+        mDesc.Format = newFormat;
+    }
+    releaseBuffers();
+    createBuffers();
+    return S_OK;
+}
+
+HRESULT IDXGISwapChain1::SetFullscreenState(BOOL fullscreen,
+                                            IDXGIOutput* pTarget)
+{
+    NOOP_CALL(SetFullscreenState);
+    return S_OK;
+}
+
+IDXGISwapChain3::IDXGISwapChain3(const DXGI_SWAP_CHAIN_DESC1& desc)
+    : IDXGISwapChain1(desc)
+{
+}
+
+UINT IDXGISwapChain3::GetCurrentBackBufferIndex()
+{
+    NOOP_CALL(GetCurrentBackBufferIndex);
+    return mCurrentBuffer;
+}
+
+HRESULT IDXGIFactory4::EnumAdapters1(UINT adapter, IDXGIAdapter1** ppAdapter)
+{
+    NOOP_CALL(EnumAdapters1);
+    if (adapter > 0)
+    {
+        return DXGI_ERROR_NOT_FOUND;
+    }
+    *ppAdapter = new IDXGIAdapter1();
+    return S_OK;
+}
+
+HRESULT IDXGIFactory4::CreateSwapChainForComposition(
+    IUnknown* pDevice, const DXGI_SWAP_CHAIN_DESC1* pDesc,
+    IDXGIOutput* pRestrictToOutput, IDXGISwapChain1** ppSwapChain)
+{
+    NOOP_CALL(CreateSwapChainForComposition);
+    if (pDevice == nullptr || pDesc == nullptr || pDesc->BufferCount == 0)
+    {
+        return E_INVALIDARG;
+    }
+    *ppSwapChain = new IDXGISwapChain3(*pDesc);
+    return S_OK;
+}
+
+// Free Functions
+
+HRESULT CreateDXGIFactory2(UINT flags, REFIID riid, void** ppFactory)
+{
+    NOOP_CALL(CreateDXGIFactory2);
+    *ppFactory = new IDXGIFactory4();
+    return S_OK;
+}
+
+HRESULT D3D12CreateDevice(IUnknown* pAdapter,
+                          D3D_FEATURE_LEVEL minimumFeatureLevel, REFIID riid,
+                          void** ppDevice)
+{
+    NOOP_CALL(D3D12CreateDevice);
+    // A null output only checks for support
+    if (ppDevice != nullptr)
+    {
+        *ppDevice = new ID3D12Device1();
+    }
+    return S_OK;
+}
+
+HRESULT D3D12SerializeVersionedRootSignature(
+    const D3D12_VERSIONED_ROOT_SIGNATURE_DESC* pRootSignature, ID3DBlob** ppBlob,
+    ID3DBlob** ppErrorBlob)
+{
+    NOOP_CALL(D3D12SerializeVersionedRootSignature);
+    if (pRootSignature == nullptr || ppBlob == nullptr)
+    {
+        return E_INVALIDARG;
+    }
+
+    // Serialize the parameter layout, which is all the NOOP device looks at
+    std::vector<uint32_t> data;
+    const D3D12_ROOT_SIGNATURE_DESC1& desc = pRootSignature->Desc_1_1;
+    data.push_back(pRootSignature->Version);
+    data.push_back(desc.Flags);
+    data.push_back(desc.NumParameters);
+    for (UINT i = 0; i < desc.NumParameters; ++i)
+    {
+        const D3D12_ROOT_PARAMETER1& parameter = desc.pParameters[i];
+        data.push_back(parameter.ParameterType);
+        data.push_back(parameter.ShaderVisibility);
+        switch (parameter.ParameterType)
+        {
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            data.push_back(parameter.DescriptorTable.NumDescriptorRanges);
+            for (UINT r = 0; r < parameter.DescriptorTable.NumDescriptorRanges;
+                 ++r)
+            {
+                const D3D12_DESCRIPTOR_RANGE1& range =
+                    parameter.DescriptorTable.pDescriptorRanges[r];
+                data.push_back(range.RangeType);
+                data.push_back(range.NumDescriptors);
+                data.push_back(range.BaseShaderRegister);
+                data.push_back(range.RegisterSpace);
+                data.push_back(range.OffsetInDescriptorsFromTableStart);
+            }
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            data.push_back(parameter.Constants.ShaderRegister);
+            data.push_back(parameter.Constants.RegisterSpace);
+            data.push_back(parameter.Constants.Num32BitValues);
+            break;
+        default:
+            data.push_back(parameter.Descriptor.ShaderRegister);
+            data.push_back(parameter.Descriptor.RegisterSpace);
+            data.push_back(parameter.Descriptor.Flags);
+            break;
+        }
+    }
+    *ppBlob = new ID3DBlob(data.data(), data.size() * sizeof(uint32_t));
+    if (ppErrorBlob != nullptr)
+    {
+        *ppErrorBlob = nullptr;
+    }
+    return S_OK;
+}
+
+HRESULT D3DCompileFromFile(LPCWSTR pFileName, const D3D_SHADER_MACRO* pDefines,
+                           ID3DInclude* pInclude, LPCSTR pEntrypoint,
+                           LPCSTR pTarget, UINT flags1, UINT flags2,
+                           ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs)
+{
+    NOOP_CALL(D3DCompileFromFile);
+    std::string path;
+    for (const wchar_t* c = pFileName; *c != L'\0'; ++c)
+    {
+        path += (char)*c;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        const std::string error = "failed to open " + path + "\n";
+        if (ppErrorMsgs != nullptr)
+        {
+            *ppErrorMsgs = new ID3DBlob(error.c_str(), error.size() + 1);
+        }
+        return E_FAIL;
+    }
+
+    std::vector<char> source((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+    std::this_thread::sleep_for(noopConfig().shaderCompileTime);
+    *ppCode = new ID3DBlob(source.data(), source.size());
+    if (ppErrorMsgs != nullptr)
+    {
+        *ppErrorMsgs = nullptr;
+    }
+    return S_OK;
+}
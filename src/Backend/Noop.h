@@ -0,0 +1,1626 @@
+#pragma once
+
+// NOOP Graphics Backend
+// Mirrors the subset of the DirectX 12 / DXGI API surface the renderer uses
+// so the exact same Renderer code can run on machines without a GPU. No work
+// is ever executed, but every call is counted and timed, and resources are
+// backed by plain CPU memory so mapped writes behave like they would on an
+// upload heap.
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Win32 Types
+
+typedef int32_t HRESULT;
+typedef int32_t INT;
+typedef uint32_t UINT;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint64_t UINT64;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef float FLOAT;
+typedef size_t SIZE_T;
+typedef wchar_t WCHAR;
+typedef const char* LPCSTR;
+typedef const wchar_t* LPCWSTR;
+typedef void* HANDLE;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+#define DXGI_ERROR_NOT_FOUND ((HRESULT)0x887A0002)
+#define D3D12_ERROR_ADAPTER_NOT_FOUND ((HRESULT)0x887E0001)
+#define D3D12_ERROR_DRIVER_VERSION_MISMATCH ((HRESULT)0x887E0002)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define HRESULT_FROM_WIN32(x)                                                  \
+    ((HRESULT)(x) <= 0 ? ((HRESULT)(x))                                        \
+                       : ((HRESULT)(((x)&0x0000FFFF) | (7 << 16) | 0x80000000)))
+#define INFINITE 0xFFFFFFFF
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 0x102
+
+#ifndef _countof
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+#endif
+
+HANDLE CreateEvent(void* attributes, BOOL manualReset, BOOL initialState,
+                   LPCWSTR name);
+BOOL CloseHandle(HANDLE handle);
+DWORD WaitForSingleObject(HANDLE handle, DWORD milliseconds);
+DWORD WaitForSingleObjectEx(HANDLE handle, DWORD milliseconds, BOOL alertable);
+DWORD GetLastError();
+
+// COM
+
+struct GUID
+{
+    const void* id;
+};
+typedef const GUID& REFIID;
+
+template <typename T> REFIID noopUuidOf()
+{
+    static const char tag = 0;
+    static const GUID guid = {&tag};
+    return guid;
+}
+
+#define __uuidof(T) noopUuidOf<T>()
+#define _uuidof(T) noopUuidOf<T>()
+#define IID_PPV_ARGS(ppType)                                                   \
+    noopUuidOf<typename std::decay<decltype(**(ppType))>::type>(),             \
+        reinterpret_cast<void**>(ppType)
+
+class IUnknown
+{
+  public:
+    virtual ~IUnknown() {}
+
+    ULONG AddRef();
+
+    ULONG Release();
+
+    HRESULT QueryInterface(REFIID riid, void** ppvObject);
+
+    template <typename T> HRESULT QueryInterface(T** ppvObject)
+    {
+        return QueryInterface(__uuidof(T), reinterpret_cast<void**>(ppvObject));
+    }
+
+  protected:
+    std::atomic<ULONG> mRefCount{1};
+};
+
+class ID3DBlob : public IUnknown
+{
+  public:
+    ID3DBlob(const void* data, SIZE_T size);
+
+    void* GetBufferPointer();
+
+    SIZE_T GetBufferSize();
+
+  protected:
+    std::vector<uint8_t> mData;
+};
+
+class ID3D12Object : public IUnknown
+{
+  public:
+    HRESULT SetName(LPCWSTR name);
+
+  protected:
+    std::wstring mName;
+};
+
+// Enums
+
+enum DXGI_FORMAT
+{
+    DXGI_FORMAT_UNKNOWN = 0,
+    DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+    DXGI_FORMAT_R32G32B32_FLOAT = 6,
+    DXGI_FORMAT_R16G16B16A16_FLOAT = 10,
+    DXGI_FORMAT_R16G16B16A16_UNORM = 11,
+    DXGI_FORMAT_R32G32_FLOAT = 16,
+    DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+    DXGI_FORMAT_R16G16_FLOAT = 34,
+    DXGI_FORMAT_R16G16_SNORM = 37,
+    DXGI_FORMAT_D32_FLOAT = 40,
+    DXGI_FORMAT_R32_FLOAT = 41,
+    DXGI_FORMAT_R32_UINT = 42,
+    DXGI_FORMAT_R16_UINT = 57
+};
+
+enum D3D_FEATURE_LEVEL
+{
+    D3D_FEATURE_LEVEL_11_0 = 0xb000,
+    D3D_FEATURE_LEVEL_12_0 = 0xc000,
+    D3D_FEATURE_LEVEL_12_1 = 0xc100
+};
+
+enum D3D_PRIMITIVE_TOPOLOGY
+{
+    D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+    D3D_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+    D3D_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+    D3D_PRIMITIVE_TOPOLOGY_LINESTRIP = 3,
+    D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+    D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5
+};
+
+enum D3D_ROOT_SIGNATURE_VERSION
+{
+    D3D_ROOT_SIGNATURE_VERSION_1 = 0x1,
+    D3D_ROOT_SIGNATURE_VERSION_1_0 = 0x1,
+    D3D_ROOT_SIGNATURE_VERSION_1_1 = 0x2
+};
+
+enum D3D12_COMMAND_LIST_TYPE
+{
+    D3D12_COMMAND_LIST_TYPE_DIRECT = 0,
+    D3D12_COMMAND_LIST_TYPE_BUNDLE = 1,
+    D3D12_COMMAND_LIST_TYPE_COMPUTE = 2,
+    D3D12_COMMAND_LIST_TYPE_COPY = 3
+};
+
+enum D3D12_COMMAND_QUEUE_FLAGS
+{
+    D3D12_COMMAND_QUEUE_FLAG_NONE = 0,
+    D3D12_COMMAND_QUEUE_FLAG_DISABLE_GPU_TIMEOUT = 0x1
+};
+
+enum D3D12_FENCE_FLAGS
+{
+    D3D12_FENCE_FLAG_NONE = 0,
+    D3D12_FENCE_FLAG_SHARED = 0x1
+};
+
+enum D3D12_DESCRIPTOR_HEAP_TYPE
+{
+    D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV = 0,
+    D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER = 1,
+    D3D12_DESCRIPTOR_HEAP_TYPE_RTV = 2,
+    D3D12_DESCRIPTOR_HEAP_TYPE_DSV = 3,
+    D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES = 4
+};
+
+enum D3D12_DESCRIPTOR_HEAP_FLAGS
+{
+    D3D12_DESCRIPTOR_HEAP_FLAG_NONE = 0,
+    D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE = 0x1
+};
+
+enum D3D12_HEAP_TYPE
+{
+    D3D12_HEAP_TYPE_DEFAULT = 1,
+    D3D12_HEAP_TYPE_UPLOAD = 2,
+    D3D12_HEAP_TYPE_READBACK = 3,
+    D3D12_HEAP_TYPE_CUSTOM = 4
+};
+
+enum D3D12_QUERY_HEAP_TYPE
+{
+    D3D12_QUERY_HEAP_TYPE_OCCLUSION = 0,
+    D3D12_QUERY_HEAP_TYPE_TIMESTAMP = 1
+};
+
+enum D3D12_QUERY_TYPE
+{
+    D3D12_QUERY_TYPE_OCCLUSION = 0,
+    D3D12_QUERY_TYPE_BINARY_OCCLUSION = 1,
+    D3D12_QUERY_TYPE_TIMESTAMP = 2
+};
+
+enum D3D12_CPU_PAGE_PROPERTY
+{
+    D3D12_CPU_PAGE_PROPERTY_UNKNOWN = 0,
+    D3D12_CPU_PAGE_PROPERTY_NOT_AVAILABLE = 1,
+    D3D12_CPU_PAGE_PROPERTY_WRITE_COMBINE = 2,
+    D3D12_CPU_PAGE_PROPERTY_WRITE_BACK = 3
+};
+
+enum D3D12_MEMORY_POOL
+{
+    D3D12_MEMORY_POOL_UNKNOWN = 0,
+    D3D12_MEMORY_POOL_L0 = 1,
+    D3D12_MEMORY_POOL_L1 = 2
+};
+
+enum D3D12_HEAP_FLAGS
+{
+    D3D12_HEAP_FLAG_NONE = 0,
+    D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS = 0xc0,
+    D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES = 0x44,
+    D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES = 0x84
+};
+
+#define D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT 65536
+#define D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT 4096
+#define D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT 4194304
+
+enum D3D12_RESOURCE_DIMENSION
+{
+    D3D12_RESOURCE_DIMENSION_UNKNOWN = 0,
+    D3D12_RESOURCE_DIMENSION_BUFFER = 1,
+    D3D12_RESOURCE_DIMENSION_TEXTURE1D = 2,
+    D3D12_RESOURCE_DIMENSION_TEXTURE2D = 3,
+    D3D12_RESOURCE_DIMENSION_TEXTURE3D = 4
+};
+
+enum D3D12_TEXTURE_LAYOUT
+{
+    D3D12_TEXTURE_LAYOUT_UNKNOWN = 0,
+    D3D12_TEXTURE_LAYOUT_ROW_MAJOR = 1
+};
+
+enum D3D12_RESOURCE_FLAGS
+{
+    D3D12_RESOURCE_FLAG_NONE = 0,
+    D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET = 0x1,
+    D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL = 0x2,
+    D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS = 0x4
+};
+
+enum D3D12_RESOURCE_STATES
+{
+    D3D12_RESOURCE_STATE_COMMON = 0,
+    D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1,
+    D3D12_RESOURCE_STATE_INDEX_BUFFER = 0x2,
+    D3D12_RESOURCE_STATE_RENDER_TARGET = 0x4,
+    D3D12_RESOURCE_STATE_UNORDERED_ACCESS = 0x8,
+    D3D12_RESOURCE_STATE_DEPTH_WRITE = 0x10,
+    D3D12_RESOURCE_STATE_DEPTH_READ = 0x20,
+    D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE = 0x40,
+    D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE = 0x80,
+    D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT = 0x200,
+    D3D12_RESOURCE_STATE_COPY_DEST = 0x400,
+    D3D12_RESOURCE_STATE_COPY_SOURCE = 0x800,
+    D3D12_RESOURCE_STATE_GENERIC_READ = 0x1 | 0x2 | 0x40 | 0x80 | 0x200 | 0x800,
+    D3D12_RESOURCE_STATE_PRESENT = 0
+};
+
+enum D3D12_RESOURCE_BARRIER_TYPE
+{
+    D3D12_RESOURCE_BARRIER_TYPE_TRANSITION = 0,
+    D3D12_RESOURCE_BARRIER_TYPE_ALIASING = 1,
+    D3D12_RESOURCE_BARRIER_TYPE_UAV = 2
+};
+
+enum D3D12_RESOURCE_BARRIER_FLAGS
+{
+    D3D12_RESOURCE_BARRIER_FLAG_NONE = 0,
+    D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY = 0x1,
+    D3D12_RESOURCE_BARRIER_FLAG_END_ONLY = 0x2
+};
+
+#define D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES 0xffffffff
+
+enum D3D12_FEATURE
+{
+    D3D12_FEATURE_D3D12_OPTIONS = 0,
+    D3D12_FEATURE_ROOT_SIGNATURE = 12
+};
+
+enum D3D12_DESCRIPTOR_RANGE_TYPE
+{
+    D3D12_DESCRIPTOR_RANGE_TYPE_SRV = 0,
+    D3D12_DESCRIPTOR_RANGE_TYPE_UAV = 1,
+    D3D12_DESCRIPTOR_RANGE_TYPE_CBV = 2,
+    D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER = 3
+};
+
+enum D3D12_DESCRIPTOR_RANGE_FLAGS
+{
+    D3D12_DESCRIPTOR_RANGE_FLAG_NONE = 0,
+    D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE = 0x1,
+    D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE = 0x2,
+    D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC = 0x8
+};
+
+#define D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND 0xffffffff
+#define D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT 256
+
+enum D3D12_ROOT_DESCRIPTOR_FLAGS
+{
+    D3D12_ROOT_DESCRIPTOR_FLAG_NONE = 0,
+    D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE = 0x2,
+    D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC = 0x8
+};
+
+enum D3D12_ROOT_PARAMETER_TYPE
+{
+    D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE = 0,
+    D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS = 1,
+    D3D12_ROOT_PARAMETER_TYPE_CBV = 2,
+    D3D12_ROOT_PARAMETER_TYPE_SRV = 3,
+    D3D12_ROOT_PARAMETER_TYPE_UAV = 4
+};
+
+enum D3D12_SHADER_VISIBILITY
+{
+    D3D12_SHADER_VISIBILITY_ALL = 0,
+    D3D12_SHADER_VISIBILITY_VERTEX = 1,
+    D3D12_SHADER_VISIBILITY_PIXEL = 5
+};
+
+enum D3D12_ROOT_SIGNATURE_FLAGS
+{
+    D3D12_ROOT_SIGNATURE_FLAG_NONE = 0,
+    D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT = 0x1
+};
+
+enum D3D12_INPUT_CLASSIFICATION
+{
+    D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA = 0,
+    D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA = 1
+};
+
+#define D3D12_APPEND_ALIGNED_ELEMENT 0xffffffff
+
+enum D3D12_INDIRECT_ARGUMENT_TYPE
+{
+    D3D12_INDIRECT_ARGUMENT_TYPE_DRAW = 0,
+    D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED = 1,
+    D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH = 2,
+    D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW = 3,
+    D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW = 4,
+    D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT = 5,
+    D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT_BUFFER_VIEW = 6
+};
+
+enum D3D12_FILL_MODE
+{
+    D3D12_FILL_MODE_WIREFRAME = 2,
+    D3D12_FILL_MODE_SOLID = 3
+};
+
+enum D3D12_CULL_MODE
+{
+    D3D12_CULL_MODE_NONE = 1,
+    D3D12_CULL_MODE_FRONT = 2,
+    D3D12_CULL_MODE_BACK = 3
+};
+
+enum D3D12_CONSERVATIVE_RASTERIZATION_MODE
+{
+    D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF = 0,
+    D3D12_CONSERVATIVE_RASTERIZATION_MODE_ON = 1
+};
+
+#define D3D12_DEFAULT_DEPTH_BIAS 0
+#define D3D12_DEFAULT_DEPTH_BIAS_CLAMP 0.0f
+#define D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS 0.0f
+#define D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT 8
+
+enum D3D12_BLEND
+{
+    D3D12_BLEND_ZERO = 1,
+    D3D12_BLEND_ONE = 2,
+    D3D12_BLEND_SRC_ALPHA = 5,
+    D3D12_BLEND_INV_SRC_ALPHA = 6
+};
+
+enum D3D12_BLEND_OP
+{
+    D3D12_BLEND_OP_ADD = 1
+};
+
+enum D3D12_LOGIC_OP
+{
+    D3D12_LOGIC_OP_CLEAR = 0,
+    D3D12_LOGIC_OP_NOOP = 4
+};
+
+enum D3D12_COLOR_WRITE_ENABLE
+{
+    D3D12_COLOR_WRITE_ENABLE_ALL = 15
+};
+
+enum D3D12_DEPTH_WRITE_MASK
+{
+    D3D12_DEPTH_WRITE_MASK_ZERO = 0,
+    D3D12_DEPTH_WRITE_MASK_ALL = 1
+};
+
+enum D3D12_COMPARISON_FUNC
+{
+    D3D12_COMPARISON_FUNC_NEVER = 1,
+    D3D12_COMPARISON_FUNC_LESS = 2,
+    D3D12_COMPARISON_FUNC_LESS_EQUAL = 4,
+    D3D12_COMPARISON_FUNC_ALWAYS = 8
+};
+
+enum D3D12_STENCIL_OP
+{
+    D3D12_STENCIL_OP_KEEP = 1
+};
+
+enum D3D12_INDEX_BUFFER_STRIP_CUT_VALUE
+{
+    D3D12_INDEX_BUFFER_STRIP_CUT_VALUE_DISABLED = 0
+};
+
+enum D3D12_PRIMITIVE_TOPOLOGY_TYPE
+{
+    D3D12_PRIMITIVE_TOPOLOGY_TYPE_UNDEFINED = 0,
+    D3D12_PRIMITIVE_TOPOLOGY_TYPE_POINT = 1,
+    D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE = 2,
+    D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE = 3
+};
+
+enum D3D12_PIPELINE_STATE_FLAGS
+{
+    D3D12_PIPELINE_STATE_FLAG_NONE = 0
+};
+
+enum DXGI_ADAPTER_FLAG
+{
+    DXGI_ADAPTER_FLAG_NONE = 0,
+    DXGI_ADAPTER_FLAG_SOFTWARE = 2
+};
+
+enum DXGI_SWAP_EFFECT
+{
+    DXGI_SWAP_EFFECT_DISCARD = 0,
+    DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL = 3,
+    DXGI_SWAP_EFFECT_FLIP_DISCARD = 4
+};
+
+#define DXGI_USAGE_RENDER_TARGET_OUTPUT 0x00000020UL
+#define DXGI_CREATE_FACTORY_DEBUG 0x01
+
+// Structures
+
+typedef UINT64 D3D12_GPU_VIRTUAL_ADDRESS;
+
+struct D3D12_CPU_DESCRIPTOR_HANDLE
+{
+    SIZE_T ptr;
+};
+
+struct D3D12_GPU_DESCRIPTOR_HANDLE
+{
+    UINT64 ptr;
+};
+
+struct D3D12_RECT
+{
+    LONG left;
+    LONG top;
+    LONG right;
+    LONG bottom;
+};
+
+struct D3D12_RANGE
+{
+    SIZE_T Begin;
+    SIZE_T End;
+};
+
+struct D3D12_VIEWPORT
+{
+    FLOAT TopLeftX;
+    FLOAT TopLeftY;
+    FLOAT Width;
+    FLOAT Height;
+    FLOAT MinDepth;
+    FLOAT MaxDepth;
+};
+
+struct DXGI_SAMPLE_DESC
+{
+    UINT Count;
+    UINT Quality;
+};
+
+struct DXGI_ADAPTER_DESC1
+{
+    WCHAR Description[128];
+    UINT VendorId;
+    UINT DeviceId;
+    SIZE_T DedicatedVideoMemory;
+    SIZE_T SharedSystemMemory;
+    UINT Flags;
+};
+
+struct DXGI_SWAP_CHAIN_DESC1
+{
+    UINT Width;
+    UINT Height;
+    DXGI_FORMAT Format;
+    BOOL Stereo;
+    DXGI_SAMPLE_DESC SampleDesc;
+    UINT BufferUsage;
+    UINT BufferCount;
+    UINT Scaling;
+    DXGI_SWAP_EFFECT SwapEffect;
+    UINT AlphaMode;
+    UINT Flags;
+};
+
+struct D3D12_COMMAND_QUEUE_DESC
+{
+    D3D12_COMMAND_LIST_TYPE Type;
+    INT Priority;
+    D3D12_COMMAND_QUEUE_FLAGS Flags;
+    UINT NodeMask;
+};
+
+struct D3D12_DESCRIPTOR_HEAP_DESC
+{
+    D3D12_DESCRIPTOR_HEAP_TYPE Type;
+    UINT NumDescriptors;
+    D3D12_DESCRIPTOR_HEAP_FLAGS Flags;
+    UINT NodeMask;
+};
+
+struct D3D12_QUERY_HEAP_DESC
+{
+    D3D12_QUERY_HEAP_TYPE Type;
+    UINT Count;
+    UINT NodeMask;
+};
+
+struct D3D12_HEAP_PROPERTIES
+{
+    D3D12_HEAP_TYPE Type;
+    D3D12_CPU_PAGE_PROPERTY CPUPageProperty;
+    D3D12_MEMORY_POOL MemoryPoolPreference;
+    UINT CreationNodeMask;
+    UINT VisibleNodeMask;
+};
+
+struct D3D12_RESOURCE_DESC
+{
+    D3D12_RESOURCE_DIMENSION Dimension;
+    UINT64 Alignment;
+    UINT64 Width;
+    UINT Height;
+    UINT16 DepthOrArraySize;
+    UINT16 MipLevels;
+    DXGI_FORMAT Format;
+    DXGI_SAMPLE_DESC SampleDesc;
+    D3D12_TEXTURE_LAYOUT Layout;
+    D3D12_RESOURCE_FLAGS Flags;
+};
+
+struct D3D12_HEAP_DESC
+{
+    UINT64 SizeInBytes;
+    D3D12_HEAP_PROPERTIES Properties;
+    UINT64 Alignment;
+    D3D12_HEAP_FLAGS Flags;
+};
+
+struct D3D12_RESOURCE_ALLOCATION_INFO
+{
+    UINT64 SizeInBytes;
+    UINT64 Alignment;
+};
+
+struct D3D12_CLEAR_VALUE
+{
+    DXGI_FORMAT Format;
+    FLOAT Color[4];
+};
+
+struct D3D12_CONSTANT_BUFFER_VIEW_DESC
+{
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+    UINT SizeInBytes;
+};
+
+struct D3D12_VERTEX_BUFFER_VIEW
+{
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+    UINT SizeInBytes;
+    UINT StrideInBytes;
+};
+
+struct D3D12_INDEX_BUFFER_VIEW
+{
+    D3D12_GPU_VIRTUAL_ADDRESS BufferLocation;
+    UINT SizeInBytes;
+    DXGI_FORMAT Format;
+};
+
+class ID3D12Resource;
+
+struct D3D12_RESOURCE_TRANSITION_BARRIER
+{
+    ID3D12Resource* pResource;
+    UINT Subresource;
+    D3D12_RESOURCE_STATES StateBefore;
+    D3D12_RESOURCE_STATES StateAfter;
+};
+
+struct D3D12_RESOURCE_ALIASING_BARRIER
+{
+    ID3D12Resource* pResourceBefore;
+    ID3D12Resource* pResourceAfter;
+};
+
+struct D3D12_RESOURCE_UAV_BARRIER
+{
+    ID3D12Resource* pResource;
+};
+
+struct D3D12_RESOURCE_BARRIER
+{
+    D3D12_RESOURCE_BARRIER_TYPE Type;
+    D3D12_RESOURCE_BARRIER_FLAGS Flags;
+    union {
+        D3D12_RESOURCE_TRANSITION_BARRIER Transition;
+        D3D12_RESOURCE_ALIASING_BARRIER Aliasing;
+        D3D12_RESOURCE_UAV_BARRIER UAV;
+    };
+};
+
+struct D3D12_FEATURE_DATA_ROOT_SIGNATURE
+{
+    D3D_ROOT_SIGNATURE_VERSION HighestVersion;
+};
+
+struct D3D12_DESCRIPTOR_RANGE1
+{
+    D3D12_DESCRIPTOR_RANGE_TYPE RangeType;
+    UINT NumDescriptors;
+    UINT BaseShaderRegister;
+    UINT RegisterSpace;
+    D3D12_DESCRIPTOR_RANGE_FLAGS Flags;
+    UINT OffsetInDescriptorsFromTableStart;
+};
+
+struct D3D12_ROOT_DESCRIPTOR_TABLE1
+{
+    UINT NumDescriptorRanges;
+    const D3D12_DESCRIPTOR_RANGE1* pDescriptorRanges;
+};
+
+struct D3D12_ROOT_CONSTANTS
+{
+    UINT ShaderRegister;
+    UINT RegisterSpace;
+    UINT Num32BitValues;
+};
+
+struct D3D12_ROOT_DESCRIPTOR1
+{
+    UINT ShaderRegister;
+    UINT RegisterSpace;
+    D3D12_ROOT_DESCRIPTOR_FLAGS Flags;
+};
+
+struct D3D12_ROOT_PARAMETER1
+{
+    D3D12_ROOT_PARAMETER_TYPE ParameterType;
+    union {
+        D3D12_ROOT_DESCRIPTOR_TABLE1 DescriptorTable;
+        D3D12_ROOT_CONSTANTS Constants;
+        D3D12_ROOT_DESCRIPTOR1 Descriptor;
+    };
+    D3D12_SHADER_VISIBILITY ShaderVisibility;
+};
+
+struct D3D12_STATIC_SAMPLER_DESC;
+
+struct D3D12_ROOT_SIGNATURE_DESC1
+{
+    UINT NumParameters;
+    const D3D12_ROOT_PARAMETER1* pParameters;
+    UINT NumStaticSamplers;
+    const D3D12_STATIC_SAMPLER_DESC* pStaticSamplers;
+    D3D12_ROOT_SIGNATURE_FLAGS Flags;
+};
+
+struct D3D12_VERSIONED_ROOT_SIGNATURE_DESC
+{
+    D3D_ROOT_SIGNATURE_VERSION Version;
+    D3D12_ROOT_SIGNATURE_DESC1 Desc_1_1;
+};
+
+struct D3D12_SHADER_BYTECODE
+{
+    const void* pShaderBytecode;
+    SIZE_T BytecodeLength;
+};
+
+struct D3D12_INPUT_ELEMENT_DESC
+{
+    LPCSTR SemanticName;
+    UINT SemanticIndex;
+    DXGI_FORMAT Format;
+    UINT InputSlot;
+    UINT AlignedByteOffset;
+    D3D12_INPUT_CLASSIFICATION InputSlotClass;
+    UINT InstanceDataStepRate;
+};
+
+struct D3D12_INPUT_LAYOUT_DESC
+{
+    const D3D12_INPUT_ELEMENT_DESC* pInputElementDescs;
+    UINT NumElements;
+};
+
+struct D3D12_SO_DECLARATION_ENTRY;
+
+struct D3D12_STREAM_OUTPUT_DESC
+{
+    const D3D12_SO_DECLARATION_ENTRY* pSODeclaration;
+    UINT NumEntries;
+    const UINT* pBufferStrides;
+    UINT NumStrides;
+    UINT RasterizedStream;
+};
+
+struct D3D12_RENDER_TARGET_BLEND_DESC
+{
+    BOOL BlendEnable;
+    BOOL LogicOpEnable;
+    D3D12_BLEND SrcBlend;
+    D3D12_BLEND DestBlend;
+    D3D12_BLEND_OP BlendOp;
+    D3D12_BLEND SrcBlendAlpha;
+    D3D12_BLEND DestBlendAlpha;
+    D3D12_BLEND_OP BlendOpAlpha;
+    D3D12_LOGIC_OP LogicOp;
+    UINT8 RenderTargetWriteMask;
+};
+
+struct D3D12_BLEND_DESC
+{
+    BOOL AlphaToCoverageEnable;
+    BOOL IndependentBlendEnable;
+    D3D12_RENDER_TARGET_BLEND_DESC RenderTarget[8];
+};
+
+struct D3D12_RASTERIZER_DESC
+{
+    D3D12_FILL_MODE FillMode;
+    D3D12_CULL_MODE CullMode;
+    BOOL FrontCounterClockwise;
+    INT DepthBias;
+    FLOAT DepthBiasClamp;
+    FLOAT SlopeScaledDepthBias;
+    BOOL DepthClipEnable;
+    BOOL MultisampleEnable;
+    BOOL AntialiasedLineEnable;
+    UINT ForcedSampleCount;
+    D3D12_CONSERVATIVE_RASTERIZATION_MODE ConservativeRaster;
+};
+
+struct D3D12_DEPTH_STENCILOP_DESC
+{
+    D3D12_STENCIL_OP StencilFailOp;
+    D3D12_STENCIL_OP StencilDepthFailOp;
+    D3D12_STENCIL_OP StencilPassOp;
+    D3D12_COMPARISON_FUNC StencilFunc;
+};
+
+struct D3D12_DEPTH_STENCIL_DESC
+{
+    BOOL DepthEnable;
+    D3D12_DEPTH_WRITE_MASK DepthWriteMask;
+    D3D12_COMPARISON_FUNC DepthFunc;
+    BOOL StencilEnable;
+    UINT8 StencilReadMask;
+    UINT8 StencilWriteMask;
+    D3D12_DEPTH_STENCILOP_DESC FrontFace;
+    D3D12_DEPTH_STENCILOP_DESC BackFace;
+};
+
+struct D3D12_CACHED_PIPELINE_STATE
+{
+    const void* pCachedBlob;
+    SIZE_T CachedBlobSizeInBytes;
+};
+
+class ID3D12RootSignature;
+
+struct D3D12_GRAPHICS_PIPELINE_STATE_DESC
+{
+    ID3D12RootSignature* pRootSignature;
+    D3D12_SHADER_BYTECODE VS;
+    D3D12_SHADER_BYTECODE PS;
+    D3D12_SHADER_BYTECODE DS;
+    D3D12_SHADER_BYTECODE HS;
+    D3D12_SHADER_BYTECODE GS;
+    D3D12_STREAM_OUTPUT_DESC StreamOutput;
+    D3D12_BLEND_DESC BlendState;
+    UINT SampleMask;
+    D3D12_RASTERIZER_DESC RasterizerState;
+    D3D12_DEPTH_STENCIL_DESC DepthStencilState;
+    D3D12_INPUT_LAYOUT_DESC InputLayout;
+    D3D12_INDEX_BUFFER_STRIP_CUT_VALUE IBStripCutValue;
+    D3D12_PRIMITIVE_TOPOLOGY_TYPE PrimitiveTopologyType;
+    UINT NumRenderTargets;
+    DXGI_FORMAT RTVFormats[8];
+    DXGI_FORMAT DSVFormat;
+    DXGI_SAMPLE_DESC SampleDesc;
+    UINT NodeMask;
+    D3D12_CACHED_PIPELINE_STATE CachedPSO;
+    D3D12_PIPELINE_STATE_FLAGS Flags;
+};
+
+struct D3D12_DRAW_INDEXED_ARGUMENTS
+{
+    UINT IndexCountPerInstance;
+    UINT InstanceCount;
+    UINT StartIndexLocation;
+    INT BaseVertexLocation;
+    UINT StartInstanceLocation;
+};
+
+struct D3D12_INDIRECT_ARGUMENT_DESC
+{
+    D3D12_INDIRECT_ARGUMENT_TYPE Type;
+    union
+    {
+        struct
+        {
+            UINT Slot;
+        } VertexBuffer;
+        struct
+        {
+            UINT RootParameterIndex;
+            UINT DestOffsetIn32BitValues;
+            UINT Num32BitValuesToSet;
+        } Constant;
+        struct
+        {
+            UINT RootParameterIndex;
+        } ConstantBufferView;
+    };
+};
+
+struct D3D12_COMMAND_SIGNATURE_DESC
+{
+    UINT ByteStride;
+    UINT NumArgumentDescs;
+    const D3D12_INDIRECT_ARGUMENT_DESC* pArgumentDescs;
+    UINT NodeMask;
+};
+
+// API Call Statistics
+// Every entry point of the NOOP backend records how often it was called and
+// how long it took, so CPU frame cost can be profiled on headless machines.
+
+#define NOOP_API_CALLS(X)                                                      \
+    X(CreateDXGIFactory2)                                                      \
+    X(EnumAdapters1)                                                           \
+    X(GetDesc1)                                                                \
+    X(D3D12CreateDevice)                                                       \
+    X(D3D12SerializeVersionedRootSignature)                                    \
+    X(D3DCompileFromFile)                                                      \
+    X(CreateSwapChainForComposition)                                           \
+    X(CreateCommandQueue)                                                      \
+    X(CreateCommandAllocator)                                                  \
+    X(CreateCommandList)                                                       \
+    X(CreateFence)                                                             \
+    X(CreateDescriptorHeap)                                                    \
+    X(GetDescriptorHandleIncrementSize)                                        \
+    X(CreateRenderTargetView)                                                  \
+    X(CreateConstantBufferView)                                                \
+    X(CopyDescriptors)                                                         \
+    X(CopyDescriptorsSimple)                                                   \
+    X(CheckFeatureSupport)                                                     \
+    X(CreateRootSignature)                                                     \
+    X(CreateGraphicsPipelineState)                                             \
+    X(CreatePipelineLibrary)                                                   \
+    X(CreateCommandSignature)                                                  \
+    X(CreateQueryHeap)                                                         \
+    X(StorePipeline)                                                           \
+    X(LoadGraphicsPipeline)                                                    \
+    X(SerializePipelineLibrary)                                                \
+    X(CreateCommittedResource)                                                 \
+    X(CreateHeap)                                                              \
+    X(CreatePlacedResource)                                                    \
+    X(GetResourceAllocationInfo)                                               \
+    X(Map)                                                                     \
+    X(Unmap)                                                                   \
+    X(GetGPUVirtualAddress)                                                    \
+    X(GetCPUDescriptorHandleForHeapStart)                                      \
+    X(GetGPUDescriptorHandleForHeapStart)                                      \
+    X(CommandAllocatorReset)                                                   \
+    X(CommandListReset)                                                        \
+    X(CommandListClose)                                                        \
+    X(ClearState)                                                              \
+    X(SetPipelineState)                                                        \
+    X(SetGraphicsRootSignature)                                                \
+    X(RSSetViewports)                                                          \
+    X(RSSetScissorRects)                                                       \
+    X(SetDescriptorHeaps)                                                      \
+    X(SetGraphicsRootDescriptorTable)                                          \
+    X(SetGraphicsRootConstantBufferView)                                       \
+    X(SetGraphicsRoot32BitConstants)                                           \
+    X(ResourceBarrier)                                                         \
+    X(OMSetRenderTargets)                                                      \
+    X(ClearRenderTargetView)                                                   \
+    X(IASetPrimitiveTopology)                                                  \
+    X(IASetVertexBuffers)                                                      \
+    X(IASetIndexBuffer)                                                        \
+    X(DrawIndexedInstanced)                                                    \
+    X(ExecuteIndirect)                                                         \
+    X(CopyBufferRegion)                                                        \
+    X(EndQuery)                                                                \
+    X(ResolveQueryData)                                                        \
+    X(ExecuteCommandLists)                                                     \
+    X(GetTimestampFrequency)                                                   \
+    X(GetClockCalibration)                                                     \
+    X(QueueSignal)                                                             \
+    X(QueueWait)                                                               \
+    X(GetCompletedValue)                                                       \
+    X(SetEventOnCompletion)                                                    \
+    X(WaitForSingleObject)                                                     \
+    X(GetBuffer)                                                               \
+    X(GetCurrentBackBufferIndex)                                               \
+    X(Present)                                                                 \
+    X(ResizeBuffers)                                                           \
+    X(SetFullscreenState)
+
+enum class NoopApiCall : unsigned
+{
+#define NOOP_API_CALL_ENUM(name) name,
+    NOOP_API_CALLS(NOOP_API_CALL_ENUM)
+#undef NOOP_API_CALL_ENUM
+        Count
+};
+
+struct NoopStats
+{
+    std::atomic<UINT64> calls[(unsigned)NoopApiCall::Count];
+    std::atomic<UINT64> nanoseconds[(unsigned)NoopApiCall::Count];
+
+    // Resource allocations
+    std::atomic<UINT64> allocations;
+    std::atomic<UINT64> allocatedBytes;
+    std::atomic<UINT64> liveResources;
+
+    // Bytes moved by executed copy commands
+    std::atomic<UINT64> copiedBytes;
+
+    // Descriptors copied between heaps
+    std::atomic<UINT64> copiedDescriptors;
+
+    // Commands the debug layer would have rejected, such as out of bounds
+    // copies
+    std::atomic<UINT64> validationErrors;
+
+    NoopStats();
+
+    // Zero every counter, usually after initialization so only steady state
+    // frames are measured
+    void reset();
+
+    UINT64 totalCalls() const;
+
+    UINT64 totalNanoseconds() const;
+
+    // Print a table of every call made, and averages per frame. Frames
+    // default to those presented, offscreen rendering never presents.
+    void report(std::ostream& out, UINT64 frames = 0) const;
+};
+
+NoopStats& noopStats();
+
+// Simulated GPU
+// Command queues model a GPU timeline so fences complete some time after
+// they're signaled, which lets frame pacing and CPU/GPU overlap be measured.
+
+struct NoopConfig
+{
+    // Fixed cost of every ExecuteCommandLists call
+    std::chrono::microseconds gpuSubmitLatency{0};
+
+    // Cost of every command recorded in the submitted lists
+    std::chrono::nanoseconds gpuCommandCost{0};
+
+    // Speed copy commands move data at, 0 makes copies free
+    double gpuCopyBytesPerSecond = 0.0;
+
+    // Time D3DCompileFromFile takes, like a real compiler would
+    std::chrono::microseconds shaderCompileTime{0};
+
+    // Time the driver takes to compile a pipeline state, loading one from a
+    // pipeline library is free
+    std::chrono::microseconds pipelineCompileTime{0};
+};
+
+NoopConfig& noopConfig();
+
+const char* noopApiCallName(NoopApiCall call);
+
+// Records one call to a NOOP entry point for as long as it's in scope
+class NoopCallScope
+{
+  public:
+    NoopCallScope(NoopApiCall call);
+
+    ~NoopCallScope();
+
+  protected:
+    NoopApiCall mCall;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+#define NOOP_CALL(name) NoopCallScope noopCallScope(NoopApiCall::name)
+
+// Interfaces
+
+class IDXGIOutput;
+class ID3D12PipelineState;
+class ID3D12CommandAllocator;
+class ID3D12Fence;
+
+class ID3D12DeviceChild : public ID3D12Object
+{
+};
+
+class ID3D12Pageable : public ID3D12DeviceChild
+{
+};
+
+class ID3D12Heap : public ID3D12Pageable
+{
+  public:
+    ID3D12Heap(const D3D12_HEAP_DESC& desc);
+
+    ~ID3D12Heap();
+
+    D3D12_HEAP_DESC GetDesc();
+
+    // NOOP only, memory placed buffers alias, left uninitialized so pages
+    // are only committed once something is written to them
+    uint8_t* getData();
+
+    D3D12_GPU_VIRTUAL_ADDRESS getGpuAddress() const;
+
+  protected:
+    D3D12_HEAP_DESC mDesc;
+    D3D12_GPU_VIRTUAL_ADDRESS mAddress;
+    std::unique_ptr<uint8_t[]> mData;
+};
+
+class ID3D12Resource : public ID3D12Pageable
+{
+  public:
+    // A committed resource with its own memory
+    ID3D12Resource(const D3D12_HEAP_PROPERTIES& heapProperties,
+                   const D3D12_RESOURCE_DESC& desc,
+                   D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON);
+
+    // A placed resource aliasing part of a heap, it holds a reference to it
+    ID3D12Resource(ID3D12Heap* heap, UINT64 heapOffset,
+                   const D3D12_RESOURCE_DESC& desc,
+                   D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON);
+
+    ~ID3D12Resource();
+
+    HRESULT Map(UINT subresource, const D3D12_RANGE* pReadRange, void** ppData);
+
+    void Unmap(UINT subresource, const D3D12_RANGE* pWrittenRange);
+
+    D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress();
+
+    D3D12_RESOURCE_DESC GetDesc();
+
+    // NOOP only, the CPU backing store of a buffer, whatever heap it's in,
+    // so copies can be executed and their results inspected
+    uint8_t* getData();
+
+    UINT64 getSize() const;
+
+    // NOOP only, the state executed commands left a buffer in. Textures
+    // aren't tracked.
+    D3D12_RESOURCE_STATES getState() const;
+
+  protected:
+    friend class ID3D12CommandQueue;
+
+    D3D12_HEAP_PROPERTIES mHeapProperties;
+    D3D12_RESOURCE_DESC mDesc;
+    D3D12_GPU_VIRTUAL_ADDRESS mAddress;
+    UINT64 mSize;
+
+    // CPU backing store for buffers, so mapped pointers are writable. Placed
+    // buffers point into their heap's memory instead of owning it.
+    std::vector<uint8_t> mStorage;
+    uint8_t* mData;
+    ID3D12Heap* mHeap;
+
+    // Set when a copy implicitly promoted a common buffer, which decays back
+    // once the commands it was executed with finish
+    D3D12_RESOURCE_STATES mState;
+    bool mPromoted;
+};
+
+class ID3D12DescriptorHeap : public ID3D12Pageable
+{
+  public:
+    ID3D12DescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC& desc);
+
+    ~ID3D12DescriptorHeap();
+
+    D3D12_DESCRIPTOR_HEAP_DESC GetDesc();
+
+    D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandleForHeapStart();
+
+    D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptorHandleForHeapStart();
+
+  protected:
+    D3D12_DESCRIPTOR_HEAP_DESC mDesc;
+    UINT64 mStart;
+};
+
+class ID3D12RootSignature : public ID3D12DeviceChild
+{
+  public:
+    // Reads back the layout the NOOP serializer wrote
+    ID3D12RootSignature(std::vector<D3D12_ROOT_PARAMETER_TYPE> parameterTypes,
+                        std::vector<UINT> constantCounts);
+
+    // Whether a parameter exists, has the type and, for constants, has
+    // room for the values
+    bool checkParameter(UINT index, D3D12_ROOT_PARAMETER_TYPE type,
+                        UINT num32BitValues = 0) const;
+
+  protected:
+    std::vector<D3D12_ROOT_PARAMETER_TYPE> mParameterTypes;
+    std::vector<UINT> mConstantCounts;
+};
+
+class ID3D12PipelineState : public ID3D12Pageable
+{
+};
+
+// Pipelines stored by name. The serialized form only records the names, a
+// blob with anything else in it is rejected like a driver would.
+class ID3D12PipelineLibrary : public ID3D12DeviceChild
+{
+  public:
+    HRESULT StorePipeline(LPCWSTR pName, ID3D12PipelineState* pPipeline);
+
+    HRESULT LoadGraphicsPipeline(LPCWSTR pName,
+                                 const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc,
+                                 REFIID riid, void** ppPipelineState);
+
+    SIZE_T GetSerializedSize();
+
+    HRESULT Serialize(void* pData, SIZE_T dataSizeInBytes);
+
+  protected:
+    friend class ID3D12Device1;
+
+    std::mutex mMutex;
+    std::vector<std::wstring> mNames;
+};
+
+// Only remembers its stride, which is all ExecuteIndirect validates against
+class ID3D12CommandSignature : public ID3D12Pageable
+{
+  public:
+    ID3D12CommandSignature(UINT byteStride);
+
+    UINT getByteStride() const;
+
+  protected:
+    UINT mByteStride;
+};
+
+// Timestamps are written when the list recording them is executed, at the
+// time the simulated GPU reaches the query
+class ID3D12QueryHeap : public ID3D12Pageable
+{
+  public:
+    ID3D12QueryHeap(const D3D12_QUERY_HEAP_DESC& desc);
+
+    D3D12_QUERY_HEAP_DESC getDesc() const;
+
+    UINT64* getValues();
+
+  protected:
+    D3D12_QUERY_HEAP_DESC mDesc;
+    std::vector<UINT64> mValues;
+};
+
+class ID3D12CommandAllocator : public ID3D12Pageable
+{
+  public:
+    HRESULT Reset();
+};
+
+class ID3D12Fence : public ID3D12Pageable
+{
+  public:
+    ID3D12Fence(UINT64 initialValue);
+
+    UINT64 GetCompletedValue();
+
+    HRESULT SetEventOnCompletion(UINT64 value, HANDLE hEvent);
+
+    HRESULT Signal(UINT64 value);
+
+    // NOOP only, time at which the simulated GPU reaches a value, or the
+    // maximum time point if nothing has signaled it yet
+    std::chrono::steady_clock::time_point getCompletionTime(UINT64 value);
+
+  protected:
+    friend class ID3D12CommandQueue;
+
+    // Retire every pending signal the simulated GPU has already passed
+    UINT64 updateCompletedValue();
+
+    std::mutex mMutex;
+    UINT64 mCompletedValue;
+    std::deque<std::pair<UINT64, std::chrono::steady_clock::time_point>>
+        mPending;
+};
+
+class ID3D12CommandList : public ID3D12DeviceChild
+{
+  public:
+    ID3D12CommandList(D3D12_COMMAND_LIST_TYPE type);
+
+    D3D12_COMMAND_LIST_TYPE GetType();
+
+    // Number of commands recorded since the last Reset
+    UINT64 getRecordedCommandCount() const;
+
+  protected:
+    friend class ID3D12CommandQueue;
+
+    // Copies are replayed on CPU backing stores when the list is executed,
+    // in the order they were recorded
+    struct BufferCopy
+    {
+        ID3D12Resource* dst;
+        UINT64 dstOffset;
+        ID3D12Resource* src;
+        UINT64 srcOffset;
+        UINT64 numBytes;
+    };
+
+    // Buffer transitions are replayed between the copies recorded around
+    // them, checking each buffer is in the state the barrier expects
+    struct BufferTransition
+    {
+        ID3D12Resource* resource;
+        D3D12_RESOURCE_STATES before;
+        D3D12_RESOURCE_STATES after;
+        size_t copyIndex;
+    };
+
+    // Query commands are replayed in order after the copies. An end writes
+    // the time the simulated GPU reaches the command at its position in the
+    // list, a resolve copies values into a buffer.
+    struct QueryOp
+    {
+        ID3D12QueryHeap* heap;
+        UINT index;
+        UINT count;
+        ID3D12Resource* dst;
+        UINT64 dstOffset;
+        UINT64 commandIndex;
+    };
+
+    D3D12_COMMAND_LIST_TYPE mType;
+    UINT64 mRecordedCommands;
+    std::vector<BufferCopy> mCopies;
+    std::vector<BufferTransition> mTransitions;
+    std::vector<QueryOp> mQueries;
+    bool mClosed;
+};
+
+class ID3D12GraphicsCommandList : public ID3D12CommandList
+{
+  public:
+    ID3D12GraphicsCommandList(D3D12_COMMAND_LIST_TYPE type);
+
+    HRESULT Close();
+
+    HRESULT Reset(ID3D12CommandAllocator* pAllocator,
+                  ID3D12PipelineState* pInitialState);
+
+    void ClearState(ID3D12PipelineState* pPipelineState);
+
+    void SetPipelineState(ID3D12PipelineState* pPipelineState);
+
+    void SetGraphicsRootSignature(ID3D12RootSignature* pRootSignature);
+
+    void RSSetViewports(UINT numViewports, const D3D12_VIEWPORT* pViewports);
+
+    void RSSetScissorRects(UINT numRects, const D3D12_RECT* pRects);
+
+    void SetDescriptorHeaps(UINT numDescriptorHeaps,
+                            ID3D12DescriptorHeap* const* ppDescriptorHeaps);
+
+    void SetGraphicsRootDescriptorTable(
+        UINT rootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE baseDescriptor);
+
+    void SetGraphicsRootConstantBufferView(
+        UINT rootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS bufferLocation);
+
+    void SetGraphicsRoot32BitConstants(UINT rootParameterIndex,
+                                       UINT num32BitValuesToSet,
+                                       const void* pSrcData,
+                                       UINT destOffsetIn32BitValues);
+
+    void ResourceBarrier(UINT numBarriers,
+                         const D3D12_RESOURCE_BARRIER* pBarriers);
+
+    void OMSetRenderTargets(
+        UINT numRenderTargetDescriptors,
+        const D3D12_CPU_DESCRIPTOR_HANDLE* pRenderTargetDescriptors,
+        BOOL rtsSingleHandleToDescriptorRange,
+        const D3D12_CPU_DESCRIPTOR_HANDLE* pDepthStencilDescriptor);
+
+    void ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE renderTargetView,
+                               const FLOAT colorRGBA[4], UINT numRects,
+                               const D3D12_RECT* pRects);
+
+    void IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY primitiveTopology);
+
+    void IASetVertexBuffers(UINT startSlot, UINT numViews,
+                            const D3D12_VERTEX_BUFFER_VIEW* pViews);
+
+    void IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* pView);
+
+    void DrawIndexedInstanced(UINT indexCountPerInstance, UINT instanceCount,
+                              UINT startIndexLocation, INT baseVertexLocation,
+                              UINT startInstanceLocation);
+
+    // Every command the signature could generate counts as recorded, the
+    // count buffer isn't read
+    void ExecuteIndirect(ID3D12CommandSignature* pCommandSignature,
+                         UINT maxCommandCount, ID3D12Resource* pArgumentBuffer,
+                         UINT64 argumentBufferOffset,
+                         ID3D12Resource* pCountBuffer,
+                         UINT64 countBufferOffset);
+
+    void CopyBufferRegion(ID3D12Resource* pDstBuffer, UINT64 dstOffset,
+                          ID3D12Resource* pSrcBuffer, UINT64 srcOffset,
+                          UINT64 numBytes);
+
+    // Only timestamp queries are supported
+    void EndQuery(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE type,
+                  UINT index);
+
+    void ResolveQueryData(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE type,
+                          UINT startIndex, UINT numQueries,
+                          ID3D12Resource* pDestinationBuffer,
+                          UINT64 alignedDestinationBufferOffset);
+
+  protected:
+    // Root arguments are checked against the bound root signature
+    void checkRootParameter(UINT index, D3D12_ROOT_PARAMETER_TYPE type,
+                            UINT num32BitValues = 0);
+
+    ID3D12RootSignature* mRootSignature;
+};
+
+class ID3D12CommandQueue : public ID3D12Pageable
+{
+  public:
+    ID3D12CommandQueue(const D3D12_COMMAND_QUEUE_DESC& desc);
+
+    D3D12_COMMAND_QUEUE_DESC GetDesc();
+
+    void ExecuteCommandLists(UINT numCommandLists,
+                             ID3D12CommandList* const* ppCommandLists);
+
+    HRESULT Signal(ID3D12Fence* pFence, UINT64 value);
+
+    // Work submitted after the wait can't start until the fence reaches the
+    // value on the simulated GPU
+    HRESULT Wait(ID3D12Fence* pFence, UINT64 value);
+
+    // Timestamps count steady clock nanoseconds
+    HRESULT GetTimestampFrequency(UINT64* pFrequency);
+
+    HRESULT GetClockCalibration(UINT64* pGpuTimestamp, UINT64* pCpuTimestamp);
+
+  protected:
+    D3D12_COMMAND_QUEUE_DESC mDesc;
+
+    // When the simulated GPU finishes everything submitted so far
+    std::mutex mMutex;
+    std::chrono::steady_clock::time_point mGpuIdleTime;
+};
+
+class ID3D12Device : public ID3D12Object
+{
+  public:
+    HRESULT CreateCommandQueue(const D3D12_COMMAND_QUEUE_DESC* pDesc,
+                               REFIID riid, void** ppCommandQueue);
+
+    HRESULT CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE type, REFIID riid,
+                                   void** ppCommandAllocator);
+
+    HRESULT CreateCommandList(UINT nodeMask, D3D12_COMMAND_LIST_TYPE type,
+                              ID3D12CommandAllocator* pCommandAllocator,
+                              ID3D12PipelineState* pInitialState, REFIID riid,
+                              void** ppCommandList);
+
+    HRESULT CreateFence(UINT64 initialValue, D3D12_FENCE_FLAGS flags,
+                        REFIID riid, void** ppFence);
+
+    HRESULT CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC* pDesc,
+                                 REFIID riid, void** ppHeap);
+
+    UINT GetDescriptorHandleIncrementSize(
+        D3D12_DESCRIPTOR_HEAP_TYPE descriptorHeapType);
+
+    void CreateRenderTargetView(ID3D12Resource* pResource, const void* pDesc,
+                                D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor);
+
+    void CreateConstantBufferView(const D3D12_CONSTANT_BUFFER_VIEW_DESC* pDesc,
+                                  D3D12_CPU_DESCRIPTOR_HANDLE destDescriptor);
+
+    // Sources have to be in heaps that aren't shader visible, and every
+    // range in a heap of the given type. Null sizes mean ranges of one.
+    void CopyDescriptors(UINT numDestDescriptorRanges,
+                         const D3D12_CPU_DESCRIPTOR_HANDLE* pDestRangeStarts,
+                         const UINT* pDestRangeSizes,
+                         UINT numSrcDescriptorRanges,
+                         const D3D12_CPU_DESCRIPTOR_HANDLE* pSrcRangeStarts,
+                         const UINT* pSrcRangeSizes,
+                         D3D12_DESCRIPTOR_HEAP_TYPE descriptorHeapsType);
+
+    void CopyDescriptorsSimple(UINT numDescriptors,
+                               D3D12_CPU_DESCRIPTOR_HANDLE destRangeStart,
+                               D3D12_CPU_DESCRIPTOR_HANDLE srcRangeStart,
+                               D3D12_DESCRIPTOR_HEAP_TYPE descriptorHeapsType);
+
+    HRESULT CheckFeatureSupport(D3D12_FEATURE feature, void* pFeatureSupportData,
+                                UINT featureSupportDataSize);
+
+    HRESULT CreateRootSignature(UINT nodeMask, const void* pBlobWithRootSignature,
+                                SIZE_T blobLengthInBytes, REFIID riid,
+                                void** ppvRootSignature);
+
+    HRESULT
+    CreateGraphicsPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC* pDesc,
+                                REFIID riid, void** ppPipelineState);
+
+    HRESULT CreateCommandSignature(const D3D12_COMMAND_SIGNATURE_DESC* pDesc,
+                                   ID3D12RootSignature* pRootSignature,
+                                   REFIID riid, void** ppvCommandSignature);
+
+    HRESULT CreateQueryHeap(const D3D12_QUERY_HEAP_DESC* pDesc, REFIID riid,
+                            void** ppvHeap);
+
+    HRESULT CreateCommittedResource(
+        const D3D12_HEAP_PROPERTIES* pHeapProperties, D3D12_HEAP_FLAGS heapFlags,
+        const D3D12_RESOURCE_DESC* pDesc,
+        D3D12_RESOURCE_STATES initialResourceState,
+        const D3D12_CLEAR_VALUE* pOptimizedClearValue, REFIID riidResource,
+        void** ppvResource);
+
+    HRESULT CreateHeap(const D3D12_HEAP_DESC* pDesc, REFIID riid, void** ppvHeap);
+
+    HRESULT CreatePlacedResource(ID3D12Heap* pHeap, UINT64 heapOffset,
+                                 const D3D12_RESOURCE_DESC* pDesc,
+                                 D3D12_RESOURCE_STATES initialState,
+                                 const D3D12_CLEAR_VALUE* pOptimizedClearValue,
+                                 REFIID riid, void** ppvResource);
+
+    D3D12_RESOURCE_ALLOCATION_INFO
+    GetResourceAllocationInfo(UINT visibleMask, UINT numResourceDescs,
+                              const D3D12_RESOURCE_DESC* pResourceDescs);
+};
+
+class ID3D12Device1 : public ID3D12Device
+{
+  public:
+    HRESULT CreatePipelineLibrary(const void* pLibraryBlob, SIZE_T blobLength,
+                                  REFIID riid, void** ppPipelineLibrary);
+};
+
+class IDXGIAdapter1 : public IUnknown
+{
+  public:
+    HRESULT GetDesc1(DXGI_ADAPTER_DESC1* pDesc);
+};
+
+class IDXGISwapChain1 : public IUnknown
+{
+  public:
+    IDXGISwapChain1(const DXGI_SWAP_CHAIN_DESC1& desc);
+
+    ~IDXGISwapChain1();
+
+    HRESULT GetBuffer(UINT buffer, REFIID riid, void** ppSurface);
+
+    HRESULT Present(UINT syncInterval, UINT flags);
+
+    HRESULT ResizeBuffers(UINT bufferCount, UINT width, UINT height,
+                          DXGI_FORMAT newFormat, UINT swapChainFlags);
+
+    HRESULT SetFullscreenState(BOOL fullscreen, IDXGIOutput* pTarget);
+
+  protected:
+    void createBuffers();
+
+    void releaseBuffers();
+
+    DXGI_SWAP_CHAIN_DESC1 mDesc;
+    std::vector<ID3D12Resource*> mBuffers;
+    UINT mCurrentBuffer;
+};
+
+class IDXGISwapChain3 : public IDXGISwapChain1
+{
+  public:
+    IDXGISwapChain3(const DXGI_SWAP_CHAIN_DESC1& desc);
+
+    UINT GetCurrentBackBufferIndex();
+};
+
+class IDXGIFactory4 : public IUnknown
+{
+  public:
+    HRESULT EnumAdapters1(UINT adapter, IDXGIAdapter1** ppAdapter);
+
+    HRESULT CreateSwapChainForComposition(IUnknown* pDevice,
+                                          const DXGI_SWAP_CHAIN_DESC1* pDesc,
+                                          IDXGIOutput* pRestrictToOutput,
+                                          IDXGISwapChain1** ppSwapChain);
+};
+
+// Free Functions
+
+HRESULT CreateDXGIFactory2(UINT flags, REFIID riid, void** ppFactory);
+
+HRESULT D3D12CreateDevice(IUnknown* pAdapter,
+                          D3D_FEATURE_LEVEL minimumFeatureLevel, REFIID riid,
+                          void** ppDevice);
+
+HRESULT D3D12SerializeVersionedRootSignature(
+    const D3D12_VERSIONED_ROOT_SIGNATURE_DESC* pRootSignature, ID3DBlob** ppBlob,
+    ID3DBlob** ppErrorBlob);
+
+struct D3D_SHADER_MACRO
+{
+    LPCSTR Name;
+    LPCSTR Definition;
+};
+
+class ID3DInclude;
+
+#define D3D_COMPILE_STANDARD_FILE_INCLUDE ((ID3DInclude*)(size_t)1)
+
+#define D3DCOMPILE_DEBUG (1 << 0)
+#define D3DCOMPILE_SKIP_OPTIMIZATION (1 << 2)
+
+// Reads the source file and returns it verbatim as "bytecode", so shader
+// loading paths can be exercised without a compiler
+HRESULT D3DCompileFromFile(LPCWSTR pFileName, const D3D_SHADER_MACRO* pDefines,
+                           ID3DInclude* pInclude, LPCSTR pEntrypoint,
+                           LPCSTR pTarget, UINT flags1, UINT flags2,
+                           ID3DBlob** ppCode, ID3DBlob** ppErrorMsgs);
@@ -0,0 +1,218 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+const uint32_t kSlots = 4;
+
+// Spread the low 10 bits of a value out to every third bit
+uint32_t expandBits(uint32_t value)
+{
+    value = (value * 0x00010001u) & 0xff0000ffu;
+    value = (value * 0x00000101u) & 0x0f00f00fu;
+    value = (value * 0x00000011u) & 0xc30c30c3u;
+    value = (value * 0x00000005u) & 0x49249249u;
+    return value;
+}
+
+// Quantize a coordinate within [min, max] to 10 bits
+uint32_t quantize(float value, float min, float max)
+{
+    const float extent = max - min;
+    const float t = extent > 0.0f ? (value - min) / extent : 0.0f;
+    return (uint32_t)std::min(std::max(t * 1023.0f, 0.0f), 1023.0f);
+}
+
+float surfaceArea(float dx, float dy, float dz)
+{
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+}
+
+void Bvh::build(const std::vector<Aabb>& bounds)
+{
+    const uint32_t count = (uint32_t)bounds.size();
+
+    // Order objects along a Morton curve over their centers, so nearby
+    // objects end up in the same subtrees
+    float centerMin[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float centerMax[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (const Aabb& box : bounds)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float center = (box.min[axis] + box.max[axis]) * 0.5f;
+            centerMin[axis] = std::min(centerMin[axis], center);
+            centerMax[axis] = std::max(centerMax[axis], center);
+        }
+    }
+
+    std::vector<uint64_t> keys(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint32_t code = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float center =
+                (bounds[i].min[axis] + bounds[i].max[axis]) * 0.5f;
+            code |= expandBits(quantize(center, centerMin[axis],
+                                        centerMax[axis]))
+                    << (2 - axis);
+        }
+        keys[i] = ((uint64_t)code << 32) | i;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    mOrder.resize(count);
+    for (std::vector<float>* values :
+         {&mMinX, &mMinY, &mMinZ, &mMaxX, &mMaxY, &mMaxZ})
+    {
+        values->resize(count);
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t object = (uint32_t)keys[i];
+        mOrder[i] = object;
+        mMinX[i] = bounds[object].min[0];
+        mMinY[i] = bounds[object].min[1];
+        mMinZ[i] = bounds[object].min[2];
+        mMaxX[i] = bounds[object].max[0];
+        mMaxY[i] = bounds[object].max[1];
+        mMaxZ[i] = bounds[object].max[2];
+    }
+
+    // The root is always a node, even when everything fits in one leaf
+    mNodes.clear();
+    mBuiltSurfaceArea = 0.0f;
+    if (count == 0)
+    {
+        return;
+    }
+    mNodes.emplace_back();
+    const uint32_t partSize = (count + kSlots - 1) / kSlots;
+    for (uint32_t slot = 0; slot < kSlots; ++slot)
+    {
+        const uint32_t first = std::min(slot * partSize, count);
+        buildChild(0, slot, first, std::min(partSize, count - first));
+    }
+
+    refit();
+    mBuiltSurfaceArea = getSurfaceArea();
+}
+
+void Bvh::buildChild(uint32_t node, uint32_t slot, uint32_t first,
+                     uint32_t count)
+{
+    mNodes[node].first[slot] = first;
+    mNodes[node].count[slot] = count;
+    mNodes[node].child[slot] = -1;
+    if (count <= kLeafSize)
+    {
+        return;
+    }
+
+    // Split into quarters of the Morton order, which keeps the tree balanced
+    const uint32_t child = (uint32_t)mNodes.size();
+    mNodes.emplace_back();
+    mNodes[node].child[slot] = (int32_t)child;
+
+    const uint32_t partSize = (count + kSlots - 1) / kSlots;
+    for (uint32_t childSlot = 0; childSlot < kSlots; ++childSlot)
+    {
+        const uint32_t offset = std::min(childSlot * partSize, count);
+        buildChild(child, childSlot, first + offset,
+                   std::min(partSize, count - offset));
+    }
+}
+
+const std::vector<uint32_t>& Bvh::getOrder() const { return mOrder; }
+
+float* Bvh::getMinX() { return mMinX.data(); }
+
+float* Bvh::getMinY() { return mMinY.data(); }
+
+float* Bvh::getMinZ() { return mMinZ.data(); }
+
+float* Bvh::getMaxX() { return mMaxX.data(); }
+
+float* Bvh::getMaxY() { return mMaxY.data(); }
+
+float* Bvh::getMaxZ() { return mMaxZ.data(); }
+
+float Bvh::refit()
+{
+    for (size_t i = mNodes.size(); i-- > 0;)
+    {
+        BvhNode& node = mNodes[i];
+        for (uint32_t slot = 0; slot < kSlots; ++slot)
+        {
+            float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+            float maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
+
+            if (node.child[slot] >= 0)
+            {
+                // Children come later, so they've already been refit
+                const BvhNode& child = mNodes[node.child[slot]];
+                for (uint32_t childSlot = 0; childSlot < kSlots; ++childSlot)
+                {
+                    minX = std::min(minX, child.minX[childSlot]);
+                    minY = std::min(minY, child.minY[childSlot]);
+                    minZ = std::min(minZ, child.minZ[childSlot]);
+                    maxX = std::max(maxX, child.maxX[childSlot]);
+                    maxY = std::max(maxY, child.maxY[childSlot]);
+                    maxZ = std::max(maxZ, child.maxZ[childSlot]);
+                }
+            }
+            else
+            {
+                const uint32_t end = node.first[slot] + node.count[slot];
+                for (uint32_t object = node.first[slot]; object < end; ++object)
+                {
+                    minX = std::min(minX, mMinX[object]);
+                    minY = std::min(minY, mMinY[object]);
+                    minZ = std::min(minZ, mMinZ[object]);
+                    maxX = std::max(maxX, mMaxX[object]);
+                    maxY = std::max(maxY, mMaxY[object]);
+                    maxZ = std::max(maxZ, mMaxZ[object]);
+                }
+            }
+
+            // Empty slots end up inverted, so no test can pass them
+            node.minX[slot] = minX;
+            node.minY[slot] = minY;
+            node.minZ[slot] = minZ;
+            node.maxX[slot] = maxX;
+            node.maxY[slot] = maxY;
+            node.maxZ[slot] = maxZ;
+        }
+    }
+
+    return mBuiltSurfaceArea > 0.0f ? getSurfaceArea() / mBuiltSurfaceArea
+                                    : 1.0f;
+}
+
+const std::vector<BvhNode>& Bvh::getNodes() const { return mNodes; }
+
+size_t Bvh::getObjectCount() const { return mOrder.size(); }
+
+bool Bvh::empty() const { return mNodes.empty(); }
+
+float Bvh::getSurfaceArea() const
+{
+    float area = 0.0f;
+    for (const BvhNode& node : mNodes)
+    {
+        for (uint32_t slot = 0; slot < kSlots; ++slot)
+        {
+            if (node.count[slot] > 0)
+            {
+                area += surfaceArea(node.maxX[slot] - node.minX[slot],
+                                    node.maxY[slot] - node.minY[slot],
+                                    node.maxZ[slot] - node.minZ[slot]);
+            }
+        }
+    }
+    return area;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding Volume Hierarchy
+// A four wide tree over object bounds. Every node keeps its children's
+// bounds as a structure of arrays, so one SIMD test covers all four, and
+// every subtree covers a contiguous range of the object order, so a subtree
+// that's entirely visible is accepted without visiting it. Objects are
+// ordered along a Morton curve of their centers when the tree is built.
+// When they move, refit() updates the bounds in place, keeping the shape
+// of the tree, and it's rebuilt once refitting has degraded it too much.
+
+struct Aabb
+{
+    float min[3];
+    float max[3];
+};
+
+struct alignas(16) BvhNode
+{
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+
+    // Index of the child node, or -1 when the child is a leaf
+    int32_t child[4];
+
+    // Range of the object order a child covers, empty slots have no objects
+    uint32_t first[4];
+    uint32_t count[4];
+};
+
+class Bvh
+{
+  public:
+    // Objects per leaf, at most
+    static const uint32_t kLeafSize = 16;
+
+    // Rebuild over new bounds, indexed by object
+    void build(const std::vector<Aabb>& bounds);
+
+    // Objects in tree order
+    const std::vector<uint32_t>& getOrder() const;
+
+    // Bounds in tree order as a structure of arrays, refit() reads these
+    float* getMinX();
+    float* getMinY();
+    float* getMinZ();
+    float* getMaxX();
+    float* getMaxY();
+    float* getMaxZ();
+
+    // Recompute node bounds after the object bounds in tree order changed,
+    // returns how much bigger the tree got than when it was built, a ratio
+    // of summed node surface areas
+    float refit();
+
+    const std::vector<BvhNode>& getNodes() const;
+
+    size_t getObjectCount() const;
+
+    bool empty() const;
+
+  protected:
+    // Set up the child slot of a node covering [first, first + count)
+    void buildChild(uint32_t node, uint32_t slot, uint32_t first,
+                    uint32_t count);
+
+    float getSurfaceArea() const;
+
+    std::vector<uint32_t> mOrder;
+    std::vector<float> mMinX, mMinY, mMinZ, mMaxX, mMaxY, mMaxZ;
+
+    // Parents come before their children, so refitting runs backwards
+    std::vector<BvhNode> mNodes;
+
+    float mBuiltSurfaceArea = 0.0f;
+};
@@ -0,0 +1,373 @@
+#include "ClusterCuller.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+
+namespace
+{
+// Meshlets loaded past the end of the arrays at most
+const uint32_t kPadding = 8;
+
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// The arrays of ClusterCuller, indexed by meshlet
+struct MeshletArrays
+{
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* radius;
+    const float* axisX;
+    const float* axisY;
+    const float* axisZ;
+    const float* cutoff;
+};
+
+// Frustum planes and camera in a mesh's model space. The planes aren't
+// normalized, so sphere radii are scaled by the length of their normals.
+struct ModelView
+{
+    float planes[6][4];
+    float planeLength[6];
+    float camera[3];
+    bool cones;
+};
+
+// Bit 0 of outside is set if the meshlet's sphere is outside the frustum,
+// and of away if its triangles all face away from the camera
+void testMeshlet(const MeshletArrays& m, uint32_t i, const ModelView& view,
+                 int& outside, int& away)
+{
+    outside = 0;
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = view.planes[p];
+        const float distance = plane[0] * m.centerX[i] +
+                               plane[1] * m.centerY[i] +
+                               plane[2] * m.centerZ[i] + plane[3];
+        outside |= distance < -m.radius[i] * view.planeLength[p];
+    }
+
+    away = 0;
+    if (view.cones)
+    {
+        const float vx = m.centerX[i] - view.camera[0];
+        const float vy = m.centerY[i] - view.camera[1];
+        const float vz = m.centerZ[i] - view.camera[2];
+        const float length = std::sqrt(vx * vx + vy * vy + vz * vz);
+        away = vx * m.axisX[i] + vy * m.axisY[i] + vz * m.axisZ[i] >=
+               m.cutoff[i] * length + m.radius[i];
+    }
+}
+
+#if defined(XGFX_SIMD_X86)
+// Bit i of outside and away is meshlet i's, as testMeshlet
+void testMeshletsSse(const MeshletArrays& m, uint32_t i,
+                     const ModelView& view, int& outside, int& away)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 cx = _mm_loadu_ps(m.centerX + i);
+    const __m128 cy = _mm_loadu_ps(m.centerY + i);
+    const __m128 cz = _mm_loadu_ps(m.centerZ + i);
+    const __m128 r = _mm_loadu_ps(m.radius + i);
+
+    __m128 out = zero;
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = view.planes[p];
+        const __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), cx),
+                       _mm_mul_ps(_mm_set1_ps(plane[1]), cy)),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[2]), cz),
+                       _mm_set1_ps(plane[3])));
+        const __m128 reach = _mm_mul_ps(r, _mm_set1_ps(view.planeLength[p]));
+        out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(distance, reach), zero));
+    }
+    outside = _mm_movemask_ps(out);
+
+    away = 0;
+    if (view.cones)
+    {
+        const __m128 vx = _mm_sub_ps(cx, _mm_set1_ps(view.camera[0]));
+        const __m128 vy = _mm_sub_ps(cy, _mm_set1_ps(view.camera[1]));
+        const __m128 vz = _mm_sub_ps(cz, _mm_set1_ps(view.camera[2]));
+        const __m128 length = _mm_sqrt_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+                       _mm_mul_ps(vz, vz)));
+        const __m128 along = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(vx, _mm_loadu_ps(m.axisX + i)),
+                       _mm_mul_ps(vy, _mm_loadu_ps(m.axisY + i))),
+            _mm_mul_ps(vz, _mm_loadu_ps(m.axisZ + i)));
+        const __m128 limit =
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(m.cutoff + i), length), r);
+        away = _mm_movemask_ps(_mm_cmpge_ps(along, limit));
+    }
+}
+
+XGFX_TARGET_AVX2 void testMeshletsAvx2(const MeshletArrays& m, uint32_t i,
+                                       const ModelView& view, int& outside,
+                                       int& away)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 cx = _mm256_loadu_ps(m.centerX + i);
+    const __m256 cy = _mm256_loadu_ps(m.centerY + i);
+    const __m256 cz = _mm256_loadu_ps(m.centerZ + i);
+    const __m256 r = _mm256_loadu_ps(m.radius + i);
+
+    __m256 out = zero;
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = view.planes[p];
+        const __m256 distance = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), cx),
+                          _mm256_mul_ps(_mm256_set1_ps(plane[1]), cy)),
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[2]), cz),
+                          _mm256_set1_ps(plane[3])));
+        const __m256 reach =
+            _mm256_mul_ps(r, _mm256_set1_ps(view.planeLength[p]));
+        out = _mm256_or_ps(out, _mm256_cmp_ps(_mm256_add_ps(distance, reach),
+                                              zero, _CMP_LT_OQ));
+    }
+    outside = _mm256_movemask_ps(out);
+
+    away = 0;
+    if (view.cones)
+    {
+        const __m256 vx = _mm256_sub_ps(cx, _mm256_set1_ps(view.camera[0]));
+        const __m256 vy = _mm256_sub_ps(cy, _mm256_set1_ps(view.camera[1]));
+        const __m256 vz = _mm256_sub_ps(cz, _mm256_set1_ps(view.camera[2]));
+        const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)),
+            _mm256_mul_ps(vz, vz)));
+        const __m256 along = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(vx, _mm256_loadu_ps(m.axisX + i)),
+                          _mm256_mul_ps(vy, _mm256_loadu_ps(m.axisY + i))),
+            _mm256_mul_ps(vz, _mm256_loadu_ps(m.axisZ + i)));
+        const __m256 limit = _mm256_add_ps(
+            _mm256_mul_ps(_mm256_loadu_ps(m.cutoff + i), length), r);
+        away = _mm256_movemask_ps(_mm256_cmp_ps(along, limit, _CMP_GE_OQ));
+    }
+}
+#endif
+}
+
+double ClusterCullingStats::trianglesCulledPerMillisecond() const
+{
+    return cullTime > 0.0 ? (double)trianglesCulled / cullTime : 0.0;
+}
+
+void ClusterCullingStats::report(std::ostream& out) const
+{
+    out << "Cluster culling: " << trianglesCulled << " of " << triangles
+        << " triangles culled, " << frustumCulled << " outside and "
+        << backfaceCulled << " facing away of " << meshlets
+        << " meshlets over " << frames << " frames\n";
+    out << "  ms: " << cullTime << " culling, "
+        << trianglesCulledPerMillisecond() << " triangles culled per ms\n";
+}
+
+ClusterCuller::ClusterCuller() : mAvx2(cpuSupportsAvx2()) {}
+
+void ClusterCuller::setMeshlets(const MeshMeshlet* meshlets, uint32_t count)
+{
+    mMeshlets.assign(meshlets, meshlets + count);
+
+    std::vector<float>* arrays[] = {&mCenterX, &mCenterY, &mCenterZ,
+                                    &mRadius,  &mAxisX,   &mAxisY,
+                                    &mAxisZ,   &mCutoff};
+    for (std::vector<float>* array : arrays)
+    {
+        array->assign(count + kPadding, 0.0f);
+    }
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const MeshMeshlet& meshlet = meshlets[i];
+        mCenterX[i] = meshlet.center[0];
+        mCenterY[i] = meshlet.center[1];
+        mCenterZ[i] = meshlet.center[2];
+        mRadius[i] = meshlet.radius;
+        mAxisX[i] = meshlet.coneAxis[0];
+        mAxisY[i] = meshlet.coneAxis[1];
+        mAxisZ[i] = meshlet.coneAxis[2];
+        mCutoff[i] = meshlet.coneCutoff;
+    }
+}
+
+void ClusterCuller::build(const DrawBatcher& batcher,
+                          const std::vector<DrawItem>& items,
+                          const std::vector<MeshRange>& meshes,
+                          const glm::mat4& viewProjection,
+                          const glm::vec3& cameraPosition, bool cullMeshlets,
+                          bool backfaceCulling)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    // Rows of the matrix combine into the planes of the clip volume, the
+    // same way the culling system finds them
+    float frustum[6][4];
+    for (int p = 0; p < 6; ++p)
+    {
+        const int row = p / 2;
+        const float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int column = 0; column < 4; ++column)
+        {
+            frustum[p][column] = viewProjection[column][3] +
+                                 sign * viewProjection[column][row];
+        }
+    }
+
+    mDraws.clear();
+    for (const InstancedDraw& draw : batcher.getDraws())
+    {
+        const MeshRange& mesh = meshes[draw.mesh];
+        if (!cullMeshlets || draw.instanceCount != 1 || mesh.meshletCount < 2)
+        {
+            mDraws.push_back({draw.pipeline, mesh.indexCount, mesh.firstIndex,
+                              mesh.baseVertex, draw.firstInstance,
+                              draw.instanceCount});
+            continue;
+        }
+
+        // A plane of the frustum in model space is the plane times the model
+        // matrix, so that it holds for model space positions
+        const glm::mat4& model =
+            items[batcher.getItem(draw.firstInstance)].modelMatrix;
+        float planes[6][4];
+        for (int p = 0; p < 6; ++p)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                planes[p][column] = frustum[p][0] * model[column][0] +
+                                    frustum[p][1] * model[column][1] +
+                                    frustum[p][2] * model[column][2] +
+                                    frustum[p][3] * model[column][3];
+            }
+        }
+        const glm::vec4 camera =
+            glm::inverse(model) * glm::vec4(cameraPosition, 1.0f);
+
+        // Mirroring flips which side of a triangle the rasterizer culls
+        const bool cones =
+            backfaceCulling && glm::determinant(glm::mat3(model)) > 0.0f;
+
+        cullDraw(draw, mesh, planes, &camera[0], cones);
+    }
+
+    mStats.frames++;
+    mStats.cullTime +=
+        elapsedMilliseconds(start, std::chrono::steady_clock::now());
+}
+
+const std::vector<ClusterDraw>& ClusterCuller::getDraws() const
+{
+    return mDraws;
+}
+
+void ClusterCuller::writeIndirectArguments(
+    D3D12_DRAW_INDEXED_ARGUMENTS* arguments) const
+{
+    for (size_t i = 0; i < mDraws.size(); ++i)
+    {
+        const ClusterDraw& draw = mDraws[i];
+
+        D3D12_DRAW_INDEXED_ARGUMENTS& args = arguments[i];
+        args.IndexCountPerInstance = draw.indexCount;
+        args.InstanceCount = draw.instanceCount;
+        args.StartIndexLocation = draw.firstIndex;
+        args.BaseVertexLocation = draw.baseVertex;
+        args.StartInstanceLocation = draw.firstInstance;
+    }
+}
+
+const ClusterCullingStats& ClusterCuller::getStats() const { return mStats; }
+
+void ClusterCuller::resetStats() { mStats = ClusterCullingStats(); }
+
+void ClusterCuller::cullDraw(const InstancedDraw& draw, const MeshRange& mesh,
+                             const float (*planes)[4], const float* camera,
+                             bool cones)
+{
+    ModelView view;
+    std::copy(&planes[0][0], &planes[0][0] + 6 * 4, &view.planes[0][0]);
+    for (int p = 0; p < 6; ++p)
+    {
+        view.planeLength[p] =
+            std::sqrt(planes[p][0] * planes[p][0] +
+                      planes[p][1] * planes[p][1] +
+                      planes[p][2] * planes[p][2]);
+    }
+    std::copy(camera, camera + 3, view.camera);
+    view.cones = cones;
+
+    const MeshletArrays arrays = {
+        mCenterX.data(), mCenterY.data(), mCenterZ.data(), mRadius.data(),
+        mAxisX.data(),   mAxisY.data(),   mAxisZ.data(),   mCutoff.data()};
+
+    // Visible meshlets extend the last draw when their indices follow on
+    // from it, which they do unless a meshlet between them was culled
+    const size_t firstDraw = mDraws.size();
+    auto accept = [&](uint32_t meshletIndex, int outside, int away) {
+        const MeshMeshlet& meshlet = mMeshlets[meshletIndex];
+        mStats.meshlets++;
+        mStats.triangles += meshlet.triangleCount;
+        if (outside || away)
+        {
+            mStats.frustumCulled += outside != 0;
+            mStats.backfaceCulled += outside == 0;
+            mStats.trianglesCulled += meshlet.triangleCount;
+            return;
+        }
+
+        if (mDraws.size() > firstDraw &&
+            mDraws.back().firstIndex + mDraws.back().indexCount ==
+                meshlet.firstIndex)
+        {
+            mDraws.back().indexCount += meshlet.triangleCount * 3;
+        }
+        else
+        {
+            mDraws.push_back({draw.pipeline, meshlet.triangleCount * 3,
+                              meshlet.firstIndex, mesh.baseVertex,
+                              draw.firstInstance, 1});
+        }
+    };
+
+    const uint32_t end = mesh.firstMeshlet + mesh.meshletCount;
+    uint32_t i = mesh.firstMeshlet;
+#if defined(XGFX_SIMD_X86)
+    if (mAvx2)
+    {
+        for (; i + 8 <= end; i += 8)
+        {
+            int outside, away;
+            testMeshletsAvx2(arrays, i, view, outside, away);
+            for (uint32_t lane = 0; lane < 8; ++lane)
+            {
+                accept(i + lane, (outside >> lane) & 1, (away >> lane) & 1);
+            }
+        }
+    }
+    for (; i + 4 <= end; i += 4)
+    {
+        int outside, away;
+        testMeshletsSse(arrays, i, view, outside, away);
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            accept(i + lane, (outside >> lane) & 1, (away >> lane) & 1);
+        }
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        int outside, away;
+        testMeshlet(arrays, i, view, outside, away);
+        accept(i, outside, away);
+    }
+}
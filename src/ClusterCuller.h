@@ -0,0 +1,98 @@
+#pragma once
+
+#include "DrawBatcher.h"
+#include "FramePacket.h"
+#include "MeshFormat.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Cluster Culler
+// Culls the meshlets of large meshes before their triangles reach the GPU.
+// A draw of a single instance of a mesh with several meshlets is split into
+// draws of its visible meshlets: the frustum planes and camera are taken
+// into the instance's model space, where meshlet spheres are tested against
+// the planes and normal cones against the camera four or eight at a time,
+// and runs of visible meshlets are merged back into one draw. Instanced
+// draws are drawn whole, splitting them per instance would cost more draws
+// than it saves triangles, and every other draw passes through unchanged.
+
+// A draw of a range of a mesh's indices
+struct ClusterDraw
+{
+    uint32_t pipeline;
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+struct ClusterCullingStats
+{
+    uint64_t frames = 0;
+
+    // Meshlets of split draws tested, and those outside the frustum or
+    // facing away from the camera
+    uint64_t meshlets = 0;
+    uint64_t frustumCulled = 0;
+    uint64_t backfaceCulled = 0;
+
+    // Triangles of split draws, and those culled with their meshlets
+    uint64_t triangles = 0;
+    uint64_t trianglesCulled = 0;
+
+    // Time spent culling meshlets, in milliseconds
+    double cullTime = 0.0;
+
+    double trianglesCulledPerMillisecond() const;
+
+    void report(std::ostream& out) const;
+};
+
+class ClusterCuller
+{
+  public:
+    ClusterCuller();
+
+    // Meshlets of every mesh, meshes refer to them by their first meshlet
+    void setMeshlets(const MeshMeshlet* meshlets, uint32_t count);
+
+    // Turn the batcher's draws into the draws to record. Normal cones only
+    // cull with backfaceCulling set, a pipeline drawing both sides of its
+    // triangles shows the ones they'd remove.
+    void build(const DrawBatcher& batcher, const std::vector<DrawItem>& items,
+               const std::vector<MeshRange>& meshes,
+               const glm::mat4& viewProjection,
+               const glm::vec3& cameraPosition, bool cullMeshlets,
+               bool backfaceCulling);
+
+    const std::vector<ClusterDraw>& getDraws() const;
+
+    // Write one set of arguments per draw, in draw order
+    void writeIndirectArguments(D3D12_DRAW_INDEXED_ARGUMENTS* arguments) const;
+
+    const ClusterCullingStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    // Split a draw into draws of its meshlets that are visible from the
+    // camera, with planes and camera in model space
+    void cullDraw(const InstancedDraw& draw, const MeshRange& mesh,
+                  const float (*planes)[4], const float* camera, bool cones);
+
+    bool mAvx2;
+
+    std::vector<MeshMeshlet> mMeshlets;
+
+    // Meshlet spheres and cones as a structure of arrays, padded so the
+    // last meshlets can be loaded eight at a time
+    std::vector<float> mCenterX, mCenterY, mCenterZ, mRadius;
+    std::vector<float> mAxisX, mAxisY, mAxisZ, mCutoff;
+
+    std::vector<ClusterDraw> mDraws;
+
+    ClusterCullingStats mStats;
+};
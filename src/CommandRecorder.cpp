@@ -0,0 +1,123 @@
+#include "CommandRecorder.h"
+#include "Profiler.h"
+
+#include <chrono>
+#include <ostream>
+
+void CommandRecorderStats::report(std::ostream& out) const
+{
+    out << "Command recording: " << batches << " batches over " << frames
+        << " frames, " << submits << " submits\n";
+    out << "  record ms: " << recordTime << " total, "
+        << (frames > 0 ? recordTime / (double)frames : 0.0) << " per frame\n";
+}
+
+CommandRecorder::CommandRecorder(ID3D12Device* device, JobSystem& jobSystem,
+                                 unsigned framesInFlight,
+                                 D3D12_COMMAND_LIST_TYPE type)
+    : mDevice(device), mJobSystem(jobSystem), mType(type), mFrameIndex(0),
+      mRecordedLists(0)
+{
+    mAllocators.resize(framesInFlight);
+    for (std::vector<ID3D12CommandAllocator*>& allocators : mAllocators)
+    {
+        allocators.resize(mJobSystem.getThreadCount(), nullptr);
+        for (ID3D12CommandAllocator*& allocator : allocators)
+        {
+            ThrowIfFailed(mDevice->CreateCommandAllocator(
+                mType, IID_PPV_ARGS(&allocator)));
+        }
+    }
+}
+
+CommandRecorder::~CommandRecorder()
+{
+    for (ID3D12GraphicsCommandList* commandList : mCommandLists)
+    {
+        commandList->Release();
+    }
+    mCommandLists.clear();
+
+    for (std::vector<ID3D12CommandAllocator*>& allocators : mAllocators)
+    {
+        for (ID3D12CommandAllocator* allocator : allocators)
+        {
+            allocator->Release();
+        }
+    }
+    mAllocators.clear();
+}
+
+void CommandRecorder::beginFrame(unsigned frameIndex)
+{
+    mFrameIndex = frameIndex;
+    for (ID3D12CommandAllocator* allocator : mAllocators[mFrameIndex])
+    {
+        ThrowIfFailed(allocator->Reset());
+    }
+    mRecordedLists = 0;
+    mStats.frames++;
+}
+
+void CommandRecorder::record(uint32_t batchCount,
+                             ID3D12PipelineState* initialState,
+                             const RecordBatchFunction& recordBatch)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<ID3D12CommandAllocator*>& allocators =
+        mAllocators[mFrameIndex];
+
+    // Lists are created open, close new ones so every list starts out the
+    // same way
+    while (mCommandLists.size() < mRecordedLists + batchCount)
+    {
+        ID3D12GraphicsCommandList* commandList = nullptr;
+        ThrowIfFailed(mDevice->CreateCommandList(
+            0, mType, allocators[0], nullptr, IID_PPV_ARGS(&commandList)));
+        ThrowIfFailed(commandList->Close());
+        mCommandLists.push_back(commandList);
+    }
+
+    const size_t firstList = mRecordedLists;
+    mJobSystem.parallelFor(
+        batchCount, 1,
+        [&](uint32_t begin, uint32_t end, unsigned threadIndex) {
+            for (uint32_t batch = begin; batch < end; ++batch)
+            {
+                ID3D12GraphicsCommandList* commandList =
+                    mCommandLists[firstList + batch];
+                PROFILE_SCOPE("Record Batch");
+                ThrowIfFailed(
+                    commandList->Reset(allocators[threadIndex], initialState));
+                recordBatch(commandList, batch);
+                ThrowIfFailed(commandList->Close());
+            }
+        });
+    mRecordedLists += batchCount;
+
+    mStats.batches += batchCount;
+    mStats.recordTime += std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+}
+
+void CommandRecorder::submit(ID3D12CommandQueue* queue)
+{
+    if (mRecordedLists == 0)
+    {
+        return;
+    }
+
+    mSubmitLists.assign(mCommandLists.begin(),
+                        mCommandLists.begin() + mRecordedLists);
+    queue->ExecuteCommandLists((UINT)mSubmitLists.size(), mSubmitLists.data());
+    mRecordedLists = 0;
+    mStats.submits++;
+}
+
+const CommandRecorderStats& CommandRecorder::getStats() const
+{
+    return mStats;
+}
+
+void CommandRecorder::resetStats() { mStats = CommandRecorderStats(); }
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+// Command Recorder
+// Records a frame's commands in parallel on the job system. Every batch of
+// commands gets a command list of its own, recorded from the command
+// allocator of whichever thread runs it, and the lists are submitted in
+// batch order with a single ExecuteCommandLists call. Allocators exist per
+// thread and per frame in flight, since an allocator can't be reset until
+// the GPU is done with every list recorded from it.
+
+struct CommandRecorderStats
+{
+    uint64_t frames = 0;
+    uint64_t batches = 0;
+    uint64_t submits = 0;
+
+    // Wall time spent in record(), in milliseconds
+    double recordTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+// Records one batch into a list that's already reset, the list is closed
+// afterwards
+typedef std::function<void(ID3D12GraphicsCommandList* commandList,
+                           uint32_t batch)>
+    RecordBatchFunction;
+
+class CommandRecorder
+{
+  public:
+    CommandRecorder(ID3D12Device* device, JobSystem& jobSystem,
+                    unsigned framesInFlight,
+                    D3D12_COMMAND_LIST_TYPE type =
+                        D3D12_COMMAND_LIST_TYPE_DIRECT);
+
+    // The GPU has to be done with every frame
+    ~CommandRecorder();
+
+    // Reset the allocators of a frame in flight, the GPU has to be done with
+    // what was last recorded into it
+    void beginFrame(unsigned frameIndex);
+
+    // Record batches in parallel, they're queued for submission after the
+    // ones recorded before
+    void record(uint32_t batchCount, ID3D12PipelineState* initialState,
+                const RecordBatchFunction& recordBatch);
+
+    // Execute every list recorded this frame in order, in one call
+    void submit(ID3D12CommandQueue* queue);
+
+    const CommandRecorderStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    ID3D12Device* mDevice;
+    JobSystem& mJobSystem;
+    D3D12_COMMAND_LIST_TYPE mType;
+
+    // Allocators by frame in flight, then by thread
+    std::vector<std::vector<ID3D12CommandAllocator*>> mAllocators;
+    unsigned mFrameIndex;
+
+    // Lists can be reset as soon as they're submitted, so they're shared by
+    // every frame, the first mRecordedLists of them are recorded
+    std::vector<ID3D12GraphicsCommandList*> mCommandLists;
+    size_t mRecordedLists;
+    std::vector<ID3D12CommandList*> mSubmitLists;
+
+    CommandRecorderStats mStats;
+};
@@ -0,0 +1,467 @@
+#include "CullingSystem.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+
+namespace
+{
+// Rebuild once refitting has grown the tree's summed surface area past this
+// multiple of what it was when built
+const float kRebuildGrowth = 2.0f;
+
+// Items whose bounds are updated per job
+const uint32_t kBoundsBatchSize = 4096;
+
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// The mesh bounds transformed by the model matrix, as the box around the
+// transformed box's center and extents
+Aabb getWorldBounds(const DrawItem& item, const MeshRange& mesh)
+{
+    const glm::mat4& m = item.modelMatrix;
+    float center[3], extent[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        center[axis] = (mesh.boundsMin[axis] + mesh.boundsMax[axis]) * 0.5f;
+        extent[axis] = (mesh.boundsMax[axis] - mesh.boundsMin[axis]) * 0.5f;
+    }
+
+    Aabb bounds;
+    for (int row = 0; row < 3; ++row)
+    {
+        const float worldCenter = m[0][row] * center[0] +
+                                  m[1][row] * center[1] +
+                                  m[2][row] * center[2] + m[3][row];
+        const float worldExtent = std::fabs(m[0][row]) * extent[0] +
+                                  std::fabs(m[1][row]) * extent[1] +
+                                  std::fabs(m[2][row]) * extent[2];
+        bounds.min[row] = worldCenter - worldExtent;
+        bounds.max[row] = worldCenter + worldExtent;
+    }
+    return bounds;
+}
+
+// 0 if a box is outside the planes, 1 if it intersects them, 2 if it's
+// entirely inside
+int classifyBox(float minX, float minY, float minZ, float maxX, float maxY,
+                float maxZ, const float (*planes)[4])
+{
+    int result = 2;
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = planes[p];
+
+        // The corners furthest along and against the plane normal
+        const float px = plane[0] >= 0.0f ? maxX : minX;
+        const float py = plane[1] >= 0.0f ? maxY : minY;
+        const float pz = plane[2] >= 0.0f ? maxZ : minZ;
+        const float nx = plane[0] >= 0.0f ? minX : maxX;
+        const float ny = plane[1] >= 0.0f ? minY : maxY;
+        const float nz = plane[2] >= 0.0f ? minZ : maxZ;
+        if (plane[0] * px + plane[1] * py + plane[2] * pz + plane[3] < 0.0f)
+        {
+            return 0;
+        }
+        if (plane[0] * nx + plane[1] * ny + plane[2] * nz + plane[3] < 0.0f)
+        {
+            result = 1;
+        }
+    }
+    return result;
+}
+
+#if defined(XGFX_SIMD_X86)
+// Bit i of visible is set if box i isn't outside, bit i of inside if it's
+// entirely inside
+void classifyBoxesSse(const float* minX, const float* minY, const float* minZ,
+                      const float* maxX, const float* maxY, const float* maxZ,
+                      const float (*planes)[4], int& visible, int& inside)
+{
+    const __m128 zero = _mm_setzero_ps();
+    __m128 outside = zero;
+    __m128 partial = zero;
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = planes[p];
+        const __m128 a = _mm_set1_ps(plane[0]);
+        const __m128 b = _mm_set1_ps(plane[1]);
+        const __m128 c = _mm_set1_ps(plane[2]);
+        const __m128 d = _mm_set1_ps(plane[3]);
+
+        // Which corner to test only depends on the plane, not the box
+        const __m128 px = _mm_loadu_ps(plane[0] >= 0.0f ? maxX : minX);
+        const __m128 py = _mm_loadu_ps(plane[1] >= 0.0f ? maxY : minY);
+        const __m128 pz = _mm_loadu_ps(plane[2] >= 0.0f ? maxZ : minZ);
+        const __m128 nx = _mm_loadu_ps(plane[0] >= 0.0f ? minX : maxX);
+        const __m128 ny = _mm_loadu_ps(plane[1] >= 0.0f ? minY : maxY);
+        const __m128 nz = _mm_loadu_ps(plane[2] >= 0.0f ? minZ : maxZ);
+
+        const __m128 pDistance = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a, px), _mm_mul_ps(b, py)),
+            _mm_add_ps(_mm_mul_ps(c, pz), d));
+        const __m128 nDistance = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a, nx), _mm_mul_ps(b, ny)),
+            _mm_add_ps(_mm_mul_ps(c, nz), d));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(pDistance, zero));
+        partial = _mm_or_ps(partial, _mm_cmplt_ps(nDistance, zero));
+    }
+    visible = ~_mm_movemask_ps(outside) & 0xf;
+    inside = ~_mm_movemask_ps(_mm_or_ps(outside, partial)) & 0xf;
+}
+
+// Bit i is set if box i isn't outside
+XGFX_TARGET_AVX2 int testBoxesAvx2(const float* minX, const float* minY,
+                                   const float* minZ, const float* maxX,
+                                   const float* maxY, const float* maxZ,
+                                   const float (*planes)[4])
+{
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 outside = zero;
+    for (int p = 0; p < 6; ++p)
+    {
+        const float* plane = planes[p];
+        const __m256 px = _mm256_loadu_ps(plane[0] >= 0.0f ? maxX : minX);
+        const __m256 py = _mm256_loadu_ps(plane[1] >= 0.0f ? maxY : minY);
+        const __m256 pz = _mm256_loadu_ps(plane[2] >= 0.0f ? maxZ : minZ);
+        const __m256 pDistance = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), px),
+                          _mm256_mul_ps(_mm256_set1_ps(plane[1]), py)),
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[2]), pz),
+                          _mm256_set1_ps(plane[3])));
+        outside =
+            _mm256_or_ps(outside, _mm256_cmp_ps(pDistance, zero, _CMP_LT_OQ));
+    }
+    return ~_mm256_movemask_ps(outside) & 0xff;
+}
+#endif
+}
+
+double CullingStats::rejectionRate() const
+{
+    return objects > 0 ? 1.0 - (double)visible / (double)objects : 0.0;
+}
+
+void CullingStats::report(std::ostream& out) const
+{
+    out << "Culling: " << visible << " of " << objects << " objects visible, "
+        << rejectionRate() * 100.0 << "% rejected, " << builds
+        << " builds over " << frames << " frames\n";
+    out << "  ms: " << buildTime << " building, " << refitTime << " refitting, "
+        << cullTime << " culling, "
+        << (frames > 0 ? (refitTime + cullTime) / (double)frames : 0.0)
+        << " per frame\n";
+}
+
+CullingSystem::CullingSystem(JobSystem& jobSystem)
+    : mJobSystem(jobSystem), mAvx2(cpuSupportsAvx2())
+{
+}
+
+void CullingSystem::cull(const std::vector<DrawItem>& items,
+                         const std::vector<MeshRange>& meshes,
+                         const glm::mat4& viewProjection)
+{
+    if (mBvh.getObjectCount() != items.size() || mBvh.empty())
+    {
+        rebuild(items, meshes);
+    }
+    else
+    {
+        refit(items, meshes);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Rows of the matrix combine into the planes of the clip volume, the
+    // near plane is -w <= z, which holds for either depth convention
+    Frustum frustum;
+    for (int p = 0; p < 6; ++p)
+    {
+        const int row = p / 2;
+        const float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        for (int column = 0; column < 4; ++column)
+        {
+            frustum.planes[p][column] = viewProjection[column][3] +
+                                        sign * viewProjection[column][row];
+        }
+    }
+
+    mVisibleFlags.assign(items.size(), 0);
+    mJobSystem.parallelFor(
+        (uint32_t)mTasks.size(), 1,
+        [&](uint32_t begin, uint32_t end, unsigned threadIndex) {
+            for (uint32_t task = begin; task < end; ++task)
+            {
+                cullTask(mTasks[task], frustum);
+            }
+        });
+
+    // Compact in submission order, so a scene that's already sorted for
+    // batching stays sorted
+    mVisible.clear();
+    for (uint32_t item = 0; item < (uint32_t)mVisibleFlags.size(); ++item)
+    {
+        if (mVisibleFlags[item] != 0)
+        {
+            mVisible.push_back(item);
+        }
+    }
+
+    mStats.frames++;
+    mStats.objects += items.size();
+    mStats.visible += mVisible.size();
+    mStats.cullTime +=
+        elapsedMilliseconds(start, std::chrono::steady_clock::now());
+}
+
+const std::vector<uint32_t>& CullingSystem::getVisible() const
+{
+    return mVisible;
+}
+
+const CullingStats& CullingSystem::getStats() const { return mStats; }
+
+void CullingSystem::resetStats() { mStats = CullingStats(); }
+
+void CullingSystem::rebuild(const std::vector<DrawItem>& items,
+                            const std::vector<MeshRange>& meshes)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    mBuildBounds.resize(items.size());
+    mJobSystem.parallelFor(
+        (uint32_t)items.size(), kBoundsBatchSize,
+        [&](uint32_t begin, uint32_t end, unsigned threadIndex) {
+            for (uint32_t item = begin; item < end; ++item)
+            {
+                mBuildBounds[item] =
+                    getWorldBounds(items[item], meshes[items[item].mesh]);
+            }
+        });
+    mBvh.build(mBuildBounds);
+    buildTasks();
+
+    mStats.builds++;
+    mStats.buildTime +=
+        elapsedMilliseconds(start, std::chrono::steady_clock::now());
+}
+
+void CullingSystem::refit(const std::vector<DrawItem>& items,
+                          const std::vector<MeshRange>& meshes)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    // Bounds are written in tree order, so leaves read them contiguously
+    const std::vector<uint32_t>& order = mBvh.getOrder();
+    float* minX = mBvh.getMinX();
+    float* minY = mBvh.getMinY();
+    float* minZ = mBvh.getMinZ();
+    float* maxX = mBvh.getMaxX();
+    float* maxY = mBvh.getMaxY();
+    float* maxZ = mBvh.getMaxZ();
+    mJobSystem.parallelFor(
+        (uint32_t)order.size(), kBoundsBatchSize,
+        [&](uint32_t begin, uint32_t end, unsigned threadIndex) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const DrawItem& item = items[order[i]];
+                const Aabb bounds = getWorldBounds(item, meshes[item.mesh]);
+                minX[i] = bounds.min[0];
+                minY[i] = bounds.min[1];
+                minZ[i] = bounds.min[2];
+                maxX[i] = bounds.max[0];
+                maxY[i] = bounds.max[1];
+                maxZ[i] = bounds.max[2];
+            }
+        });
+    const float growth = mBvh.refit();
+
+    mStats.refitTime +=
+        elapsedMilliseconds(start, std::chrono::steady_clock::now());
+
+    if (growth > kRebuildGrowth)
+    {
+        rebuild(items, meshes);
+    }
+}
+
+void CullingSystem::buildTasks()
+{
+    mTasks.clear();
+    if (mBvh.empty())
+    {
+        return;
+    }
+
+    const std::vector<BvhNode>& nodes = mBvh.getNodes();
+    for (uint32_t slot = 0; slot < 4; ++slot)
+    {
+        if (nodes[0].count[slot] > 0)
+        {
+            mTasks.push_back({0, slot});
+        }
+    }
+
+    // Expand a level at a time until there's a few tasks per thread, or
+    // only leaves are left
+    const size_t targetCount = mJobSystem.getThreadCount() * 4;
+    std::vector<Task> expanded;
+    while (mTasks.size() < targetCount)
+    {
+        expanded.clear();
+        for (const Task& task : mTasks)
+        {
+            const int32_t child = nodes[task.node].child[task.slot];
+            if (child < 0)
+            {
+                expanded.push_back(task);
+                continue;
+            }
+            for (uint32_t slot = 0; slot < 4; ++slot)
+            {
+                if (nodes[child].count[slot] > 0)
+                {
+                    expanded.push_back({(uint32_t)child, slot});
+                }
+            }
+        }
+        if (expanded.size() == mTasks.size())
+        {
+            break;
+        }
+        mTasks.swap(expanded);
+    }
+}
+
+void CullingSystem::cullTask(const Task& task, const Frustum& frustum)
+{
+    const BvhNode& node = mBvh.getNodes()[task.node];
+    const uint32_t slot = task.slot;
+    const int result = classifyBox(node.minX[slot], node.minY[slot],
+                                   node.minZ[slot], node.maxX[slot],
+                                   node.maxY[slot], node.maxZ[slot],
+                                   frustum.planes);
+    if (result == 0)
+    {
+        return;
+    }
+    if (result == 2)
+    {
+        acceptObjects(node.first[slot], node.count[slot]);
+    }
+    else if (node.child[slot] >= 0)
+    {
+        cullNode((uint32_t)node.child[slot], frustum);
+    }
+    else
+    {
+        cullObjects(node.first[slot], node.count[slot], frustum);
+    }
+}
+
+void CullingSystem::cullNode(uint32_t nodeIndex, const Frustum& frustum)
+{
+    const BvhNode& node = mBvh.getNodes()[nodeIndex];
+
+    int visible = 0;
+    int inside = 0;
+#if defined(XGFX_SIMD_X86)
+    classifyBoxesSse(node.minX, node.minY, node.minZ, node.maxX, node.maxY,
+                     node.maxZ, frustum.planes, visible, inside);
+#else
+    for (int slot = 0; slot < 4; ++slot)
+    {
+        const int result =
+            classifyBox(node.minX[slot], node.minY[slot], node.minZ[slot],
+                        node.maxX[slot], node.maxY[slot], node.maxZ[slot],
+                        frustum.planes);
+        visible |= (result != 0) << slot;
+        inside |= (result == 2) << slot;
+    }
+#endif
+
+    for (uint32_t slot = 0; slot < 4; ++slot)
+    {
+        if (node.count[slot] == 0 || (visible & (1 << slot)) == 0)
+        {
+            continue;
+        }
+
+        // Whole subtrees inside the frustum aren't visited
+        if (inside & (1 << slot))
+        {
+            acceptObjects(node.first[slot], node.count[slot]);
+        }
+        else if (node.child[slot] >= 0)
+        {
+            cullNode((uint32_t)node.child[slot], frustum);
+        }
+        else
+        {
+            cullObjects(node.first[slot], node.count[slot], frustum);
+        }
+    }
+}
+
+void CullingSystem::cullObjects(uint32_t first, uint32_t count,
+                                const Frustum& frustum)
+{
+    const std::vector<uint32_t>& order = mBvh.getOrder();
+    const float* minX = mBvh.getMinX();
+    const float* minY = mBvh.getMinY();
+    const float* minZ = mBvh.getMinZ();
+    const float* maxX = mBvh.getMaxX();
+    const float* maxY = mBvh.getMaxY();
+    const float* maxZ = mBvh.getMaxZ();
+
+    const uint32_t end = first + count;
+    uint32_t i = first;
+#if defined(XGFX_SIMD_X86)
+    if (mAvx2)
+    {
+        for (; i + 8 <= end; i += 8)
+        {
+            const int visible =
+                testBoxesAvx2(minX + i, minY + i, minZ + i, maxX + i,
+                              maxY + i, maxZ + i, frustum.planes);
+            for (uint32_t lane = 0; lane < 8; ++lane)
+            {
+                mVisibleFlags[order[i + lane]] = (visible >> lane) & 1;
+            }
+        }
+    }
+    for (; i + 4 <= end; i += 4)
+    {
+        int visible = 0;
+        int inside = 0;
+        classifyBoxesSse(minX + i, minY + i, minZ + i, maxX + i, maxY + i,
+                         maxZ + i, frustum.planes, visible, inside);
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            mVisibleFlags[order[i + lane]] = (visible >> lane) & 1;
+        }
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        mVisibleFlags[order[i]] =
+            classifyBox(minX[i], minY[i], minZ[i], maxX[i], maxY[i], maxZ[i],
+                        frustum.planes) != 0;
+    }
+}
+
+void CullingSystem::acceptObjects(uint32_t first, uint32_t count)
+{
+    const std::vector<uint32_t>& order = mBvh.getOrder();
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        mVisibleFlags[order[i]] = 1;
+    }
+}
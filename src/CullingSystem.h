@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Bvh.h"
+#include "DrawBatcher.h"
+#include "FramePacket.h"
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Culling System
+// Decides which draw items are inside the view frustum before anything is
+// recorded. Item bounds are the mesh bounds transformed by the item's model
+// matrix, kept in a BVH that's refit every frame and rebuilt when the item
+// count changes or refitting has loosened it too much. Subtrees are
+// traversed in parallel on the job system, testing four nodes or eight
+// items at a time against the frustum planes, and the result is compacted
+// into a list of visible items in submission order.
+
+struct CullingStats
+{
+    uint64_t frames = 0;
+    uint64_t objects = 0;
+    uint64_t visible = 0;
+    uint64_t builds = 0;
+
+    // Times spent, in milliseconds
+    double buildTime = 0.0;
+    double refitTime = 0.0;
+    double cullTime = 0.0;
+
+    // Share of objects culled
+    double rejectionRate() const;
+
+    void report(std::ostream& out) const;
+};
+
+class CullingSystem
+{
+  public:
+    CullingSystem(JobSystem& jobSystem);
+
+    // Cull items against the frustum of a view projection matrix, every
+    // item's mesh has to be in meshes
+    void cull(const std::vector<DrawItem>& items,
+              const std::vector<MeshRange>& meshes,
+              const glm::mat4& viewProjection);
+
+    // Visible items from the last cull, in submission order
+    const std::vector<uint32_t>& getVisible() const;
+
+    const CullingStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    // A child slot of a node, subtrees below these are culled in parallel
+    struct Task
+    {
+        uint32_t node;
+        uint32_t slot;
+    };
+
+    // Planes as a, b, c, d with normals pointing inside
+    struct Frustum
+    {
+        float planes[6][4];
+    };
+
+    // Rebuild the tree over the current item bounds
+    void rebuild(const std::vector<DrawItem>& items,
+                 const std::vector<MeshRange>& meshes);
+
+    // Refit the tree to the current item bounds, rebuilding it if that
+    // loosens it too much
+    void refit(const std::vector<DrawItem>& items,
+               const std::vector<MeshRange>& meshes);
+
+    // Split the top of the tree into enough subtrees to keep every thread
+    // busy
+    void buildTasks();
+
+    void cullTask(const Task& task, const Frustum& frustum);
+
+    void cullNode(uint32_t node, const Frustum& frustum);
+
+    void cullObjects(uint32_t first, uint32_t count, const Frustum& frustum);
+
+    void acceptObjects(uint32_t first, uint32_t count);
+
+    JobSystem& mJobSystem;
+    bool mAvx2;
+
+    Bvh mBvh;
+    std::vector<Aabb> mBuildBounds;
+    std::vector<Task> mTasks;
+
+    // Per item, written by whichever task owns its leaf
+    std::vector<uint8_t> mVisibleFlags;
+    std::vector<uint32_t> mVisible;
+
+    CullingStats mStats;
+};
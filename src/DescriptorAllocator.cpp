@@ -0,0 +1,347 @@
+#include "DescriptorAllocator.h"
+
+#include "Hash.h"
+
+#include <ostream>
+#include <stdexcept>
+
+void DescriptorStats::report(std::ostream& out) const
+{
+    out << "Descriptors: " << tables << " tables bound (" << reusedTables
+        << " reused) in " << frames << " frames, " << descriptorsCopied
+        << " copied in " << copyCalls << " calls, "
+        << (frames > 0 ? (double)descriptorsCopied / (double)frames : 0.0)
+        << " per frame (" << frameDescriptorsCopied << " last frame)\n";
+    out << "  ring peak: " << peakRingDescriptors
+        << ", bindless: " << bindlessDescriptors
+        << ", staging: " << stagingDescriptors << " in " << stagingHeaps
+        << " heaps\n";
+}
+
+DescriptorAllocator::DescriptorAllocator(ID3D12Device* device,
+                                         const DescriptorAllocatorDesc& desc)
+    : mDevice(device), mDesc(desc), mHeap(nullptr),
+      mBindless(desc.bindlessDescriptors),
+      mRing(desc.shaderVisibleDescriptors - desc.bindlessDescriptors),
+      mFrameCopies(0)
+{
+    if (desc.bindlessDescriptors >= desc.shaderVisibleDescriptors ||
+        desc.stagingHeapSize == 0)
+    {
+        throw std::runtime_error("descriptor allocator has no room for its "
+                                 "ring or staging heaps!");
+    }
+
+    for (unsigned type = 0; type < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES;
+         ++type)
+    {
+        mIncrementSizes[type] = mDevice->GetDescriptorHandleIncrementSize(
+            (D3D12_DESCRIPTOR_HEAP_TYPE)type);
+    }
+
+    D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+    heapDesc.NumDescriptors = desc.shaderVisibleDescriptors;
+    heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+    heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+    ThrowIfFailed(
+        mDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mHeap)));
+    mHeap->SetName(L"Shader Visible Descriptors");
+    mCpuStart = mHeap->GetCPUDescriptorHandleForHeapStart();
+    mGpuStart = mHeap->GetGPUDescriptorHandleForHeapStart();
+
+    mCurrent.fenceValue = 0;
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    for (StagingPool& pool : mStagingPools)
+    {
+        for (ID3D12DescriptorHeap* heap : pool.heaps)
+        {
+            heap->Release();
+        }
+    }
+    if (mHeap)
+    {
+        mHeap->Release();
+        mHeap = nullptr;
+    }
+}
+
+StagingDescriptor
+DescriptorAllocator::allocateStaging(D3D12_DESCRIPTOR_HEAP_TYPE type)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    StagingPool& pool = mStagingPools[type];
+    if (pool.freeList.empty())
+    {
+        D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+        heapDesc.NumDescriptors = mDesc.stagingHeapSize;
+        heapDesc.Type = type;
+        heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+        ID3D12DescriptorHeap* heap = nullptr;
+        ThrowIfFailed(
+            mDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&heap)));
+        heap->SetName(L"Staging Descriptors");
+        pool.heaps.push_back(heap);
+        pool.starts.push_back(heap->GetCPUDescriptorHandleForHeapStart());
+        mStats.stagingHeaps++;
+
+        // Lowest slots are popped first
+        const uint32_t first =
+            (uint32_t)(pool.heaps.size() - 1) * mDesc.stagingHeapSize;
+        for (uint32_t i = mDesc.stagingHeapSize; i > 0; --i)
+        {
+            pool.freeList.push_back(first + i - 1);
+        }
+    }
+
+    StagingDescriptor descriptor;
+    descriptor.index = pool.freeList.back();
+    pool.freeList.pop_back();
+    descriptor.cpu = pool.starts[descriptor.index / mDesc.stagingHeapSize];
+    descriptor.cpu.ptr += (SIZE_T)(descriptor.index % mDesc.stagingHeapSize) *
+                          mIncrementSizes[type];
+    mStats.stagingDescriptors++;
+    return descriptor;
+}
+
+void DescriptorAllocator::freeStaging(D3D12_DESCRIPTOR_HEAP_TYPE type,
+                                      const StagingDescriptor& descriptor)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStagingPools[type].pendingFrees.push_back(descriptor.index);
+}
+
+DescriptorRange DescriptorAllocator::allocateBindless(uint32_t count)
+{
+    TlsfAllocation allocation;
+    if (!mBindless.allocate(count, 1, allocation))
+    {
+        throw std::runtime_error("bindless descriptors are out of space!");
+    }
+
+    DescriptorRange range;
+    range.index = (uint32_t)allocation.offset;
+    range.count = count;
+    range.cpu = getCpuHandle(range.index);
+    range.gpu = getGpuHandle(range.index);
+    range.block = allocation.block;
+    mStats.bindlessDescriptors += count;
+    return range;
+}
+
+void DescriptorAllocator::freeBindless(const DescriptorRange& range)
+{
+    mCurrent.bindlessFrees.push_back(range.block);
+    mStats.bindlessDescriptors -= range.count;
+}
+
+void DescriptorAllocator::copyBindless(
+    const DescriptorRange& range, uint32_t offset,
+    const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors, uint32_t count)
+{
+    if (offset + count > range.count)
+    {
+        throw std::runtime_error("bindless copy is out of range!");
+    }
+    std::lock_guard<std::mutex> lock(mMutex);
+    stageCopies(range.index + offset, descriptors, count);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE
+DescriptorAllocator::bindTable(const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors,
+                               uint32_t count)
+{
+    uint64_t hash = kHashBasis;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        hashValue(hash, (uint64_t)descriptors[i].ptr);
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats.tables++;
+
+    // Bound earlier this frame with the same descriptors
+    auto range = mTables.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const Table& table = it->second;
+        bool same = table.count == count;
+        for (uint32_t i = 0; same && i < count; ++i)
+        {
+            same = mTableSources[table.firstSource + i].ptr ==
+                   descriptors[i].ptr;
+        }
+        if (same)
+        {
+            mStats.reusedTables++;
+            return getGpuHandle(table.index);
+        }
+    }
+
+    uint64_t offset = 0;
+    if (!mRing.allocate(count, 1, offset))
+    {
+        throw std::runtime_error("descriptor ring is out of space!");
+    }
+    mStats.peakRingDescriptors = mRing.getStats().peakUsed;
+
+    Table table;
+    table.firstSource = (uint32_t)mTableSources.size();
+    table.count = count;
+    table.index = mDesc.bindlessDescriptors + (uint32_t)offset;
+    mTableSources.insert(mTableSources.end(), descriptors,
+                         descriptors + count);
+    mTables.emplace(hash, table);
+
+    stageCopies(table.index, descriptors, count);
+    return getGpuHandle(table.index);
+}
+
+void DescriptorAllocator::flush()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    flushLocked();
+}
+
+void DescriptorAllocator::setHeaps(
+    ID3D12GraphicsCommandList* commandList) const
+{
+    ID3D12DescriptorHeap* heaps[] = {mHeap};
+    commandList->SetDescriptorHeaps(1, heaps);
+}
+
+ID3D12DescriptorHeap* DescriptorAllocator::getShaderVisibleHeap() const
+{
+    return mHeap;
+}
+
+void DescriptorAllocator::finishFrame(UINT64 fenceValue)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    flushLocked();
+
+    mRing.finishFrame(fenceValue);
+    mCurrent.fenceValue = fenceValue;
+    mFrames.push_back(std::move(mCurrent));
+    mCurrent = Frame();
+
+    mTables.clear();
+    mTableSources.clear();
+
+    mStats.frames++;
+    mStats.frameDescriptorsCopied = mFrameCopies;
+    mFrameCopies = 0;
+}
+
+void DescriptorAllocator::retire(UINT64 completedFenceValue)
+{
+    mRing.retire(completedFenceValue);
+    while (!mFrames.empty() &&
+           mFrames.front().fenceValue <= completedFenceValue)
+    {
+        for (uint32_t block : mFrames.front().bindlessFrees)
+        {
+            mBindless.free(block);
+        }
+        mFrames.pop_front();
+    }
+}
+
+const DescriptorStats& DescriptorAllocator::getStats() const { return mStats; }
+
+void DescriptorAllocator::resetStats()
+{
+    // Live counts describe the allocator, not a measurement window
+    DescriptorStats stats;
+    stats.stagingDescriptors = mStats.stagingDescriptors;
+    stats.stagingHeaps = mStats.stagingHeaps;
+    stats.bindlessDescriptors = mStats.bindlessDescriptors;
+    mStats = stats;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE
+DescriptorAllocator::getCpuHandle(uint32_t index) const
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE handle = mCpuStart;
+    handle.ptr += (SIZE_T)index *
+                  mIncrementSizes[D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV];
+    return handle;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE
+DescriptorAllocator::getGpuHandle(uint32_t index) const
+{
+    D3D12_GPU_DESCRIPTOR_HANDLE handle = mGpuStart;
+    handle.ptr += (UINT64)index *
+                  mIncrementSizes[D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV];
+    return handle;
+}
+
+void DescriptorAllocator::stageCopies(
+    uint32_t index, const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors,
+    uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        mCopyDestinations.push_back(index + i);
+        mCopySources.push_back(descriptors[i]);
+    }
+}
+
+void DescriptorAllocator::flushLocked()
+{
+    if (!mCopyDestinations.empty())
+    {
+        // Destinations and sources are split into ranges independently,
+        // each run of adjacent descriptors is one range
+        const UINT increment =
+            mIncrementSizes[D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV];
+        std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> destStarts, srcStarts;
+        std::vector<UINT> destSizes, srcSizes;
+        for (size_t i = 0; i < mCopyDestinations.size(); ++i)
+        {
+            if (i > 0 && mCopyDestinations[i] == mCopyDestinations[i - 1] + 1)
+            {
+                destSizes.back()++;
+            }
+            else
+            {
+                destStarts.push_back(getCpuHandle(mCopyDestinations[i]));
+                destSizes.push_back(1);
+            }
+
+            if (i > 0 &&
+                mCopySources[i].ptr == mCopySources[i - 1].ptr + increment)
+            {
+                srcSizes.back()++;
+            }
+            else
+            {
+                srcStarts.push_back(mCopySources[i]);
+                srcSizes.push_back(1);
+            }
+        }
+
+        mDevice->CopyDescriptors(
+            (UINT)destStarts.size(), destStarts.data(), destSizes.data(),
+            (UINT)srcStarts.size(), srcStarts.data(), srcSizes.data(),
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+        mStats.copyCalls++;
+        mStats.descriptorsCopied += mCopyDestinations.size();
+        mFrameCopies += mCopyDestinations.size();
+        mCopyDestinations.clear();
+        mCopySources.clear();
+    }
+
+    // Staging descriptors freed since the last flush aren't read anymore
+    for (StagingPool& pool : mStagingPools)
+    {
+        mStats.stagingDescriptors -= pool.pendingFrees.size();
+        pool.freeList.insert(pool.freeList.end(), pool.pendingFrees.begin(),
+                             pool.pendingFrees.end());
+        pool.pendingFrees.clear();
+    }
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "RingAllocator.h"
+#include "TlsfAllocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Descriptor Allocator
+// Views are created in CPU only staging heaps, which grow a heap at a time
+// and recycle descriptors through a free list. Shaders see one large
+// CBV/SRV/UAV heap: its first part is handed out as persistent ranges for
+// bindless access, and the rest is a ring that tables are copied into when
+// they're bound, recycled once the GPU is done with the frame. Copies are
+// staged and issued together in one CopyDescriptors call per flush, with
+// adjacent descriptors merged into ranges, and a table bound again with the
+// same descriptors in the same frame reuses its first copy.
+
+struct DescriptorAllocatorDesc
+{
+    // Descriptors in the shader visible heap, the first bindlessDescriptors
+    // of them are persistent and the rest are the per-frame ring
+    uint32_t shaderVisibleDescriptors = 65536;
+    uint32_t bindlessDescriptors = 16384;
+
+    // Descriptors in each staging heap
+    uint32_t stagingHeapSize = 1024;
+};
+
+// A descriptor in a staging heap, views are created in it and copied into
+// the shader visible heap when bound. RTVs and DSVs are used from here.
+struct StagingDescriptor
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE cpu = {0};
+    uint32_t index = UINT32_MAX;
+};
+
+// Descriptors in the shader visible heap
+struct DescriptorRange
+{
+    D3D12_CPU_DESCRIPTOR_HANDLE cpu = {0};
+    D3D12_GPU_DESCRIPTOR_HANDLE gpu = {0};
+
+    // Where the range starts in the heap, what bindless shaders index with
+    uint32_t index = 0;
+    uint32_t count = 0;
+
+  protected:
+    friend class DescriptorAllocator;
+
+    uint32_t block = UINT32_MAX;
+};
+
+struct DescriptorStats
+{
+    uint64_t frames = 0;
+
+    // Tables bound, and those that reused a copy made earlier in the frame
+    uint64_t tables = 0;
+    uint64_t reusedTables = 0;
+
+    // Descriptors copied into the shader visible heap and the CopyDescriptors
+    // calls they were batched into, in total and in the last finished frame
+    uint64_t descriptorsCopied = 0;
+    uint64_t copyCalls = 0;
+    uint64_t frameDescriptorsCopied = 0;
+
+    // Most ring descriptors in flight at once
+    uint64_t peakRingDescriptors = 0;
+
+    // Live staging descriptors and the heaps holding them, and bindless
+    // descriptors handed out
+    uint64_t stagingDescriptors = 0;
+    uint64_t stagingHeaps = 0;
+    uint64_t bindlessDescriptors = 0;
+
+    void report(std::ostream& out) const;
+};
+
+class DescriptorAllocator
+{
+  public:
+    DescriptorAllocator(
+        ID3D12Device* device,
+        const DescriptorAllocatorDesc& desc = DescriptorAllocatorDesc());
+
+    // Assumes the GPU is idle
+    ~DescriptorAllocator();
+
+    StagingDescriptor allocateStaging(D3D12_DESCRIPTOR_HEAP_TYPE type);
+
+    // The descriptor is recycled at the next flush, after any copy of it
+    // that's still staged
+    void freeStaging(D3D12_DESCRIPTOR_HEAP_TYPE type,
+                     const StagingDescriptor& descriptor);
+
+    // Throws if the bindless part of the heap is full
+    DescriptorRange allocateBindless(uint32_t count);
+
+    // The range is recycled once the frame being recorded has finished on
+    // the GPU
+    void freeBindless(const DescriptorRange& range);
+
+    // Stage a copy of staging descriptors into a bindless range
+    void copyBindless(const DescriptorRange& range, uint32_t offset,
+                      const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors,
+                      uint32_t count);
+
+    // A table of the given staging CBV/SRV/UAV descriptors in the ring, valid
+    // once flushed. Safe to call from several threads recording at once.
+    // Throws if the ring is full, size it for every frame in flight.
+    D3D12_GPU_DESCRIPTOR_HANDLE
+    bindTable(const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors, uint32_t count);
+
+    // Issue every staged copy, before the command lists using them are
+    // executed
+    void flush();
+
+    // Set the shader visible heap on a command list, before any table is
+    // set on it
+    void setHeaps(ID3D12GraphicsCommandList* commandList) const;
+
+    ID3D12DescriptorHeap* getShaderVisibleHeap() const;
+
+    // Flush, and tag the ring descriptors and bindless frees of this frame
+    // with the fence value the GPU signals once it's done with them
+    void finishFrame(UINT64 fenceValue);
+
+    // Recycle everything the GPU has finished with
+    void retire(UINT64 completedFenceValue);
+
+    const DescriptorStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    // Staging heaps of one type, descriptor i is slot i % stagingHeapSize of
+    // heap i / stagingHeapSize
+    struct StagingPool
+    {
+        std::vector<ID3D12DescriptorHeap*> heaps;
+        std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> starts;
+        std::vector<uint32_t> freeList;
+        std::vector<uint32_t> pendingFrees;
+    };
+
+    // A table copied earlier in the frame, its sources start at
+    // mTableSources[firstSource]
+    struct Table
+    {
+        uint32_t firstSource;
+        uint32_t count;
+        uint32_t index;
+    };
+
+    struct Frame
+    {
+        UINT64 fenceValue;
+        std::vector<uint32_t> bindlessFrees;
+    };
+
+    D3D12_CPU_DESCRIPTOR_HANDLE getCpuHandle(uint32_t index) const;
+
+    D3D12_GPU_DESCRIPTOR_HANDLE getGpuHandle(uint32_t index) const;
+
+    // Queue copies of descriptors to the heap starting at index, with the
+    // mutex held
+    void stageCopies(uint32_t index,
+                     const D3D12_CPU_DESCRIPTOR_HANDLE* descriptors,
+                     uint32_t count);
+
+    void flushLocked();
+
+    ID3D12Device* mDevice;
+    DescriptorAllocatorDesc mDesc;
+    UINT mIncrementSizes[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+
+    StagingPool mStagingPools[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+
+    ID3D12DescriptorHeap* mHeap;
+    D3D12_CPU_DESCRIPTOR_HANDLE mCpuStart;
+    D3D12_GPU_DESCRIPTOR_HANDLE mGpuStart;
+    TlsfAllocator mBindless;
+    RingAllocator mRing;
+
+    // Guards the ring, the staged copies and the frame's tables
+    std::mutex mMutex;
+
+    // Staged copies, heap index and source of each descriptor
+    std::vector<uint32_t> mCopyDestinations;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mCopySources;
+
+    // Tables of this frame by the hash of their sources
+    std::unordered_multimap<uint64_t, Table> mTables;
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> mTableSources;
+
+    // Bindless frees waiting on the GPU oldest first, and those of this frame
+    std::deque<Frame> mFrames;
+    Frame mCurrent;
+
+    uint64_t mFrameCopies;
+    DescriptorStats mStats;
+};
@@ -0,0 +1,109 @@
+#include "DrawBatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+uint32_t getPipeline(uint64_t key) { return (uint32_t)(key >> 48); }
+
+uint32_t getMesh(uint64_t key) { return (uint32_t)(key >> 32) & 0xffff; }
+
+uint32_t getItem(uint64_t key) { return (uint32_t)key; }
+}
+
+void DrawBatcherStats::report(std::ostream& out) const
+{
+    out << "Draw batching: " << items << " items merged into " << draws
+        << " draws over " << frames << " frames\n";
+    out << "  ms: " << sortTime << " sorting, " << mergeTime << " merging\n";
+}
+
+void DrawBatcher::build(const std::vector<DrawItem>& items, bool merge,
+                        const std::vector<uint32_t>* visible,
+                        const std::vector<uint32_t>* meshes)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    const size_t count = visible != nullptr ? visible->size() : items.size();
+    mKeys.resize(count);
+    for (size_t k = 0; k < count; ++k)
+    {
+        const size_t i = visible != nullptr ? (*visible)[k] : k;
+        const DrawItem& item = items[i];
+        const uint32_t mesh = meshes != nullptr ? (*meshes)[i] : item.mesh;
+        if (item.pipeline > kMaxIndex || mesh > kMaxIndex)
+        {
+            throw std::runtime_error("draw item index out of range!");
+        }
+        mKeys[k] = ((uint64_t)item.pipeline << 48) | ((uint64_t)mesh << 32) |
+                   (uint64_t)i;
+    }
+
+    // Scenes tend to submit in a stable order, so this is often already done
+    if (merge && !std::is_sorted(mKeys.begin(), mKeys.end()))
+    {
+        std::sort(mKeys.begin(), mKeys.end());
+    }
+    const auto sorted = std::chrono::steady_clock::now();
+
+    mDraws.clear();
+    for (uint32_t instance = 0; instance < (uint32_t)mKeys.size(); ++instance)
+    {
+        const uint64_t key = mKeys[instance];
+        const uint32_t pipeline = getPipeline(key);
+        const uint32_t mesh = getMesh(key);
+        if (merge && !mDraws.empty() && mDraws.back().pipeline == pipeline &&
+            mDraws.back().mesh == mesh)
+        {
+            mDraws.back().instanceCount++;
+        }
+        else
+        {
+            mDraws.push_back({pipeline, mesh, instance, 1});
+        }
+    }
+
+    mStats.frames++;
+    mStats.items += count;
+    mStats.draws += mDraws.size();
+    mStats.sortTime += elapsedMilliseconds(start, sorted);
+    mStats.mergeTime +=
+        elapsedMilliseconds(sorted, std::chrono::steady_clock::now());
+}
+
+const std::vector<InstancedDraw>& DrawBatcher::getDraws() const
+{
+    return mDraws;
+}
+
+uint32_t DrawBatcher::getInstanceCount() const
+{
+    return (uint32_t)mKeys.size();
+}
+
+void DrawBatcher::writeInstances(const std::vector<DrawItem>& items,
+                                 glm::mat4* instances) const
+{
+    for (size_t i = 0; i < mKeys.size(); ++i)
+    {
+        instances[i] = items[::getItem(mKeys[i])].modelMatrix;
+    }
+}
+
+uint32_t DrawBatcher::getItem(uint32_t instance) const
+{
+    return ::getItem(mKeys[instance]);
+}
+
+const DrawBatcherStats& DrawBatcher::getStats() const { return mStats; }
+
+void DrawBatcher::resetStats() { mStats = DrawBatcherStats(); }
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "FramePacket.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Draw Batcher
+// Turns a frame's draw items into as few draws as possible. Items are sorted
+// by pipeline and then by mesh, and every run sharing both collapses into a
+// single instanced draw, with the instance data laid out in sorted order so
+// each draw's instances are contiguous. The cluster culler turns the draws
+// into index ranges to record.
+
+// Where a mesh lives in the shared vertex and index buffers, its bounds in
+// model space, the meshlets it's made of and its levels of detail
+struct MeshRange
+{
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+
+    // Meshes of its coarser levels, from finest to coarsest, and how far a
+    // level is from full detail in model space units
+    uint32_t firstLod;
+    uint32_t lodCount;
+    float error;
+};
+
+struct InstancedDraw
+{
+    uint32_t pipeline;
+    uint32_t mesh;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+};
+
+struct DrawBatcherStats
+{
+    uint64_t frames = 0;
+
+    // Draw items in, and draws out
+    uint64_t items = 0;
+    uint64_t draws = 0;
+
+    // Times spent sorting and merging, in milliseconds
+    double sortTime = 0.0;
+    double mergeTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+class DrawBatcher
+{
+  public:
+    // Pipeline and mesh indices both have to fit in 16 bits
+    static const uint32_t kMaxIndex = 0xffff;
+
+    // Sort and merge a frame's items, or only the visible ones when given a
+    // list of item indices. Without merging every item is a draw of its
+    // own, in the order it was submitted. Items are drawn with the mesh in
+    // meshes at their index when it's given, such as a level of detail.
+    void build(const std::vector<DrawItem>& items, bool merge = true,
+               const std::vector<uint32_t>* visible = nullptr,
+               const std::vector<uint32_t>* meshes = nullptr);
+
+    const std::vector<InstancedDraw>& getDraws() const;
+
+    // How many instances the draws cover, one per item drawn
+    uint32_t getInstanceCount() const;
+
+    // Copy every item's model matrix, in instance order
+    void writeInstances(const std::vector<DrawItem>& items,
+                        glm::mat4* instances) const;
+
+    // The item an instance was made from
+    uint32_t getItem(uint32_t instance) const;
+
+    const DrawBatcherStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    // Pipeline, mesh and item index packed so sorting by key keeps items in
+    // submission order within a draw
+    std::vector<uint64_t> mKeys;
+    std::vector<InstancedDraw> mDraws;
+
+    DrawBatcherStats mStats;
+};
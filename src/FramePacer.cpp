@@ -0,0 +1,262 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <thread>
+
+namespace
+{
+// Weight of the newest sample in the moving averages
+const double kSmoothing = 0.1;
+
+// Bounds the adaptive spin threshold is kept within
+const PacingDuration kMinSpinThreshold = std::chrono::microseconds(50);
+const PacingDuration kMaxSpinThreshold = std::chrono::milliseconds(20);
+
+double toMilliseconds(PacingDuration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+}
+
+// Clocks
+
+PacingDuration SteadyPacingClock::now()
+{
+    return std::chrono::duration_cast<PacingDuration>(
+        std::chrono::steady_clock::now().time_since_epoch());
+}
+
+void SteadyPacingClock::sleepFor(PacingDuration duration)
+{
+    std::this_thread::sleep_for(duration);
+}
+
+void SteadyPacingClock::spin() { std::this_thread::yield(); }
+
+SimulatedPacingClock::SimulatedPacingClock(PacingDuration oversleep,
+                                           PacingDuration oversleepJitter,
+                                           PacingDuration spinStep,
+                                           uint32_t seed)
+    : mNow(0), mOversleep(oversleep), mOversleepJitter(oversleepJitter),
+      mSpinStep(spinStep), mRandom(seed ? seed : 1)
+{
+}
+
+PacingDuration SimulatedPacingClock::now() { return mNow; }
+
+void SimulatedPacingClock::sleepFor(PacingDuration duration)
+{
+    // xorshift32, so runs with the same seed are reproducible
+    mRandom ^= mRandom << 13;
+    mRandom ^= mRandom >> 17;
+    mRandom ^= mRandom << 5;
+    const double jitter = (double)mRandom / (double)UINT32_MAX;
+
+    mNow += duration + mOversleep +
+            PacingDuration((int64_t)(jitter * mOversleepJitter.count()));
+}
+
+void SimulatedPacingClock::spin() { mNow += mSpinStep; }
+
+void SimulatedPacingClock::advance(PacingDuration duration)
+{
+    mNow += duration;
+}
+
+// Stats
+
+void FramePacerStats::report(std::ostream& out) const
+{
+    out << "Frame pacing: " << frames << " frames, " << missedDeadlines
+        << " missed deadlines\n";
+    out << "  interval ms: mean " << intervalMean << ", stddev "
+        << intervalStdDev << ", min " << intervalMin << ", max " << intervalMax
+        << ", max jitter " << maxJitter << "\n";
+    out << "  wake error ms: mean " << wakeErrorMean << ", max "
+        << wakeErrorMax << "\n";
+    out << "  waiting ms: " << sleepTime << " sleeping, " << spinTime
+        << " spinning\n";
+}
+
+// Frame Pacer
+
+FramePacer::FramePacer(const FramePacerDesc& desc, PacingClock* clock)
+    : mDesc(desc), mClock(clock != nullptr ? clock : &mSteadyClock),
+      mFirstFrame(true), mFrameStart(0), mLastFrameEnd(0), mDeadline(0),
+      mWorkMean(0.0), mWorkDeviation(0.0), mWakeErrorEstimate(0.0),
+      mOversleepMean(0.0), mOversleepSampled(false),
+      mSpinThreshold(desc.spinThreshold)
+{
+    setTargetFrameRate(desc.targetFrameRate);
+    resetStats();
+}
+
+void FramePacer::setTargetFrameRate(double framesPerSecond)
+{
+    mDesc.targetFrameRate = std::max(framesPerSecond, 0.0);
+    mPeriod = mDesc.targetFrameRate > 0.0
+                  ? PacingDuration((int64_t)(1e9 / mDesc.targetFrameRate))
+                  : PacingDuration(0);
+}
+
+PacingDuration FramePacer::beginFrame()
+{
+    PacingDuration now = mClock->now();
+
+    if (mFirstFrame)
+    {
+        mFirstFrame = false;
+        mFrameStart = now;
+        mLastFrameEnd = now;
+        mDeadline = now + mPeriod;
+        return PacingDuration(0);
+    }
+
+    if (mPeriod.count() > 0)
+    {
+        // Without adaptive latency a frame starts on the previous deadline,
+        // with it the frame starts just early enough to finish on time.
+        // Late wake ups observed so far are budgeted for as well. The
+        // prediction needs a few frames of history before it's trusted.
+        const bool predicted =
+            mDesc.adaptiveLatency && mStats.frames >= kWarmupFrames;
+        const PacingDuration wake =
+            predicted
+                ? mDeadline - getPredictedWork() - mDesc.latencyMargin -
+                      PacingDuration((int64_t)mWakeErrorEstimate)
+                : mDeadline - mPeriod;
+
+        if (wake > now)
+        {
+            waitUntil(wake);
+            now = mClock->now();
+
+            mWakeErrorEstimate = std::max(
+                (double)(now - wake).count(),
+                mWakeErrorEstimate * (1.0 - kSmoothing));
+
+            const double wakeError = toMilliseconds(now - wake);
+            mWakeErrorSum += wakeError;
+            mWakeCount++;
+            mStats.wakeErrorMean = mWakeErrorSum / (double)mWakeCount;
+            mStats.wakeErrorMax = std::max(mStats.wakeErrorMax, wakeError);
+        }
+    }
+
+    const PacingDuration delta = now - mFrameStart;
+    mFrameStart = now;
+    return delta;
+}
+
+void FramePacer::endFrame()
+{
+    const PacingDuration end = mClock->now();
+
+    // Track CPU work so adaptive latency knows how early to start
+    const double work = (double)(end - mFrameStart).count();
+    mWorkMean += kSmoothing * (work - mWorkMean);
+    mWorkDeviation += kSmoothing * (std::abs(work - mWorkMean) - mWorkDeviation);
+
+    // Interval statistics use Welford's algorithm, the first frame has no
+    // previous frame to measure against
+    const double interval = toMilliseconds(end - mLastFrameEnd);
+    const bool hasInterval = mStats.frames > 0;
+    mLastFrameEnd = end;
+    mStats.frames++;
+    if (hasInterval)
+    {
+        const uint64_t count = mStats.frames - 1;
+        if (count == 1)
+        {
+            mStats.intervalMin = interval;
+            mStats.intervalMax = interval;
+        }
+        mStats.intervalMin = std::min(mStats.intervalMin, interval);
+        mStats.intervalMax = std::max(mStats.intervalMax, interval);
+        const double delta = interval - mStats.intervalMean;
+        mStats.intervalMean += delta / (double)count;
+        mIntervalM2 += delta * (interval - mStats.intervalMean);
+        mStats.intervalStdDev =
+            count > 1 ? std::sqrt(mIntervalM2 / (double)(count - 1)) : 0.0;
+    }
+
+    if (mPeriod.count() > 0)
+    {
+        if (hasInterval)
+        {
+            mStats.maxJitter = std::max(
+                mStats.maxJitter, std::abs(interval - toMilliseconds(mPeriod)));
+        }
+
+        // A frame that overran its deadline resynchronizes the schedule
+        // rather than trying to catch up with a burst of short frames.
+        if (end > mDeadline)
+        {
+            mStats.missedDeadlines++;
+            mDeadline = end + mPeriod;
+        }
+        else
+        {
+            mDeadline += mPeriod;
+        }
+    }
+}
+
+const FramePacerStats& FramePacer::getStats() const { return mStats; }
+
+void FramePacer::resetStats()
+{
+    mStats = FramePacerStats();
+    mIntervalM2 = 0.0;
+    mWakeErrorSum = 0.0;
+    mWakeCount = 0;
+}
+
+PacingDuration FramePacer::getSpinThreshold() const { return mSpinThreshold; }
+
+PacingDuration FramePacer::getPredictedWork() const
+{
+    return PacingDuration((int64_t)std::max(mWorkMean + 2.0 * mWorkDeviation, 0.0));
+}
+
+void FramePacer::waitUntil(PacingDuration time)
+{
+    PacingDuration now = mClock->now();
+
+    // Sleep in chunks while the wake up time is further away than the OS
+    // can be trusted to oversleep by.
+    while (time - now > mSpinThreshold)
+    {
+        const PacingDuration request = time - now - mSpinThreshold;
+        mClock->sleepFor(request);
+        const PacingDuration after = mClock->now();
+
+        // Averaging up from zero would shrink the threshold below the
+        // actual oversleep for the first few frames, waking them late
+        const double oversleep =
+            std::max((double)(after - now - request).count(), 0.0);
+        mOversleepMean = mOversleepSampled
+                             ? mOversleepMean +
+                                   kSmoothing * (oversleep - mOversleepMean)
+                             : oversleep;
+        mOversleepSampled = true;
+        mSpinThreshold = std::min(
+            std::max(PacingDuration((int64_t)(2.0 * mOversleepMean)),
+                     kMinSpinThreshold),
+            kMaxSpinThreshold);
+
+        mStats.sleepTime += toMilliseconds(after - now);
+        now = after;
+    }
+
+    // Spin out the rest for accuracy.
+    const PacingDuration spinStart = now;
+    while (now < time)
+    {
+        mClock->spin();
+        now = mClock->now();
+    }
+    mStats.spinTime += toMilliseconds(now - spinStart);
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// Frame Pacer
+// Paces frames to a target rate by sleeping until shortly before the next
+// frame should start and spinning out the remainder, so the CPU idles
+// between frames instead of polling the clock. With adaptive latency the
+// start of each frame is pushed as late as the predicted CPU work allows,
+// which shortens the time between reading input and presenting.
+
+typedef std::chrono::nanoseconds PacingDuration;
+
+// Time source the pacer measures and waits with, replaceable so pacing can be
+// simulated deterministically
+class PacingClock
+{
+  public:
+    virtual ~PacingClock() {}
+
+    // Monotonic time since an arbitrary epoch
+    virtual PacingDuration now() = 0;
+
+    // Sleep for at least the given duration, the OS may oversleep
+    virtual void sleepFor(PacingDuration duration) = 0;
+
+    // Called every iteration of a spin wait
+    virtual void spin() = 0;
+};
+
+// The real clock, backed by std::chrono::steady_clock
+class SteadyPacingClock : public PacingClock
+{
+  public:
+    PacingDuration now() override;
+
+    void sleepFor(PacingDuration duration) override;
+
+    void spin() override;
+};
+
+// A deterministic clock where time only moves when the pacer waits or when
+// work is simulated with advance(). Sleeps overshoot by a fixed amount plus
+// seeded pseudo random jitter, like an OS scheduler would.
+class SimulatedPacingClock : public PacingClock
+{
+  public:
+    SimulatedPacingClock(PacingDuration oversleep = PacingDuration(0),
+                         PacingDuration oversleepJitter = PacingDuration(0),
+                         PacingDuration spinStep = std::chrono::microseconds(1),
+                         uint32_t seed = 1);
+
+    PacingDuration now() override;
+
+    void sleepFor(PacingDuration duration) override;
+
+    void spin() override;
+
+    // Simulate CPU work taking the given time
+    void advance(PacingDuration duration);
+
+  protected:
+    PacingDuration mNow;
+    PacingDuration mOversleep;
+    PacingDuration mOversleepJitter;
+    PacingDuration mSpinStep;
+    uint32_t mRandom;
+};
+
+struct FramePacerDesc
+{
+    // Frames per second to pace to, 0 runs uncapped
+    double targetFrameRate = 60.0;
+
+    // Start frames as late as the predicted CPU work allows instead of right
+    // after the previous deadline
+    bool adaptiveLatency = false;
+
+    // Time kept between the predicted end of a frame's work and its deadline
+    PacingDuration latencyMargin = std::chrono::microseconds(500);
+
+    // How close to a wake up time the pacer stops sleeping and starts
+    // spinning. It grows and shrinks with the oversleep the clock exhibits.
+    PacingDuration spinThreshold = std::chrono::milliseconds(2);
+};
+
+struct FramePacerStats
+{
+    uint64_t frames = 0;
+    uint64_t missedDeadlines = 0;
+
+    // Interval between consecutive frame ends, in milliseconds
+    double intervalMean = 0.0;
+    double intervalStdDev = 0.0;
+    double intervalMin = 0.0;
+    double intervalMax = 0.0;
+
+    // Largest distance of an interval from the target period, in milliseconds
+    double maxJitter = 0.0;
+
+    // How late the pacer woke up compared to when it intended to, in
+    // milliseconds
+    double wakeErrorMean = 0.0;
+    double wakeErrorMax = 0.0;
+
+    // Total time spent waiting, split by how it was spent, in milliseconds
+    double sleepTime = 0.0;
+    double spinTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+class FramePacer
+{
+  public:
+    // Frames of history adaptive latency needs before it trusts its
+    // prediction
+    static const uint64_t kWarmupFrames = 16;
+
+    FramePacer(const FramePacerDesc& desc = FramePacerDesc(),
+               PacingClock* clock = nullptr);
+
+    // Change the target rate, 0 runs uncapped
+    void setTargetFrameRate(double framesPerSecond);
+
+    // Wait until the next frame should start, returns the time since the
+    // previous frame started
+    PacingDuration beginFrame();
+
+    // Mark the frame as submitted
+    void endFrame();
+
+    const FramePacerStats& getStats() const;
+
+    void resetStats();
+
+    // The current spin threshold, adapted to the clock's oversleep
+    PacingDuration getSpinThreshold() const;
+
+    // The CPU frame time adaptive latency is planning for
+    PacingDuration getPredictedWork() const;
+
+  protected:
+    // Sleep then spin until the given time
+    void waitUntil(PacingDuration time);
+
+    FramePacerDesc mDesc;
+    SteadyPacingClock mSteadyClock;
+    PacingClock* mClock;
+
+    PacingDuration mPeriod;
+    bool mFirstFrame;
+    PacingDuration mFrameStart;
+    PacingDuration mLastFrameEnd;
+
+    // When the frame being recorded should be submitted
+    PacingDuration mDeadline;
+
+    // Exponential moving averages of CPU work and its deviation
+    double mWorkMean;
+    double mWorkDeviation;
+
+    // Decaying peak of how late wake ups have been
+    double mWakeErrorEstimate;
+
+    // Exponential moving average of how much sleeps overshoot, seeded with
+    // the first sleep
+    double mOversleepMean;
+    bool mOversleepSampled;
+    PacingDuration mSpinThreshold;
+
+    FramePacerStats mStats;
+    double mIntervalM2;
+    double mWakeErrorSum;
+    uint64_t mWakeCount;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#define GLM_FORCE_SSE42 1
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES 1
+#define GLM_FORCE_LEFT_HANDED
+#include "glm/glm.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Frame Packet
+// Everything the render thread needs to draw a frame, filled in by the main
+// thread. A submitted packet isn't touched by the main thread again until
+// the render thread hands it back, so it needs no locking. Packets are
+// pooled and their draw lists keep their capacity, so steady state frames
+// don't allocate.
+
+struct DrawItem
+{
+    glm::mat4 modelMatrix;
+
+    // Indices into the renderer's mesh and pipeline tables, items sharing
+    // both are drawn instanced
+    uint32_t mesh = 0;
+    uint32_t pipeline = 0;
+};
+
+struct FramePacket
+{
+    uint64_t frameNumber = 0;
+
+    // Camera
+    glm::mat4 projectionMatrix;
+    glm::mat4 viewMatrix;
+
+    std::vector<DrawItem> draws;
+
+    // Set if the window was resized since the last packet
+    bool resize = false;
+    unsigned width = 0;
+    unsigned height = 0;
+
+    // When the main thread handed it over, for measuring handoff latency
+    std::chrono::steady_clock::time_point submitTime;
+};
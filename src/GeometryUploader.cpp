@@ -0,0 +1,264 @@
+#include "GeometryUploader.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+// Buffer copies have no alignment requirement, this just keeps chunks of
+// staging memory from sharing cache lines
+const UINT64 kCopyAlignment = 16;
+}
+
+void GeometryUploadStats::report(std::ostream& out) const
+{
+    out << "Geometry uploads: " << uploads << " uploads, " << copies
+        << " copies, " << bytesUploaded << " bytes\n";
+    out << "  batches: " << batches << " submitted, " << completedBatches
+        << " completed, " << stagingStalls << " staging stalls\n";
+    out << "  latency ms: mean " << latencyMean << ", max " << latencyMax
+        << "\n";
+}
+
+GeometryUploader::GeometryUploader(ID3D12Device* device,
+                                   GpuAllocator* gpuAllocator,
+                                   UINT64 stagingSize)
+    : mDevice(device), mGpuAllocator(gpuAllocator), mQueue(nullptr),
+      mCommandList(nullptr), mFence(nullptr), mFenceEvent(nullptr),
+      mFenceValue(0), mStaging(gpuAllocator, stagingSize),
+      mMaxCopySize(std::max<UINT64>(stagingSize / 4, kCopyAlignment)),
+      mAllocator(nullptr), mRecording(false), mQueuedCopies(0),
+      mLatencySum(0.0)
+{
+    // Copies get their own queue so they can overlap rendering
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    ThrowIfFailed(
+        mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mQueue)));
+    mQueue->SetName(L"Geometry Upload Queue");
+
+    ThrowIfFailed(mDevice->CreateFence(mFenceValue, D3D12_FENCE_FLAG_NONE,
+                                       IID_PPV_ARGS(&mFence)));
+    mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (mFenceEvent == nullptr)
+    {
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+
+    // Command lists are created open, so close it until the first upload
+    ID3D12CommandAllocator* allocator = nullptr;
+    ThrowIfFailed(mDevice->CreateCommandAllocator(
+        D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)));
+    ThrowIfFailed(mDevice->CreateCommandList(
+        0, D3D12_COMMAND_LIST_TYPE_COPY, allocator, nullptr,
+        IID_PPV_ARGS(&mCommandList)));
+    mCommandList->SetName(L"Geometry Upload Command List");
+    ThrowIfFailed(mCommandList->Close());
+    mFreeAllocators.push_back(allocator);
+}
+
+GeometryUploader::~GeometryUploader()
+{
+    // Staging memory has to outlive every copy reading from it
+    waitForBatch(mFenceValue);
+
+    if (mRecording)
+    {
+        mCommandList->Close();
+        mFreeAllocators.push_back(mAllocator);
+        mAllocator = nullptr;
+    }
+
+    for (ID3D12CommandAllocator* allocator : mFreeAllocators)
+    {
+        allocator->Release();
+    }
+    mFreeAllocators.clear();
+
+    if (mCommandList)
+    {
+        mCommandList->Release();
+        mCommandList = nullptr;
+    }
+
+    if (mFence)
+    {
+        mFence->Release();
+        mFence = nullptr;
+    }
+
+    if (mFenceEvent)
+    {
+        CloseHandle(mFenceEvent);
+        mFenceEvent = nullptr;
+    }
+
+    if (mQueue)
+    {
+        mQueue->Release();
+        mQueue = nullptr;
+    }
+}
+
+GpuAllocation* GeometryUploader::createBuffer(const void* data, UINT64 size,
+                                              LPCWSTR name)
+{
+    GpuAllocation* buffer = mGpuAllocator->createBuffer(
+        D3D12_HEAP_TYPE_DEFAULT, size, D3D12_RESOURCE_STATE_COMMON, name);
+    upload(buffer->resource, 0, data, size);
+    return buffer;
+}
+
+void GeometryUploader::upload(ID3D12Resource* buffer, UINT64 offset,
+                              const void* data, UINT64 size)
+{
+    mStats.uploads++;
+
+    const UINT8* source = static_cast<const UINT8*>(data);
+    while (size > 0)
+    {
+        const UINT64 chunk = std::min(size, mMaxCopySize);
+
+        UploadAllocation staging;
+        while (!mStaging.tryAllocate(chunk, kCopyAlignment, staging))
+        {
+            // The ring is full of copies the GPU hasn't executed yet, submit
+            // ours if nothing else is in flight and wait for the oldest batch
+            mStats.stagingStalls++;
+            if (mBatches.empty())
+            {
+                if (mQueuedCopies == 0)
+                {
+                    throw std::runtime_error("staging ring is too small!");
+                }
+                flush();
+            }
+            waitForBatch(mBatches.front().fenceValue);
+        }
+        memcpy(staging.cpuAddress, source, (size_t)chunk);
+
+        beginBatch();
+        mCommandList->CopyBufferRegion(buffer, offset, mStaging.getResource(),
+                                       staging.offset, chunk);
+        mQueuedCopies++;
+
+        mStats.copies++;
+        mStats.bytesUploaded += chunk;
+
+        source += chunk;
+        offset += chunk;
+        size -= chunk;
+    }
+}
+
+UINT64 GeometryUploader::flush()
+{
+    if (mQueuedCopies == 0)
+    {
+        return mFenceValue;
+    }
+
+    ThrowIfFailed(mCommandList->Close());
+    ID3D12CommandList* ppCommandLists[] = {mCommandList};
+    mQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+
+    Batch batch;
+    batch.allocator = mAllocator;
+    batch.fenceValue = ++mFenceValue;
+    batch.submitTime = std::chrono::steady_clock::now();
+    ThrowIfFailed(mQueue->Signal(mFence, batch.fenceValue));
+    mStaging.finishFrame(batch.fenceValue);
+    mBatches.push_back(batch);
+
+    mAllocator = nullptr;
+    mRecording = false;
+    mQueuedCopies = 0;
+    mStats.batches++;
+    return batch.fenceValue;
+}
+
+void GeometryUploader::waitOnQueue(ID3D12CommandQueue* queue,
+                                   UINT64 fenceValue)
+{
+    if (fenceValue > 0)
+    {
+        ThrowIfFailed(queue->Wait(mFence, fenceValue));
+    }
+}
+
+void GeometryUploader::waitForBatch(UINT64 fenceValue)
+{
+    if (mFence->GetCompletedValue() < fenceValue)
+    {
+        ThrowIfFailed(mFence->SetEventOnCompletion(fenceValue, mFenceEvent));
+        WaitForSingleObject(mFenceEvent, INFINITE);
+    }
+    retire();
+}
+
+bool GeometryUploader::isComplete(UINT64 fenceValue)
+{
+    return mFence->GetCompletedValue() >= fenceValue;
+}
+
+void GeometryUploader::retire()
+{
+    const UINT64 completed = mFence->GetCompletedValue();
+    const auto now = std::chrono::steady_clock::now();
+
+    while (!mBatches.empty() && mBatches.front().fenceValue <= completed)
+    {
+        Batch& batch = mBatches.front();
+
+        // Latency is only as precise as how often retire() is called
+        const double latency = std::chrono::duration<double, std::milli>(
+                                   now - batch.submitTime)
+                                   .count();
+        mStats.completedBatches++;
+        mLatencySum += latency;
+        mStats.latencyMean = mLatencySum / (double)mStats.completedBatches;
+        mStats.latencyMax = std::max(mStats.latencyMax, latency);
+
+        mFreeAllocators.push_back(batch.allocator);
+        mBatches.pop_front();
+    }
+    mStaging.retire(completed);
+}
+
+ID3D12CommandQueue* GeometryUploader::getQueue() const { return mQueue; }
+
+const GeometryUploadStats& GeometryUploader::getStats() const
+{
+    return mStats;
+}
+
+void GeometryUploader::resetStats()
+{
+    mStats = GeometryUploadStats();
+    mLatencySum = 0.0;
+}
+
+void GeometryUploader::beginBatch()
+{
+    if (mRecording)
+    {
+        return;
+    }
+
+    if (mFreeAllocators.empty())
+    {
+        ID3D12CommandAllocator* allocator = nullptr;
+        ThrowIfFailed(mDevice->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&allocator)));
+        mFreeAllocators.push_back(allocator);
+    }
+    mAllocator = mFreeAllocators.back();
+    mFreeAllocators.pop_back();
+
+    // Only allocators of completed batches are ever free
+    ThrowIfFailed(mAllocator->Reset());
+    ThrowIfFailed(mCommandList->Reset(mAllocator, nullptr));
+    mRecording = true;
+}
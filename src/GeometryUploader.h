@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "GpuAllocator.h"
+#include "UploadRing.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <vector>
+
+// Geometry Uploader
+// Moves static geometry into default heap buffers, which live in video memory
+// instead of being read over the bus on every access. Data is written to a
+// staging ring, and the copies out of it are recorded into batches that are
+// submitted together on a dedicated copy queue. Staging memory and command
+// allocators are recycled once the copy fence passes their batch.
+
+struct GeometryUploadStats
+{
+    // Calls to upload() and createBuffer()
+    uint64_t uploads = 0;
+
+    // CopyBufferRegion commands recorded, large uploads are split up
+    uint64_t copies = 0;
+
+    uint64_t bytesUploaded = 0;
+
+    // Batches submitted to the copy queue, and how many have completed
+    uint64_t batches = 0;
+    uint64_t completedBatches = 0;
+
+    // Times an upload had to wait for the GPU to free staging memory
+    uint64_t stagingStalls = 0;
+
+    // Time from submitting a batch to seeing it complete, in milliseconds
+    double latencyMean = 0.0;
+    double latencyMax = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+class GeometryUploader
+{
+  public:
+    GeometryUploader(ID3D12Device* device, GpuAllocator* gpuAllocator,
+                     UINT64 stagingSize = 8 * 1024 * 1024);
+
+    ~GeometryUploader();
+
+    // Create a default heap buffer and queue a copy of the data into it. The
+    // buffer is created in the common state, the copy queue promotes it to a
+    // copy destination and it decays back once the copy completes, so any
+    // queue can read it as vertices or indices without a barrier.
+    GpuAllocation* createBuffer(const void* data, UINT64 size,
+                                LPCWSTR name = nullptr);
+
+    // Queue a copy into an existing buffer. Copies execute in the order they
+    // were queued, so later uploads to the same range win.
+    void upload(ID3D12Resource* buffer, UINT64 offset, const void* data,
+                UINT64 size);
+
+    // Submit every queued copy as one batch, returns the fence value that
+    // signals its completion, or the last one if nothing was queued
+    UINT64 flush();
+
+    // Make a queue wait for a batch on the GPU without blocking the CPU
+    void waitOnQueue(ID3D12CommandQueue* queue, UINT64 fenceValue);
+
+    // Block the CPU until a batch completes
+    void waitForBatch(UINT64 fenceValue);
+
+    bool isComplete(UINT64 fenceValue);
+
+    // Recycle staging memory and allocators of every completed batch
+    void retire();
+
+    ID3D12CommandQueue* getQueue() const;
+
+    const GeometryUploadStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    struct Batch
+    {
+        ID3D12CommandAllocator* allocator;
+        UINT64 fenceValue;
+        std::chrono::steady_clock::time_point submitTime;
+    };
+
+    // Reset the command list against a free allocator if it isn't recording
+    void beginBatch();
+
+    ID3D12Device* mDevice;
+    GpuAllocator* mGpuAllocator;
+    ID3D12CommandQueue* mQueue;
+    ID3D12GraphicsCommandList* mCommandList;
+    ID3D12Fence* mFence;
+    HANDLE mFenceEvent;
+    UINT64 mFenceValue;
+
+    UploadRing mStaging;
+
+    // Largest single copy, so one upload can't fill the whole ring
+    UINT64 mMaxCopySize;
+
+    ID3D12CommandAllocator* mAllocator;
+    bool mRecording;
+    UINT64 mQueuedCopies;
+
+    // Submitted batches oldest first, and allocators ready for reuse
+    std::deque<Batch> mBatches;
+    std::vector<ID3D12CommandAllocator*> mFreeAllocators;
+
+    GeometryUploadStats mStats;
+    double mLatencySum;
+};
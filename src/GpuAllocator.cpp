@@ -0,0 +1,464 @@
+#include "GpuAllocator.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+GpuResourceClass classify(const D3D12_RESOURCE_DESC& desc)
+{
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        return GpuResourceClass::Buffer;
+    }
+    if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
+                      D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+    {
+        return GpuResourceClass::RenderTarget;
+    }
+    return GpuResourceClass::Texture;
+}
+
+D3D12_HEAP_FLAGS heapFlags(GpuResourceClass resourceClass)
+{
+    switch (resourceClass)
+    {
+    case GpuResourceClass::Buffer:
+        return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+    case GpuResourceClass::RenderTarget:
+        return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+    default:
+        return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+    }
+}
+
+UINT64 alignUp(UINT64 value, UINT64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+}
+
+void GpuAllocatorStats::report(std::ostream& out) const
+{
+    out << "GPU allocator: " << allocationCount << " allocations, "
+        << allocatedBytes << " of " << heapBytes << " bytes in " << heapCount
+        << " heaps (" << heapsCreated << " created)\n";
+    out << "  free blocks: " << freeBlockCount << ", largest "
+        << largestFreeBlock << " bytes, fragmentation " << fragmentation
+        << "\n";
+    out << "  budget: " << (budget > 0 ? std::to_string(budget) : "none")
+        << (overBudget ? ", over budget" : "") << ", defrag: " << defragMoves
+        << " moves, " << defragBytes << " bytes\n";
+}
+
+GpuAllocator::GpuAllocator(ID3D12Device* device, const GpuAllocatorDesc& desc)
+    : mDevice(device), mDesc(desc), mHeapsCreated(0), mDefragMoves(0),
+      mDefragBytes(0)
+{
+    mCurrent.fenceValue = 0;
+}
+
+GpuAllocator::~GpuAllocator()
+{
+    for (const Frame& frame : mFrames)
+    {
+        for (const PendingRelease& release : frame.releases)
+        {
+            free(release);
+        }
+    }
+    for (const PendingRelease& release : mCurrent.releases)
+    {
+        free(release);
+    }
+
+    for (Pool& pool : mPools)
+    {
+        for (auto& heap : pool.heaps)
+        {
+            heap->heap->Release();
+        }
+    }
+}
+
+GpuAllocation* GpuAllocator::createBuffer(D3D12_HEAP_TYPE heapType,
+                                          UINT64 size,
+                                          D3D12_RESOURCE_STATES initialState,
+                                          LPCWSTR name)
+{
+    D3D12_RESOURCE_DESC bufferResourceDesc;
+    bufferResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferResourceDesc.Alignment = 0;
+    bufferResourceDesc.Width = size;
+    bufferResourceDesc.Height = 1;
+    bufferResourceDesc.DepthOrArraySize = 1;
+    bufferResourceDesc.MipLevels = 1;
+    bufferResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
+    bufferResourceDesc.SampleDesc.Count = 1;
+    bufferResourceDesc.SampleDesc.Quality = 0;
+    bufferResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    return createResource(heapType, bufferResourceDesc, initialState, nullptr,
+                          name);
+}
+
+GpuAllocation* GpuAllocator::createResource(
+    D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC& desc,
+    D3D12_RESOURCE_STATES initialState,
+    const D3D12_CLEAR_VALUE* pOptimizedClearValue, LPCWSTR name)
+{
+    const GpuResourceClass resourceClass = classify(desc);
+
+    // Small textures can be placed at 4KB instead of 64KB if the driver
+    // agrees, it says so by returning the alignment that was asked for
+    D3D12_RESOURCE_DESC placedDesc = desc;
+    D3D12_RESOURCE_ALLOCATION_INFO info;
+    if (resourceClass == GpuResourceClass::Texture && desc.SampleDesc.Count <= 1)
+    {
+        placedDesc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+        info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+        if (info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT)
+        {
+            placedDesc.Alignment = 0;
+            info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+        }
+    }
+    else
+    {
+        info = mDevice->GetResourceAllocationInfo(0, 1, &placedDesc);
+    }
+    if (info.SizeInBytes == UINT64_MAX)
+    {
+        throw std::runtime_error("invalid resource description!");
+    }
+
+    // First fit across the pool's heaps, then a new heap
+    Pool& pool = getPool(heapType, resourceClass);
+    GpuHeap* heap = nullptr;
+    TlsfAllocation block;
+    for (auto& candidate : pool.heaps)
+    {
+        if (candidate->allocator.allocate(info.SizeInBytes, info.Alignment,
+                                          block))
+        {
+            heap = candidate.get();
+            break;
+        }
+    }
+    if (heap == nullptr)
+    {
+        heap = createHeap(pool, info.SizeInBytes, info.Alignment);
+        if (!heap->allocator.allocate(info.SizeInBytes, info.Alignment, block))
+        {
+            throw std::runtime_error("failed to allocate from a new heap!");
+        }
+    }
+
+    GpuAllocation* allocation = new GpuAllocation();
+    allocation->desc = placedDesc;
+    allocation->size = block.size;
+    allocation->heap = heap;
+    allocation->block = block.block;
+    allocation->state = initialState;
+    heap->allocator.setUserData(block.block, allocation);
+
+    HRESULT result = mDevice->CreatePlacedResource(
+        heap->heap, block.offset, &placedDesc, initialState,
+        pOptimizedClearValue, IID_PPV_ARGS(&allocation->resource));
+    if (FAILED(result))
+    {
+        heap->allocator.free(block.block);
+        delete allocation;
+        ThrowIfFailed(result);
+    }
+    if (name != nullptr)
+    {
+        allocation->resource->SetName(name);
+    }
+    return allocation;
+}
+
+void GpuAllocator::release(GpuAllocation* allocation)
+{
+    if (allocation == nullptr)
+    {
+        return;
+    }
+
+    PendingRelease release;
+    release.heap = allocation->heap;
+    release.block = allocation->block;
+    release.resource = allocation->resource;
+    mCurrent.releases.push_back(release);
+
+    // Defragmentation only looks at live allocations
+    allocation->heap->allocator.setUserData(allocation->block, nullptr);
+    delete allocation;
+}
+
+void GpuAllocator::finishFrame(UINT64 fenceValue)
+{
+    mCurrent.fenceValue = fenceValue;
+    mFrames.push_back(std::move(mCurrent));
+    mCurrent = Frame();
+    mCurrent.fenceValue = 0;
+}
+
+void GpuAllocator::retire(UINT64 completedFenceValue)
+{
+    bool freed = false;
+    while (!mFrames.empty() && mFrames.front().fenceValue <= completedFenceValue)
+    {
+        for (const PendingRelease& release : mFrames.front().releases)
+        {
+            free(release);
+            freed = true;
+        }
+        mFrames.pop_front();
+    }
+    if (!freed)
+    {
+        return;
+    }
+
+    // Give empty heaps back to the OS, but keep one regular sized heap per
+    // pool around so a pool doesn't churn heaps as resources come and go
+    for (Pool& pool : mPools)
+    {
+        bool keptOne = false;
+        for (auto it = pool.heaps.begin(); it != pool.heaps.end();)
+        {
+            GpuHeap& heap = **it;
+            const bool regular =
+                heap.allocator.getCapacity() <= mDesc.heapSize;
+            if (!heap.allocator.isEmpty() || (regular && !keptOne))
+            {
+                keptOne = keptOne || regular;
+                ++it;
+                continue;
+            }
+            heap.heap->Release();
+            it = pool.heaps.erase(it);
+        }
+    }
+}
+
+UINT GpuAllocator::defragment(ID3D12GraphicsCommandList* commandList,
+                              UINT64 maxBytes)
+{
+    UINT moveCount = 0;
+    std::vector<TlsfMove> moves;
+    for (Pool& pool : mPools)
+    {
+        // Upload heap buffers can't be copied into, and only buffers can be
+        // copied without knowing their layout
+        if (pool.heapType != D3D12_HEAP_TYPE_DEFAULT ||
+            pool.resourceClass != GpuResourceClass::Buffer)
+        {
+            continue;
+        }
+
+        for (auto& heap : pool.heaps)
+        {
+            moves.clear();
+            heap->allocator.planDefragment(
+                maxBytes,
+                [](void* userData) {
+                    return userData != nullptr &&
+                           static_cast<GpuAllocation*>(userData)->movable;
+                },
+                moves);
+
+            // Every copy is recorded between one batch of barriers into the
+            // copy states and one back out of them
+            std::vector<TlsfMove> moved;
+            std::vector<ID3D12Resource*> copies;
+            std::vector<D3D12_RESOURCE_BARRIER> before;
+            std::vector<D3D12_RESOURCE_BARRIER> after;
+            for (const TlsfMove& move : moves)
+            {
+                GpuAllocation* allocation =
+                    static_cast<GpuAllocation*>(move.userData);
+
+                ID3D12Resource* resource = nullptr;
+                HRESULT result = mDevice->CreatePlacedResource(
+                    heap->heap, move.to.offset, &allocation->desc,
+                    D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+                    IID_PPV_ARGS(&resource));
+                if (FAILED(result))
+                {
+                    heap->allocator.free(move.to.block);
+                    continue;
+                }
+
+                // The destination's memory may have held another buffer
+                D3D12_RESOURCE_BARRIER barrier = {};
+                barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+                barrier.Aliasing.pResourceAfter = resource;
+                before.push_back(barrier);
+
+                barrier = {};
+                barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                barrier.Transition.Subresource =
+                    D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+                if ((allocation->state & D3D12_RESOURCE_STATE_COPY_SOURCE) ==
+                    0)
+                {
+                    barrier.Transition.pResource = allocation->resource;
+                    barrier.Transition.StateBefore = allocation->state;
+                    barrier.Transition.StateAfter =
+                        D3D12_RESOURCE_STATE_COPY_SOURCE;
+                    before.push_back(barrier);
+                }
+                if (allocation->state != D3D12_RESOURCE_STATE_COPY_DEST)
+                {
+                    barrier.Transition.pResource = resource;
+                    barrier.Transition.StateBefore =
+                        D3D12_RESOURCE_STATE_COPY_DEST;
+                    barrier.Transition.StateAfter = allocation->state;
+                    after.push_back(barrier);
+                }
+
+                // The old copy is read by this command list, and stays
+                // allocated until the GPU has finished the frame
+                PendingRelease release;
+                release.heap = heap.get();
+                release.block = move.from.block;
+                release.resource = allocation->resource;
+                mCurrent.releases.push_back(release);
+                heap->allocator.setUserData(move.from.block, nullptr);
+
+                moved.push_back(move);
+                copies.push_back(resource);
+                mDefragBytes += move.to.size;
+                maxBytes -= std::min(maxBytes, move.to.size);
+            }
+            if (moved.empty())
+            {
+                continue;
+            }
+
+            commandList->ResourceBarrier((UINT)before.size(), before.data());
+            for (size_t i = 0; i < moved.size(); ++i)
+            {
+                const GpuAllocation* allocation =
+                    static_cast<GpuAllocation*>(moved[i].userData);
+                commandList->CopyBufferRegion(copies[i], 0,
+                                              allocation->resource, 0,
+                                              allocation->desc.Width);
+            }
+            if (!after.empty())
+            {
+                commandList->ResourceBarrier((UINT)after.size(),
+                                             after.data());
+            }
+
+            // Owners recreate their views of the new resources
+            for (size_t i = 0; i < moved.size(); ++i)
+            {
+                GpuAllocation* allocation =
+                    static_cast<GpuAllocation*>(moved[i].userData);
+                allocation->resource = copies[i];
+                allocation->block = moved[i].to.block;
+                if (allocation->onMoved)
+                {
+                    allocation->onMoved(*allocation);
+                }
+            }
+            moveCount += (UINT)moved.size();
+            mDefragMoves += moved.size();
+        }
+    }
+    return moveCount;
+}
+
+GpuAllocatorStats GpuAllocator::getStats() const
+{
+    GpuAllocatorStats stats;
+    uint64_t freeBytes = 0;
+    uint64_t largestFreeBytes = 0;
+    for (const Pool& pool : mPools)
+    {
+        for (const auto& heap : pool.heaps)
+        {
+            const TlsfStats heapStats = heap->allocator.getStats();
+            stats.heapCount++;
+            stats.heapBytes += heapStats.capacity;
+            stats.allocationCount += heapStats.allocationCount;
+            stats.allocatedBytes += heapStats.allocatedBytes;
+            stats.freeBlockCount += heapStats.freeBlockCount;
+            stats.largestFreeBlock =
+                std::max(stats.largestFreeBlock, heapStats.largestFreeBlock);
+            freeBytes += heapStats.freeBytes;
+            largestFreeBytes += heapStats.largestFreeBlock;
+        }
+    }
+
+    // Free space split between heaps isn't fragmentation, only free space
+    // split up within a heap is
+    stats.fragmentation =
+        freeBytes > 0 ? 1.0 - (double)largestFreeBytes / (double)freeBytes
+                      : 0.0;
+    stats.budget = mDesc.budget;
+    stats.overBudget = mDesc.budget > 0 && stats.heapBytes > mDesc.budget;
+    stats.heapsCreated = mHeapsCreated;
+    stats.defragMoves = mDefragMoves;
+    stats.defragBytes = mDefragBytes;
+    return stats;
+}
+
+GpuAllocator::Pool& GpuAllocator::getPool(D3D12_HEAP_TYPE heapType,
+                                          GpuResourceClass resourceClass)
+{
+    for (Pool& pool : mPools)
+    {
+        if (pool.heapType == heapType && pool.resourceClass == resourceClass)
+        {
+            return pool;
+        }
+    }
+    mPools.emplace_back();
+    Pool& pool = mPools.back();
+    pool.heapType = heapType;
+    pool.resourceClass = resourceClass;
+    return pool;
+}
+
+GpuHeap* GpuAllocator::createHeap(Pool& pool, UINT64 minSize,
+                                  UINT64 alignment)
+{
+    // Render targets may be multisampled, which needs 4MB placement
+    const UINT64 heapAlignment =
+        pool.resourceClass == GpuResourceClass::RenderTarget
+            ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+            : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+    D3D12_HEAP_DESC heapDesc = {};
+    heapDesc.SizeInBytes = alignUp(std::max(mDesc.heapSize, minSize),
+                                   std::max(heapAlignment, alignment));
+    heapDesc.Properties.Type = pool.heapType;
+    heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    heapDesc.Properties.CreationNodeMask = 1;
+    heapDesc.Properties.VisibleNodeMask = 1;
+    heapDesc.Alignment = heapAlignment;
+    heapDesc.Flags = heapFlags(pool.resourceClass);
+
+    std::unique_ptr<GpuHeap> heap(new GpuHeap());
+    ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap->heap)));
+    heap->heap->SetName(L"GPU Allocator Heap");
+    heap->allocator.reset(heapDesc.SizeInBytes);
+
+    mHeapsCreated++;
+    pool.heaps.push_back(std::move(heap));
+    return pool.heaps.back().get();
+}
+
+void GpuAllocator::free(const PendingRelease& release)
+{
+    release.resource->Release();
+    release.heap->allocator.free(release.block);
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "TlsfAllocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+// GPU Allocator
+// Places resources in large heaps instead of giving each one a committed
+// allocation of its own. Heaps are pooled by heap type and by resource class,
+// since most hardware can't mix buffers, textures and render targets in one
+// heap, and each heap's space is managed by a TLSF allocator. Releases are
+// deferred until the GPU has finished the frame they were made in, and a
+// defragmentation pass can compact buffers their owners allow to move into
+// lower free space.
+
+enum class GpuResourceClass : unsigned
+{
+    Buffer,
+    Texture,
+    RenderTarget,
+    Count
+};
+
+struct GpuAllocatorDesc
+{
+    // Size of every heap, larger resources get a heap of their own
+    UINT64 heapSize = 64 * 1024 * 1024;
+
+    // Heap bytes the allocator should stay under, 0 for no limit. It never
+    // refuses to allocate, going over is only reported.
+    UINT64 budget = 0;
+};
+
+// One heap and the allocator managing its space
+struct GpuHeap
+{
+    ID3D12Heap* heap = nullptr;
+    TlsfAllocator allocator;
+};
+
+struct GpuAllocation
+{
+    ID3D12Resource* resource = nullptr;
+    D3D12_RESOURCE_DESC desc;
+
+    // Bytes of heap the resource takes, including its placement alignment
+    UINT64 size = 0;
+
+    // Owners opt in to defragmentation, which replaces the resource with a
+    // copy placed elsewhere in its heap. It has to be left in the given state
+    // between frames, and onMoved is called once it's been replaced so views
+    // of it can be recreated.
+    bool movable = false;
+    D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+    std::function<void(GpuAllocation& allocation)> onMoved;
+
+  protected:
+    friend class GpuAllocator;
+
+    GpuHeap* heap = nullptr;
+    uint32_t block = UINT32_MAX;
+};
+
+struct GpuAllocatorStats
+{
+    uint64_t heapCount = 0;
+    uint64_t heapBytes = 0;
+    uint64_t allocationCount = 0;
+    uint64_t allocatedBytes = 0;
+
+    // Across every heap
+    uint64_t freeBlockCount = 0;
+    uint64_t largestFreeBlock = 0;
+    double fragmentation = 0.0;
+
+    uint64_t budget = 0;
+    bool overBudget = false;
+
+    // Totals since the allocator was created
+    uint64_t heapsCreated = 0;
+    uint64_t defragMoves = 0;
+    uint64_t defragBytes = 0;
+
+    void report(std::ostream& out) const;
+};
+
+class GpuAllocator
+{
+  public:
+    GpuAllocator(ID3D12Device* device,
+                 const GpuAllocatorDesc& desc = GpuAllocatorDesc());
+
+    // Assumes the GPU is idle, every pending release is freed right away
+    ~GpuAllocator();
+
+    GpuAllocation* createBuffer(D3D12_HEAP_TYPE heapType, UINT64 size,
+                                D3D12_RESOURCE_STATES initialState,
+                                LPCWSTR name = nullptr);
+
+    GpuAllocation*
+    createResource(D3D12_HEAP_TYPE heapType, const D3D12_RESOURCE_DESC& desc,
+                   D3D12_RESOURCE_STATES initialState,
+                   const D3D12_CLEAR_VALUE* pOptimizedClearValue = nullptr,
+                   LPCWSTR name = nullptr);
+
+    // The resource and its memory stay alive until the frame being recorded
+    // has finished on the GPU
+    void release(GpuAllocation* allocation);
+
+    // Tag releases since the last call with the fence value the GPU signals
+    // once it's done with them
+    void finishFrame(UINT64 fenceValue);
+
+    // Free every release whose fence value has been reached, and any heap
+    // left empty
+    void retire(UINT64 completedFenceValue);
+
+    // Move movable default heap buffers into lower free space of their heap,
+    // until maxBytes have been moved, recording the copies into a command
+    // list that executes before anything else uses them this frame. Moved
+    // resources are transitioned to copy from and back to their state, and
+    // the old ones are released with the frame. Returns the number of moves.
+    UINT defragment(ID3D12GraphicsCommandList* commandList, UINT64 maxBytes);
+
+    GpuAllocatorStats getStats() const;
+
+  protected:
+    struct Pool
+    {
+        D3D12_HEAP_TYPE heapType;
+        GpuResourceClass resourceClass;
+        std::vector<std::unique_ptr<GpuHeap>> heaps;
+    };
+
+    struct PendingRelease
+    {
+        GpuHeap* heap;
+        uint32_t block;
+        ID3D12Resource* resource;
+    };
+
+    struct Frame
+    {
+        UINT64 fenceValue;
+        std::vector<PendingRelease> releases;
+    };
+
+    Pool& getPool(D3D12_HEAP_TYPE heapType, GpuResourceClass resourceClass);
+
+    // Create a heap that's at least the given size, sized to the pool
+    GpuHeap* createHeap(Pool& pool, UINT64 minSize, UINT64 alignment);
+
+    void free(const PendingRelease& release);
+
+    ID3D12Device* mDevice;
+    GpuAllocatorDesc mDesc;
+
+    std::vector<Pool> mPools;
+
+    // Releases waiting on the GPU oldest first, and those of this frame
+    std::deque<Frame> mFrames;
+    Frame mCurrent;
+
+    uint64_t mHeapsCreated;
+    uint64_t mDefragMoves;
+    uint64_t mDefragBytes;
+};
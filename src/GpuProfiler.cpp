@@ -0,0 +1,132 @@
+#include "GpuProfiler.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler(ID3D12Device* device, ID3D12CommandQueue* queue,
+                         GpuAllocator& allocator, unsigned framesInFlight,
+                         uint32_t maxScopes)
+    : mQueryHeap(nullptr), mReadback(nullptr), mReadbackData(nullptr),
+      mAllocator(allocator), mMaxScopes(std::max(maxScopes, 1u)),
+      mFrames(std::max(framesInFlight, 1u)), mFrameIndex(0),
+      mCalibrationTicks(0), mCalibrationTime(0), mNanosecondsPerTick(0.0),
+      mFrameTime(0.0)
+{
+    // A begin and an end query per scope, per frame in flight
+    const UINT queryCount = 2 * mMaxScopes * (UINT)mFrames.size();
+    D3D12_QUERY_HEAP_DESC heapDesc = {};
+    heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    heapDesc.Count = queryCount;
+    ThrowIfFailed(
+        device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&mQueryHeap)));
+
+    // Readback heaps can stay mapped, the CPU only reads what the fence
+    // says is done
+    mReadback = mAllocator.createBuffer(
+        D3D12_HEAP_TYPE_READBACK, queryCount * sizeof(UINT64),
+        D3D12_RESOURCE_STATE_COPY_DEST, L"Timestamp Readback");
+    ThrowIfFailed(mReadback->resource->Map(
+        0, nullptr, reinterpret_cast<void**>(&mReadbackData)));
+
+    // Pair a GPU timestamp with the profiler's clock
+    UINT64 frequency = 0;
+    UINT64 cpuTicks = 0;
+    ThrowIfFailed(queue->GetTimestampFrequency(&frequency));
+    ThrowIfFailed(queue->GetClockCalibration(&mCalibrationTicks, &cpuTicks));
+    mCalibrationTime = Profiler::now();
+    if (frequency == 0)
+    {
+        throw std::runtime_error("timestamp frequency is zero!");
+    }
+    mNanosecondsPerTick = 1e9 / (double)frequency;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    if (mReadback)
+    {
+        mReadback->resource->Unmap(0, nullptr);
+        mAllocator.release(mReadback);
+        mReadback = nullptr;
+    }
+    if (mQueryHeap)
+    {
+        mQueryHeap->Release();
+        mQueryHeap = nullptr;
+    }
+}
+
+void GpuProfiler::beginFrame(unsigned frameContext)
+{
+    mFrameIndex = frameContext % (unsigned)mFrames.size();
+    Frame& frame = mFrames[mFrameIndex];
+    if (frame.names.empty())
+    {
+        return;
+    }
+
+    Profiler& cpuProfiler = profiler();
+    const UINT64* timestamps = mReadbackData + 2 * mMaxScopes * mFrameIndex;
+    int64_t frameStart = INT64_MAX;
+    int64_t frameEnd = INT64_MIN;
+    for (size_t i = 0; i < frame.names.size(); ++i)
+    {
+        const int64_t start = toProfilerTime(timestamps[2 * i]);
+        const int64_t end = toProfilerTime(timestamps[2 * i + 1]);
+        if (cpuProfiler.isEnabled())
+        {
+            cpuProfiler.recordGpu(frame.names[i], start, end);
+        }
+        frameStart = std::min(frameStart, start);
+        frameEnd = std::max(frameEnd, end);
+    }
+    mFrameTime = (double)(frameEnd - frameStart) / 1e6;
+    cpuProfiler.addGpuFrame(mFrameTime);
+    frame.names.clear();
+}
+
+uint32_t GpuProfiler::beginScope(const std::string& name)
+{
+    Frame& frame = mFrames[mFrameIndex];
+    if (frame.names.size() >= mMaxScopes)
+    {
+        return UINT32_MAX;
+    }
+    frame.names.push_back(profiler().intern(name));
+    return (uint32_t)frame.names.size() - 1;
+}
+
+void GpuProfiler::writeTimestamp(ID3D12GraphicsCommandList* commandList,
+                                 uint32_t scope, bool end) const
+{
+    if (scope >= mMaxScopes)
+    {
+        return;
+    }
+    const UINT index = 2 * (mMaxScopes * mFrameIndex + scope) + (end ? 1 : 0);
+    commandList->EndQuery(mQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, index);
+}
+
+void GpuProfiler::resolve(ID3D12GraphicsCommandList* commandList) const
+{
+    const Frame& frame = mFrames[mFrameIndex];
+    if (frame.names.empty())
+    {
+        return;
+    }
+    const UINT first = 2 * mMaxScopes * mFrameIndex;
+    commandList->ResolveQueryData(
+        mQueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, first,
+        2 * (UINT)frame.names.size(), mReadback->resource,
+        first * sizeof(UINT64));
+}
+
+double GpuProfiler::getFrameTime() const { return mFrameTime; }
+
+int64_t GpuProfiler::toProfilerTime(UINT64 ticks) const
+{
+    return mCalibrationTime +
+           (int64_t)((double)((int64_t)(ticks - mCalibrationTicks)) *
+                     mNanosecondsPerTick);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "GpuAllocator.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GPU Profiler
+// Brackets scopes of GPU work with timestamp queries. Every frame in flight
+// has a range of queries of its own, resolved into a readback buffer at the
+// end of the frame and read once the frame's fence has been waited on, so
+// reading results never stalls. Timestamps are moved onto the profiler's
+// clock with a calibration taken at creation, and land on its GPU track.
+
+class GpuProfiler
+{
+  public:
+    GpuProfiler(ID3D12Device* device, ID3D12CommandQueue* queue,
+                GpuAllocator& allocator, unsigned framesInFlight,
+                uint32_t maxScopes = 64);
+
+    // Assumes the GPU is idle
+    ~GpuProfiler();
+
+    // Read the scopes last recorded in this frame context, whose fence has
+    // to have been waited on, then start recording into it
+    void beginFrame(unsigned frameContext);
+
+    // Returns the scope's index, or UINT32_MAX once the frame is out of
+    // queries, which writeTimestamp ignores
+    uint32_t beginScope(const std::string& name);
+
+    // Write the scope's begin or end timestamp. Lists recording a frame's
+    // scopes may be recorded in parallel.
+    void writeTimestamp(ID3D12GraphicsCommandList* commandList,
+                        uint32_t scope, bool end) const;
+
+    // Copy the frame's timestamps into the readback buffer, recorded after
+    // every other timestamp of the frame
+    void resolve(ID3D12GraphicsCommandList* commandList) const;
+
+    // Time from the first scope's begin to the last scope's end of the
+    // latest frame read, in milliseconds
+    double getFrameTime() const;
+
+  protected:
+    struct Frame
+    {
+        std::vector<const char*> names;
+    };
+
+    // Timestamp ticks to profiler nanoseconds
+    int64_t toProfilerTime(UINT64 ticks) const;
+
+    ID3D12QueryHeap* mQueryHeap;
+    GpuAllocation* mReadback;
+    UINT64* mReadbackData;
+    GpuAllocator& mAllocator;
+    uint32_t mMaxScopes;
+
+    std::vector<Frame> mFrames;
+    unsigned mFrameIndex;
+
+    UINT64 mCalibrationTicks;
+    int64_t mCalibrationTime;
+    double mNanosecondsPerTick;
+
+    double mFrameTime;
+};
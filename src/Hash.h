@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+// Hash
+// 64 bit FNV-1a, used to build content keys for the on disk caches. It's
+// stable across runs and platforms, which std::hash doesn't promise.
+
+const uint64_t kHashBasis = 14695981039346656037ull;
+const uint64_t kHashPrime = 1099511628211ull;
+
+inline void hashBytes(uint64_t& hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= kHashPrime;
+    }
+}
+
+// Scalars and enums only, structs may contain padding
+template <typename T> inline void hashValue(uint64_t& hash, const T& value)
+{
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                  "hash structs field by field");
+    hashBytes(hash, &value, sizeof(value));
+}
+
+// Length prefixed, so adjacent strings can't run into each other
+inline void hashString(uint64_t& hash, const std::string& str)
+{
+    hashValue(hash, (uint64_t)str.size());
+    hashBytes(hash, str.data(), str.size());
+}
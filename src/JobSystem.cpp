@@ -0,0 +1,216 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <ostream>
+
+namespace
+{
+// Set on worker threads, so jobs they submit go onto their own queue
+thread_local const JobSystem* tJobSystem = nullptr;
+thread_local unsigned tThreadIndex = 0;
+}
+
+void JobSystemStats::report(std::ostream& out) const
+{
+    out << "Job system: " << jobs << " jobs, " << steals << " stolen\n";
+}
+
+JobSystem::JobSystem(unsigned workerCount)
+    : mQueuedJobs(0), mSleepers(0), mStopping(false), mJobs(0), mSteals(0)
+{
+    for (unsigned i = 0; i < workerCount + 1; ++i)
+    {
+        mQueues.emplace_back(new Queue());
+    }
+
+    // Thread 0 is whichever thread owns the system
+    for (unsigned i = 1; i < workerCount + 1; ++i)
+    {
+        mWorkers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+unsigned JobSystem::getThreadCount() const
+{
+    return (unsigned)mQueues.size();
+}
+
+void JobSystem::run(JobGroup& group, Job job)
+{
+    group.pending.fetch_add(1);
+
+    // Counted before it's queued, otherwise a thief could take it and
+    // decrement the count first, wrapping it around
+    mQueuedJobs.fetch_add(1);
+
+    Queue& queue = *mQueues[getThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.entries.push_back({std::move(job), &group});
+    }
+
+    // The count is published before sleepers are checked, and workers count
+    // themselves before they check it, so one of them always sees the other
+    // and the wake up can't be lost. While every worker is busy nothing
+    // takes the lock.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mSleepers.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mWake.notify_one();
+    }
+}
+
+void JobSystem::parallelFor(
+    uint32_t count, uint32_t batchSize,
+    const std::function<void(uint32_t begin, uint32_t end,
+                             unsigned threadIndex)>& fn)
+{
+    batchSize = std::max(batchSize, 1u);
+
+    JobGroup group;
+    for (uint32_t begin = 0; begin < count; begin += batchSize)
+    {
+        const uint32_t end = std::min(count, begin + batchSize);
+        run(group, [&fn, begin, end](unsigned threadIndex) {
+            fn(begin, end, threadIndex);
+        });
+    }
+    wait(group);
+}
+
+void JobSystem::wait(JobGroup& group)
+{
+    const unsigned threadIndex = getThreadIndex();
+    while (group.pending.load() > 0)
+    {
+        if (!runOne(threadIndex))
+        {
+            // The remaining jobs are running on other threads
+            std::this_thread::yield();
+        }
+    }
+
+    if (group.failed.load())
+    {
+        std::exception_ptr error = group.error;
+        group.error = nullptr;
+        group.failed = false;
+        std::rethrow_exception(error);
+    }
+}
+
+JobSystemStats JobSystem::getStats() const
+{
+    JobSystemStats stats;
+    stats.jobs = mJobs.load();
+    stats.steals = mSteals.load();
+    return stats;
+}
+
+void JobSystem::resetStats()
+{
+    mJobs = 0;
+    mSteals = 0;
+}
+
+unsigned JobSystem::getThreadIndex() const
+{
+    return tJobSystem == this ? tThreadIndex : 0;
+}
+
+bool JobSystem::runOne(unsigned threadIndex)
+{
+    Entry entry;
+    bool found = false;
+
+    // Newest job of our own queue first, it's the most likely to be warm
+    {
+        Queue& queue = *mQueues[threadIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.entries.empty())
+        {
+            entry = std::move(queue.entries.back());
+            queue.entries.pop_back();
+            found = true;
+        }
+    }
+
+    // Then the oldest job of someone else's
+    const unsigned threadCount = getThreadCount();
+    for (unsigned i = 1; !found && i < threadCount; ++i)
+    {
+        Queue& queue = *mQueues[(threadIndex + i) % threadCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.entries.empty())
+        {
+            entry = std::move(queue.entries.front());
+            queue.entries.pop_front();
+            found = true;
+            mSteals.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (!found)
+    {
+        return false;
+    }
+    mQueuedJobs.fetch_sub(1);
+
+    try
+    {
+        entry.job(threadIndex);
+    }
+    catch (...)
+    {
+        if (!entry.group->failed.exchange(true))
+        {
+            entry.group->error = std::current_exception();
+        }
+    }
+    mJobs.fetch_add(1, std::memory_order_relaxed);
+
+    // Last, the group may be destroyed as soon as it reaches zero
+    entry.group->pending.fetch_sub(1);
+    return true;
+}
+
+void JobSystem::workerLoop(unsigned threadIndex)
+{
+    tJobSystem = this;
+    tThreadIndex = threadIndex;
+    profiler().setThreadName("Worker " + std::to_string(threadIndex));
+
+    while (true)
+    {
+        if (runOne(threadIndex))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mSleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        mWake.wait(lock,
+                   [&] { return mStopping || mQueuedJobs.load() > 0; });
+        mSleepers.fetch_sub(1);
+        if (mStopping && mQueuedJobs.load() == 0)
+        {
+            return;
+        }
+    }
+}
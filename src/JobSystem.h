@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Job System
+// Runs jobs on a fixed set of worker threads. Every thread has its own queue,
+// it pushes and pops jobs at the back of it, and once it runs dry it steals
+// from the front of another thread's queue, so work spreads out without a
+// single contended queue. Threads that wait on a group run jobs instead of
+// blocking. Jobs are told which thread runs them, so they can use
+// per-thread resources such as command allocators without locking.
+
+// Counts the jobs of a group that haven't finished
+struct JobGroup
+{
+    std::atomic<uint32_t> pending{0};
+
+    // The first exception a job of the group threw, rethrown by wait()
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+};
+
+// Index of the thread running the job, from 0 to getThreadCount() - 1
+typedef std::function<void(unsigned threadIndex)> Job;
+
+struct JobSystemStats
+{
+    uint64_t jobs = 0;
+
+    // Jobs a thread took from another thread's queue
+    uint64_t steals = 0;
+
+    void report(std::ostream& out) const;
+};
+
+class JobSystem
+{
+  public:
+    JobSystem(unsigned workerCount);
+
+    // Finishes every queued job first
+    ~JobSystem();
+
+    // Workers plus the thread that owns the system. Threads that aren't
+    // workers all run jobs as thread 0, so only one of them should submit
+    // and wait at a time.
+    unsigned getThreadCount() const;
+
+    void run(JobGroup& group, Job job);
+
+    // Call fn(begin, end, threadIndex) over [0, count) in ranges of up to
+    // batchSize, and wait for all of them
+    void parallelFor(
+        uint32_t count, uint32_t batchSize,
+        const std::function<void(uint32_t begin, uint32_t end,
+                                 unsigned threadIndex)>& fn);
+
+    // Run jobs until every job of the group has finished, then rethrow the
+    // first exception one of them threw
+    void wait(JobGroup& group);
+
+    JobSystemStats getStats() const;
+
+    void resetStats();
+
+  protected:
+    struct Entry
+    {
+        Job job;
+        JobGroup* group;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Entry> entries;
+    };
+
+    // Index of the calling thread in this system
+    unsigned getThreadIndex() const;
+
+    // Run a job from the thread's own queue or steal one, returns false if
+    // every queue was empty
+    bool runOne(unsigned threadIndex);
+
+    void workerLoop(unsigned threadIndex);
+
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::thread> mWorkers;
+
+    // Workers sleep while nothing is queued anywhere, and are only woken if
+    // some are asleep
+    std::atomic<uint32_t> mQueuedJobs;
+    std::atomic<uint32_t> mSleepers;
+    std::mutex mSleepMutex;
+    std::condition_variable mWake;
+    bool mStopping;
+
+    std::atomic<uint64_t> mJobs;
+    std::atomic<uint64_t> mSteals;
+};
@@ -0,0 +1,170 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+
+namespace
+{
+// A coarser level is only switched to once its error is under this share of
+// the threshold
+const float kCoarsenHysteresis = 0.8f;
+
+// Items whose levels are selected per job
+const uint32_t kSelectBatchSize = 4096;
+
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// How many of a mesh's levels have an error of at most maxError, they're
+// ordered by growing error
+uint32_t countLevels(const std::vector<MeshRange>& meshes,
+                     const MeshRange& mesh, float maxError)
+{
+    uint32_t count = 0;
+    while (count < mesh.lodCount &&
+           meshes[mesh.firstLod + count].error <= maxError)
+    {
+        count++;
+    }
+    return count;
+}
+}
+
+double LodStats::triangleReduction() const
+{
+    return fullTriangles > 0
+               ? 1.0 - (double)triangles / (double)fullTriangles
+               : 0.0;
+}
+
+void LodStats::report(std::ostream& out) const
+{
+    out << "Levels of detail: " << triangles << " of " << fullTriangles
+        << " triangles drawn, " << triangleReduction() * 100.0
+        << "% reduction, " << switches << " switches over " << objects
+        << " objects in " << frames << " frames\n";
+    out << "  ms: " << selectTime << " selecting, "
+        << (frames > 0 ? selectTime / (double)frames : 0.0)
+        << " per frame\n";
+}
+
+LodSelector::LodSelector(JobSystem& jobSystem) : mJobSystem(jobSystem) {}
+
+void LodSelector::select(const std::vector<DrawItem>& items,
+                         const std::vector<MeshRange>& meshes,
+                         const std::vector<uint32_t>* visible,
+                         const glm::vec3& cameraPosition,
+                         float projectionScale, float pixelError)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    // Levels are kept per item index, they mean nothing once the items
+    // change
+    if (mLevels.size() != items.size())
+    {
+        mLevels.assign(items.size(), 0);
+    }
+    mMeshes.resize(items.size());
+
+    const uint32_t count =
+        visible != nullptr ? (uint32_t)visible->size() : (uint32_t)items.size();
+    mCounters.assign((count + kSelectBatchSize - 1) / kSelectBatchSize,
+                     Counters());
+    mJobSystem.parallelFor(
+        count, kSelectBatchSize,
+        [&](uint32_t begin, uint32_t end, unsigned threadIndex) {
+            Counters& counters = mCounters[begin / kSelectBatchSize];
+            for (uint32_t k = begin; k < end; ++k)
+            {
+                const uint32_t i = visible != nullptr ? (*visible)[k] : k;
+                const DrawItem& item = items[i];
+                const MeshRange& mesh = meshes[item.mesh];
+                counters.fullTriangles += mesh.indexCount / 3;
+                if (mesh.lodCount == 0)
+                {
+                    mMeshes[i] = item.mesh;
+                    counters.triangles += mesh.indexCount / 3;
+                    continue;
+                }
+
+                // The bounding sphere of the mesh bounds, in world space
+                const glm::mat4& m = item.modelMatrix;
+                float center[3], radiusSquared = 0.0f, scaleSquared = 0.0f;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    center[axis] =
+                        (mesh.boundsMin[axis] + mesh.boundsMax[axis]) * 0.5f;
+                    const float extent =
+                        (mesh.boundsMax[axis] - mesh.boundsMin[axis]) * 0.5f;
+                    radiusSquared += extent * extent;
+                    scaleSquared =
+                        std::max(scaleSquared, m[axis][0] * m[axis][0] +
+                                                   m[axis][1] * m[axis][1] +
+                                                   m[axis][2] * m[axis][2]);
+                }
+                const float scale = std::sqrt(scaleSquared);
+                float distanceSquared = 0.0f;
+                for (int row = 0; row < 3; ++row)
+                {
+                    const float d = m[0][row] * center[0] +
+                                    m[1][row] * center[1] +
+                                    m[2][row] * center[2] + m[3][row] -
+                                    cameraPosition[row];
+                    distanceSquared += d * d;
+                }
+
+                // Model space error the threshold allows at the nearest
+                // point of the sphere, a camera inside it sees full detail
+                const float distance = std::sqrt(distanceSquared) -
+                                       std::sqrt(radiusSquared) * scale;
+                const float maxError =
+                    distance > 0.0f
+                        ? pixelError * distance / (projectionScale * scale)
+                        : 0.0f;
+
+                uint32_t level = mLevels[i];
+                const uint32_t finest = countLevels(meshes, mesh, maxError);
+                const uint32_t coarsest = countLevels(
+                    meshes, mesh, maxError * kCoarsenHysteresis);
+                if (level > finest)
+                {
+                    level = finest;
+                }
+                else if (coarsest > level)
+                {
+                    level = coarsest;
+                }
+                counters.switches += level != mLevels[i];
+                mLevels[i] = (uint8_t)level;
+
+                mMeshes[i] = level > 0 ? mesh.firstLod + level - 1
+                                       : item.mesh;
+                counters.triangles += meshes[mMeshes[i]].indexCount / 3;
+            }
+        });
+
+    for (const Counters& counters : mCounters)
+    {
+        mStats.fullTriangles += counters.fullTriangles;
+        mStats.triangles += counters.triangles;
+        mStats.switches += counters.switches;
+    }
+    mStats.frames++;
+    mStats.objects += count;
+    mStats.selectTime +=
+        elapsedMilliseconds(start, std::chrono::steady_clock::now());
+}
+
+const std::vector<uint32_t>& LodSelector::getMeshes() const
+{
+    return mMeshes;
+}
+
+const LodStats& LodSelector::getStats() const { return mStats; }
+
+void LodSelector::resetStats() { mStats = LodStats(); }
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "DrawBatcher.h"
+#include "FramePacket.h"
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Level of Detail Selector
+// Picks which level of its mesh every draw item is drawn at. A level's error
+// is projected to pixels at the distance of the item's bounding sphere, and
+// the coarsest level whose error stays under the threshold is drawn. Items
+// only move to a coarser level once it's well under the threshold, so an
+// item sitting at a boundary doesn't switch back and forth every frame.
+// Items are selected in parallel on the job system.
+
+struct LodStats
+{
+    uint64_t frames = 0;
+    uint64_t objects = 0;
+
+    // Triangles of the selected items at full detail, and at the levels
+    // they're drawn at
+    uint64_t fullTriangles = 0;
+    uint64_t triangles = 0;
+
+    // Times an item moved to another level
+    uint64_t switches = 0;
+
+    // Time spent selecting levels, in milliseconds
+    double selectTime = 0.0;
+
+    // Share of full detail triangles that weren't drawn
+    double triangleReduction() const;
+
+    void report(std::ostream& out) const;
+};
+
+class LodSelector
+{
+  public:
+    LodSelector(JobSystem& jobSystem);
+
+    // Select a level for every item, or only the given ones. projectionScale
+    // is how many pixels a unit long object a unit away covers, half the
+    // viewport height times projection[1][1], and pixelError the most a
+    // level's error may cover.
+    void select(const std::vector<DrawItem>& items,
+                const std::vector<MeshRange>& meshes,
+                const std::vector<uint32_t>* visible,
+                const glm::vec3& cameraPosition, float projectionScale,
+                float pixelError);
+
+    // The mesh each item is drawn with, indexed like items, only valid for
+    // those selected last
+    const std::vector<uint32_t>& getMeshes() const;
+
+    const LodStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    struct Counters
+    {
+        uint64_t fullTriangles;
+        uint64_t triangles;
+        uint64_t switches;
+    };
+
+    JobSystem& mJobSystem;
+
+    // Per item, the level it was last drawn at, zero being full detail
+    std::vector<uint8_t> mLevels;
+    std::vector<uint32_t> mMeshes;
+
+    // Per batch, summed once every batch is done
+    std::vector<Counters> mCounters;
+
+    LodStats mStats;
+};
@@ -1,9 +1,50 @@
 #include "CrossWindow/CrossWindow.h"
+#include "FramePacer.h"
+#include "Profiler.h"
+#include "RenderThread.h"
 #include "Renderer.h"
+#include "TransformSystem.h"
+
+#include <cmath>
+#include <string>
+
+// Returns the value of a `--name=value` command line argument
+unsigned long long getArgument(int argc, const char** argv,
+                               const std::string& name,
+                               unsigned long long defaultValue)
+{
+    const std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+        {
+            return std::stoull(arg.substr(prefix.size()));
+        }
+    }
+    return defaultValue;
+}
+
+std::string getArgument(int argc, const char** argv, const std::string& name,
+                        const std::string& defaultValue)
+{
+    const std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+        {
+            return arg.substr(prefix.size());
+        }
+    }
+    return defaultValue;
+}
 
 void xmain(int argc, const char** argv)
 {
-    // 🖼️ Create a window
+    // 🖼️ Create a window, unless frames are rendered offscreen with
+    // --offscreen=1, which needs no window system at all
+    const bool offscreen = getArgument(argc, argv, "offscreen", 0) != 0;
     xwin::EventQueue eventQueue;
     xwin::Window window;
 
@@ -11,19 +52,119 @@ void xmain(int argc, const char** argv)
     windowDesc.name = "MainWindow";
     windowDesc.title = "Hello Triangle";
     windowDesc.visible = true;
-    windowDesc.width = 1280;
-    windowDesc.height = 720;
+    windowDesc.width = (unsigned)getArgument(argc, argv, "width", 1280);
+    windowDesc.height = (unsigned)getArgument(argc, argv, "height", 720);
     //windowDesc.fullscreen = true;
-    window.create(windowDesc, eventQueue);
+    if (!offscreen)
+    {
+        window.create(windowDesc, eventQueue);
+    }
+
+#if defined(XGFX_NOOP)
+    // 🐢 Simulate how long the GPU takes to execute each submission
+    noopConfig().gpuSubmitLatency = std::chrono::microseconds(
+        getArgument(argc, argv, "gpu-latency-us", 0));
+    noopConfig().gpuCommandCost = std::chrono::nanoseconds(
+        getArgument(argc, argv, "gpu-command-ns", 0));
+    noopConfig().gpuCopyBytesPerSecond =
+        1e6 * (double)getArgument(argc, argv, "gpu-copy-mbps", 0);
+    noopConfig().shaderCompileTime = std::chrono::microseconds(
+        getArgument(argc, argv, "shader-compile-us", 0));
+    noopConfig().pipelineCompileTime = std::chrono::microseconds(
+        getArgument(argc, argv, "pso-compile-us", 0));
+#endif
+
+    // 🔬 Record timed scopes for a Chrome trace when --trace names a file
+    const std::string tracePath =
+        getArgument(argc, argv, "trace", std::string());
+    profiler().setThreadName("Main Thread");
+    profiler().setEnabled(!tracePath.empty());
 
     // 📸 Create a renderer
-    Renderer renderer(window);
+    RendererDesc rendererDesc;
+    rendererDesc.framesInFlight =
+        (unsigned)getArgument(argc, argv, "frames-in-flight", 2);
+    rendererDesc.workerThreads = (unsigned)getArgument(
+        argc, argv, "worker-threads", rendererDesc.workerThreads);
+    rendererDesc.drawsPerBatch = (uint32_t)getArgument(
+        argc, argv, "draws-per-batch", rendererDesc.drawsPerBatch);
+    rendererDesc.instancing =
+        getArgument(argc, argv, "instancing", rendererDesc.instancing) != 0;
+    rendererDesc.indirectDraws =
+        getArgument(argc, argv, "indirect", rendererDesc.indirectDraws) != 0;
+    rendererDesc.frustumCulling =
+        getArgument(argc, argv, "culling", rendererDesc.frustumCulling) != 0;
+    rendererDesc.clusterCulling =
+        getArgument(argc, argv, "cluster-culling",
+                    rendererDesc.clusterCulling) != 0;
+    rendererDesc.backfaceCulling =
+        getArgument(argc, argv, "backface-culling",
+                    rendererDesc.backfaceCulling) != 0;
+    rendererDesc.levelOfDetail =
+        getArgument(argc, argv, "lod", rendererDesc.levelOfDetail) != 0;
+    rendererDesc.meshPath =
+        getArgument(argc, argv, "mesh", rendererDesc.meshPath);
+    rendererDesc.compactVertices =
+        getArgument(argc, argv, "compact-vertices",
+                    rendererDesc.compactVertices) != 0;
+    rendererDesc.gpuTimestamps =
+        getArgument(argc, argv, "gpu-timestamps",
+                    rendererDesc.gpuTimestamps) != 0;
+    std::unique_ptr<Renderer> renderer(
+        offscreen
+            ? new Renderer(windowDesc.width, windowDesc.height, rendererDesc)
+            : new Renderer(window, rendererDesc));
+
+    // 🧵 Render on a thread of its own, fed with packets built here
+    RenderThread renderThread(*renderer);
+
+    // 🔺 The scene is the triangle drawn --draws times on a grid receding
+    // from the camera, standing in for the objects of a real scene
+    const size_t drawCount = (size_t)getArgument(argc, argv, "draws", 1);
+    TransformSystem transforms((TransformKernel)getArgument(
+        argc, argv, "transform-kernel", (unsigned)getBestTransformKernel()));
+    const size_t gridSize =
+        (size_t)std::ceil(std::sqrt((double)std::max<size_t>(drawCount, 1)));
+    for (size_t i = 0; i < drawCount; ++i)
+    {
+        const float column = (float)(i % gridSize) - (float)(gridSize - 1) / 2;
+        const float row = (float)(i / gridSize);
+        transforms.add(glm::vec3(column * 3.0f, 0.0f, row * 3.0f));
+    }
+    float aspectRatio = (float)windowDesc.width / (float)windowDesc.height;
+    auto tStart = std::chrono::steady_clock::now();
+
+    // 📊 Headless and offscreen runs never receive a close event, so render
+    // a fixed number of frames and only measure the steady state after
+    // initialization
+    const UINT64 frameLimit = getArgument(argc, argv, "frames", 600);
+#if defined(XGFX_NOOP)
+    const bool frameLimited = true;
+    noopStats().reset();
+#else
+    const bool frameLimited = offscreen;
+#endif
+
+    // ⏱️ Pace frames to 60 fps by default, --fps=0 runs uncapped. Offscreen
+    // runs measure throughput, so they're uncapped by default.
+    FramePacerDesc pacerDesc;
+    pacerDesc.targetFrameRate =
+        (double)getArgument(argc, argv, "fps", offscreen ? 0 : 60);
+    pacerDesc.adaptiveLatency =
+        getArgument(argc, argv, "adaptive-latency", 0) != 0;
+    FramePacer pacer(pacerDesc);
 
     // 🏁 Engine loop
     bool isRunning = true;
+    bool shouldClose = false;
+    UINT64 submittedFrames = 0;
+    const auto loopStart = std::chrono::steady_clock::now();
     while (isRunning)
     {
-        bool shouldRender = true;
+        // 💤 Wait for the next frame before polling input, so it's fresh
+        pacer.beginFrame();
+        PROFILE_SCOPE("Build Packet");
+        FramePacket* packet = renderThread.beginPacket();
 
         // ♻️ Update the event queue
         eventQueue.update();
@@ -37,25 +178,104 @@ void xmain(int argc, const char** argv)
             if (event.type == xwin::EventType::Resize)
             {
                 const xwin::ResizeData data = event.data.resize;
-                renderer.resize(data.width, data.height);
-                shouldRender = false;
+                packet->resize = true;
+                packet->width = data.width;
+                packet->height = data.height;
+                aspectRatio = (float)std::max(data.width, 1u) /
+                              (float)std::max(data.height, 1u);
             }
 
             if (event.type == xwin::EventType::Close)
             {
-                window.close();
-                shouldRender = false;
+                // The window outlives whatever the render thread still has
+                shouldClose = true;
                 isRunning = false;
             }
 
             eventQueue.pop();
         }
 
-        // ✨ Update Visuals
-        if (shouldRender)
+        // 🌀 Animate by the time since the last frame, pacing is up to the
+        // pacer
+        const auto tEnd = std::chrono::steady_clock::now();
+        const float time =
+            std::chrono::duration<float, std::milli>(tEnd - tStart).count();
+        tStart = tEnd;
+        transforms.rotateAll(
+            glm::angleAxis(0.001f * time, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        // ✨ Update Visuals, the render thread draws them while the next
+        // packet is built
+        packet->projectionMatrix =
+            glm::perspective(45.0f, aspectRatio, 0.01f, 1024.0f);
+        packet->viewMatrix = glm::translate(glm::identity<glm::mat4>(),
+                                            glm::vec3(0.0f, 0.0f, 2.5f));
+        packet->draws.resize(drawCount);
+        if (drawCount > 0)
+        {
+            transforms.computeMatrices(&packet->draws[0].modelMatrix,
+                                       sizeof(DrawItem));
+        }
+        renderThread.submitPacket(packet);
+        submittedFrames++;
+        pacer.endFrame();
+
+        if (frameLimited && submittedFrames >= frameLimit)
         {
-            renderer.render();
+            isRunning = false;
         }
     }
 
+    // 🛑 Finish the submitted packets before anything they use goes away
+    renderThread.stop();
+    const double loopTime = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - loopStart)
+                                .count();
+    if (shouldClose)
+    {
+        window.close();
+    }
+
+    // ⏲️ Offscreen runs are throughput benchmarks, reported on any backend
+    if (offscreen)
+    {
+        std::cout << "Offscreen: " << renderer->getFrameCount()
+                  << " frames at " << windowDesc.width << "x"
+                  << windowDesc.height << " in " << loopTime << " ms, "
+                  << 1000.0 * (double)renderer->getFrameCount() / loopTime
+                  << " fps\n";
+#if !defined(XGFX_NOOP)
+        profiler().getFrameStats().report(std::cout);
+#endif
+    }
+
+    // 🔬 The render thread has stopped, so every scope can be collected
+    if (!tracePath.empty())
+    {
+        profiler().collect();
+        profiler().saveChromeTrace(tracePath);
+    }
+
+#if defined(XGFX_NOOP)
+    noopStats().report(std::cout, renderer->getFrameCount());
+    pacer.getStats().report(std::cout);
+    renderer->getMeshLoadStats().report(std::cout);
+    renderer->getGeometryUploadStats().report(std::cout);
+    renderer->getGpuAllocatorStats().report(std::cout);
+    renderer->getShaderCacheStats().report(std::cout);
+    renderer->getRootSignatureCacheStats().report(std::cout);
+    renderer->getPipelineCacheStats().report(std::cout);
+    renderer->getDescriptorStats().report(std::cout);
+    renderer->getRenderGraphStats().report(std::cout);
+    renderer->getCommandRecorderStats().report(std::cout);
+    renderer->getJobSystemStats().report(std::cout);
+    renderer->getCullingStats().report(std::cout);
+    renderer->getLodStats().report(std::cout);
+    renderer->getClusterCullingStats().report(std::cout);
+    renderer->getDrawBatcherStats().report(std::cout);
+    std::cout << getTransformKernelName(transforms.getKernel()) << " ";
+    transforms.getStats().report(std::cout);
+    renderThread.getStats().report(std::cout);
+    profiler().getFrameStats().report(std::cout);
+#endif
 }
\ No newline at end of file
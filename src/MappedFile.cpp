@@ -0,0 +1,152 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32) && !defined(XGFX_NOOP)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : mData(nullptr), mSize(0), mOpen(false),
+#if defined(_WIN32) && !defined(XGFX_NOOP)
+      mFile(INVALID_HANDLE_VALUE), mMapping(nullptr)
+#else
+      mFile(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile() { close(); }
+
+#if defined(_WIN32) && !defined(XGFX_NOOP)
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    mFile = CreateFileA(path.c_str(), GENERIC_READ,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(mFile, &fileSize))
+    {
+        close();
+        return false;
+    }
+    mSize = (size_t)fileSize.QuadPart;
+    mOpen = true;
+
+    // Empty files can't be mapped, but there's nothing to read anyway
+    if (mSize == 0)
+    {
+        return true;
+    }
+
+    mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMapping != nullptr)
+    {
+        mData = static_cast<const uint8_t*>(
+            MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (mData == nullptr)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData)
+    {
+        UnmapViewOfFile(mData);
+        mData = nullptr;
+    }
+
+    if (mMapping)
+    {
+        CloseHandle(mMapping);
+        mMapping = nullptr;
+    }
+
+    if (mFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(mFile);
+        mFile = INVALID_HANDLE_VALUE;
+    }
+
+    mSize = 0;
+    mOpen = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    mFile = ::open(path.c_str(), O_RDONLY);
+    if (mFile < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(mFile, &fileStat) != 0)
+    {
+        close();
+        return false;
+    }
+    mSize = (size_t)fileStat.st_size;
+    mOpen = true;
+
+    // Empty files can't be mapped, but there's nothing to read anyway
+    if (mSize == 0)
+    {
+        return true;
+    }
+
+    void* data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+    if (data == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    mData = static_cast<const uint8_t*>(data);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mData)
+    {
+        munmap(const_cast<uint8_t*>(mData), mSize);
+        mData = nullptr;
+    }
+
+    if (mFile >= 0)
+    {
+        ::close(mFile);
+        mFile = -1;
+    }
+
+    mSize = 0;
+    mOpen = false;
+}
+
+#endif
+
+bool MappedFile::isOpen() const { return mOpen; }
+
+const uint8_t* MappedFile::data() const { return mData; }
+
+size_t MappedFile::size() const { return mSize; }
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Mapped File
+// Maps a whole file read only into the address space, so its contents can be
+// used in place without reading them into a buffer first. Pages are loaded
+// by the OS on first access and shared with the file cache.
+
+class MappedFile
+{
+  public:
+    MappedFile();
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file doesn't exist or can't be mapped, empty files
+    // open successfully with no data
+    bool open(const std::string& path);
+
+    void close();
+
+    bool isOpen() const;
+
+    const uint8_t* data() const;
+
+    size_t size() const;
+
+  protected:
+    const uint8_t* mData;
+    size_t mSize;
+    bool mOpen;
+
+#if defined(_WIN32) && !defined(XGFX_NOOP)
+    void* mFile;
+    void* mMapping;
+#else
+    int mFile;
+#endif
+};
@@ -0,0 +1,747 @@
+#include "MeshCooker.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+// Spaces and tabs only, numbers never continue onto the next line
+void skipSpaces(const char*& p)
+{
+    while (*p == ' ' || *p == '\t')
+    {
+        ++p;
+    }
+}
+
+bool atLineEnd(const char* p)
+{
+    return *p == '\0' || *p == '\n' || *p == '\r' || *p == '#';
+}
+
+void skipLine(const char*& p)
+{
+    while (*p != '\0' && *p != '\n')
+    {
+        ++p;
+    }
+    if (*p == '\n')
+    {
+        ++p;
+    }
+}
+
+bool parseFloat(const char*& p, float& value)
+{
+    skipSpaces(p);
+    if (atLineEnd(p))
+    {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtof(p, &end);
+    if (end == p)
+    {
+        return false;
+    }
+    p = end;
+    return true;
+}
+
+// A face corner is v, v/vt, v//vn or v/vt/vn, the normal is zero without vn
+bool parseCorner(const char*& p, long& position, long& normal)
+{
+    skipSpaces(p);
+    if (atLineEnd(p))
+    {
+        return false;
+    }
+    char* end = nullptr;
+    position = std::strtol(p, &end, 10);
+    if (end == p)
+    {
+        return false;
+    }
+    p = end;
+
+    normal = 0;
+    for (unsigned slash = 0; *p == '/'; ++slash)
+    {
+        ++p;
+        const long value = std::strtol(p, &end, 10);
+        p = end;
+        if (slash == 1)
+        {
+            normal = value;
+        }
+    }
+    while (!atLineEnd(p) && *p != ' ' && *p != '\t')
+    {
+        ++p;
+    }
+    return true;
+}
+
+// Resolve a 1 based index, negative ones count back from the last element
+// read so far, returns false if it's before the first
+bool resolveIndex(long& index, size_t count)
+{
+    if (index < 0)
+    {
+        index += (long)count + 1;
+    }
+    index -= 1;
+    return index >= 0;
+}
+
+bool matchKeyword(const char* p, const char* keyword)
+{
+    const size_t length = strlen(keyword);
+    return strncmp(p, keyword, length) == 0 &&
+           (p[length] == ' ' || p[length] == '\t' || atLineEnd(p + length));
+}
+
+// Close the current submesh at the given index count, empty ones are
+// dropped
+void endSubmesh(uint32_t firstIndex, size_t indexCount, CookedMesh& mesh)
+{
+    if (indexCount == firstIndex)
+    {
+        return;
+    }
+
+    MeshSubmesh submesh = {};
+    submesh.firstIndex = firstIndex;
+    submesh.indexCount = (uint32_t)indexCount - firstIndex;
+    submesh.baseVertex = 0;
+    mesh.submeshes.push_back(submesh);
+}
+
+// Unit length, or facing +z if there's no direction to keep
+void normalize(float vector[3])
+{
+    const float length = std::sqrt(vector[0] * vector[0] +
+                                   vector[1] * vector[1] +
+                                   vector[2] * vector[2]);
+    if (length > 0.0f)
+    {
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+            vector[axis] /= length;
+        }
+    }
+    else
+    {
+        vector[0] = 0.0f;
+        vector[1] = 0.0f;
+        vector[2] = 1.0f;
+    }
+}
+
+// Round to the nearest step of a normalized integer format, clamping to its
+// range first
+long quantizeUnorm(float value, float steps)
+{
+    return std::lround(std::min(std::max(value, 0.0f), 1.0f) * steps);
+}
+
+long quantizeSnorm(float value, float steps)
+{
+    return std::lround(std::min(std::max(value, -1.0f), 1.0f) * steps);
+}
+
+void writePadding(std::ofstream& file, uint64_t& offset, uint64_t target)
+{
+    static const char zeros[kMeshSectionAlignment] = {};
+    file.write(zeros, (std::streamsize)(target - offset));
+    offset = target;
+}
+}
+
+bool loadObj(const std::string& path, CookedMesh& mesh, std::string& errors)
+{
+    mesh = CookedMesh();
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        errors = "failed to open " + path;
+        return false;
+    }
+    const std::string text((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+    // Positive indices can refer to elements further down the file, so
+    // corners are only turned into vertices once everything has been read
+    std::vector<MeshVertex> positions;
+    std::vector<std::array<float, 3>> normals;
+    std::vector<std::pair<long, long>> corners;
+
+    uint32_t firstIndex = 0;
+    size_t line = 1;
+    std::vector<std::pair<long, long>> face;
+    for (const char* p = text.c_str(); *p != '\0'; skipLine(p), ++line)
+    {
+        skipSpaces(p);
+
+        if (matchKeyword(p, "v"))
+        {
+            p += 1;
+
+            // x y z, x y z w or either followed by r g b
+            float values[7];
+            unsigned count = 0;
+            while (count < 7 && parseFloat(p, values[count]))
+            {
+                ++count;
+            }
+            if (count < 3)
+            {
+                errors = path + ":" + std::to_string(line) +
+                         ": vertex has fewer than 3 coordinates";
+                return false;
+            }
+
+            MeshVertex vertex = {{values[0], values[1], values[2]},
+                                 {0.0f, 0.0f, 0.0f},
+                                 {1.0f, 1.0f, 1.0f}};
+            if (count >= 6)
+            {
+                const float* color = &values[count - 3];
+                std::copy(color, color + 3, vertex.color);
+            }
+            positions.push_back(vertex);
+        }
+        else if (matchKeyword(p, "vn"))
+        {
+            p += 2;
+
+            std::array<float, 3> normal;
+            if (!parseFloat(p, normal[0]) || !parseFloat(p, normal[1]) ||
+                !parseFloat(p, normal[2]))
+            {
+                errors = path + ":" + std::to_string(line) +
+                         ": normal has fewer than 3 coordinates";
+                return false;
+            }
+            normals.push_back(normal);
+        }
+        else if (matchKeyword(p, "f"))
+        {
+            p += 1;
+
+            face.clear();
+            long position = 0;
+            long normal = 0;
+            while (parseCorner(p, position, normal))
+            {
+                if (!resolveIndex(position, positions.size()) ||
+                    (normal != 0 && !resolveIndex(normal, normals.size())))
+                {
+                    errors = path + ":" + std::to_string(line) +
+                             ": face refers to an element before the first";
+                    return false;
+                }
+                face.push_back({position, normal == 0 ? -1 : normal});
+            }
+            if (face.size() < 3)
+            {
+                errors = path + ":" + std::to_string(line) +
+                         ": face has fewer than 3 corners";
+                return false;
+            }
+
+            for (size_t i = 2; i < face.size(); ++i)
+            {
+                corners.push_back(face[0]);
+                corners.push_back(face[i - 1]);
+                corners.push_back(face[i]);
+            }
+        }
+        else if (matchKeyword(p, "o") || matchKeyword(p, "g") ||
+                 matchKeyword(p, "usemtl"))
+        {
+            endSubmesh(firstIndex, corners.size(), mesh);
+            firstIndex = (uint32_t)corners.size();
+        }
+    }
+    endSubmesh(firstIndex, corners.size(), mesh);
+
+    if (mesh.submeshes.empty())
+    {
+        errors = path + ": no faces";
+        return false;
+    }
+
+    // Every distinct position and normal pair becomes a vertex
+    std::unordered_map<uint64_t, uint32_t> vertexIndices;
+    vertexIndices.reserve(corners.size() / 4);
+    mesh.indices.reserve(corners.size());
+    std::vector<bool> hasNormal;
+    for (const std::pair<long, long>& corner : corners)
+    {
+        if ((size_t)corner.first >= positions.size() ||
+            (corner.second >= 0 && (size_t)corner.second >= normals.size()))
+        {
+            errors = path + ": face refers to a missing element";
+            return false;
+        }
+
+        const uint64_t key =
+            ((uint64_t)corner.first << 32) | (uint32_t)(corner.second + 1);
+        auto inserted =
+            vertexIndices.insert({key, (uint32_t)mesh.vertices.size()});
+        if (inserted.second)
+        {
+            MeshVertex vertex = positions[corner.first];
+            if (corner.second >= 0)
+            {
+                std::copy(normals[corner.second].begin(),
+                          normals[corner.second].end(), vertex.normal);
+            }
+            mesh.vertices.push_back(vertex);
+            hasNormal.push_back(corner.second >= 0);
+        }
+        mesh.indices.push_back(inserted.first->second);
+    }
+
+    // Vertices without a normal get the sum of their faces' normals, which
+    // the cross product already weights by area
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const float* p0 = mesh.vertices[mesh.indices[i]].position;
+        const float* p1 = mesh.vertices[mesh.indices[i + 1]].position;
+        const float* p2 = mesh.vertices[mesh.indices[i + 2]].position;
+        const float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        const float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        const float faceNormal[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                                     e1[2] * e2[0] - e1[0] * e2[2],
+                                     e1[0] * e2[1] - e1[1] * e2[0]};
+        for (size_t corner = i; corner < i + 3; ++corner)
+        {
+            if (!hasNormal[mesh.indices[corner]])
+            {
+                float* normal = mesh.vertices[mesh.indices[corner]].normal;
+                for (unsigned axis = 0; axis < 3; ++axis)
+                {
+                    normal[axis] += faceNormal[axis];
+                }
+            }
+        }
+    }
+    for (MeshVertex& vertex : mesh.vertices)
+    {
+        normalize(vertex.normal);
+    }
+    return true;
+}
+
+void computeSubmeshBounds(CookedMesh& mesh)
+{
+    for (MeshSubmesh& submesh : mesh.submeshes)
+    {
+        std::fill(submesh.boundsMin, submesh.boundsMin + 3, 0.0f);
+        std::fill(submesh.boundsMax, submesh.boundsMax + 3, 0.0f);
+
+        for (uint32_t i = 0; i < submesh.indexCount; ++i)
+        {
+            const MeshVertex& vertex =
+                mesh.vertices[mesh.indices[submesh.firstIndex + i] +
+                              submesh.baseVertex];
+            for (unsigned axis = 0; axis < 3; ++axis)
+            {
+                const float value = vertex.position[axis];
+                submesh.boundsMin[axis] =
+                    i == 0 ? value : std::min(submesh.boundsMin[axis], value);
+                submesh.boundsMax[axis] =
+                    i == 0 ? value : std::max(submesh.boundsMax[axis], value);
+            }
+        }
+    }
+}
+
+bool writeMeshFile(const std::string& path, const CookedMesh& mesh,
+                   MeshVertexFormat format, std::string& errors)
+{
+    if (mesh.vertices.empty() || mesh.indices.empty() ||
+        mesh.submeshes.empty())
+    {
+        errors = "can't write an empty mesh to " + path;
+        return false;
+    }
+
+    MeshFileHeader header = {};
+    memcpy(header.magic, kMeshMagic, sizeof(header.magic));
+    header.version = kMeshVersion;
+    header.vertexFormat = format;
+    header.vertexStride = getMeshVertexStride(format);
+    header.vertexCount = (uint32_t)mesh.vertices.size();
+    header.indexSize = mesh.vertices.size() <= 0x10000 ? 2 : 4;
+    header.indexCount = (uint32_t)mesh.indices.size();
+    header.submeshCount = (uint32_t)mesh.submeshes.size();
+    header.meshletCount = (uint32_t)mesh.meshlets.size();
+    header.lodCount = (uint32_t)mesh.lods.size();
+
+    header.vertexOffset = alignMeshSection(sizeof(MeshFileHeader));
+    header.indexOffset = alignMeshSection(
+        header.vertexOffset +
+        (uint64_t)header.vertexCount * header.vertexStride);
+    header.submeshOffset = alignMeshSection(
+        header.indexOffset + (uint64_t)header.indexCount * header.indexSize);
+    header.meshletOffset = alignMeshSection(
+        header.submeshOffset +
+        (uint64_t)header.submeshCount * sizeof(MeshSubmesh));
+    header.lodOffset = alignMeshSection(
+        header.meshletOffset +
+        (uint64_t)header.meshletCount * sizeof(MeshMeshlet));
+    header.fileSize =
+        header.lodOffset + (uint64_t)header.lodCount * sizeof(MeshLod);
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        header.boundsMin[axis] = mesh.submeshes[0].boundsMin[axis];
+        header.boundsMax[axis] = mesh.submeshes[0].boundsMax[axis];
+        for (const MeshSubmesh& submesh : mesh.submeshes)
+        {
+            header.boundsMin[axis] =
+                std::min(header.boundsMin[axis], submesh.boundsMin[axis]);
+            header.boundsMax[axis] =
+                std::max(header.boundsMax[axis], submesh.boundsMax[axis]);
+        }
+        header.positionOffset[axis] = 0.0f;
+        header.positionScale[axis] = 1.0f;
+    }
+
+    std::vector<MeshCompactVertex> compactVertices;
+    std::vector<MeshMeshlet> meshlets = mesh.meshlets;
+    if (format == MeshVertexFormat::Compact)
+    {
+        getPositionQuantization(mesh, header.positionOffset,
+                                header.positionScale);
+        compactVertices.reserve(mesh.vertices.size());
+        for (const MeshVertex& vertex : mesh.vertices)
+        {
+            compactVertices.push_back(compressVertex(
+                vertex, header.positionOffset, header.positionScale));
+        }
+
+        // Quantized vertices can move half a step along each axis, meshlet
+        // spheres grow to still contain them
+        float error = 0.0f;
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+            const float step = header.positionScale[axis] / 65535.0f;
+            error += step * step * 0.25f;
+        }
+        for (MeshMeshlet& meshlet : meshlets)
+        {
+            meshlet.radius += std::sqrt(error);
+        }
+    }
+
+    // Written next to the destination and moved over it, so a reader never
+    // maps a partly written file
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            errors = "failed to create " + tempPath;
+            return false;
+        }
+
+        uint64_t offset = sizeof(MeshFileHeader);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        writePadding(file, offset, header.vertexOffset);
+        if (format == MeshVertexFormat::Compact)
+        {
+            file.write(reinterpret_cast<const char*>(compactVertices.data()),
+                       (std::streamsize)(compactVertices.size() *
+                                         sizeof(MeshCompactVertex)));
+        }
+        else
+        {
+            file.write(reinterpret_cast<const char*>(mesh.vertices.data()),
+                       (std::streamsize)(mesh.vertices.size() *
+                                         sizeof(MeshVertex)));
+        }
+        offset += (uint64_t)header.vertexCount * header.vertexStride;
+
+        writePadding(file, offset, header.indexOffset);
+        if (header.indexSize == 2)
+        {
+            const std::vector<uint16_t> indices(mesh.indices.begin(),
+                                                mesh.indices.end());
+            file.write(reinterpret_cast<const char*>(indices.data()),
+                       (std::streamsize)(indices.size() * sizeof(uint16_t)));
+        }
+        else
+        {
+            file.write(reinterpret_cast<const char*>(mesh.indices.data()),
+                       (std::streamsize)(mesh.indices.size() *
+                                         sizeof(uint32_t)));
+        }
+        offset += (uint64_t)header.indexCount * header.indexSize;
+
+        writePadding(file, offset, header.submeshOffset);
+        file.write(reinterpret_cast<const char*>(mesh.submeshes.data()),
+                   (std::streamsize)(mesh.submeshes.size() *
+                                     sizeof(MeshSubmesh)));
+        offset += (uint64_t)header.submeshCount * sizeof(MeshSubmesh);
+
+        writePadding(file, offset, header.meshletOffset);
+        file.write(reinterpret_cast<const char*>(meshlets.data()),
+                   (std::streamsize)(meshlets.size() * sizeof(MeshMeshlet)));
+        offset += (uint64_t)header.meshletCount * sizeof(MeshMeshlet);
+
+        writePadding(file, offset, header.lodOffset);
+        file.write(reinterpret_cast<const char*>(mesh.lods.data()),
+                   (std::streamsize)(mesh.lods.size() * sizeof(MeshLod)));
+
+        if (!file.good())
+        {
+            errors = "failed to write " + tempPath;
+            return false;
+        }
+    }
+
+    // Windows won't rename over an existing file
+    std::remove(path.c_str());
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        errors = "failed to move " + tempPath + " to " + path;
+        return false;
+    }
+    return true;
+}
+
+bool cookMesh(const std::string& sourcePath, const std::string& outputPath,
+              const MeshCookOptions& options, std::string& errors)
+{
+    CookedMesh mesh;
+    if (!loadObj(sourcePath, mesh, errors))
+    {
+        return false;
+    }
+    if (options.optimize)
+    {
+        optimizeMesh(mesh);
+    }
+    if (options.generateLods)
+    {
+        generateLods(mesh, options.optimize);
+    }
+    buildMeshlets(mesh);
+    computeSubmeshBounds(mesh);
+    return writeMeshFile(outputPath, mesh, options.vertexFormat, errors);
+}
+
+std::string getCookedMeshPath(const std::string& sourcePath)
+{
+    const size_t slash = sourcePath.find_last_of("/\\");
+    const size_t dot = sourcePath.find_last_of('.');
+    if (dot == std::string::npos ||
+        (slash != std::string::npos && dot < slash))
+    {
+        return sourcePath + ".mesh";
+    }
+    return sourcePath.substr(0, dot) + ".mesh";
+}
+
+// Compression
+
+void getPositionQuantization(const CookedMesh& mesh, float offset[3],
+                             float scale[3])
+{
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        float minimum = mesh.vertices.empty() ? 0.0f : INFINITY;
+        float maximum = mesh.vertices.empty() ? 0.0f : -INFINITY;
+        for (const MeshVertex& vertex : mesh.vertices)
+        {
+            minimum = std::min(minimum, vertex.position[axis]);
+            maximum = std::max(maximum, vertex.position[axis]);
+        }
+        offset[axis] = minimum;
+        scale[axis] = maximum - minimum;
+    }
+}
+
+MeshCompactVertex compressVertex(const MeshVertex& vertex,
+                                 const float offset[3], const float scale[3])
+{
+    MeshCompactVertex compact = {};
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        const float unit =
+            scale[axis] > 0.0f
+                ? (vertex.position[axis] - offset[axis]) / scale[axis]
+                : 0.0f;
+        compact.position[axis] = (uint16_t)quantizeUnorm(unit, 65535.0f);
+    }
+
+    // Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower
+    // half over the upper one so it fits in a square
+    const float* n = vertex.normal;
+    const float sum = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+    float x = sum > 0.0f ? n[0] / sum : 0.0f;
+    float y = sum > 0.0f ? n[1] / sum : 0.0f;
+    if (n[2] < 0.0f)
+    {
+        const float foldedX =
+            (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY =
+            (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    compact.normal[0] = (int16_t)quantizeSnorm(x, 32767.0f);
+    compact.normal[1] = (int16_t)quantizeSnorm(y, 32767.0f);
+
+    for (unsigned channel = 0; channel < 3; ++channel)
+    {
+        compact.color[channel] =
+            (uint8_t)quantizeUnorm(vertex.color[channel], 255.0f);
+    }
+    compact.color[3] = 255;
+    return compact;
+}
+
+MeshVertex decompressVertex(const MeshCompactVertex& vertex,
+                            const float offset[3], const float scale[3])
+{
+    MeshVertex decoded = {};
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        decoded.position[axis] =
+            offset[axis] +
+            (float)vertex.position[axis] / 65535.0f * scale[axis];
+    }
+
+    // Unfold the octahedron, then project back onto the sphere
+    float* n = decoded.normal;
+    n[0] = std::max((float)vertex.normal[0] / 32767.0f, -1.0f);
+    n[1] = std::max((float)vertex.normal[1] / 32767.0f, -1.0f);
+    n[2] = 1.0f - std::fabs(n[0]) - std::fabs(n[1]);
+    if (n[2] < 0.0f)
+    {
+        const float unfoldedX =
+            (1.0f - std::fabs(n[1])) * (n[0] >= 0.0f ? 1.0f : -1.0f);
+        const float unfoldedY =
+            (1.0f - std::fabs(n[0])) * (n[1] >= 0.0f ? 1.0f : -1.0f);
+        n[0] = unfoldedX;
+        n[1] = unfoldedY;
+    }
+    normalize(n);
+
+    for (unsigned channel = 0; channel < 3; ++channel)
+    {
+        decoded.color[channel] = (float)vertex.color[channel] / 255.0f;
+    }
+    return decoded;
+}
+
+bool MeshCompressionReport::isWithinBounds() const
+{
+    return positionError <= positionErrorBound &&
+           normalError <= normalErrorBound && colorError <= colorErrorBound;
+}
+
+void MeshCompressionReport::report(std::ostream& out) const
+{
+    out << "Compact vertices: max error " << positionError << " (bound "
+        << positionErrorBound << ") position, " << normalError << " (bound "
+        << normalErrorBound << ") degrees normal, " << colorError
+        << " (bound " << colorErrorBound << ") color\n";
+
+    // Each vertex and index is fetched once a draw at best, so bytes per
+    // triangle is the least bandwidth drawing the mesh takes
+    const double triangles = (double)std::max<uint64_t>(triangleCount, 1);
+    out << "  memory: " << standardBytes << " bytes as floats with 32 bit "
+        << "indices, " << compactBytes << " bytes compact ("
+        << (standardBytes > 0
+                ? 100.0 * (double)compactBytes / (double)standardBytes
+                : 0.0)
+        << "%)\n";
+    out << "  bandwidth: " << (double)standardBytes / triangles << " to "
+        << (double)compactBytes / triangles << " bytes per triangle drawn\n";
+}
+
+MeshCompressionReport measureCompression(const CookedMesh& mesh)
+{
+    MeshCompressionReport report;
+    report.vertexCount = mesh.vertices.size();
+    report.triangleCount = mesh.indices.size() / 3;
+
+    const uint64_t indexSize = mesh.vertices.size() <= 0x10000 ? 2 : 4;
+    report.standardBytes = mesh.vertices.size() * sizeof(MeshVertex) +
+                           mesh.indices.size() * sizeof(uint32_t);
+    report.compactBytes = mesh.vertices.size() * sizeof(MeshCompactVertex) +
+                          mesh.indices.size() * indexSize;
+
+    float offset[3];
+    float scale[3];
+    getPositionQuantization(mesh, offset, scale);
+
+    // Rounding to the nearest step is off by half a step at most, the slack
+    // covers float rounding while encoding and decoding
+    const float slack = 1.0f + 1e-3f;
+    report.positionErrorBound =
+        std::max(std::max(scale[0], scale[1]), scale[2]) / 65535.0f * 0.5f *
+            slack +
+        1e-7f * std::max(std::max(std::fabs(offset[0]), std::fabs(offset[1])),
+                         std::fabs(offset[2]));
+    // Octahedral 16 bit normals are within 0.004 degrees when rounded to
+    // the nearest step
+    report.normalErrorBound = 0.01f;
+    report.colorErrorBound = 0.5f / 255.0f * slack;
+
+    for (const MeshVertex& vertex : mesh.vertices)
+    {
+        const MeshVertex decoded = decompressVertex(
+            compressVertex(vertex, offset, scale), offset, scale);
+
+        // acos loses too much precision near zero, the angle is measured
+        // from both its sine and cosine in double precision instead
+        const float* a = vertex.normal;
+        const float* b = decoded.normal;
+        const double cross[3] = {
+            (double)a[1] * b[2] - (double)a[2] * b[1],
+            (double)a[2] * b[0] - (double)a[0] * b[2],
+            (double)a[0] * b[1] - (double)a[1] * b[0]};
+        const double sine = std::sqrt(cross[0] * cross[0] +
+                                      cross[1] * cross[1] +
+                                      cross[2] * cross[2]);
+        const double cosine =
+            (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+        const float degrees =
+            (float)(std::atan2(sine, cosine) * 57.29577951308232);
+
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+            report.positionError = std::max(
+                report.positionError,
+                std::fabs(decoded.position[axis] - vertex.position[axis]));
+
+            const float color =
+                std::min(std::max(vertex.color[axis], 0.0f), 1.0f);
+            report.colorError = std::max(
+                report.colorError, std::fabs(decoded.color[axis] - color));
+        }
+        report.normalError = std::max(report.normalError, degrees);
+    }
+    return report;
+}
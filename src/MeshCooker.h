@@ -0,0 +1,94 @@
+#pragma once
+
+#include "MeshFormat.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Mesh Cooker
+// Turns source meshes into cooked mesh files offline, so loading one at
+// startup is a file mapping instead of parsing text. Wavefront OBJ is read,
+// with optional vertex colors after each position. Every object, group or
+// material change starts a submesh, polygons are split into fans, and
+// vertices without a normal get the area weighted normal of their faces.
+
+struct CookedMesh
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshSubmesh> submeshes;
+    std::vector<MeshMeshlet> meshlets;
+    std::vector<MeshLod> lods;
+};
+
+// Returns false and fills in errors if the file can't be read or parsed
+bool loadObj(const std::string& path, CookedMesh& mesh, std::string& errors);
+
+// Compute the bounds of every submesh from the vertices it indexes
+void computeSubmeshBounds(CookedMesh& mesh);
+
+// Write a mesh in the cooked format, replacing the file only once it has
+// been written completely
+bool writeMeshFile(const std::string& path, const CookedMesh& mesh,
+                   MeshVertexFormat format, std::string& errors);
+
+struct MeshCookOptions
+{
+    MeshVertexFormat vertexFormat = MeshVertexFormat::Standard;
+
+    // Reorder triangles and vertices for the vertex cache, overdraw and
+    // vertex fetch, see MeshOptimizer.h
+    bool optimize = true;
+
+    // Append simplified levels of detail to every submesh, see
+    // MeshSimplifier.h
+    bool generateLods = true;
+};
+
+// Load, optimize, simplify, split into meshlets and write a source mesh
+bool cookMesh(const std::string& sourcePath, const std::string& outputPath,
+              const MeshCookOptions& options, std::string& errors);
+
+// Where a source mesh is cooked to, its path with a .mesh extension
+std::string getCookedMeshPath(const std::string& sourcePath);
+
+// Compression
+
+// Range compact positions are quantized over, it covers every vertex
+void getPositionQuantization(const CookedMesh& mesh, float offset[3],
+                             float scale[3]);
+
+MeshCompactVertex compressVertex(const MeshVertex& vertex,
+                                 const float offset[3], const float scale[3]);
+
+// What the input assembler and vertex shader read back
+MeshVertex decompressVertex(const MeshCompactVertex& vertex,
+                            const float offset[3], const float scale[3]);
+
+// How far compact vertices are from the originals, against what
+// quantization promises, and what they save
+struct MeshCompressionReport
+{
+    // Largest error of any vertex and its bound, positions per axis in model
+    // space units, normals in degrees and colors in [0, 1]
+    float positionError = 0.0f;
+    float positionErrorBound = 0.0f;
+    float normalError = 0.0f;
+    float normalErrorBound = 0.0f;
+    float colorError = 0.0f;
+    float colorErrorBound = 0.0f;
+
+    // Vertex and index bytes as floats with 32 bit indices, and compacted
+    // with the index size the mesh gets
+    uint64_t vertexCount = 0;
+    uint64_t triangleCount = 0;
+    uint64_t standardBytes = 0;
+    uint64_t compactBytes = 0;
+
+    bool isWithinBounds() const;
+
+    void report(std::ostream& out) const;
+};
+
+MeshCompressionReport measureCompression(const CookedMesh& mesh);
@@ -0,0 +1,161 @@
+#include "MeshFile.h"
+
+#include <cstring>
+#include <ostream>
+
+namespace
+{
+// A section has to start aligned and end within the file
+bool isSectionValid(const MeshFileHeader& header, uint64_t offset,
+                    uint64_t size)
+{
+    return offset % kMeshSectionAlignment == 0 &&
+           offset >= sizeof(MeshFileHeader) && offset <= header.fileSize &&
+           size <= header.fileSize - offset;
+}
+}
+
+void MeshLoadStats::report(std::ostream& out) const
+{
+    out << "Meshes: " << loads << " loaded, " << cooks << " cooked, "
+        << bytesMapped << " bytes mapped\n";
+    out << "  video memory: " << vertexBytes << " vertex bytes, "
+        << indexBytes << " index bytes\n";
+    out << "  ms: " << cookTime << " cooking, " << loadTime << " loading, "
+        << uploadTime << " uploading\n";
+}
+
+MeshFile::MeshFile() : mHeader(nullptr) {}
+
+bool MeshFile::open(const std::string& path)
+{
+    close();
+
+    if (!mFile.open(path) || mFile.size() < sizeof(MeshFileHeader))
+    {
+        close();
+        return false;
+    }
+
+    // Mappings are page aligned, so the header can be read in place
+    const MeshFileHeader& header =
+        *reinterpret_cast<const MeshFileHeader*>(mFile.data());
+    const bool valid =
+        memcmp(header.magic, kMeshMagic, sizeof(header.magic)) == 0 &&
+        header.version == kMeshVersion &&
+        (header.vertexFormat == MeshVertexFormat::Standard ||
+         header.vertexFormat == MeshVertexFormat::Compact) &&
+        header.vertexStride == getMeshVertexStride(header.vertexFormat) &&
+        (header.indexSize == 2 || header.indexSize == 4) &&
+        header.fileSize == mFile.size() &&
+        isSectionValid(header, header.vertexOffset,
+                       (uint64_t)header.vertexCount * header.vertexStride) &&
+        isSectionValid(header, header.indexOffset,
+                       (uint64_t)header.indexCount * header.indexSize) &&
+        isSectionValid(header, header.submeshOffset,
+                       (uint64_t)header.submeshCount * sizeof(MeshSubmesh)) &&
+        isSectionValid(header, header.meshletOffset,
+                       (uint64_t)header.meshletCount * sizeof(MeshMeshlet)) &&
+        isSectionValid(header, header.lodOffset,
+                       (uint64_t)header.lodCount * sizeof(MeshLod));
+    if (!valid)
+    {
+        close();
+        return false;
+    }
+    mHeader = &header;
+
+    // Indices aren't checked, they'd all have to be read, but the ranges
+    // drawn with them are
+    for (uint32_t i = 0; i < header.submeshCount; ++i)
+    {
+        const MeshSubmesh& submesh = getSubmeshes()[i];
+        if (submesh.firstIndex > header.indexCount ||
+            submesh.indexCount > header.indexCount - submesh.firstIndex ||
+            submesh.firstMeshlet > header.meshletCount ||
+            submesh.meshletCount > header.meshletCount - submesh.firstMeshlet ||
+            submesh.firstLod > header.lodCount ||
+            submesh.lodCount > header.lodCount - submesh.firstLod)
+        {
+            close();
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header.meshletCount; ++i)
+    {
+        const MeshMeshlet& meshlet = getMeshlets()[i];
+        if (meshlet.firstIndex > header.indexCount ||
+            meshlet.triangleCount >
+                (header.indexCount - meshlet.firstIndex) / 3)
+        {
+            close();
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < header.lodCount; ++i)
+    {
+        const MeshLod& lod = getLods()[i];
+        if (lod.firstIndex > header.indexCount ||
+            lod.indexCount > header.indexCount - lod.firstIndex ||
+            lod.firstMeshlet > header.meshletCount ||
+            lod.meshletCount > header.meshletCount - lod.firstMeshlet)
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void MeshFile::close()
+{
+    mFile.close();
+    mHeader = nullptr;
+}
+
+bool MeshFile::isOpen() const { return mHeader != nullptr; }
+
+const MeshFileHeader& MeshFile::getHeader() const { return *mHeader; }
+
+const void* MeshFile::getVertexData() const
+{
+    return mFile.data() + mHeader->vertexOffset;
+}
+
+size_t MeshFile::getVertexDataSize() const
+{
+    return (size_t)mHeader->vertexCount * mHeader->vertexStride;
+}
+
+const void* MeshFile::getIndexData() const
+{
+    return mFile.data() + mHeader->indexOffset;
+}
+
+size_t MeshFile::getIndexDataSize() const
+{
+    return (size_t)mHeader->indexCount * mHeader->indexSize;
+}
+
+const MeshSubmesh* MeshFile::getSubmeshes() const
+{
+    return reinterpret_cast<const MeshSubmesh*>(mFile.data() +
+                                                mHeader->submeshOffset);
+}
+
+uint32_t MeshFile::getSubmeshCount() const { return mHeader->submeshCount; }
+
+const MeshMeshlet* MeshFile::getMeshlets() const
+{
+    return reinterpret_cast<const MeshMeshlet*>(mFile.data() +
+                                                mHeader->meshletOffset);
+}
+
+uint32_t MeshFile::getMeshletCount() const { return mHeader->meshletCount; }
+
+const MeshLod* MeshFile::getLods() const
+{
+    return reinterpret_cast<const MeshLod*>(mFile.data() + mHeader->lodOffset);
+}
+
+uint32_t MeshFile::getLodCount() const { return mHeader->lodCount; }
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "MeshFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Mesh File
+// Maps a cooked mesh file and hands out views of its sections in place. Only
+// the header, submesh, meshlet and level of detail tables are checked when
+// the file is opened, vertices and indices aren't touched until they're read,
+// so most of a large mesh goes from the file cache to the upload path
+// without an intermediate copy.
+
+struct MeshLoadStats
+{
+    // Meshes cooked because no up to date cooked file existed
+    uint64_t cooks = 0;
+    uint64_t loads = 0;
+    uint64_t bytesMapped = 0;
+
+    // Video memory the uploaded vertices and indices take
+    uint64_t vertexBytes = 0;
+    uint64_t indexBytes = 0;
+
+    // Time spent cooking, mapping and uploading meshes, in milliseconds
+    double cookTime = 0.0;
+    double loadTime = 0.0;
+    double uploadTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+class MeshFile
+{
+  public:
+    MeshFile();
+
+    // Returns false if the file is missing, truncated or from another version
+    // of the format, the caller can cook it again
+    bool open(const std::string& path);
+
+    void close();
+
+    bool isOpen() const;
+
+    const MeshFileHeader& getHeader() const;
+
+    const void* getVertexData() const;
+
+    size_t getVertexDataSize() const;
+
+    const void* getIndexData() const;
+
+    size_t getIndexDataSize() const;
+
+    const MeshSubmesh* getSubmeshes() const;
+
+    uint32_t getSubmeshCount() const;
+
+    const MeshMeshlet* getMeshlets() const;
+
+    uint32_t getMeshletCount() const;
+
+    const MeshLod* getLods() const;
+
+    uint32_t getLodCount() const;
+
+  protected:
+    MappedFile mFile;
+    const MeshFileHeader* mHeader;
+};
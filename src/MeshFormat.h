@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Mesh Format
+// Layout of cooked mesh files. A file is a header followed by its vertex,
+// index, submesh, meshlet and level of detail sections, each starting on a
+// kMeshSectionAlignment boundary, so once the file is mapped every section
+// can be used in place and handed to the upload path without being copied
+// or parsed. Every field is little endian. Files of any other version are
+// cooked again.
+
+const char kMeshMagic[4] = {'X', 'M', 'S', 'H'};
+const uint32_t kMeshVersion = 5;
+const uint64_t kMeshSectionAlignment = 64;
+
+// Meshlets have at most this many unique vertices and triangles, what mesh
+// shaders are commonly limited to
+const uint32_t kMaxMeshletVertices = 64;
+const uint32_t kMaxMeshletTriangles = 124;
+
+enum class MeshVertexFormat : uint32_t
+{
+    // MeshVertex, full precision floats
+    Standard = 0,
+
+    // MeshCompactVertex, quantized to 16 bytes
+    Compact = 1
+};
+
+// MeshVertexFormat::Standard
+struct MeshVertex
+{
+    float position[3];
+    float normal[3];
+    float color[3];
+};
+
+// MeshVertexFormat::Compact
+struct MeshCompactVertex
+{
+    // R16G16B16A16_UNORM, relative to the header's position offset and
+    // scale, w is unused
+    uint16_t position[4];
+
+    // R16G16_SNORM, unit normal folded onto an octahedron
+    int16_t normal[2];
+
+    // R8G8B8A8_UNORM, alpha is always opaque
+    uint8_t color[4];
+};
+
+// A range of the index buffer drawn on its own, with its bounds in model
+// space
+struct MeshSubmesh
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t baseVertex;
+
+    // Meshlets covering the submesh's indices in order
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+
+    // Simplified levels of detail, from finest to coarsest, the submesh
+    // itself is the full detail one
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t reserved;
+
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// A cluster of a submesh's triangles that's culled as a whole, with bounds
+// in model space
+struct MeshMeshlet
+{
+    // Triangles are a range of the index buffer, drawn with the base vertex
+    // of their submesh
+    uint32_t firstIndex;
+    uint32_t triangleCount;
+    uint32_t vertexCount;
+    uint32_t reserved;
+
+    // Bounding sphere of its vertices
+    float center[3];
+    float radius;
+
+    // Every triangle faces away from a camera at position p when
+    // dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius,
+    // a cutoff of 1 or more means it can't be culled that way
+    float coneAxis[3];
+    float coneCutoff;
+};
+
+// A simplified copy of a submesh, drawn with the same vertices and base
+// vertex
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+
+    // How far the simplified surface is from the full detail one, in model
+    // space units, it only grows from one level to the next
+    float error;
+    uint32_t reserved[3];
+};
+
+struct MeshFileHeader
+{
+    char magic[4];
+    uint32_t version;
+
+    MeshVertexFormat vertexFormat;
+    uint32_t vertexStride;
+    uint32_t vertexCount;
+
+    // 2 or 4 bytes, 16 bit indices are used whenever they can address every
+    // vertex
+    uint32_t indexSize;
+    uint32_t indexCount;
+    uint32_t submeshCount;
+    uint32_t meshletCount;
+    uint32_t lodCount;
+
+    // Byte offsets from the start of the file
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t submeshOffset;
+    uint64_t meshletOffset;
+    uint64_t lodOffset;
+    uint64_t fileSize;
+
+    // Bounds of every submesh together
+    float boundsMin[3];
+    float boundsMax[3];
+
+    // Model space position = offset + stored position * scale, which is
+    // zero and one for full precision vertices
+    float positionOffset[3];
+    float positionScale[3];
+};
+
+static_assert(sizeof(MeshVertex) == 36, "MeshVertex has padding");
+static_assert(sizeof(MeshCompactVertex) == 16,
+              "MeshCompactVertex has padding");
+static_assert(sizeof(MeshSubmesh) == 56, "MeshSubmesh has padding");
+static_assert(sizeof(MeshMeshlet) == 48, "MeshMeshlet has padding");
+static_assert(sizeof(MeshLod) == 32, "MeshLod has padding");
+static_assert(sizeof(MeshFileHeader) == 136, "MeshFileHeader has padding");
+
+inline uint32_t getMeshVertexStride(MeshVertexFormat format)
+{
+    return format == MeshVertexFormat::Compact ? sizeof(MeshCompactVertex)
+                                               : sizeof(MeshVertex);
+}
+
+inline uint64_t alignMeshSection(uint64_t offset)
+{
+    return (offset + kMeshSectionAlignment - 1) & ~(kMeshSectionAlignment - 1);
+}
@@ -0,0 +1,549 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <ostream>
+#include <vector>
+
+namespace
+{
+// Forsyth's scoring, tuned for a 32 entry LRU cache. Vertices score higher
+// the more recently they were used and the fewer triangles they have left,
+// so the order finishes off vertices before moving on.
+const unsigned kScoreCacheSize = 32;
+const float kCacheDecayPower = 1.5f;
+const float kLastTriangleScore = 0.75f;
+const float kValenceBoostScale = 2.0f;
+const float kValenceBoostPower = 0.5f;
+const unsigned kValenceTableSize = 32;
+
+// Lines of the simulated vertex fetch cache, 16 KB of them
+const size_t kFetchLineSize = 64;
+const unsigned kFetchCacheLines = 256;
+
+struct ScoreTables
+{
+    float cache[kScoreCacheSize];
+    float valence[kValenceTableSize];
+
+    ScoreTables()
+    {
+        for (unsigned i = 0; i < kScoreCacheSize; ++i)
+        {
+            // The last triangle's vertices score the same whatever order
+            // they went in
+            cache[i] = i < 3 ? kLastTriangleScore
+                             : std::pow(1.0f - (float)(i - 3) /
+                                                   (kScoreCacheSize - 3),
+                                        kCacheDecayPower);
+        }
+        valence[0] = 0.0f;
+        for (unsigned i = 1; i < kValenceTableSize; ++i)
+        {
+            valence[i] =
+                kValenceBoostScale * std::pow((float)i, -kValenceBoostPower);
+        }
+    }
+};
+
+float getVertexScore(const ScoreTables& tables, int cachePosition,
+                     uint32_t remaining)
+{
+    // Vertices with nothing left to draw never attract triangles
+    if (remaining == 0)
+    {
+        return -1.0f;
+    }
+
+    const float cacheScore = cachePosition >= 0 ? tables.cache[cachePosition]
+                                                : 0.0f;
+    const float valenceScore =
+        remaining < kValenceTableSize
+            ? tables.valence[remaining]
+            : kValenceBoostScale *
+                  std::pow((float)remaining, -kValenceBoostPower);
+    return cacheScore + valenceScore;
+}
+
+// Renumber the vertices an index range uses from zero, so the per vertex
+// state of one submesh doesn't scale with the whole mesh. Returns how many
+// vertices it uses, and fills in their original indices.
+size_t remapToLocal(const uint32_t* indices, size_t indexCount,
+                    std::vector<uint32_t>& local,
+                    std::vector<uint32_t>& original)
+{
+    original.assign(indices, indices + indexCount);
+    std::sort(original.begin(), original.end());
+    original.erase(std::unique(original.begin(), original.end()),
+                   original.end());
+
+    local.resize(indexCount);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        local[i] = (uint32_t)(std::lower_bound(original.begin(),
+                                               original.end(), indices[i]) -
+                              original.begin());
+    }
+    return original.size();
+}
+
+// Split triangles into clusters that each stay within the threshold of the
+// whole range's ACMR even when they start with a cold cache, so they can be
+// put in any order without costing much vertex cache efficiency. Returns
+// the first triangle of every cluster.
+std::vector<uint32_t> findClusters(const std::vector<uint32_t>& local,
+                                   size_t vertexCount, unsigned cacheSize,
+                                   float threshold)
+{
+    const size_t triangleCount = local.size() / 3;
+    const double target =
+        threshold * analyzeVertexCache(local.data(), local.size(),
+                                       vertexCount, cacheSize)
+                        .acmr;
+
+    std::vector<uint32_t> starts(1, 0);
+    std::vector<uint32_t> insertTime(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    uint32_t misses = 0;
+    for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t vertex = local[triangle * 3 + corner];
+            if (time - insertTime[vertex] > cacheSize)
+            {
+                insertTime[vertex] = time++;
+                misses++;
+            }
+        }
+
+        // Skipping time ahead empties the cache for the next cluster
+        const size_t clusterSize = triangle + 1 - starts.back();
+        if ((double)misses <= target * (double)clusterSize &&
+            triangle + 1 < triangleCount)
+        {
+            starts.push_back((uint32_t)(triangle + 1));
+            misses = 0;
+            time += cacheSize + 1;
+        }
+    }
+    return starts;
+}
+
+void addCross(const float* p0, const float* p1, const float* p2,
+              double normal[3])
+{
+    const double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    const double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    normal[0] += e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] += e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] += e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+double getLength(const double vector[3])
+{
+    return std::sqrt(vector[0] * vector[0] + vector[1] * vector[1] +
+                     vector[2] * vector[2]);
+}
+}
+
+void MeshOptimizeReport::report(std::ostream& out) const
+{
+    out << "Mesh optimization: " << optimizeTime << " ms, overdraw order kept"
+        << " for " << overdrawOrdered << " of " << submeshes
+        << " submeshes\n";
+    out << "  FIFO " << kSimulatedCacheSize << " vertex cache: ACMR "
+        << cacheBefore.acmr << " -> " << cacheAfter.acmr << ", ATVR "
+        << cacheBefore.atvr << " -> " << cacheAfter.atvr << "\n";
+    out << "  vertex fetch: overfetch " << fetchBefore.overfetch << " -> "
+        << fetchAfter.overfetch << ", " << fetchBefore.bytesFetched << " -> "
+        << fetchAfter.bytesFetched << " bytes\n";
+}
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount,
+                                    size_t vertexCount, unsigned cacheSize)
+{
+    VertexCacheStats stats;
+    stats.triangles = indexCount / 3;
+
+    // A vertex is still cached while fewer than cacheSize vertices were
+    // inserted after it
+    std::vector<uint32_t> insertTime(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    uint32_t time = cacheSize + 1;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const uint32_t vertex = indices[i];
+        if (time - insertTime[vertex] > cacheSize)
+        {
+            insertTime[vertex] = time++;
+            stats.misses++;
+        }
+        if (!used[vertex])
+        {
+            used[vertex] = true;
+            stats.vertices++;
+        }
+    }
+
+    stats.acmr = stats.triangles > 0
+                     ? (double)stats.misses / (double)stats.triangles
+                     : 0.0;
+    stats.atvr = stats.vertices > 0
+                     ? (double)stats.misses / (double)stats.vertices
+                     : 0.0;
+    return stats;
+}
+
+VertexFetchStats analyzeVertexFetch(const uint32_t* indices, size_t indexCount,
+                                    size_t vertexCount, size_t vertexSize)
+{
+    VertexFetchStats stats;
+
+    const size_t lineCount =
+        (vertexCount * vertexSize + kFetchLineSize - 1) / kFetchLineSize;
+    std::vector<uint32_t> insertTime(lineCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    uint64_t usedBytes = 0;
+    uint32_t time = kFetchCacheLines + 1;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        const uint32_t vertex = indices[i];
+        if (!used[vertex])
+        {
+            used[vertex] = true;
+            usedBytes += vertexSize;
+        }
+
+        // Vertices can straddle lines
+        const size_t firstLine = vertex * vertexSize / kFetchLineSize;
+        const size_t lastLine =
+            (vertex * vertexSize + vertexSize - 1) / kFetchLineSize;
+        for (size_t line = firstLine; line <= lastLine; ++line)
+        {
+            if (time - insertTime[line] > kFetchCacheLines)
+            {
+                insertTime[line] = time++;
+                stats.bytesFetched += kFetchLineSize;
+            }
+        }
+    }
+
+    stats.overfetch =
+        usedBytes > 0 ? (double)stats.bytesFetched / (double)usedBytes : 0.0;
+    return stats;
+}
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount)
+{
+    static const ScoreTables tables;
+
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> local;
+    std::vector<uint32_t> original;
+    const size_t localCount =
+        remapToLocal(indices, indexCount, local, original);
+
+    // Triangles using each vertex, the live ones first, and how many are
+    // live
+    std::vector<uint32_t> remaining(localCount, 0);
+    for (uint32_t vertex : local)
+    {
+        remaining[vertex]++;
+    }
+    std::vector<uint32_t> offsets(localCount + 1, 0);
+    std::partial_sum(remaining.begin(), remaining.end(), offsets.begin() + 1);
+    std::vector<uint32_t> adjacency(indexCount);
+    {
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            adjacency[cursor[local[i]]++] = (uint32_t)(i / 3);
+        }
+    }
+
+    std::vector<int> cachePosition(localCount, -1);
+    std::vector<float> vertexScore(localCount);
+    for (size_t vertex = 0; vertex < localCount; ++vertex)
+    {
+        vertexScore[vertex] = getVertexScore(tables, -1, remaining[vertex]);
+    }
+
+    // Start from the best triangle of all, after that only triangles of
+    // cached vertices are candidates
+    int64_t best = -1;
+    float bestScore = -1.0f;
+    for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+    {
+        const float score = vertexScore[local[triangle * 3]] +
+                            vertexScore[local[triangle * 3 + 1]] +
+                            vertexScore[local[triangle * 3 + 2]];
+        if (score > bestScore)
+        {
+            best = (int64_t)triangle;
+            bestScore = score;
+        }
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> output(indexCount);
+    std::vector<uint32_t> cache;
+    std::vector<uint32_t> nextCache;
+    size_t nextUnemitted = 0;
+    for (size_t written = 0; written < triangleCount; ++written)
+    {
+        // Nothing cached has triangles left, carry on from the first
+        // triangle not drawn yet
+        if (best < 0)
+        {
+            while (emitted[nextUnemitted])
+            {
+                ++nextUnemitted;
+            }
+            best = (int64_t)nextUnemitted;
+        }
+
+        const size_t triangle = (size_t)best;
+        emitted[triangle] = true;
+        nextCache.clear();
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+            output[written * 3 + corner] =
+                original[local[triangle * 3 + corner]];
+
+            // Degenerate triangles use a vertex twice, it's cached once
+            const uint32_t vertex = local[triangle * 3 + corner];
+            if (std::find(nextCache.begin(), nextCache.end(), vertex) ==
+                nextCache.end())
+            {
+                nextCache.push_back(vertex);
+            }
+
+            // Swap the triangle out of the vertex's live ones
+            uint32_t* live = &adjacency[offsets[vertex]];
+            const uint32_t last = --remaining[vertex];
+            for (uint32_t i = 0; i <= last; ++i)
+            {
+                if (live[i] == triangle)
+                {
+                    std::swap(live[i], live[last]);
+                    break;
+                }
+            }
+        }
+
+        // The triangle's vertices move to the front, LRU style
+        for (uint32_t vertex : cache)
+        {
+            if (std::find(nextCache.begin(), nextCache.end(), vertex) ==
+                nextCache.end())
+            {
+                nextCache.push_back(vertex);
+            }
+        }
+
+        for (size_t i = 0; i < nextCache.size(); ++i)
+        {
+            const uint32_t vertex = nextCache[i];
+            cachePosition[vertex] = i < kScoreCacheSize ? (int)i : -1;
+            vertexScore[vertex] = getVertexScore(tables, cachePosition[vertex],
+                                                 remaining[vertex]);
+        }
+        if (nextCache.size() > kScoreCacheSize)
+        {
+            nextCache.resize(kScoreCacheSize);
+        }
+        cache.swap(nextCache);
+
+        best = -1;
+        bestScore = -1.0f;
+        for (uint32_t vertex : cache)
+        {
+            const uint32_t* live = &adjacency[offsets[vertex]];
+            for (uint32_t i = 0; i < remaining[vertex]; ++i)
+            {
+                const size_t candidate = live[i];
+                const float score = vertexScore[local[candidate * 3]] +
+                                    vertexScore[local[candidate * 3 + 1]] +
+                                    vertexScore[local[candidate * 3 + 2]];
+                if (score > bestScore)
+                {
+                    best = (int64_t)candidate;
+                    bestScore = score;
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices);
+}
+
+bool optimizeOverdraw(uint32_t* indices, size_t indexCount,
+                      const MeshVertex* vertices, float threshold)
+{
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> local;
+    std::vector<uint32_t> original;
+    const size_t localCount =
+        remapToLocal(indices, indexCount, local, original);
+
+    std::vector<uint32_t> clusterStarts =
+        findClusters(local, localCount, kSimulatedCacheSize, threshold);
+    const size_t clusterCount = clusterStarts.size();
+    if (clusterCount < 2)
+    {
+        return false;
+    }
+    clusterStarts.push_back((uint32_t)triangleCount);
+
+    // Area weighted centroids and normals, the cross product's length is
+    // twice the triangle's area
+    std::vector<double> centroids(clusterCount * 3, 0.0);
+    std::vector<double> normals(clusterCount * 3, 0.0);
+    std::vector<double> areas(clusterCount, 0.0);
+    double meshCentroid[3] = {0.0, 0.0, 0.0};
+    double meshArea = 0.0;
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        for (uint32_t triangle = clusterStarts[cluster];
+             triangle < clusterStarts[cluster + 1]; ++triangle)
+        {
+            const float* p0 = vertices[indices[triangle * 3]].position;
+            const float* p1 = vertices[indices[triangle * 3 + 1]].position;
+            const float* p2 = vertices[indices[triangle * 3 + 2]].position;
+
+            double normal[3] = {0.0, 0.0, 0.0};
+            addCross(p0, p1, p2, normal);
+            const double area = getLength(normal);
+            for (unsigned axis = 0; axis < 3; ++axis)
+            {
+                const double center =
+                    ((double)p0[axis] + p1[axis] + p2[axis]) / 3.0;
+                centroids[cluster * 3 + axis] += center * area;
+                normals[cluster * 3 + axis] += normal[axis];
+                meshCentroid[axis] += center * area;
+            }
+            areas[cluster] += area;
+            meshArea += area;
+        }
+    }
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        meshCentroid[axis] /= std::max(meshArea, 1e-30);
+    }
+
+    // Clusters facing away from the middle of the mesh are in front of the
+    // rest from most directions they can be seen from
+    std::vector<double> keys(clusterCount, 0.0);
+    for (size_t cluster = 0; cluster < clusterCount; ++cluster)
+    {
+        const double* normal = &normals[cluster * 3];
+        const double length = getLength(normal);
+        if (length <= 0.0 || areas[cluster] <= 0.0)
+        {
+            continue;
+        }
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+            const double centroid =
+                centroids[cluster * 3 + axis] / areas[cluster];
+            keys[cluster] +=
+                (centroid - meshCentroid[axis]) * normal[axis] / length;
+        }
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> sorted;
+    std::vector<uint32_t> sortedLocal;
+    sorted.reserve(indexCount);
+    sortedLocal.reserve(indexCount);
+    for (uint32_t cluster : order)
+    {
+        sorted.insert(sorted.end(), indices + clusterStarts[cluster] * 3,
+                      indices + clusterStarts[cluster + 1] * 3);
+        sortedLocal.insert(sortedLocal.end(),
+                           local.begin() + clusterStarts[cluster] * 3,
+                           local.begin() + clusterStarts[cluster + 1] * 3);
+    }
+
+    const VertexCacheStats before = analyzeVertexCache(
+        local.data(), local.size(), localCount, kSimulatedCacheSize);
+    const VertexCacheStats after = analyzeVertexCache(
+        sortedLocal.data(), sortedLocal.size(), localCount,
+        kSimulatedCacheSize);
+    if (after.acmr > before.acmr * threshold)
+    {
+        return false;
+    }
+
+    std::copy(sorted.begin(), sorted.end(), indices);
+    return true;
+}
+
+void optimizeVertexFetch(CookedMesh& mesh)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t& index : mesh.indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = (uint32_t)vertices.size();
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+MeshOptimizeReport optimizeMesh(CookedMesh& mesh)
+{
+    const auto start = std::chrono::steady_clock::now();
+    MeshOptimizeReport report;
+    report.submeshes = (uint32_t)mesh.submeshes.size();
+    report.cacheBefore =
+        analyzeVertexCache(mesh.indices.data(), mesh.indices.size(),
+                           mesh.vertices.size(), kSimulatedCacheSize);
+    report.fetchBefore =
+        analyzeVertexFetch(mesh.indices.data(), mesh.indices.size(),
+                           mesh.vertices.size(), sizeof(MeshVertex));
+
+    for (const MeshSubmesh& submesh : mesh.submeshes)
+    {
+        uint32_t* indices = &mesh.indices[submesh.firstIndex];
+        optimizeVertexCache(indices, submesh.indexCount);
+        if (optimizeOverdraw(indices, submesh.indexCount, mesh.vertices.data()))
+        {
+            report.overdrawOrdered++;
+        }
+    }
+    optimizeVertexFetch(mesh);
+
+    report.cacheAfter =
+        analyzeVertexCache(mesh.indices.data(), mesh.indices.size(),
+                           mesh.vertices.size(), kSimulatedCacheSize);
+    report.fetchAfter =
+        analyzeVertexFetch(mesh.indices.data(), mesh.indices.size(),
+                           mesh.vertices.size(), sizeof(MeshVertex));
+    report.optimizeTime = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+    return report;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "MeshCooker.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+// Mesh Optimizer
+// Reorders cooked meshes for the GPU without changing what they look like.
+// Triangles of each submesh are ordered for the post-transform vertex cache
+// with Forsyth's algorithm, then split into clusters that keep most of that
+// efficiency on their own, which are sorted so outward facing ones come
+// first to lower overdraw from most directions. Vertices are last reordered
+// by first use, so fetching them walks memory forward.
+
+// Post-transform cache behaviour of an index buffer, from a simulated FIFO
+// cache of a given size
+struct VertexCacheStats
+{
+    uint64_t triangles = 0;
+    uint64_t vertices = 0;
+    uint64_t misses = 0;
+
+    // Average cache miss ratio, vertices shaded per triangle, which is 0.5
+    // at best for a regular grid and 3 at worst
+    double acmr = 0.0;
+
+    // Average transform to vertex ratio, vertices shaded per vertex, which
+    // is 1 at best
+    double atvr = 0.0;
+};
+
+// Vertex fetch behaviour of an index buffer, from a simulated cache of 64
+// byte lines
+struct VertexFetchStats
+{
+    uint64_t bytesFetched = 0;
+
+    // Bytes fetched over the bytes of every vertex used, 1 at best
+    double overfetch = 0.0;
+};
+
+struct MeshOptimizeReport
+{
+    VertexCacheStats cacheBefore;
+    VertexCacheStats cacheAfter;
+    VertexFetchStats fetchBefore;
+    VertexFetchStats fetchAfter;
+
+    // Submeshes whose overdraw ordering was kept, the rest cost too much
+    // cache efficiency
+    uint32_t overdrawOrdered = 0;
+    uint32_t submeshes = 0;
+
+    double optimizeTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+// The cache size reports are simulated with, common to most GPUs
+const unsigned kSimulatedCacheSize = 16;
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount,
+                                    size_t vertexCount, unsigned cacheSize);
+
+VertexFetchStats analyzeVertexFetch(const uint32_t* indices, size_t indexCount,
+                                    size_t vertexCount, size_t vertexSize);
+
+// Reorder the triangles of an index range for the vertex cache
+void optimizeVertexCache(uint32_t* indices, size_t indexCount);
+
+// Sort clusters of triangles outward facing first, keeping the original
+// order if the ACMR grows by more than the threshold. Returns whether the
+// new order was kept.
+bool optimizeOverdraw(uint32_t* indices, size_t indexCount,
+                      const MeshVertex* vertices, float threshold = 1.05f);
+
+// Reorder vertices by first use and drop unused ones
+void optimizeVertexFetch(CookedMesh& mesh);
+
+// Every stage, submesh by submesh
+MeshOptimizeReport optimizeMesh(CookedMesh& mesh);
@@ -0,0 +1,409 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <ostream>
+
+namespace
+{
+// Sum of area * (dot(n, p) + d)^2 over a vertex's triangle planes, and the
+// area it was weighted by
+struct Quadric
+{
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+};
+
+struct Collapse
+{
+    uint32_t from;
+    uint32_t to;
+    double cost;
+};
+
+void addPlane(Quadric& q, const double n[3], double d, double weight)
+{
+    q.a00 += weight * n[0] * n[0];
+    q.a01 += weight * n[0] * n[1];
+    q.a02 += weight * n[0] * n[2];
+    q.a11 += weight * n[1] * n[1];
+    q.a12 += weight * n[1] * n[2];
+    q.a22 += weight * n[2] * n[2];
+    q.b0 += weight * n[0] * d;
+    q.b1 += weight * n[1] * d;
+    q.b2 += weight * n[2] * d;
+    q.c += weight * d * d;
+    q.weight += weight;
+}
+
+void addQuadric(Quadric& q, const Quadric& other)
+{
+    q.a00 += other.a00;
+    q.a01 += other.a01;
+    q.a02 += other.a02;
+    q.a11 += other.a11;
+    q.a12 += other.a12;
+    q.a22 += other.a22;
+    q.b0 += other.b0;
+    q.b1 += other.b1;
+    q.b2 += other.b2;
+    q.c += other.c;
+    q.weight += other.weight;
+}
+
+// Mean squared distance of a position from the quadric's planes
+double evaluate(const Quadric& q, const float* p)
+{
+    const double x = p[0], y = p[1], z = p[2];
+    const double value =
+        q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+        2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+        2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+    return q.weight > 0.0 ? std::max(value, 0.0) / q.weight : 0.0;
+}
+
+void getNormal(const float* p0, const float* p1, const float* p2,
+               double normal[3])
+{
+    const double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+    const double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+    normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+}
+
+void MeshLodReport::report(std::ostream& out) const
+{
+    out << "Levels of detail: " << triangles.size() << " levels over "
+        << submeshes << " submeshes built in " << buildTime << " ms\n";
+    for (size_t level = 0; level < triangles.size(); ++level)
+    {
+        out << "  level " << level << ": " << triangles[level]
+            << " triangles ("
+            << (triangles[0] > 0 ? 100.0 * (double)triangles[level] /
+                                       (double)triangles[0]
+                                 : 0.0)
+            << "%), error " << errors[level] << "\n";
+    }
+}
+
+std::vector<uint32_t> simplifyIndices(const CookedMesh& mesh,
+                                      int32_t baseVertex,
+                                      const uint32_t* indices,
+                                      size_t indexCount,
+                                      size_t targetIndexCount, float& error)
+{
+    error = 0.0f;
+
+    // Vertices are numbered from zero, so per vertex state doesn't scale
+    // with the whole mesh
+    std::vector<uint32_t> original(indices, indices + indexCount);
+    std::sort(original.begin(), original.end());
+    original.erase(std::unique(original.begin(), original.end()),
+                   original.end());
+    const size_t vertexCount = original.size();
+    std::vector<uint32_t> current(indexCount);
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        current[i] = (uint32_t)(std::lower_bound(original.begin(),
+                                                 original.end(), indices[i]) -
+                                original.begin());
+    }
+    auto getPosition = [&](uint32_t vertex) {
+        return mesh.vertices[original[vertex] + baseVertex].position;
+    };
+
+    // Vertices sharing a position but not their attributes sit on a seam,
+    // collapsing them would tear it open
+    std::vector<uint8_t> seam(vertexCount, 0);
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return memcmp(getPosition(a), getPosition(b), sizeof(float) * 3) < 0;
+    });
+    for (size_t i = 1; i < vertexCount; ++i)
+    {
+        if (memcmp(getPosition(order[i - 1]), getPosition(order[i]),
+                   sizeof(float) * 3) == 0)
+        {
+            seam[order[i - 1]] = seam[order[i]] = 1;
+        }
+    }
+
+    // Edges of anything but two triangles are on a border or non-manifold
+    std::vector<uint8_t> locked = seam;
+    std::vector<uint64_t> edges;
+    edges.reserve(indexCount);
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+            const uint32_t a = current[i + corner];
+            const uint32_t b = current[i + (corner + 1) % 3];
+            edges.push_back(((uint64_t)std::min(a, b) << 32) |
+                            std::max(a, b));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();)
+    {
+        size_t end = i + 1;
+        while (end < edges.size() && edges[end] == edges[i])
+        {
+            ++end;
+        }
+        if (end - i != 2)
+        {
+            locked[(uint32_t)(edges[i] >> 32)] = 1;
+            locked[(uint32_t)edges[i]] = 1;
+        }
+        i = end;
+    }
+
+    std::vector<Quadric> quadrics(vertexCount, Quadric());
+    for (size_t i = 0; i < indexCount; i += 3)
+    {
+        const float* p0 = getPosition(current[i]);
+        double normal[3];
+        getNormal(p0, getPosition(current[i + 1]), getPosition(current[i + 2]),
+                  normal);
+        const double length = std::sqrt(normal[0] * normal[0] +
+                                        normal[1] * normal[1] +
+                                        normal[2] * normal[2]);
+        if (length == 0.0)
+        {
+            continue;
+        }
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            normal[c] /= length;
+        }
+        const double d =
+            -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+            addPlane(quadrics[current[i + corner]], normal, d, length * 0.5);
+        }
+    }
+
+    // Each pass collapses the cheapest edges whose triangles no other
+    // collapse of the pass touches, then rewrites the indices
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    double maxCost = 0.0;
+    while (current.size() > targetIndexCount)
+    {
+        const size_t triangleCount = current.size() / 3;
+
+        // Triangles around each vertex
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (uint32_t vertex : current)
+        {
+            adjacencyOffsets[vertex + 1]++;
+        }
+        std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(),
+                         adjacencyOffsets.begin());
+        adjacency.resize(current.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(),
+                                   adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < current.size(); ++i)
+        {
+            adjacency[fill[current[i]]++] = (uint32_t)(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            for (unsigned corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t from = current[i + corner];
+                if (locked[from])
+                {
+                    continue;
+                }
+                for (unsigned other = 1; other < 3; ++other)
+                {
+                    const uint32_t to = current[i + (corner + other) % 3];
+                    if (to == from || seam[to])
+                    {
+                        continue;
+                    }
+                    Quadric merged = quadrics[from];
+                    addQuadric(merged, quadrics[to]);
+                    collapses.push_back(
+                        {from, to, evaluate(merged, getPosition(to))});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse& a, const Collapse& b) {
+                      return a.cost < b.cost;
+                  });
+
+        // A collapse removes about two triangles
+        const size_t budget =
+            std::max<size_t>((triangleCount - targetIndexCount / 3) / 2, 1);
+        std::iota(remap.begin(), remap.end(), 0);
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t collapsed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapsed >= budget)
+            {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to])
+            {
+                continue;
+            }
+
+            // Triangles keeping both ends vanish, the rest move a corner
+            // to the new position and mustn't turn over
+            bool flips = false;
+            for (uint32_t a = adjacencyOffsets[collapse.from];
+                 a < adjacencyOffsets[collapse.from + 1] && !flips; ++a)
+            {
+                const uint32_t* triangle = &current[adjacency[a] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+                    triangle[2] == collapse.to)
+                {
+                    continue;
+                }
+                const float* corners[3];
+                const float* moved[3];
+                for (unsigned corner = 0; corner < 3; ++corner)
+                {
+                    corners[corner] = getPosition(triangle[corner]);
+                    moved[corner] = triangle[corner] == collapse.from
+                                        ? getPosition(collapse.to)
+                                        : corners[corner];
+                }
+                double before[3], after[3];
+                getNormal(corners[0], corners[1], corners[2], before);
+                getNormal(moved[0], moved[1], moved[2], after);
+                flips = before[0] * after[0] + before[1] * after[1] +
+                            before[2] * after[2] <=
+                        0.0;
+            }
+            if (flips)
+            {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            maxCost = std::max(maxCost, collapse.cost);
+            for (uint32_t a = adjacencyOffsets[collapse.from];
+                 a < adjacencyOffsets[collapse.from + 1]; ++a)
+            {
+                const uint32_t* triangle = &current[adjacency[a] * 3];
+                touched[triangle[0]] = touched[triangle[1]] =
+                    touched[triangle[2]] = 1;
+            }
+            collapsed++;
+        }
+        if (collapsed == 0)
+        {
+            break;
+        }
+
+        size_t written = 0;
+        for (size_t i = 0; i < current.size(); i += 3)
+        {
+            const uint32_t a = remap[current[i]];
+            const uint32_t b = remap[current[i + 1]];
+            const uint32_t c = remap[current[i + 2]];
+            if (a != b && b != c && a != c)
+            {
+                current[written++] = a;
+                current[written++] = b;
+                current[written++] = c;
+            }
+        }
+        current.resize(written);
+    }
+
+    error = (float)std::sqrt(maxCost);
+    for (uint32_t& index : current)
+    {
+        index = original[index];
+    }
+    return current;
+}
+
+MeshLodReport generateLods(CookedMesh& mesh, bool optimize)
+{
+    const auto start = std::chrono::steady_clock::now();
+    MeshLodReport report;
+    report.submeshes = (uint32_t)mesh.submeshes.size();
+    report.triangles.push_back(0);
+    report.errors.push_back(0.0f);
+    mesh.lods.clear();
+
+    for (MeshSubmesh& submesh : mesh.submeshes)
+    {
+        report.triangles[0] += submesh.indexCount / 3;
+        submesh.firstLod = (uint32_t)mesh.lods.size();
+
+        // Every level halves the triangles of the one before it, and is
+        // simplified from it so each level costs half as much as the last.
+        // The surface moves at most the sum of the errors on the way.
+        uint32_t previousFirst = submesh.firstIndex;
+        size_t previousCount = submesh.indexCount;
+        float previousError = 0.0f;
+        for (uint32_t level = 1; level <= kMaxLodLevels &&
+                                 previousCount / 3 >= kMinLodTriangles;
+             ++level)
+        {
+            float error = 0.0f;
+            const std::vector<uint32_t> indices = simplifyIndices(
+                mesh, submesh.baseVertex, &mesh.indices[previousFirst],
+                previousCount, previousCount / 6 * 3, error);
+            if (indices.empty() || indices.size() > previousCount * 3 / 4)
+            {
+                break;
+            }
+
+            MeshLod lod = {};
+            lod.firstIndex = (uint32_t)mesh.indices.size();
+            lod.indexCount = (uint32_t)indices.size();
+            lod.error = previousError + error;
+            mesh.indices.insert(mesh.indices.end(), indices.begin(),
+                                indices.end());
+            if (optimize)
+            {
+                optimizeVertexCache(&mesh.indices[lod.firstIndex],
+                                    lod.indexCount);
+            }
+            mesh.lods.push_back(lod);
+
+            if (report.triangles.size() <= level)
+            {
+                report.triangles.push_back(0);
+                report.errors.push_back(0.0f);
+            }
+            report.triangles[level] += lod.indexCount / 3;
+            report.errors[level] = std::max(report.errors[level], lod.error);
+
+            previousFirst = lod.firstIndex;
+            previousCount = indices.size();
+            previousError = lod.error;
+        }
+        submesh.lodCount = (uint32_t)mesh.lods.size() - submesh.firstLod;
+    }
+
+    report.buildTime = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    return report;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MeshCooker.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Mesh Simplifier
+// Builds levels of detail by collapsing edges in order of their quadric
+// error. Every vertex accumulates the planes of the triangles around it, and
+// collapsing one vertex into a neighbor costs the squared distance of the
+// neighbor from those planes, so flat areas go first. Vertices only ever
+// collapse into ones that already exist, which lets every level share the
+// full detail vertex buffer and only add indices. Vertices on borders or
+// attribute seams are kept, as are collapses that would flip a triangle.
+
+struct MeshLodReport
+{
+    uint32_t submeshes = 0;
+
+    // Per level, summed over submeshes, the full detail level first
+    std::vector<uint64_t> triangles;
+    std::vector<float> errors;
+
+    double buildTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+// Levels stop once one has fewer triangles than this, or when simplifying
+// can't halve the triangle count any more
+const uint32_t kMinLodTriangles = 32;
+const uint32_t kMaxLodLevels = 6;
+
+// Simplify an index range to at most targetIndexCount indices if it can,
+// returning the new indices and filling in how far the surface moved, in
+// model space units
+std::vector<uint32_t> simplifyIndices(const CookedMesh& mesh,
+                                      int32_t baseVertex,
+                                      const uint32_t* indices,
+                                      size_t indexCount,
+                                      size_t targetIndexCount, float& error);
+
+// Append a chain of levels of detail to every submesh, optimized for the
+// vertex cache if optimize is set
+MeshLodReport generateLods(CookedMesh& mesh, bool optimize);
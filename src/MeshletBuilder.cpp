@@ -0,0 +1,208 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <vector>
+
+namespace
+{
+// Cones wider than about 168 degrees would hardly ever cull anything, and
+// their tests get unstable close to a hemisphere
+const double kMinConeSpread = 0.1;
+
+// Marks a vertex that isn't in the meshlet being built
+const uint32_t kNoMeshlet = ~0u;
+
+// Bounding sphere and normal cone of a meshlet's triangles
+void computeMeshletBounds(const CookedMesh& mesh, int32_t baseVertex,
+                          MeshMeshlet& meshlet)
+{
+    const uint32_t* indices = &mesh.indices[meshlet.firstIndex];
+    const uint32_t indexCount = meshlet.triangleCount * 3;
+    auto getPosition = [&](uint32_t i) {
+        return mesh.vertices[indices[i] + baseVertex].position;
+    };
+
+    // The sphere is centered on the box around the vertices
+    float boundsMin[3], boundsMax[3];
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        boundsMin[axis] = boundsMax[axis] = getPosition(0)[axis];
+        for (uint32_t i = 1; i < indexCount; ++i)
+        {
+            boundsMin[axis] = std::min(boundsMin[axis], getPosition(i)[axis]);
+            boundsMax[axis] = std::max(boundsMax[axis], getPosition(i)[axis]);
+        }
+        meshlet.center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+    }
+    float radiusSquared = 0.0f;
+    for (uint32_t i = 0; i < indexCount; ++i)
+    {
+        const float* p = getPosition(i);
+        const float dx = p[0] - meshlet.center[0];
+        const float dy = p[1] - meshlet.center[1];
+        const float dz = p[2] - meshlet.center[2];
+        radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+    meshlet.radius = std::sqrt(radiusSquared);
+
+    // The cone axis is the average unit normal, and its spread the normal
+    // furthest from it. Degenerate triangles face nowhere and are skipped.
+    std::vector<double> normals;
+    normals.reserve(meshlet.triangleCount * 3);
+    double axis[3] = {0.0, 0.0, 0.0};
+    for (uint32_t i = 0; i < indexCount; i += 3)
+    {
+        const float* p0 = getPosition(i);
+        const float* p1 = getPosition(i + 1);
+        const float* p2 = getPosition(i + 2);
+        const double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        const double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        const double n[3] = {e1[1] * e2[2] - e1[2] * e2[1],
+                             e1[2] * e2[0] - e1[0] * e2[2],
+                             e1[0] * e2[1] - e1[1] * e2[0]};
+        const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] +
+                                        n[2] * n[2]);
+        if (length == 0.0)
+        {
+            continue;
+        }
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            normals.push_back(n[c] / length);
+            axis[c] += n[c] / length;
+        }
+    }
+
+    const double axisLength =
+        std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    double spread = normals.empty() || axisLength == 0.0 ? -1.0 : 1.0;
+    for (size_t i = 0; i < normals.size() && spread >= kMinConeSpread;
+         i += 3)
+    {
+        spread = std::min(spread, (normals[i] * axis[0] +
+                                   normals[i + 1] * axis[1] +
+                                   normals[i + 2] * axis[2]) /
+                                      axisLength);
+    }
+    if (spread < kMinConeSpread)
+    {
+        std::fill(meshlet.coneAxis, meshlet.coneAxis + 3, 0.0f);
+        meshlet.coneCutoff = 1.0f;
+        return;
+    }
+
+    // Triangles with normals within acos(spread) of the axis all face away
+    // from every direction within asin(spread) of it
+    for (unsigned c = 0; c < 3; ++c)
+    {
+        meshlet.coneAxis[c] = (float)(axis[c] / axisLength);
+    }
+    meshlet.coneCutoff = (float)std::sqrt(1.0 - spread * spread);
+}
+
+// Append the meshlets of an index range, returning how many there are.
+// vertexMeshlet holds which meshlet each vertex was last added to, so
+// vertices are counted once per meshlet without clearing anything between
+// them.
+uint32_t buildRange(CookedMesh& mesh, uint32_t firstIndex, uint32_t indexCount,
+                    int32_t baseVertex, std::vector<uint32_t>& vertexMeshlet)
+{
+    const size_t firstMeshlet = mesh.meshlets.size();
+    MeshMeshlet meshlet = {};
+    meshlet.firstIndex = firstIndex;
+    uint32_t meshletIndex = (uint32_t)mesh.meshlets.size();
+    for (uint32_t i = 0; i < indexCount; i += 3)
+    {
+        const uint32_t* triangle = &mesh.indices[firstIndex + i];
+        auto countNewVertices = [&]() {
+            uint32_t count = 0;
+            for (unsigned corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t vertex = triangle[corner] + baseVertex;
+                const bool repeated =
+                    (corner > 0 && triangle[corner] == triangle[0]) ||
+                    (corner > 1 && triangle[corner] == triangle[1]);
+                count += vertexMeshlet[vertex] != meshletIndex && !repeated;
+            }
+            return count;
+        };
+
+        uint32_t newVertices = countNewVertices();
+        if (meshlet.triangleCount == kMaxMeshletTriangles ||
+            meshlet.vertexCount + newVertices > kMaxMeshletVertices)
+        {
+            computeMeshletBounds(mesh, baseVertex, meshlet);
+            mesh.meshlets.push_back(meshlet);
+
+            meshlet = MeshMeshlet();
+            meshlet.firstIndex = firstIndex + i;
+            meshletIndex++;
+            newVertices = countNewVertices();
+        }
+
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+            vertexMeshlet[triangle[corner] + baseVertex] = meshletIndex;
+        }
+        meshlet.vertexCount += newVertices;
+        meshlet.triangleCount++;
+    }
+    if (meshlet.triangleCount > 0)
+    {
+        computeMeshletBounds(mesh, baseVertex, meshlet);
+        mesh.meshlets.push_back(meshlet);
+    }
+    return (uint32_t)(mesh.meshlets.size() - firstMeshlet);
+}
+}
+
+void MeshletBuildReport::report(std::ostream& out) const
+{
+    out << "Meshlets: " << meshlets << " built in " << buildTime << " ms, "
+        << (meshlets > 0 ? (double)triangles / (double)meshlets : 0.0)
+        << " triangles and "
+        << (meshlets > 0 ? (double)vertices / (double)meshlets : 0.0)
+        << " vertices each on average, " << wideCones
+        << " without a normal cone\n";
+}
+
+MeshletBuildReport buildMeshlets(CookedMesh& mesh)
+{
+    const auto start = std::chrono::steady_clock::now();
+    MeshletBuildReport report;
+    mesh.meshlets.clear();
+
+    std::vector<uint32_t> vertexMeshlet(mesh.vertices.size(), kNoMeshlet);
+    for (MeshSubmesh& submesh : mesh.submeshes)
+    {
+        submesh.firstMeshlet = (uint32_t)mesh.meshlets.size();
+        submesh.meshletCount =
+            buildRange(mesh, submesh.firstIndex, submesh.indexCount,
+                       submesh.baseVertex, vertexMeshlet);
+
+        // Levels of detail share their submesh's vertices
+        for (uint32_t level = 0; level < submesh.lodCount; ++level)
+        {
+            MeshLod& lod = mesh.lods[submesh.firstLod + level];
+            lod.firstMeshlet = (uint32_t)mesh.meshlets.size();
+            lod.meshletCount =
+                buildRange(mesh, lod.firstIndex, lod.indexCount,
+                           submesh.baseVertex, vertexMeshlet);
+        }
+    }
+
+    for (const MeshMeshlet& meshlet : mesh.meshlets)
+    {
+        report.triangles += meshlet.triangleCount;
+        report.vertices += meshlet.vertexCount;
+        report.wideCones += meshlet.coneCutoff >= 1.0f;
+    }
+    report.meshlets = mesh.meshlets.size();
+    report.buildTime = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    return report;
+}
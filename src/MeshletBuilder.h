@@ -0,0 +1,33 @@
+#pragma once
+
+#include "MeshCooker.h"
+
+#include <cstdint>
+#include <iosfwd>
+
+// Meshlet Builder
+// Splits every submesh and level of detail of a cooked mesh into meshlets of
+// at most kMaxMeshletVertices vertices and kMaxMeshletTriangles triangles, so
+// large meshes can be culled a piece at a time. Triangles are taken in index
+// order, which the optimizer has already made local, and a meshlet is closed
+// as soon as the next triangle doesn't fit. Each one gets a bounding sphere
+// for frustum culling and a cone around its triangle normals for backface
+// culling.
+
+struct MeshletBuildReport
+{
+    uint64_t meshlets = 0;
+    uint64_t triangles = 0;
+    uint64_t vertices = 0;
+
+    // Meshlets whose normals spread too far for a useful cone
+    uint64_t wideCones = 0;
+
+    double buildTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+// Fill in the mesh's meshlets and each submesh's and level of detail's range
+// of them, after the indices are in their final order
+MeshletBuildReport buildMeshlets(CookedMesh& mesh);
@@ -0,0 +1,472 @@
+#include "PipelineCache.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+void hashShader(uint64_t& hash, const D3D12_SHADER_BYTECODE& shader)
+{
+    hashValue(hash, (uint64_t)shader.BytecodeLength);
+    if (shader.pShaderBytecode)
+    {
+        hashBytes(hash, shader.pShaderBytecode, shader.BytecodeLength);
+    }
+}
+
+void hashStencilOp(uint64_t& hash, const D3D12_DEPTH_STENCILOP_DESC& op)
+{
+    hashValue(hash, op.StencilFailOp);
+    hashValue(hash, op.StencilDepthFailOp);
+    hashValue(hash, op.StencilPassOp);
+    hashValue(hash, op.StencilFunc);
+}
+
+// Library entries are named after their key
+std::wstring getLibraryName(uint64_t key)
+{
+    const wchar_t* digits = L"0123456789abcdef";
+    std::wstring name = L"pso_";
+    for (int shift = 60; shift >= 0; shift -= 4)
+    {
+        name += digits[(key >> shift) & 0xf];
+    }
+    return name;
+}
+
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+}
+
+// Stats
+
+double PipelineCacheStats::hitRate() const
+{
+    return requests > 0 ? (double)(dedupHits + libraryHits) / (double)requests
+                        : 0.0;
+}
+
+void PipelineCacheStats::report(std::ostream& out) const
+{
+    out << "Pipeline cache: " << requests << " requests, " << dedupHits
+        << " deduplicated, " << libraryHits << " from library, " << compiles
+        << " compiled, " << failures << " failed\n";
+    out << "  hit rate: " << hitRate() * 100.0 << "%, latency ms: mean "
+        << latencyMean << ", max " << latencyMax << ", waited " << waitTime
+        << "\n";
+}
+
+// Cache
+
+PipelineCache::PipelineCache(ID3D12Device* device,
+                             const std::string& libraryPath,
+                             unsigned workerCount)
+    : mDevice(device), mLibraryPath(libraryPath), mLibrary(nullptr),
+      mLibraryDirty(false), mBusyWorkers(0), mStopping(false),
+      mLatencySum(0.0)
+{
+    // Pipeline libraries need ID3D12Device1, without one every pipeline is
+    // compiled, but requests are still deduplicated
+    ID3D12Device1* device1 = nullptr;
+    if (SUCCEEDED(mDevice->QueryInterface(&device1)))
+    {
+        std::ifstream file(mLibraryPath, std::ios::binary);
+        if (file.is_open())
+        {
+            mLibraryBlob.assign((std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>());
+        }
+
+        // Libraries from another driver or adapter are rejected, start over
+        if (FAILED(device1->CreatePipelineLibrary(
+                mLibraryBlob.data(), mLibraryBlob.size(),
+                IID_PPV_ARGS(&mLibrary))))
+        {
+            mLibrary = nullptr;
+            mLibraryBlob.clear();
+            if (FAILED(device1->CreatePipelineLibrary(
+                    nullptr, 0, IID_PPV_ARGS(&mLibrary))))
+            {
+                mLibrary = nullptr;
+            }
+        }
+        device1->Release();
+    }
+
+    for (unsigned i = 0; i < std::max(workerCount, 1u); ++i)
+    {
+        mWorkers.emplace_back(&PipelineCache::workerLoop, this);
+    }
+}
+
+PipelineCache::~PipelineCache()
+{
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWorkAvailable.notify_all();
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+
+    try
+    {
+        save();
+    }
+    catch (const std::exception&)
+    {
+        // A library that can't be written only costs compile time next run
+    }
+
+    for (auto& entry : mPipelines)
+    {
+        if (entry.second->state)
+        {
+            entry.second->state->Release();
+            entry.second->state = nullptr;
+        }
+    }
+
+    if (mLibrary)
+    {
+        mLibrary->Release();
+        mLibrary = nullptr;
+    }
+}
+
+void PipelineCache::addRootSignature(ID3D12RootSignature* rootSignature,
+                                     const void* blob, SIZE_T blobSize)
+{
+    uint64_t hash = kHashBasis;
+    hashBytes(hash, blob, blobSize);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRootSignatureKeys[rootSignature] = hash;
+}
+
+GraphicsPipeline*
+PipelineCache::request(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+                       LPCWSTR name)
+{
+    if (desc.StreamOutput.NumEntries > 0)
+    {
+        throw std::runtime_error("stream output pipelines aren't cached!");
+    }
+
+    const uint64_t key = computeKey(desc);
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mStats.requests++;
+
+    auto found = mPipelines.find(key);
+    if (found != mPipelines.end())
+    {
+        mStats.dedupHits++;
+        return found->second.get();
+    }
+
+    std::unique_ptr<GraphicsPipeline> pipeline(new GraphicsPipeline());
+    pipeline->key = key;
+    pipeline->requestTime = std::chrono::steady_clock::now();
+    if (name)
+    {
+        pipeline->name = name;
+    }
+
+    // Repoint the copied description at memory the pipeline owns
+    pipeline->desc = desc;
+    D3D12_SHADER_BYTECODE* shaders[] = {
+        &pipeline->desc.VS, &pipeline->desc.PS, &pipeline->desc.DS,
+        &pipeline->desc.HS, &pipeline->desc.GS};
+    for (unsigned i = 0; i < _countof(shaders); ++i)
+    {
+        const UINT8* bytecode =
+            static_cast<const UINT8*>(shaders[i]->pShaderBytecode);
+        if (bytecode)
+        {
+            pipeline->shaders[i].assign(bytecode,
+                                        bytecode + shaders[i]->BytecodeLength);
+            shaders[i]->pShaderBytecode = pipeline->shaders[i].data();
+        }
+    }
+
+    const D3D12_INPUT_LAYOUT_DESC& inputLayout = desc.InputLayout;
+    pipeline->semanticNames.reserve(inputLayout.NumElements);
+    for (UINT i = 0; i < inputLayout.NumElements; ++i)
+    {
+        D3D12_INPUT_ELEMENT_DESC element = inputLayout.pInputElementDescs[i];
+        pipeline->semanticNames.push_back(element.SemanticName);
+        element.SemanticName = pipeline->semanticNames.back().c_str();
+        pipeline->inputElements.push_back(element);
+    }
+    pipeline->desc.InputLayout.pInputElementDescs =
+        pipeline->inputElements.data();
+
+    // A cached blob of another pipeline would be rejected, the library
+    // takes care of reuse instead
+    pipeline->desc.CachedPSO.pCachedBlob = nullptr;
+    pipeline->desc.CachedPSO.CachedBlobSizeInBytes = 0;
+
+    GraphicsPipeline* result = pipeline.get();
+    mPipelines[key] = std::move(pipeline);
+    mQueue.push_back(result);
+    lock.unlock();
+
+    mWorkAvailable.notify_one();
+    return result;
+}
+
+ID3D12PipelineState* PipelineCache::wait(GraphicsPipeline* pipeline)
+{
+    if (pipeline->status.load() == PipelineStatus::Pending)
+    {
+        const auto waitStart = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        // Nothing has started on it yet, so create it here rather than wait
+        // behind the rest of the queue
+        auto queued = std::find(mQueue.begin(), mQueue.end(), pipeline);
+        if (queued != mQueue.end())
+        {
+            mQueue.erase(queued);
+            mBusyWorkers++;
+            lock.unlock();
+            create(pipeline);
+            lock.lock();
+        }
+
+        mWorkDone.wait(lock, [&] {
+            return pipeline->status.load() != PipelineStatus::Pending;
+        });
+        mStats.waitTime += elapsedMilliseconds(waitStart);
+    }
+
+    if (pipeline->status.load() == PipelineStatus::Failed)
+    {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    return pipeline->state;
+}
+
+void PipelineCache::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mWorkDone.wait(lock, [&] { return mQueue.empty() && mBusyWorkers == 0; });
+}
+
+void PipelineCache::save()
+{
+    waitIdle();
+    if (!mLibrary || !mLibraryDirty.exchange(false))
+    {
+        return;
+    }
+
+    std::vector<char> data(mLibrary->GetSerializedSize());
+    ThrowIfFailed(mLibrary->Serialize(data.data(), data.size()));
+
+    std::ofstream out(mLibraryPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+        throw std::runtime_error("failed to open pipeline library for writing!");
+    }
+    out.write(data.data(), data.size());
+}
+
+uint64_t
+PipelineCache::computeKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) const
+{
+    uint64_t hash = kHashBasis;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto found = mRootSignatureKeys.find(desc.pRootSignature);
+        if (found == mRootSignatureKeys.end())
+        {
+            throw std::runtime_error(
+                "root signature wasn't added to the pipeline cache!");
+        }
+        hashValue(hash, found->second);
+    }
+
+    hashShader(hash, desc.VS);
+    hashShader(hash, desc.PS);
+    hashShader(hash, desc.DS);
+    hashShader(hash, desc.HS);
+    hashShader(hash, desc.GS);
+
+    const D3D12_BLEND_DESC& blend = desc.BlendState;
+    hashValue(hash, blend.AlphaToCoverageEnable);
+    hashValue(hash, blend.IndependentBlendEnable);
+    for (const D3D12_RENDER_TARGET_BLEND_DESC& target : blend.RenderTarget)
+    {
+        hashValue(hash, target.BlendEnable);
+        hashValue(hash, target.LogicOpEnable);
+        hashValue(hash, target.SrcBlend);
+        hashValue(hash, target.DestBlend);
+        hashValue(hash, target.BlendOp);
+        hashValue(hash, target.SrcBlendAlpha);
+        hashValue(hash, target.DestBlendAlpha);
+        hashValue(hash, target.BlendOpAlpha);
+        hashValue(hash, target.LogicOp);
+        hashValue(hash, target.RenderTargetWriteMask);
+    }
+    hashValue(hash, desc.SampleMask);
+
+    const D3D12_RASTERIZER_DESC& raster = desc.RasterizerState;
+    hashValue(hash, raster.FillMode);
+    hashValue(hash, raster.CullMode);
+    hashValue(hash, raster.FrontCounterClockwise);
+    hashValue(hash, raster.DepthBias);
+    hashValue(hash, raster.DepthBiasClamp);
+    hashValue(hash, raster.SlopeScaledDepthBias);
+    hashValue(hash, raster.DepthClipEnable);
+    hashValue(hash, raster.MultisampleEnable);
+    hashValue(hash, raster.AntialiasedLineEnable);
+    hashValue(hash, raster.ForcedSampleCount);
+    hashValue(hash, raster.ConservativeRaster);
+
+    const D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+    hashValue(hash, depthStencil.DepthEnable);
+    hashValue(hash, depthStencil.DepthWriteMask);
+    hashValue(hash, depthStencil.DepthFunc);
+    hashValue(hash, depthStencil.StencilEnable);
+    hashValue(hash, depthStencil.StencilReadMask);
+    hashValue(hash, depthStencil.StencilWriteMask);
+    hashStencilOp(hash, depthStencil.FrontFace);
+    hashStencilOp(hash, depthStencil.BackFace);
+
+    const D3D12_INPUT_LAYOUT_DESC& inputLayout = desc.InputLayout;
+    hashValue(hash, inputLayout.NumElements);
+    for (UINT i = 0; i < inputLayout.NumElements; ++i)
+    {
+        const D3D12_INPUT_ELEMENT_DESC& element =
+            inputLayout.pInputElementDescs[i];
+        hashString(hash, element.SemanticName);
+        hashValue(hash, element.SemanticIndex);
+        hashValue(hash, element.Format);
+        hashValue(hash, element.InputSlot);
+        hashValue(hash, element.AlignedByteOffset);
+        hashValue(hash, element.InputSlotClass);
+        hashValue(hash, element.InstanceDataStepRate);
+    }
+
+    hashValue(hash, desc.IBStripCutValue);
+    hashValue(hash, desc.PrimitiveTopologyType);
+    hashValue(hash, desc.NumRenderTargets);
+    for (UINT i = 0; i < desc.NumRenderTargets && i < 8; ++i)
+    {
+        hashValue(hash, desc.RTVFormats[i]);
+    }
+    hashValue(hash, desc.DSVFormat);
+    hashValue(hash, desc.SampleDesc.Count);
+    hashValue(hash, desc.SampleDesc.Quality);
+    hashValue(hash, desc.NodeMask);
+    hashValue(hash, desc.Flags);
+    return hash;
+}
+
+PipelineCacheStats PipelineCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+void PipelineCache::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStats = PipelineCacheStats();
+    mLatencySum = 0.0;
+}
+
+void PipelineCache::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mWorkAvailable.wait(lock, [&] { return mStopping || !mQueue.empty(); });
+        if (mQueue.empty())
+        {
+            return;
+        }
+
+        GraphicsPipeline* pipeline = mQueue.front();
+        mQueue.pop_front();
+        mBusyWorkers++;
+
+        lock.unlock();
+        create(pipeline);
+        lock.lock();
+    }
+}
+
+void PipelineCache::create(GraphicsPipeline* pipeline)
+{
+    const std::wstring libraryName = getLibraryName(pipeline->key);
+
+    ID3D12PipelineState* state = nullptr;
+    bool fromLibrary = false;
+    bool stored = false;
+    if (mLibrary && SUCCEEDED(mLibrary->LoadGraphicsPipeline(
+                        libraryName.c_str(), &pipeline->desc,
+                        IID_PPV_ARGS(&state))))
+    {
+        fromLibrary = true;
+    }
+    else
+    {
+        state = nullptr;
+        if (FAILED(mDevice->CreateGraphicsPipelineState(
+                &pipeline->desc, IID_PPV_ARGS(&state))))
+        {
+            state = nullptr;
+        }
+        else if (mLibrary)
+        {
+            stored = SUCCEEDED(
+                mLibrary->StorePipeline(libraryName.c_str(), state));
+        }
+    }
+
+    if (state && !pipeline->name.empty())
+    {
+        state->SetName(pipeline->name.c_str());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (state)
+        {
+            const double latency = elapsedMilliseconds(pipeline->requestTime);
+            const uint64_t created = mStats.libraryHits + mStats.compiles + 1;
+            mLatencySum += latency;
+            mStats.latencyMean = mLatencySum / (double)created;
+            mStats.latencyMax = std::max(mStats.latencyMax, latency);
+            (fromLibrary ? mStats.libraryHits : mStats.compiles)++;
+        }
+        else
+        {
+            mStats.failures++;
+        }
+        if (stored)
+        {
+            mLibraryDirty = true;
+        }
+
+        pipeline->state = state;
+        pipeline->status.store(state ? PipelineStatus::Ready
+                                     : PipelineStatus::Failed);
+        mBusyWorkers--;
+    }
+    mWorkDone.notify_all();
+}
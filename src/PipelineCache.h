@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Backend/Backend.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Pipeline Cache
+// Creates graphics pipeline states on worker threads and deduplicates them by
+// a hash of their full description, including the shader bytecode, input
+// layout and root signature. Pipelines are stored in a pipeline library that
+// is serialized to disk, so on later runs the driver loads them instead of
+// compiling them again.
+
+enum class PipelineStatus : unsigned
+{
+    Pending,
+    Ready,
+    Failed
+};
+
+// A pipeline owned by the cache, requesting an identical description again
+// returns the same one
+struct GraphicsPipeline
+{
+    // Null until the status is ready
+    ID3D12PipelineState* state = nullptr;
+    std::atomic<PipelineStatus> status{PipelineStatus::Pending};
+
+    uint64_t key = 0;
+
+  protected:
+    friend class PipelineCache;
+
+    // Copy of the description and everything it points at, so compilation
+    // doesn't depend on the caller's memory
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC desc;
+    std::vector<uint8_t> shaders[5];
+    std::vector<D3D12_INPUT_ELEMENT_DESC> inputElements;
+    std::vector<std::string> semanticNames;
+    std::wstring name;
+
+    std::chrono::steady_clock::time_point requestTime;
+};
+
+struct PipelineCacheStats
+{
+    // Calls to request(), and how many found an existing pipeline
+    uint64_t requests = 0;
+    uint64_t dedupHits = 0;
+
+    // Pipelines loaded from the library, and compiled from scratch
+    uint64_t libraryHits = 0;
+    uint64_t compiles = 0;
+    uint64_t failures = 0;
+
+    // Time from a request to its pipeline being ready, in milliseconds
+    double latencyMean = 0.0;
+    double latencyMax = 0.0;
+
+    // Time callers spent blocked in wait(), in milliseconds
+    double waitTime = 0.0;
+
+    // Requests served without compiling
+    double hitRate() const;
+
+    void report(std::ostream& out) const;
+};
+
+class PipelineCache
+{
+  public:
+    // The library file is loaded if it exists and the driver accepts it
+    PipelineCache(ID3D12Device* device, const std::string& libraryPath,
+                  unsigned workerCount = 2);
+
+    // Waits for pending pipelines and saves the library
+    ~PipelineCache();
+
+    // Pipelines are keyed by root signature contents rather than by the
+    // object, so keys stay the same across runs. Root signatures have to be
+    // added before they're used in a request.
+    void addRootSignature(ID3D12RootSignature* rootSignature,
+                          const void* blob, SIZE_T blobSize);
+
+    // Returns the pipeline for a description, queueing its creation on a
+    // worker if it's new. Stream output isn't supported.
+    GraphicsPipeline* request(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc,
+                              LPCWSTR name = nullptr);
+
+    // Block until a pipeline is created, throws if creation failed
+    ID3D12PipelineState* wait(GraphicsPipeline* pipeline);
+
+    // Block until every queued pipeline is created
+    void waitIdle();
+
+    // Serialize the library to disk if pipelines were added to it
+    void save();
+
+    uint64_t computeKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) const;
+
+    PipelineCacheStats getStats() const;
+
+    void resetStats();
+
+  protected:
+    void workerLoop();
+
+    // Load the pipeline from the library or compile it
+    void create(GraphicsPipeline* pipeline);
+
+    ID3D12Device* mDevice;
+    std::string mLibraryPath;
+
+    // Null if the device doesn't support pipeline libraries. The driver
+    // reads from the blob it was created with for as long as it lives.
+    ID3D12PipelineLibrary* mLibrary;
+    std::vector<char> mLibraryBlob;
+    std::atomic<bool> mLibraryDirty;
+
+    std::unordered_map<ID3D12RootSignature*, uint64_t> mRootSignatureKeys;
+    std::unordered_map<uint64_t, std::unique_ptr<GraphicsPipeline>> mPipelines;
+
+    // Guards the queue, the stats and the status of pending pipelines
+    mutable std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+    std::deque<GraphicsPipeline*> mQueue;
+    unsigned mBusyWorkers;
+    bool mStopping;
+    std::vector<std::thread> mWorkers;
+
+    PipelineCacheStats mStats;
+    double mLatencySum;
+};
@@ -0,0 +1,322 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+// Nesting of the scopes open on this thread
+thread_local uint32_t tDepth = 0;
+
+void writeJsonString(std::ostream& out, const char* text)
+{
+    static const char kHex[] = "0123456789abcdef";
+    out << '"';
+    for (const char* c = text; *c != '\0'; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            out << '\\' << *c;
+        }
+        else if ((unsigned char)*c < 0x20)
+        {
+            out << "\\u00" << kHex[(*c >> 4) & 0xf] << kHex[*c & 0xf];
+        }
+        else
+        {
+            out << *c;
+        }
+    }
+    out << '"';
+}
+
+void reportPercentiles(std::ostream& out, const char* label,
+                       const FrameTimePercentiles& percentiles)
+{
+    out << "  " << label << " ms: " << percentiles.p50 << " p50, "
+        << percentiles.p95 << " p95, " << percentiles.p99 << " p99, "
+        << percentiles.max << " max\n";
+}
+} // namespace
+
+void FrameTimeStats::report(std::ostream& out) const
+{
+    out << "Frame times: " << frames << " frames, " << gpuFrames
+        << " timed on the GPU, " << events << " events traced, "
+        << droppedEvents << " dropped\n";
+    reportPercentiles(out, "CPU frame", cpuFrame);
+    reportPercentiles(out, "GPU frame", gpuFrame);
+    reportPercentiles(out, "present wait", presentWait);
+}
+
+void Profiler::FrameWindow::add(double sample)
+{
+    if (samples.size() < kFrameWindow)
+    {
+        samples.push_back(sample);
+    }
+    else
+    {
+        samples[next] = sample;
+    }
+    next = (next + 1) % kFrameWindow;
+    count++;
+}
+
+FrameTimePercentiles Profiler::FrameWindow::getPercentiles() const
+{
+    FrameTimePercentiles percentiles;
+    if (samples.empty())
+    {
+        return percentiles;
+    }
+
+    // Nearest rank, so every percentile is a frame that actually happened
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    auto rank = [&](double p) {
+        const size_t index = (size_t)std::ceil(p * sorted.size());
+        return sorted[std::max(index, (size_t)1) - 1];
+    };
+    percentiles.p50 = rank(0.50);
+    percentiles.p95 = rank(0.95);
+    percentiles.p99 = rank(0.99);
+    percentiles.max = sorted.back();
+    return percentiles;
+}
+
+void* Profiler::ThreadBuffer::operator new(size_t size)
+{
+    // The allocation's start is kept just before the aligned block
+    const size_t alignment = alignof(ThreadBuffer);
+    void* allocation = ::operator new(size + alignment + sizeof(void*));
+    const uintptr_t aligned =
+        ((uintptr_t)allocation + sizeof(void*) + alignment - 1) &
+        ~(uintptr_t)(alignment - 1);
+    ((void**)aligned)[-1] = allocation;
+    return (void*)aligned;
+}
+
+void Profiler::ThreadBuffer::operator delete(void* pointer)
+{
+    if (pointer != nullptr)
+    {
+        ::operator delete(((void**)pointer)[-1]);
+    }
+}
+
+Profiler::Profiler()
+    : mEnabled(false), mEpoch(now()), mGpu(nullptr), mDroppedEvents(0)
+{
+    mGpu = createThreadBuffer("GPU");
+}
+
+int64_t Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void Profiler::setEnabled(bool enabled) { mEnabled.store(enabled); }
+
+bool Profiler::isEnabled() const
+{
+    return mEnabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const std::string& name)
+{
+    ThreadBuffer& buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(mMutex);
+    buffer.name = name;
+}
+
+void Profiler::record(const char* name, int64_t start, int64_t end,
+                      uint32_t depth)
+{
+    ThreadBuffer& buffer = getThreadBuffer();
+    if (!buffer.events.push({name, start, end - start, depth}))
+    {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Profiler::recordGpu(const char* name, int64_t start, int64_t end)
+{
+    if (!mGpu->events.push({name, start, end - start, 0}))
+    {
+        mGpu->dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+const char* Profiler::intern(const std::string& name)
+{
+    // Set elements don't move when the set grows
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNames.insert(name).first->c_str();
+}
+
+void Profiler::collect()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    ProfileEvent event;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : mThreads)
+    {
+        while (buffer->events.pop(event))
+        {
+            if (mEvents.size() < kMaxEvents)
+            {
+                mEvents.push_back(event);
+                mEventThreads.push_back(buffer->id);
+            }
+            else
+            {
+                mDroppedEvents++;
+            }
+        }
+        mDroppedEvents += buffer->dropped.exchange(0);
+    }
+}
+
+void Profiler::addFrame(double cpuTime, double presentWaitTime)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCpuFrames.add(cpuTime);
+    mPresentWaits.add(presentWaitTime);
+}
+
+void Profiler::addGpuFrame(double gpuTime)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mGpuFrames.add(gpuTime);
+}
+
+FrameTimeStats Profiler::getFrameStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    FrameTimeStats stats;
+    stats.frames = mCpuFrames.count;
+    stats.gpuFrames = mGpuFrames.count;
+    stats.cpuFrame = mCpuFrames.getPercentiles();
+    stats.gpuFrame = mGpuFrames.getPercentiles();
+    stats.presentWait = mPresentWaits.getPercentiles();
+    stats.events = mEvents.size();
+    stats.droppedEvents = mDroppedEvents;
+    return stats;
+}
+
+void Profiler::writeChromeTrace(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out.setf(std::ios::fixed, std::ios::floatfield);
+    out.precision(3);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : mThreads)
+    {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << buffer->id << ",\"args\":{\"name\":";
+        writeJsonString(out, buffer->name.c_str());
+        out << "}}";
+    }
+
+    // Complete events, in microseconds
+    for (size_t i = 0; i < mEvents.size(); ++i)
+    {
+        const ProfileEvent& event = mEvents[i];
+        out << ",\n{\"name\":";
+        writeJsonString(out, event.name);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << mEventThreads[i]
+            << ",\"ts\":" << (event.start - mEpoch) / 1000.0
+            << ",\"dur\":" << event.duration / 1000.0
+            << ",\"args\":{\"depth\":" << event.depth << "}}";
+    }
+    out << "\n]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void Profiler::saveChromeTrace(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        throw std::runtime_error("failed to open trace file!");
+    }
+    writeChromeTrace(file);
+    if (!file)
+    {
+        throw std::runtime_error("failed to write trace file!");
+    }
+}
+
+void Profiler::reset()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mEvents.clear();
+    mEventThreads.clear();
+    mDroppedEvents = 0;
+    mCpuFrames = FrameWindow();
+    mGpuFrames = FrameWindow();
+    mPresentWaits = FrameWindow();
+}
+
+Profiler::ThreadBuffer& Profiler::getThreadBuffer()
+{
+    // Threads usually only ever record into the global profiler
+    thread_local Profiler* owner = nullptr;
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (owner != this)
+    {
+        buffer = createThreadBuffer(std::string());
+        owner = this;
+    }
+    return *buffer;
+}
+
+Profiler::ThreadBuffer* Profiler::createThreadBuffer(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mThreads.emplace_back(new ThreadBuffer());
+    ThreadBuffer* buffer = mThreads.back().get();
+    buffer->id = (uint32_t)mThreads.size() - 1;
+    buffer->name =
+        name.empty() ? "Thread " + std::to_string(buffer->id) : name;
+    return buffer;
+}
+
+Profiler& profiler()
+{
+    static Profiler instance;
+    return instance;
+}
+
+ProfileScope::ProfileScope(const char* name) : mName(nullptr), mStart(0)
+{
+    if (profiler().isEnabled())
+    {
+        mName = name;
+        mStart = Profiler::now();
+        tDepth++;
+    }
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (mName != nullptr)
+    {
+        tDepth--;
+        profiler().record(mName, mStart, Profiler::now(), tDepth);
+    }
+}
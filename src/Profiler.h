@@ -0,0 +1,189 @@
+#pragma once
+
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Profiler
+// Timed scopes are pushed into a lock-free queue owned by the thread that
+// timed them, so a scope costs two clock reads and a push, and one collector
+// drains every queue between frames. GPU scopes arrive on a track of their
+// own once their timestamps have been read back. Collected events are
+// exported as a Chrome trace, which chrome://tracing and Perfetto open, and
+// frame times are kept over a rolling window for percentiles.
+
+struct ProfileEvent
+{
+    // A string literal or a name from Profiler::intern()
+    const char* name;
+
+    // Nanoseconds on the profiler's clock
+    int64_t start;
+    int64_t duration;
+
+    // Nesting level within the thread, 0 is outermost
+    uint32_t depth;
+};
+
+struct FrameTimePercentiles
+{
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+struct FrameTimeStats
+{
+    uint64_t frames = 0;
+    uint64_t gpuFrames = 0;
+
+    // Over the last Profiler::kFrameWindow frames, in milliseconds. The CPU
+    // frame is all of Renderer::render(), present wait is the part of it
+    // spent waiting for a frame context and presenting.
+    FrameTimePercentiles cpuFrame;
+    FrameTimePercentiles gpuFrame;
+    FrameTimePercentiles presentWait;
+
+    // Events kept for the trace, and those lost to a full thread queue or
+    // a full trace
+    uint64_t events = 0;
+    uint64_t droppedEvents = 0;
+
+    void report(std::ostream& out) const;
+};
+
+class Profiler
+{
+  public:
+    // Events each thread can queue between two collections
+    static const size_t kThreadEvents = 4096;
+
+    // Frames the percentiles are taken over
+    static const size_t kFrameWindow = 512;
+
+    // Events kept for the trace, later ones are dropped
+    static const size_t kMaxEvents = 1 << 20;
+
+    Profiler();
+
+    // Nanoseconds on the steady clock
+    static int64_t now();
+
+    // Scopes are only recorded while enabled, frame times always are
+    void setEnabled(bool enabled);
+
+    bool isEnabled() const;
+
+    // Name the calling thread's track in the trace
+    void setThreadName(const std::string& name);
+
+    // Record a finished scope on the calling thread's track
+    void record(const char* name, int64_t start, int64_t end,
+                uint32_t depth = 0);
+
+    // Record a scope on the GPU track, in the profiler's clock. Only one
+    // thread may record GPU scopes.
+    void recordGpu(const char* name, int64_t start, int64_t end);
+
+    // A copy of the name that lives as long as the profiler
+    const char* intern(const std::string& name);
+
+    // Move every queued event into the trace. Call regularly, once a frame
+    // is plenty, from one thread at a time.
+    void collect();
+
+    // Times of a finished frame, in milliseconds
+    void addFrame(double cpuTime, double presentWaitTime);
+
+    void addGpuFrame(double gpuTime);
+
+    FrameTimeStats getFrameStats() const;
+
+    // Write collected events in the Chrome trace event format, timestamps
+    // count from when the profiler was created
+    void writeChromeTrace(std::ostream& out) const;
+
+    // Throws if the file can't be written
+    void saveChromeTrace(const std::string& path) const;
+
+    // Drop collected events and frame times
+    void reset();
+
+  protected:
+    struct ThreadBuffer
+    {
+        SpscQueue<ProfileEvent, kThreadEvents> events;
+        std::atomic<uint64_t> dropped{0};
+        uint32_t id = 0;
+        std::string name;
+
+        // The queue is aligned to cache lines, which plain new only honors
+        // from C++17 on
+        static void* operator new(size_t size);
+        static void operator delete(void* pointer);
+    };
+
+    // The last kFrameWindow samples of a frame time
+    struct FrameWindow
+    {
+        std::vector<double> samples;
+        size_t next = 0;
+        uint64_t count = 0;
+
+        void add(double sample);
+
+        FrameTimePercentiles getPercentiles() const;
+    };
+
+    // The calling thread's buffer, registered on first use
+    ThreadBuffer& getThreadBuffer();
+
+    ThreadBuffer* createThreadBuffer(const std::string& name);
+
+    std::atomic<bool> mEnabled;
+    int64_t mEpoch;
+
+    // Guards the buffer list, interned names, the trace and frame times
+    mutable std::mutex mMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> mThreads;
+    ThreadBuffer* mGpu;
+    std::unordered_set<std::string> mNames;
+
+    // Collected events, and the track of each
+    std::vector<ProfileEvent> mEvents;
+    std::vector<uint32_t> mEventThreads;
+    uint64_t mDroppedEvents;
+
+    FrameWindow mCpuFrames;
+    FrameWindow mGpuFrames;
+    FrameWindow mPresentWaits;
+};
+
+Profiler& profiler();
+
+// Times its lifetime on the calling thread, when the profiler is enabled
+class ProfileScope
+{
+  public:
+    ProfileScope(const char* name);
+
+    ~ProfileScope();
+
+  protected:
+    const char* mName;
+    int64_t mStart;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name)                                                    \
+    ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
@@ -0,0 +1,786 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+// States a resource is written in, every other state only reads
+const UINT kWriteStates = D3D12_RESOURCE_STATE_RENDER_TARGET |
+                          D3D12_RESOURCE_STATE_UNORDERED_ACCESS |
+                          D3D12_RESOURCE_STATE_DEPTH_WRITE |
+                          D3D12_RESOURCE_STATE_COPY_DEST;
+
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+GpuResourceClass classify(const D3D12_RESOURCE_DESC& desc)
+{
+    if (desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+    {
+        return GpuResourceClass::Buffer;
+    }
+    if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET |
+                      D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+    {
+        return GpuResourceClass::RenderTarget;
+    }
+    return GpuResourceClass::Texture;
+}
+
+D3D12_HEAP_FLAGS heapFlags(GpuResourceClass resourceClass)
+{
+    switch (resourceClass)
+    {
+    case GpuResourceClass::Buffer:
+        return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+    case GpuResourceClass::RenderTarget:
+        return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+    default:
+        return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+    }
+}
+
+UINT64 alignUp(UINT64 value, UINT64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+bool isReadOnly(D3D12_RESOURCE_STATES state)
+{
+    return state != D3D12_RESOURCE_STATE_COMMON && (state & kWriteStates) == 0;
+}
+
+D3D12_RESOURCE_STATES combine(D3D12_RESOURCE_STATES a,
+                              D3D12_RESOURCE_STATES b)
+{
+    return (D3D12_RESOURCE_STATES)(a | b);
+}
+}
+
+void RenderGraphStats::report(std::ostream& out) const
+{
+    out << "Render graph: " << passes << " passes, " << culledPasses
+        << " culled, " << barriers << " barriers in " << barrierBatches
+        << " batches over " << frames << " frames\n";
+    out << "  transients: " << transientResources << " in " << heapBytes
+        << " heap bytes, " << transientBytes << " unaliased, "
+        << resourcesCreated << " resources and " << heapsCreated
+        << " heaps created\n";
+    out << "  ms: " << compileTime << " compiling, " << executeTime
+        << " executing\n";
+}
+
+RenderGraph::RenderGraph(ID3D12Device* device)
+    : mDevice(device), mProfiler(nullptr), mCompiled(false)
+{
+    for (unsigned c = 0; c < (unsigned)GpuResourceClass::Count; ++c)
+    {
+        mHeapSizes[c] = 0;
+        mHeaps[c] = nullptr;
+        mHeapCapacities[c] = 0;
+    }
+    mCurrent.fenceValue = 0;
+}
+
+RenderGraph::~RenderGraph()
+{
+    finishFrame(0);
+    retire(UINT64_MAX);
+    for (Transient& transient : mTransients)
+    {
+        transient.resource->Release();
+    }
+    for (ID3D12Heap* heap : mHeaps)
+    {
+        if (heap != nullptr)
+        {
+            heap->Release();
+        }
+    }
+}
+
+void RenderGraph::reset()
+{
+    mResources.clear();
+    mPasses.clear();
+    mFinalBarriers.clear();
+    mCompiled = false;
+}
+
+RenderGraphResource RenderGraph::importResource(const std::string& name,
+                                                ID3D12Resource* resource,
+                                                D3D12_RESOURCE_STATES state)
+{
+    Resource imported = {};
+    imported.name = name;
+    imported.resource = resource;
+    imported.imported = true;
+    imported.state = state;
+    mResources.push_back(imported);
+    return (RenderGraphResource)mResources.size() - 1;
+}
+
+RenderGraphResource
+RenderGraph::createTransient(const std::string& name,
+                             const D3D12_RESOURCE_DESC& desc,
+                             const D3D12_CLEAR_VALUE* clearValue, UINT64 size,
+                             UINT64 alignment)
+{
+    Resource transient = {};
+    transient.name = name;
+    transient.desc = desc;
+    transient.hasClearValue = clearValue != nullptr;
+    if (clearValue != nullptr)
+    {
+        transient.clearValue = *clearValue;
+    }
+    transient.resourceClass = classify(desc);
+    if (size == 0)
+    {
+        if (mDevice == nullptr)
+        {
+            throw std::runtime_error("transient " + name + " needs a size!");
+        }
+        const D3D12_RESOURCE_ALLOCATION_INFO info =
+            mDevice->GetResourceAllocationInfo(0, 1, &desc);
+        if (info.SizeInBytes == UINT64_MAX)
+        {
+            throw std::runtime_error("invalid resource description!");
+        }
+        size = info.SizeInBytes;
+        alignment = info.Alignment;
+    }
+    transient.size = size;
+    transient.alignment =
+        alignment > 0 ? alignment : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    mResources.push_back(transient);
+    return (RenderGraphResource)mResources.size() - 1;
+}
+
+RenderGraphPass RenderGraph::addPass(const std::string& name,
+                                     uint32_t batchCount,
+                                     ID3D12PipelineState* initialState,
+                                     const RecordBatchFunction& recordBatch)
+{
+    Pass pass;
+    pass.name = name;
+    pass.batchCount = std::max(batchCount, 1u);
+    pass.initialState = initialState;
+    pass.recordBatch = recordBatch;
+    pass.sideEffects = false;
+    pass.culled = false;
+    mPasses.push_back(pass);
+    return (RenderGraphPass)mPasses.size() - 1;
+}
+
+void RenderGraph::read(RenderGraphPass pass, RenderGraphResource resource,
+                       D3D12_RESOURCE_STATES state)
+{
+    mPasses[pass].accesses.push_back({resource, state, false});
+}
+
+void RenderGraph::write(RenderGraphPass pass, RenderGraphResource resource,
+                        D3D12_RESOURCE_STATES state)
+{
+    mPasses[pass].accesses.push_back({resource, state, true});
+}
+
+void RenderGraph::setSideEffects(RenderGraphPass pass)
+{
+    mPasses[pass].sideEffects = true;
+}
+
+void RenderGraph::compile()
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    cullPasses();
+    placeTransients();
+    deriveBarriers();
+    mCompiled = true;
+
+    mStats.frames++;
+    mStats.passes += mPasses.size();
+    for (const Pass& pass : mPasses)
+    {
+        mStats.culledPasses += pass.culled;
+        mStats.barriers += pass.barriers.size();
+        mStats.barrierBatches += !pass.barriers.empty();
+    }
+    mStats.barriers += mFinalBarriers.size();
+    mStats.barrierBatches += !mFinalBarriers.empty();
+    mStats.transientResources = 0;
+    mStats.transientBytes = 0;
+    mStats.heapBytes = 0;
+    for (const Resource& resource : mResources)
+    {
+        if (!resource.imported && resource.firstPass != UINT32_MAX)
+        {
+            mStats.transientResources++;
+            mStats.transientBytes += resource.size;
+        }
+    }
+    for (UINT64 size : mHeapSizes)
+    {
+        mStats.heapBytes += size;
+    }
+    mStats.compileTime +=
+        elapsedMilliseconds(start, std::chrono::steady_clock::now());
+}
+
+void RenderGraph::cullPasses()
+{
+    // Walking backwards, a pass is needed if it has side effects or writes
+    // something a later needed pass reads, or an imported resource that
+    // outlives the frame. Writes don't end a resource's need, a pass may
+    // only write part of it.
+    std::vector<uint8_t> needed(mResources.size(), 0);
+    for (size_t r = 0; r < mResources.size(); ++r)
+    {
+        needed[r] = mResources[r].imported;
+    }
+    for (size_t p = mPasses.size(); p-- > 0;)
+    {
+        Pass& pass = mPasses[p];
+        bool live = pass.sideEffects;
+        for (const Access& access : pass.accesses)
+        {
+            live = live || (access.write && needed[access.resource]);
+        }
+        pass.culled = !live;
+        if (!live)
+        {
+            continue;
+        }
+        for (const Access& access : pass.accesses)
+        {
+            if (!access.write)
+            {
+                needed[access.resource] = 1;
+            }
+        }
+    }
+}
+
+void RenderGraph::placeTransients()
+{
+    for (Resource& resource : mResources)
+    {
+        resource.firstPass = UINT32_MAX;
+        resource.lastPass = 0;
+        resource.offset = 0;
+        resource.aliased = false;
+    }
+    for (uint32_t p = 0; p < (uint32_t)mPasses.size(); ++p)
+    {
+        if (mPasses[p].culled)
+        {
+            continue;
+        }
+        for (const Access& access : mPasses[p].accesses)
+        {
+            Resource& resource = mResources[access.resource];
+            resource.firstPass = std::min(resource.firstPass, p);
+            resource.lastPass = std::max(resource.lastPass, p);
+        }
+    }
+
+    // Largest first, each at the lowest offset that doesn't overlap the
+    // memory of a transient alive at the same time
+    std::vector<uint32_t> order;
+    for (uint32_t r = 0; r < (uint32_t)mResources.size(); ++r)
+    {
+        if (!mResources[r].imported && mResources[r].firstPass != UINT32_MAX)
+        {
+            order.push_back(r);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return mResources[a].size > mResources[b].size;
+    });
+
+    std::fill(mHeapSizes, mHeapSizes + (unsigned)GpuResourceClass::Count, 0);
+    std::vector<uint32_t> placed;
+    for (uint32_t r : order)
+    {
+        Resource& resource = mResources[r];
+        std::vector<const Resource*> conflicts;
+        for (uint32_t other : placed)
+        {
+            const Resource& o = mResources[other];
+            if (o.resourceClass == resource.resourceClass &&
+                o.firstPass <= resource.lastPass &&
+                resource.firstPass <= o.lastPass)
+            {
+                conflicts.push_back(&o);
+            }
+        }
+        std::sort(conflicts.begin(), conflicts.end(),
+                  [](const Resource* a, const Resource* b) {
+                      return a->offset < b->offset;
+                  });
+
+        UINT64 offset = 0;
+        for (const Resource* conflict : conflicts)
+        {
+            if (offset + resource.size <= conflict->offset)
+            {
+                break;
+            }
+            offset = std::max(offset,
+                              alignUp(conflict->offset + conflict->size,
+                                      resource.alignment));
+        }
+        resource.offset = offset;
+        placed.push_back(r);
+
+        UINT64& heapSize = mHeapSizes[(unsigned)resource.resourceClass];
+        heapSize = std::max(heapSize, offset + resource.size);
+    }
+
+    // Memory another transient uses has to be handed over with an aliasing
+    // barrier. Placements carry over into the next frame, so even the first
+    // transient in shared memory takes it over from the last one of the
+    // frame before.
+    for (uint32_t r : placed)
+    {
+        Resource& resource = mResources[r];
+        for (uint32_t other : placed)
+        {
+            const Resource& o = mResources[other];
+            if (other != r && o.resourceClass == resource.resourceClass &&
+                o.offset < resource.offset + resource.size &&
+                resource.offset < o.offset + o.size)
+            {
+                resource.aliased = true;
+                break;
+            }
+        }
+    }
+}
+
+void RenderGraph::deriveBarriers()
+{
+    // Transients are created in the state of their first use and returned
+    // to it after their last, before anything aliasing their memory starts,
+    // so every frame finds them the same way
+    std::vector<D3D12_RESOURCE_STATES> states(mResources.size());
+    std::vector<uint8_t> started(mResources.size(), 0);
+    std::vector<uint8_t> finished(mResources.size(), 0);
+    std::vector<uint8_t> lastWroteUav(mResources.size(), 0);
+    auto finishTransients = [&](uint32_t pass,
+                                std::vector<RenderGraphBarrier>& barriers) {
+        for (RenderGraphResource r = 0;
+             r < (RenderGraphResource)mResources.size(); ++r)
+        {
+            const Resource& resource = mResources[r];
+            if (!resource.imported && started[r] && !finished[r] &&
+                resource.lastPass < pass)
+            {
+                finished[r] = 1;
+                if (states[r] != resource.state)
+                {
+                    barriers.push_back({D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+                                        r, states[r], resource.state});
+                }
+            }
+        }
+    };
+    for (size_t r = 0; r < mResources.size(); ++r)
+    {
+        states[r] = mResources[r].state;
+        started[r] = mResources[r].imported;
+    }
+
+    mFinalBarriers.clear();
+    for (uint32_t p = 0; p < (uint32_t)mPasses.size(); ++p)
+    {
+        Pass& pass = mPasses[p];
+        pass.barriers.clear();
+        if (pass.culled)
+        {
+            continue;
+        }
+        finishTransients(p, pass.barriers);
+
+        // The states the pass asks for, merged per resource
+        std::vector<Access> uses;
+        for (const Access& access : pass.accesses)
+        {
+            auto use = std::find_if(uses.begin(), uses.end(),
+                                    [&](const Access& u) {
+                                        return u.resource == access.resource;
+                                    });
+            if (use == uses.end())
+            {
+                uses.push_back(access);
+            }
+            else
+            {
+                use->state = combine(use->state, access.state);
+                use->write = use->write || access.write;
+            }
+        }
+
+        for (const Access& use : uses)
+        {
+            const RenderGraphResource r = use.resource;
+            D3D12_RESOURCE_STATES target = use.state;
+
+            // Reads carry on into every later pass that only reads, so one
+            // transition covers all of them
+            if (!use.write && isReadOnly(target))
+            {
+                for (uint32_t next = p + 1; next < (uint32_t)mPasses.size();
+                     ++next)
+                {
+                    if (mPasses[next].culled)
+                    {
+                        continue;
+                    }
+                    bool writes = false;
+                    for (const Access& access : mPasses[next].accesses)
+                    {
+                        if (access.resource == r)
+                        {
+                            writes = writes || access.write ||
+                                     !isReadOnly(access.state);
+                        }
+                    }
+                    if (writes)
+                    {
+                        break;
+                    }
+                    for (const Access& access : mPasses[next].accesses)
+                    {
+                        if (access.resource == r)
+                        {
+                            target = combine(target, access.state);
+                        }
+                    }
+                }
+            }
+
+            if (!started[r])
+            {
+                started[r] = 1;
+                states[r] = target;
+                mResources[r].state = target;
+                if (mResources[r].aliased)
+                {
+                    pass.barriers.push_back(
+                        {D3D12_RESOURCE_BARRIER_TYPE_ALIASING, r, target,
+                         target});
+                }
+            }
+            else if (isReadOnly(states[r]) && isReadOnly(use.state) &&
+                     (states[r] & use.state) == use.state)
+            {
+                // Already in a state covering the read
+            }
+            else if (states[r] != target)
+            {
+                pass.barriers.push_back({D3D12_RESOURCE_BARRIER_TYPE_TRANSITION,
+                                         r, states[r], target});
+                states[r] = target;
+            }
+            else if (lastWroteUav[r] &&
+                     target == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+            {
+                pass.barriers.push_back(
+                    {D3D12_RESOURCE_BARRIER_TYPE_UAV, r, target, target});
+            }
+            lastWroteUav[r] =
+                use.write && target == D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+        }
+    }
+
+    finishTransients(UINT32_MAX, mFinalBarriers);
+    for (RenderGraphResource r = 0; r < (RenderGraphResource)mResources.size();
+         ++r)
+    {
+        if (mResources[r].imported && states[r] != mResources[r].state)
+        {
+            mFinalBarriers.push_back({D3D12_RESOURCE_BARRIER_TYPE_TRANSITION, r,
+                                      states[r], mResources[r].state});
+        }
+    }
+}
+
+bool RenderGraph::isCulled(RenderGraphPass pass) const
+{
+    return mPasses[pass].culled;
+}
+
+const std::vector<RenderGraphBarrier>&
+RenderGraph::getBarriers(RenderGraphPass pass) const
+{
+    return mPasses[pass].barriers;
+}
+
+const std::vector<RenderGraphBarrier>& RenderGraph::getFinalBarriers() const
+{
+    return mFinalBarriers;
+}
+
+UINT64 RenderGraph::getOffset(RenderGraphResource resource) const
+{
+    return mResources[resource].offset;
+}
+
+void RenderGraph::execute(CommandRecorder& recorder)
+{
+    if (!mCompiled)
+    {
+        throw std::runtime_error("render graph executed before compiling!");
+    }
+    const auto start = std::chrono::steady_clock::now();
+
+    createTransients();
+
+    std::vector<uint32_t> live;
+    for (uint32_t p = 0; p < (uint32_t)mPasses.size(); ++p)
+    {
+        if (!mPasses[p].culled)
+        {
+            live.push_back(p);
+        }
+    }
+    const std::vector<D3D12_RESOURCE_BARRIER> finalBarriers =
+        getD3D12Barriers(mFinalBarriers);
+
+    for (size_t i = 0; i < live.size(); ++i)
+    {
+        const Pass& pass = mPasses[live[i]];
+        const bool lastPass = i + 1 == live.size();
+        const std::vector<D3D12_RESOURCE_BARRIER> barriers =
+            getD3D12Barriers(pass.barriers);
+
+        // A pass's time includes its barriers, the frame's timestamps are
+        // resolved once everything else is recorded
+        const uint32_t scope =
+            mProfiler ? mProfiler->beginScope(pass.name) : UINT32_MAX;
+        recorder.record(
+            pass.batchCount, pass.initialState,
+            [&](ID3D12GraphicsCommandList* commandList, uint32_t batch) {
+                const bool lastBatch = batch + 1 == pass.batchCount;
+                if (batch == 0 && mProfiler)
+                {
+                    mProfiler->writeTimestamp(commandList, scope, false);
+                }
+                if (batch == 0 && !barriers.empty())
+                {
+                    commandList->ResourceBarrier((UINT)barriers.size(),
+                                                 barriers.data());
+                }
+                pass.recordBatch(commandList, batch);
+                if (lastBatch && mProfiler)
+                {
+                    mProfiler->writeTimestamp(commandList, scope, true);
+                }
+                if (lastPass && lastBatch && !finalBarriers.empty())
+                {
+                    commandList->ResourceBarrier((UINT)finalBarriers.size(),
+                                                 finalBarriers.data());
+                }
+                if (lastPass && lastBatch && mProfiler)
+                {
+                    mProfiler->resolve(commandList);
+                }
+            });
+    }
+
+    // Imported resources still go back to their state with nothing drawn
+    if (live.empty() && !finalBarriers.empty())
+    {
+        recorder.record(1, nullptr,
+                        [&](ID3D12GraphicsCommandList* commandList,
+                            uint32_t batch) {
+                            commandList->ResourceBarrier(
+                                (UINT)finalBarriers.size(),
+                                finalBarriers.data());
+                        });
+    }
+
+    mStats.executeTime +=
+        elapsedMilliseconds(start, std::chrono::steady_clock::now());
+}
+
+void RenderGraph::setProfiler(GpuProfiler* profiler) { mProfiler = profiler; }
+
+void RenderGraph::createTransients()
+{
+    for (unsigned c = 0; c < (unsigned)GpuResourceClass::Count; ++c)
+    {
+        if (mHeapSizes[c] <= mHeapCapacities[c])
+        {
+            continue;
+        }
+
+        // A heap that's too small goes, with every transient placed in it
+        const GpuResourceClass resourceClass = (GpuResourceClass)c;
+        for (auto it = mTransients.begin(); it != mTransients.end();)
+        {
+            if (it->resourceClass == resourceClass)
+            {
+                mCurrent.releases.push_back(it->resource);
+                it = mTransients.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        if (mHeaps[c] != nullptr)
+        {
+            mCurrent.releases.push_back(mHeaps[c]);
+            mHeaps[c] = nullptr;
+        }
+
+        // Render targets may be multisampled, which needs 4MB placement
+        const UINT64 heapAlignment =
+            resourceClass == GpuResourceClass::RenderTarget
+                ? D3D12_DEFAULT_MSAA_RESOURCE_PLACEMENT_ALIGNMENT
+                : D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        D3D12_HEAP_DESC heapDesc = {};
+        heapDesc.SizeInBytes = alignUp(mHeapSizes[c], heapAlignment);
+        heapDesc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+        heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+        heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+        heapDesc.Properties.CreationNodeMask = 1;
+        heapDesc.Properties.VisibleNodeMask = 1;
+        heapDesc.Alignment = heapAlignment;
+        heapDesc.Flags = heapFlags(resourceClass);
+        ThrowIfFailed(mDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(&mHeaps[c])));
+        mHeaps[c]->SetName(L"Render Graph Heap");
+        mHeapCapacities[c] = heapDesc.SizeInBytes;
+        mStats.heapsCreated++;
+    }
+
+    for (Transient& transient : mTransients)
+    {
+        transient.used = false;
+    }
+    for (Resource& resource : mResources)
+    {
+        if (resource.imported || resource.firstPass == UINT32_MAX)
+        {
+            continue;
+        }
+        auto matches = [&](const Transient& t) {
+            return t.resourceClass == resource.resourceClass &&
+                   t.offset == resource.offset && t.state == resource.state &&
+                   !t.used &&
+                   memcmp(&t.desc, &resource.desc, sizeof(t.desc)) == 0 &&
+                   t.hasClearValue == resource.hasClearValue &&
+                   (!t.hasClearValue ||
+                    memcmp(&t.clearValue, &resource.clearValue,
+                           sizeof(t.clearValue)) == 0);
+        };
+        auto found =
+            std::find_if(mTransients.begin(), mTransients.end(), matches);
+        if (found == mTransients.end())
+        {
+            Transient transient;
+            transient.resourceClass = resource.resourceClass;
+            transient.offset = resource.offset;
+            transient.desc = resource.desc;
+            transient.hasClearValue = resource.hasClearValue;
+            transient.clearValue = resource.clearValue;
+            transient.state = resource.state;
+            ThrowIfFailed(mDevice->CreatePlacedResource(
+                mHeaps[(unsigned)resource.resourceClass], resource.offset,
+                &resource.desc, resource.state,
+                resource.hasClearValue ? &resource.clearValue : nullptr,
+                IID_PPV_ARGS(&transient.resource)));
+            mTransients.push_back(transient);
+            found = mTransients.end() - 1;
+            mStats.resourcesCreated++;
+        }
+        found->used = true;
+        resource.resource = found->resource;
+    }
+
+    // Transients no frame placed the same way are dropped
+    for (auto it = mTransients.begin(); it != mTransients.end();)
+    {
+        if (!it->used)
+        {
+            mCurrent.releases.push_back(it->resource);
+            it = mTransients.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+std::vector<D3D12_RESOURCE_BARRIER> RenderGraph::getD3D12Barriers(
+    const std::vector<RenderGraphBarrier>& barriers) const
+{
+    std::vector<D3D12_RESOURCE_BARRIER> result(barriers.size());
+    for (size_t i = 0; i < barriers.size(); ++i)
+    {
+        D3D12_RESOURCE_BARRIER& barrier = result[i];
+        barrier.Type = barriers[i].type;
+        barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+        ID3D12Resource* resource = mResources[barriers[i].resource].resource;
+        switch (barriers[i].type)
+        {
+        case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+            barrier.Transition.pResource = resource;
+            barrier.Transition.StateBefore = barriers[i].stateBefore;
+            barrier.Transition.StateAfter = barriers[i].stateAfter;
+            barrier.Transition.Subresource =
+                D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+            break;
+        case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+            // Whichever transient used the memory before
+            barrier.Aliasing.pResourceBefore = nullptr;
+            barrier.Aliasing.pResourceAfter = resource;
+            break;
+        default:
+            barrier.UAV.pResource = resource;
+            break;
+        }
+    }
+    return result;
+}
+
+ID3D12Resource* RenderGraph::getResource(RenderGraphResource resource) const
+{
+    return mResources[resource].resource;
+}
+
+void RenderGraph::finishFrame(UINT64 fenceValue)
+{
+    mCurrent.fenceValue = fenceValue;
+    mFrames.push_back(std::move(mCurrent));
+    mCurrent = Frame();
+    mCurrent.fenceValue = 0;
+}
+
+void RenderGraph::retire(UINT64 completedFenceValue)
+{
+    while (!mFrames.empty() &&
+           mFrames.front().fenceValue <= completedFenceValue)
+    {
+        for (ID3D12Pageable* release : mFrames.front().releases)
+        {
+            release->Release();
+        }
+        mFrames.pop_front();
+    }
+}
+
+const RenderGraphStats& RenderGraph::getStats() const { return mStats; }
+
+void RenderGraph::resetStats() { mStats = RenderGraphStats(); }
@@ -0,0 +1,242 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "CommandRecorder.h"
+#include "GpuAllocator.h"
+#include "GpuProfiler.h"
+
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Render Graph
+// Describes a frame as passes that read and write resources, and derives
+// what has to happen between them. Passes are declared in the order they
+// run, along with the state they use each resource in. Compiling culls
+// passes whose writes nothing reads, works out the transitions every pass
+// needs, merging runs of reads into one combined state and every barrier
+// before a pass into a single ResourceBarrier call, and places transient
+// resources whose lifetimes don't overlap at the same offsets of a heap.
+// Executing creates the transients and records the live passes in order on
+// the command recorder, each pass between timestamps when a GPU profiler is
+// set. Compiling doesn't touch the device, so graphs can be checked without
+// a GPU.
+
+typedef uint32_t RenderGraphResource;
+typedef uint32_t RenderGraphPass;
+
+// A barrier between passes, on graph resources
+struct RenderGraphBarrier
+{
+    D3D12_RESOURCE_BARRIER_TYPE type;
+    RenderGraphResource resource;
+    D3D12_RESOURCE_STATES stateBefore;
+    D3D12_RESOURCE_STATES stateAfter;
+};
+
+struct RenderGraphStats
+{
+    uint64_t frames = 0;
+
+    // Passes declared and culled, barriers derived and the ResourceBarrier
+    // calls they were merged into
+    uint64_t passes = 0;
+    uint64_t culledPasses = 0;
+    uint64_t barriers = 0;
+    uint64_t barrierBatches = 0;
+
+    // Of the last compiled frame, the bytes transient resources would take
+    // on their own and the heap bytes they're aliased into
+    uint64_t transientResources = 0;
+    uint64_t transientBytes = 0;
+    uint64_t heapBytes = 0;
+
+    // Transient resources and heaps created
+    uint64_t resourcesCreated = 0;
+    uint64_t heapsCreated = 0;
+
+    // Times spent, in milliseconds
+    double compileTime = 0.0;
+    double executeTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+class RenderGraph
+{
+  public:
+    // Without a device graphs can only be compiled, and transient sizes have
+    // to be given when they're declared
+    RenderGraph(ID3D12Device* device = nullptr);
+
+    // Assumes the GPU is idle, every heap and transient is released
+    ~RenderGraph();
+
+    // Forget the last frame's passes and resources, transients created for
+    // it are kept for the next one to reuse
+    void reset();
+
+    // A resource from outside the graph, in the given state before the frame
+    // and returned to it after the last pass
+    RenderGraphResource importResource(const std::string& name,
+                                       ID3D12Resource* resource,
+                                       D3D12_RESOURCE_STATES state);
+
+    // A resource that only lives during the frame. Its memory may have held
+    // another transient, so the first pass using it has to clear, discard or
+    // overwrite it. A size of 0 asks the device for it.
+    RenderGraphResource
+    createTransient(const std::string& name, const D3D12_RESOURCE_DESC& desc,
+                    const D3D12_CLEAR_VALUE* clearValue = nullptr,
+                    UINT64 size = 0, UINT64 alignment = 0);
+
+    // A pass recorded in batchCount batches on the command recorder, the
+    // barriers it needs are recorded before its first batch
+    RenderGraphPass addPass(const std::string& name, uint32_t batchCount,
+                            ID3D12PipelineState* initialState,
+                            const RecordBatchFunction& recordBatch);
+
+    // Declare a pass's use of a resource, a pass uses a resource in one
+    // state or in several read states
+    void read(RenderGraphPass pass, RenderGraphResource resource,
+              D3D12_RESOURCE_STATES state);
+
+    void write(RenderGraphPass pass, RenderGraphResource resource,
+               D3D12_RESOURCE_STATES state);
+
+    // Keep a pass even if nothing reads what it writes
+    void setSideEffects(RenderGraphPass pass);
+
+    void compile();
+
+    bool isCulled(RenderGraphPass pass) const;
+
+    // Barriers recorded before a pass, and after the last one
+    const std::vector<RenderGraphBarrier>&
+    getBarriers(RenderGraphPass pass) const;
+
+    const std::vector<RenderGraphBarrier>& getFinalBarriers() const;
+
+    // Where a transient is placed in the heap of its resource class
+    UINT64 getOffset(RenderGraphResource resource) const;
+
+    // Create the compiled frame's transients and record its live passes
+    void execute(CommandRecorder& recorder);
+
+    // Time every live pass on the GPU, null stops timing them
+    void setProfiler(GpuProfiler* profiler);
+
+    // The D3D12 resource behind a graph resource, transients only have one
+    // while executing
+    ID3D12Resource* getResource(RenderGraphResource resource) const;
+
+    // Tag heaps and transients dropped since the last call with the fence
+    // value the GPU signals once it's done with them
+    void finishFrame(UINT64 fenceValue);
+
+    // Release everything dropped before the completed fence value
+    void retire(UINT64 completedFenceValue);
+
+    const RenderGraphStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    struct Resource
+    {
+        std::string name;
+        ID3D12Resource* resource;
+        bool imported;
+
+        // Imported resources start and end the frame in this state,
+        // transients in the state of their first use
+        D3D12_RESOURCE_STATES state;
+
+        D3D12_RESOURCE_DESC desc;
+        bool hasClearValue;
+        D3D12_CLEAR_VALUE clearValue;
+        GpuResourceClass resourceClass;
+        UINT64 size;
+        UINT64 alignment;
+
+        // Live passes using it, its placement and whether its memory is
+        // shared with another transient
+        uint32_t firstPass;
+        uint32_t lastPass;
+        UINT64 offset;
+        bool aliased;
+    };
+
+    struct Access
+    {
+        RenderGraphResource resource;
+        D3D12_RESOURCE_STATES state;
+        bool write;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        uint32_t batchCount;
+        ID3D12PipelineState* initialState;
+        RecordBatchFunction recordBatch;
+        std::vector<Access> accesses;
+        bool sideEffects;
+        bool culled;
+        std::vector<RenderGraphBarrier> barriers;
+    };
+
+    // A transient created for an earlier frame, reused by any later one
+    // placing the same resource at the same offset
+    struct Transient
+    {
+        GpuResourceClass resourceClass;
+        UINT64 offset;
+        D3D12_RESOURCE_DESC desc;
+        bool hasClearValue;
+        D3D12_CLEAR_VALUE clearValue;
+        D3D12_RESOURCE_STATES state;
+        ID3D12Resource* resource;
+        bool used;
+    };
+
+    struct Frame
+    {
+        UINT64 fenceValue;
+        std::vector<ID3D12Pageable*> releases;
+    };
+
+    void cullPasses();
+
+    void placeTransients();
+
+    void deriveBarriers();
+
+    // Grow the heaps to the compiled frame and find or create its transients
+    void createTransients();
+
+    std::vector<D3D12_RESOURCE_BARRIER>
+    getD3D12Barriers(const std::vector<RenderGraphBarrier>& barriers) const;
+
+    ID3D12Device* mDevice;
+    GpuProfiler* mProfiler;
+
+    std::vector<Resource> mResources;
+    std::vector<Pass> mPasses;
+    std::vector<RenderGraphBarrier> mFinalBarriers;
+    bool mCompiled;
+
+    // Heap bytes each resource class needs, and the heaps holding them
+    UINT64 mHeapSizes[(unsigned)GpuResourceClass::Count];
+    ID3D12Heap* mHeaps[(unsigned)GpuResourceClass::Count];
+    UINT64 mHeapCapacities[(unsigned)GpuResourceClass::Count];
+    std::vector<Transient> mTransients;
+
+    // Releases waiting on the GPU oldest first, and those of this frame
+    std::deque<Frame> mFrames;
+    Frame mCurrent;
+
+    RenderGraphStats mStats;
+};
@@ -0,0 +1,208 @@
+#include "RenderThread.h"
+#include "Profiler.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+// Yields before a waiting thread goes to sleep, most handoffs are shorter
+const unsigned kSpinCount = 64;
+
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+}
+
+void RenderThreadStats::report(std::ostream& out) const
+{
+    out << "Render thread: " << packets << " packets, handoff ms: mean "
+        << handoffMean << ", max " << handoffMax << "\n";
+    out << "  producer: " << producerStalls << " stalls, " << producerWaitTime
+        << " ms waiting, " << packetGrowths << " packet growths\n";
+}
+
+RenderThread::RenderThread(Renderer& renderer, unsigned packetCount)
+    : mRenderer(renderer), mNextFrameNumber(0), mStopping(false),
+      mFailed(false), mRenderedFrames(0), mHandoffSum(0.0)
+{
+    // Both queues have to fit every packet
+    mPackets.resize(std::max(1u, std::min<unsigned>(packetCount, kMaxPackets)));
+    mCapacities.resize(mPackets.size(), 0);
+    for (FramePacket& packet : mPackets)
+    {
+        mFree.push(&packet);
+    }
+
+    mThread = std::thread(&RenderThread::threadLoop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    try
+    {
+        stop();
+    }
+    catch (const std::exception&)
+    {
+        // Already surfaced through beginPacket() or an explicit stop()
+    }
+}
+
+FramePacket* RenderThread::beginPacket()
+{
+    checkError();
+
+    FramePacket* packet = nullptr;
+    if (!mFree.pop(packet))
+    {
+        const auto waitStart = std::chrono::steady_clock::now();
+        waitUntil(mProducerWaiter,
+                  [&] { return mFree.pop(packet) || mFailed.load(); });
+        checkError();
+
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        mStats.producerStalls++;
+        mStats.producerWaitTime += elapsedMilliseconds(
+            waitStart, std::chrono::steady_clock::now());
+    }
+
+    packet->frameNumber = mNextFrameNumber++;
+    packet->draws.clear();
+    packet->resize = false;
+    return packet;
+}
+
+void RenderThread::submitPacket(FramePacket* packet)
+{
+    // Capacity only grows, so a change means the draw list reallocated
+    const size_t index = (size_t)(packet - mPackets.data());
+    if (packet->draws.capacity() != mCapacities[index])
+    {
+        mCapacities[index] = packet->draws.capacity();
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        mStats.packetGrowths++;
+    }
+
+    packet->submitTime = std::chrono::steady_clock::now();
+
+    // There are never more packets than slots, so this can't fail
+    mSubmitted.push(packet);
+    wake(mRenderWaiter);
+}
+
+void RenderThread::stop()
+{
+    if (mThread.joinable())
+    {
+        mStopping = true;
+        wake(mRenderWaiter);
+        mThread.join();
+    }
+    checkError();
+}
+
+uint64_t RenderThread::getRenderedFrames() const
+{
+    return mRenderedFrames.load();
+}
+
+RenderThreadStats RenderThread::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    return mStats;
+}
+
+void RenderThread::resetStats()
+{
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    mStats = RenderThreadStats();
+    mHandoffSum = 0.0;
+}
+
+template <typename Ready>
+void RenderThread::waitUntil(Waiter& waiter, Ready ready)
+{
+    for (unsigned i = 0; i < kSpinCount; ++i)
+    {
+        if (ready())
+        {
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    // The flag is set before ready() is checked again, and the other side
+    // publishes before it checks the flag, so one of them always sees the
+    // other and the wake up can't be lost
+    std::unique_lock<std::mutex> lock(waiter.mutex);
+    waiter.sleeping = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    waiter.condition.wait(lock, ready);
+    waiter.sleeping = false;
+}
+
+void RenderThread::wake(Waiter& waiter)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiter.sleeping.load())
+    {
+        std::lock_guard<std::mutex> lock(waiter.mutex);
+        waiter.condition.notify_one();
+    }
+}
+
+void RenderThread::threadLoop()
+{
+    profiler().setThreadName("Render Thread");
+    try
+    {
+        while (true)
+        {
+            FramePacket* packet = nullptr;
+            waitUntil(mRenderWaiter,
+                      [&] { return mSubmitted.pop(packet) || mStopping; });
+
+            // Stopping still renders whatever was submitted before it
+            if (packet == nullptr && !mSubmitted.pop(packet))
+            {
+                break;
+            }
+
+            const double handoff = elapsedMilliseconds(
+                packet->submitTime, std::chrono::steady_clock::now());
+            {
+                std::lock_guard<std::mutex> lock(mStatsMutex);
+                mStats.packets++;
+                mHandoffSum += handoff;
+                mStats.handoffMean = mHandoffSum / (double)mStats.packets;
+                mStats.handoffMax = std::max(mStats.handoffMax, handoff);
+            }
+
+            mRenderer.render(*packet);
+            mRenderedFrames++;
+
+            mFree.push(packet);
+            wake(mProducerWaiter);
+        }
+    }
+    catch (...)
+    {
+        mError = std::current_exception();
+        mFailed = true;
+        wake(mProducerWaiter);
+    }
+}
+
+void RenderThread::checkError()
+{
+    // The thread is gone after a failure, so it keeps being reported
+    if (mFailed.load())
+    {
+        std::rethrow_exception(mError);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "FramePacket.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <iosfwd>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Renderer;
+
+// Render Thread
+// Renders frame packets on a thread of its own, so the main thread can build
+// packet N + 1 while packet N is being rendered. Packets go to the render
+// thread through one lock-free queue and come back for reuse through
+// another, the pool is fixed so how far the main thread can run ahead is
+// bounded by its size.
+
+struct RenderThreadStats
+{
+    uint64_t packets = 0;
+
+    // Time from a packet being submitted to the render thread starting it,
+    // in milliseconds
+    double handoffMean = 0.0;
+    double handoffMax = 0.0;
+
+    // Times the main thread waited for a free packet, and for how long
+    uint64_t producerStalls = 0;
+    double producerWaitTime = 0.0;
+
+    // Times a packet's draw list had to grow, which stops once every packet
+    // in the pool has seen the largest frame
+    uint64_t packetGrowths = 0;
+
+    void report(std::ostream& out) const;
+};
+
+class RenderThread
+{
+  public:
+    static const size_t kMaxPackets = 4;
+
+    // Starts rendering right away, the renderer is only used from the render
+    // thread until stop() returns
+    RenderThread(Renderer& renderer, unsigned packetCount = 3);
+
+    ~RenderThread();
+
+    // Take a free packet to fill, waits while the render thread has every
+    // packet. Rethrows anything the render thread threw.
+    FramePacket* beginPacket();
+
+    // Hand a filled packet over for rendering
+    void submitPacket(FramePacket* packet);
+
+    // Render every submitted packet and join the thread
+    void stop();
+
+    // Packets the render thread has finished
+    uint64_t getRenderedFrames() const;
+
+    RenderThreadStats getStats() const;
+
+    void resetStats();
+
+  protected:
+    // One side of the handoff sleeps on this once spinning hasn't helped
+    struct Waiter
+    {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> sleeping{false};
+    };
+
+    // Spin on ready() for a while, then sleep until woken
+    template <typename Ready> void waitUntil(Waiter& waiter, Ready ready);
+
+    void wake(Waiter& waiter);
+
+    void threadLoop();
+
+    // Rethrow what the render thread threw, if anything
+    void checkError();
+
+    Renderer& mRenderer;
+
+    std::vector<FramePacket> mPackets;
+    std::vector<size_t> mCapacities;
+    uint64_t mNextFrameNumber;
+
+    SpscQueue<FramePacket*, kMaxPackets> mSubmitted;
+    SpscQueue<FramePacket*, kMaxPackets> mFree;
+    Waiter mRenderWaiter;
+    Waiter mProducerWaiter;
+
+    std::atomic<bool> mStopping;
+    std::atomic<bool> mFailed;
+    std::exception_ptr mError;
+    std::atomic<uint64_t> mRenderedFrames;
+    std::thread mThread;
+
+    mutable std::mutex mStatsMutex;
+    RenderThreadStats mStats;
+    double mHandoffSum;
+};
@@ -1,22 +1,69 @@
 #include "Renderer.h"
+#include "MeshCooker.h"
 
 using namespace glm;
 
-// Helper functions
-
-inline void ThrowIfFailed(HRESULT hr)
+namespace
+{
+// Vertex elements of a mesh vertex format in slot 0, followed by the model
+// matrix stepped once per instance in slot 1
+std::vector<D3D12_INPUT_ELEMENT_DESC> getInputLayout(MeshVertexFormat format)
 {
-    if (FAILED(hr))
+    std::vector<D3D12_INPUT_ELEMENT_DESC> elements;
+    if (format == MeshVertexFormat::Compact)
+    {
+        elements.push_back({"POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0,
+                            offsetof(MeshCompactVertex, position),
+                            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0});
+        elements.push_back({"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0,
+                            offsetof(MeshCompactVertex, normal),
+                            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0});
+        elements.push_back({"COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0,
+                            offsetof(MeshCompactVertex, color),
+                            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0});
+    }
+    else
+    {
+        elements.push_back({"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0,
+                            offsetof(MeshVertex, position),
+                            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0});
+        elements.push_back({"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0,
+                            offsetof(MeshVertex, normal),
+                            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0});
+        elements.push_back({"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0,
+                            offsetof(MeshVertex, color),
+                            D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0});
+    }
+
+    for (UINT row = 0; row < 4; ++row)
     {
-        throw std::exception();
+        elements.push_back({"MODEL", row, DXGI_FORMAT_R32G32B32A32_FLOAT, 1,
+                            row * 16,
+                            D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1});
     }
+    return elements;
+}
 }
 
 // Renderer
 
-Renderer::Renderer(xwin::Window& window)
+Renderer::Renderer(xwin::Window& window, const RendererDesc& desc)
+    : Renderer(&window, window.getDesc().width, window.getDesc().height, desc)
+{
+}
+
+Renderer::Renderer(unsigned width, unsigned height, const RendererDesc& desc)
+    : Renderer(nullptr, width, height, desc)
 {
-    mWindow;
+}
+
+Renderer::Renderer(xwin::Window* window, unsigned width, unsigned height,
+                   const RendererDesc& desc)
+    : mDesc(desc)
+{
+    // The renderer needs the window when resizing the swapchain
+    mWindow = window;
+    mDesc.framesInFlight = std::max(mDesc.framesInFlight, 1u);
 
     // Initialization
     mFactory = nullptr;
@@ -26,8 +73,7 @@ Renderer::Renderer(xwin::Window& window)
 #endif
     mDevice = nullptr;
     mCommandQueue = nullptr;
-    mCommandAllocator = nullptr;
-    mCommandList = nullptr;
+    mFrameContextIndex = 0;
     mSwapchain = nullptr;
 
     // Resources
@@ -35,26 +81,31 @@ Renderer::Renderer(xwin::Window& window)
     mVertexBuffer = nullptr;
     mIndexBuffer = nullptr;
 
-    mUniformBuffer = nullptr;
-    mUniformBufferHeap = nullptr;
-    mMappedUniformBuffer = nullptr;
+    mUniformAddress = 0;
+    mArgumentOffset = 0;
+    mCommandSignature = nullptr;
 
     mRootSignature = nullptr;
+    mViewConstantsParameter = 0;
+    mMeshConstantsParameter = 0;
+    mPipeline = nullptr;
     mPipelineState = nullptr;
 
     // Current Frame
-    mRtvHeap = nullptr;
     for (size_t i = 0; i < backbufferCount; ++i)
     {
         mRenderTargets[i] = nullptr;
+        mOffscreenTargets[i] = nullptr;
     }
+    mFrameIndex = 0;
     // Sync
     mFence = nullptr;
+    mFenceEvent = nullptr;
+    mFenceValue = 0;
+    mFrameCount = 0;
 
-    initializeAPI(window);
+    initializeAPI(width, height);
     initializeResources();
-    setupCommands();
-    tStart = std::chrono::high_resolution_clock::now();
 }
 
 Renderer::~Renderer()
@@ -72,11 +123,8 @@ Renderer::~Renderer()
     destroyAPI();
 }
 
-void Renderer::initializeAPI(xwin::Window& window)
+void Renderer::initializeAPI(unsigned width, unsigned height)
 {
-    // The renderer needs the window when resizing the swapchain
-    mWindow = &window;
-
     // Create Factory
 
     UINT dxgiFactoryFlags = 0;
@@ -145,33 +193,70 @@ void Renderer::initializeAPI(xwin::Window& window)
     ThrowIfFailed(
         mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCommandQueue)));
 
-    // Create Command Allocator
-    ThrowIfFailed(mDevice->CreateCommandAllocator(
-        D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&mCommandAllocator)));
+    // Each frame in flight has its own fence value, the command recorder
+    // keeps allocators for each of them
+    mFrameContexts.resize(mDesc.framesInFlight);
+    for (FrameContext& frame : mFrameContexts)
+    {
+        frame.fenceValue = 0;
+    }
+
+    // Create the worker threads commands are recorded and draws are culled on
+    mJobSystem.reset(new JobSystem(mDesc.workerThreads));
+    mCullingSystem.reset(new CullingSystem(*mJobSystem));
+    mLodSelector.reset(new LodSelector(*mJobSystem));
+
+    // Create the allocator every buffer and texture is placed with
+    mGpuAllocator.reset(new GpuAllocator(mDevice, mDesc.gpuAllocator));
+    mRenderGraph.reset(new RenderGraph(mDevice));
+    if (mDesc.gpuTimestamps)
+    {
+        mGpuProfiler.reset(new GpuProfiler(mDevice, mCommandQueue,
+                                           *mGpuAllocator,
+                                           mDesc.framesInFlight));
+        mRenderGraph->setProfiler(mGpuProfiler.get());
+    }
+
+    // Create the descriptor heaps and the back buffer views, which outlive
+    // every resize
+    mDescriptorAllocator.reset(
+        new DescriptorAllocator(mDevice, mDesc.descriptors));
+    for (UINT n = 0; n < backbufferCount; n++)
+    {
+        mRtvDescriptors[n] = mDescriptorAllocator->allocateStaging(
+            D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+    }
 
     // Sync
-    ThrowIfFailed(
-        mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+    createSynchronization();
 
     // Create Swapchain
-    const xwin::WindowDesc wdesc = window.getDesc();
-    resize(wdesc.width, wdesc.height);
+    resize(width, height);
 }
 
 void Renderer::destroyAPI()
 {
+    if (mFenceEvent)
+    {
+        CloseHandle(mFenceEvent);
+        mFenceEvent = nullptr;
+    }
+
     if (mFence)
     {
         mFence->Release();
         mFence = nullptr;
     }
 
-    if (mCommandAllocator)
-    {
-        ThrowIfFailed(mCommandAllocator->Reset());
-        mCommandAllocator->Release();
-        mCommandAllocator = nullptr;
-    }
+    mFrameContexts.clear();
+    mCullingSystem.reset();
+    mLodSelector.reset();
+    mJobSystem.reset();
+
+    mDescriptorAllocator.reset();
+    mRenderGraph.reset();
+    mGpuProfiler.reset();
+    mGpuAllocator.reset();
 
     if (mCommandQueue)
     {
@@ -219,36 +304,20 @@ void Renderer::destroyAPI()
 
 void Renderer::initFrameBuffer()
 {
-    mCurrentBuffer = mSwapchain->GetCurrentBackBufferIndex();
-
-    // Create descriptor heaps.
-    {
-        // Describe and create a render target view (RTV) descriptor heap.
-        D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-        rtvHeapDesc.NumDescriptors = backbufferCount;
-        rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-        rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-        ThrowIfFailed(mDevice->CreateDescriptorHeap(&rtvHeapDesc,
-                                                    IID_PPV_ARGS(&mRtvHeap)));
-
-        mRtvDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(
-            D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-    }
-
-    // Create frame resources.
+    // Create frame resources, rewriting the RTV of each frame.
+    for (UINT n = 0; n < backbufferCount; n++)
     {
-        D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle(
-            mRtvHeap->GetCPUDescriptorHandleForHeapStart());
-
-        // Create a RTV for each frame.
-        for (UINT n = 0; n < backbufferCount; n++)
+        if (mSwapchain != nullptr)
         {
             ThrowIfFailed(
                 mSwapchain->GetBuffer(n, IID_PPV_ARGS(&mRenderTargets[n])));
-            mDevice->CreateRenderTargetView(mRenderTargets[n], nullptr,
-                                            rtvHandle);
-            rtvHandle.ptr += (1 * mRtvDescriptorSize);
         }
+        else
+        {
+            mRenderTargets[n] = mOffscreenTargets[n]->resource;
+        }
+        mDevice->CreateRenderTargetView(mRenderTargets[n], nullptr,
+                                        mRtvDescriptors[n].cpu);
     }
 }
 
@@ -256,94 +325,62 @@ void Renderer::destroyFrameBuffer()
 {
     for (size_t i = 0; i < backbufferCount; ++i)
     {
-        if (mRenderTargets[i])
+        if (mOffscreenTargets[i])
+        {
+            mGpuAllocator->release(mOffscreenTargets[i]);
+            mOffscreenTargets[i] = nullptr;
+        }
+        else if (mRenderTargets[i])
         {
             mRenderTargets[i]->Release();
-            mRenderTargets[i] = 0;
         }
-    }
-    if (mRtvHeap)
-    {
-        mRtvHeap->Release();
-        mRtvHeap = nullptr;
+        mRenderTargets[i] = 0;
     }
 }
 
 void Renderer::initializeResources()
 {
-    // Create the root signature.
+    // Create the pipeline cache, pipelines it has seen before are loaded from
+    // its library instead of being compiled.
     {
-        D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
-
-        // This is the highest version the sample supports. If
-        // CheckFeatureSupport succeeds, the HighestVersion returned will not be
-        // greater than this.
-        featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+        mPipelineCache.reset(new PipelineCache(
+            mDevice, getWorkingDirectory() + "/" + mDesc.pipelineLibraryPath,
+            mDesc.pipelineWorkers));
+    }
 
-        if (FAILED(mDevice->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE,
-                                                &featureData,
-                                                sizeof(featureData))))
-        {
-            featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
-        }
+    // Create the root signature, from its cached blob when it has been
+    // serialized before.
+    {
+        mRootSignatureCache.reset(new RootSignatureCache(
+            mDevice,
+            getWorkingDirectory() + "/" + mDesc.rootSignatureCachePath));
 
-        D3D12_DESCRIPTOR_RANGE1 ranges[1];
-        ranges[0].BaseShaderRegister = 0;
-        ranges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-        ranges[0].NumDescriptors = 1;
-        ranges[0].RegisterSpace = 0;
-        ranges[0].OffsetInDescriptorsFromTableStart = 0;
-        ranges[0].Flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE;
-
-        D3D12_ROOT_PARAMETER1 rootParameters[1];
-        rootParameters[0].ParameterType =
-            D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-        rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
-
-        rootParameters[0].DescriptorTable.NumDescriptorRanges = 1;
-        rootParameters[0].DescriptorTable.pDescriptorRanges = ranges;
-
-        D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
-        rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
-        rootSignatureDesc.Desc_1_1.Flags =
+        RootSignatureDesc rootSignatureDesc;
+        rootSignatureDesc.flags =
             D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT;
-        rootSignatureDesc.Desc_1_1.NumParameters = 1;
-        rootSignatureDesc.Desc_1_1.pParameters = rootParameters;
-        rootSignatureDesc.Desc_1_1.NumStaticSamplers = 0;
-        rootSignatureDesc.Desc_1_1.pStaticSamplers = nullptr;
-
-        ID3DBlob* signature;
-        ID3DBlob* error;
-        try
-        {
-            ThrowIfFailed(D3D12SerializeVersionedRootSignature(
-                &rootSignatureDesc, &signature, &error));
-            ThrowIfFailed(mDevice->CreateRootSignature(
-                0, signature->GetBufferPointer(), signature->GetBufferSize(),
-                IID_PPV_ARGS(&mRootSignature)));
-            mRootSignature->SetName(L"Hello Triangle Root Signature");
-        }
-        catch (std::exception e)
-        {
-            const char* errStr = (const char*)error->GetBufferPointer();
-            std::cout << errStr;
-            error->Release();
-            error = nullptr;
-        }
 
-        if (signature)
-        {
-            signature->Release();
-            signature = nullptr;
-        }
+        // The view constants move around the upload ring every frame, so
+        // they're bound as a root CBV by address rather than through a
+        // descriptor table. Per-object data comes in as instance attributes.
+        mViewConstantsParameter = rootSignatureDesc.addConstantBuffer(
+            0, D3D12_SHADER_VISIBILITY_VERTEX,
+            D3D12_ROOT_DESCRIPTOR_FLAG_DATA_STATIC);
+
+        // Mesh constants are a handful of values, so they live in the root
+        // signature itself
+        mMeshConstantsParameter = rootSignatureDesc.addConstants(
+            1, sizeof(MeshConstants) / 4, D3D12_SHADER_VISIBILITY_VERTEX);
+
+        const RootSignature& rootSignature = mRootSignatureCache->get(
+            rootSignatureDesc, L"Hello Triangle Root Signature");
+        mRootSignature = rootSignature.signature;
+        mPipelineCache->addRootSignature(mRootSignature, rootSignature.blob,
+                                         rootSignature.blobSize);
+        mRootSignatureCache->save();
     }
 
     // Create the pipeline state, which includes compiling and loading shaders.
     {
-        ID3DBlob* vertexShader = nullptr;
-        ID3DBlob* pixelShader = nullptr;
-        ID3DBlob* errors = nullptr;
-
 #if defined(_DEBUG)
         // Enable better shader debugging with the graphics debugging tools.
         UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
@@ -351,157 +388,59 @@ void Renderer::initializeResources()
         UINT compileFlags = 0;
 #endif
 
-        std::string path = "";
-        char pBuf[1024];
-
-        _getcwd(pBuf, 1024);
-        path = pBuf;
-        path += "\\";
-        std::wstring wpath = std::wstring(path.begin(), path.end());
+        std::string path = getWorkingDirectory() + "/";
 
-        std::string vertCompiledPath = path, fragCompiledPath = path;
-        vertCompiledPath += "assets\\triangle.vert.dxbc";
-        fragCompiledPath += "assets\\triangle.frag.dxbc";
+        // Shaders are only compiled if their source, includes or options
+        // changed since they were cached
+        mShaderCache.reset(
+            new ShaderCache(path + mDesc.shaderCachePath, mShaderCompiler));
 
-#define COMPILESHADERS
-#ifdef COMPILESHADERS
-        std::wstring vertPath = wpath + L"assets\\triangle.vert.hlsl";
-        std::wstring fragPath = wpath + L"assets\\triangle.frag.hlsl";
+        // The vertex format is known once the mesh is mapped, the input
+        // layout and vertex shader are built to match it
+        openMesh(path + mDesc.meshPath);
+        const MeshVertexFormat vertexFormat =
+            mMeshFile.getHeader().vertexFormat;
 
-        try
-        {
-            ThrowIfFailed(D3DCompileFromFile(vertPath.c_str(), nullptr, nullptr,
-                                             "main", "vs_5_0", compileFlags, 0,
-                                             &vertexShader, &errors));
-            ThrowIfFailed(D3DCompileFromFile(fragPath.c_str(), nullptr, nullptr,
-                                             "main", "ps_5_0", compileFlags, 0,
-                                             &pixelShader, &errors));
-        }
-        catch (std::exception e)
+        ShaderDesc vertDesc;
+        vertDesc.path = path + "assets/triangle.vert.hlsl";
+        vertDesc.target = "vs_5_0";
+        vertDesc.flags = compileFlags;
+        if (vertexFormat == MeshVertexFormat::Compact)
         {
-            const char* errStr = (const char*)errors->GetBufferPointer();
-            std::cout << errStr;
-            errors->Release();
-            errors = nullptr;
+            vertDesc.defines.push_back({"COMPACT_VERTICES", "1"});
         }
 
-        std::ofstream vsOut(vertCompiledPath, std::ios::out | std::ios::binary),
-            fsOut(fragCompiledPath, std::ios::out | std::ios::binary);
+        ShaderDesc fragDesc;
+        fragDesc.path = path + "assets/triangle.frag.hlsl";
+        fragDesc.target = "ps_5_0";
+        fragDesc.flags = compileFlags;
 
-        vsOut.write((const char*)vertexShader->GetBufferPointer(),
-                    vertexShader->GetBufferSize());
-        fsOut.write((const char*)pixelShader->GetBufferPointer(),
-                    pixelShader->GetBufferSize());
+        D3D12_SHADER_BYTECODE vsBytecode = mShaderCache->getShader(vertDesc);
+        D3D12_SHADER_BYTECODE psBytecode = mShaderCache->getShader(fragDesc);
+        mShaderCache->save();
 
-#else
-        std::vector<char> vsBytecodeData = readFile(vertCompiledPath);
-        std::vector<char> fsBytecodeData = readFile(fragCompiledPath);
-
-#endif
         // Define the vertex input layout.
-        D3D12_INPUT_ELEMENT_DESC inputElementDescs[] = {
-            {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
-             D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-            {"COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12,
-             D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}};
+        const std::vector<D3D12_INPUT_ELEMENT_DESC> inputElementDescs =
+            getInputLayout(vertexFormat);
 
-        // Create the UBO.
-        {
-            // Note: using upload heaps to transfer static data like vert
-            // buffers is not recommended. Every time the GPU needs it, the
-            // upload heap will be marshalled over. Please read up on Default
-            // Heap usage. An upload heap is used here for code simplicity and
-            // because there are very few verts to actually transfer.
-            D3D12_HEAP_PROPERTIES heapProps;
-            heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-            heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-            heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-            heapProps.CreationNodeMask = 1;
-            heapProps.VisibleNodeMask = 1;
-
-            D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-            heapDesc.NumDescriptors = 1;
-            heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-            heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-            ThrowIfFailed(mDevice->CreateDescriptorHeap(
-                &heapDesc, IID_PPV_ARGS(&mUniformBufferHeap)));
-
-            D3D12_RESOURCE_DESC uboResourceDesc;
-            uboResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-            uboResourceDesc.Alignment = 0;
-            uboResourceDesc.Width = (sizeof(uboVS) + 255) & ~255;
-            uboResourceDesc.Height = 1;
-            uboResourceDesc.DepthOrArraySize = 1;
-            uboResourceDesc.MipLevels = 1;
-            uboResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-            uboResourceDesc.SampleDesc.Count = 1;
-            uboResourceDesc.SampleDesc.Quality = 0;
-            uboResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-            uboResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-            ThrowIfFailed(mDevice->CreateCommittedResource(
-                &heapProps, D3D12_HEAP_FLAG_NONE, &uboResourceDesc,
-                D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-                IID_PPV_ARGS(&mUniformBuffer)));
-            mUniformBufferHeap->SetName(
-                L"Constant Buffer Upload Resource Heap");
-
-            D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-            cbvDesc.BufferLocation = mUniformBuffer->GetGPUVirtualAddress();
-            cbvDesc.SizeInBytes =
-                (sizeof(uboVS) + 255) &
-                ~255; // CB size is required to be 256-byte aligned.
-
-            D3D12_CPU_DESCRIPTOR_HANDLE cbvHandle(
-                mUniformBufferHeap->GetCPUDescriptorHandleForHeapStart());
-            cbvHandle.ptr =
-                cbvHandle.ptr + mDevice->GetDescriptorHandleIncrementSize(
-                                    D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV) *
-                                    0;
-
-            mDevice->CreateConstantBufferView(&cbvDesc, cbvHandle);
-
-            // We do not intend to read from this resource on the CPU. (End is
-            // less than or equal to begin)
-            D3D12_RANGE readRange;
-            readRange.Begin = 0;
-            readRange.End = 0;
-
-            ThrowIfFailed(mUniformBuffer->Map(
-                0, &readRange,
-                reinterpret_cast<void**>(&mMappedUniformBuffer)));
-            memcpy(mMappedUniformBuffer, &uboVS, sizeof(uboVS));
-            mUniformBuffer->Unmap(0, &readRange);
-        }
+        // Create the upload ring the UBO, instance data and indirect
+        // arguments are written to each frame.
+        mUploadRing.reset(
+            new UploadRing(mGpuAllocator.get(), mDesc.uploadRingSize));
 
         // Describe and create the graphics pipeline state object (PSO).
         D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-        psoDesc.InputLayout = {inputElementDescs, _countof(inputElementDescs)};
+        psoDesc.InputLayout = {inputElementDescs.data(),
+                               (UINT)inputElementDescs.size()};
         psoDesc.pRootSignature = mRootSignature;
 
-        D3D12_SHADER_BYTECODE vsBytecode;
-        D3D12_SHADER_BYTECODE psBytecode;
-
-#ifdef COMPILESHADERS
-        vsBytecode.pShaderBytecode = vertexShader->GetBufferPointer();
-        vsBytecode.BytecodeLength = vertexShader->GetBufferSize();
-
-        psBytecode.pShaderBytecode = pixelShader->GetBufferPointer();
-        psBytecode.BytecodeLength = pixelShader->GetBufferSize();
-#else
-        vsBytecode.pShaderBytecode = vsBytecodeData.data();
-        vsBytecode.BytecodeLength = vsBytecodeData.size();
-
-        psBytecode.pShaderBytecode = fsBytecodeData.data();
-        psBytecode.BytecodeLength = fsBytecodeData.size();
-#endif
-
         psoDesc.VS = vsBytecode;
         psoDesc.PS = psBytecode;
 
         D3D12_RASTERIZER_DESC rasterDesc;
         rasterDesc.FillMode = D3D12_FILL_MODE_SOLID;
-        rasterDesc.CullMode = D3D12_CULL_MODE_NONE;
+        rasterDesc.CullMode = mDesc.backfaceCulling ? D3D12_CULL_MODE_BACK
+                                                    : D3D12_CULL_MODE_NONE;
         rasterDesc.FrontCounterClockwise = FALSE;
         rasterDesc.DepthBias = D3D12_DEFAULT_DEPTH_BIAS;
         rasterDesc.DepthBiasClamp = D3D12_DEFAULT_DEPTH_BIAS_CLAMP;
@@ -541,314 +480,339 @@ void Renderer::initializeResources()
         psoDesc.NumRenderTargets = 1;
         psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
         psoDesc.SampleDesc.Count = 1;
-        try
-        {
-            ThrowIfFailed(mDevice->CreateGraphicsPipelineState(
-                &psoDesc, IID_PPV_ARGS(&mPipelineState)));
-        }
-        catch (std::exception e)
-        {
-            std::cout << "Failed to create Graphics Pipeline!";
-        }
-
-        if (vertexShader)
-        {
-            vertexShader->Release();
-            vertexShader = nullptr;
-        }
 
-        if (pixelShader)
-        {
-            pixelShader->Release();
-            pixelShader = nullptr;
-        }
+        // It's created on a worker while the geometry uploads
+        mPipeline = mPipelineCache->request(psoDesc, L"Hello Triangle PSO");
     }
 
     createCommands();
 
-    // Command lists are created in the recording state, but there is nothing
-    // to record yet. The main loop expects it to be closed, so close it now.
-    ThrowIfFailed(mCommandList->Close());
-
-    // Create the vertex buffer.
-    {
-        const UINT vertexBufferSize = sizeof(mVertexBufferData);
-
-        // Note: using upload heaps to transfer static data like vert buffers is
-        // not recommended. Every time the GPU needs it, the upload heap will be
-        // marshalled over. Please read up on Default Heap usage. An upload heap
-        // is used here for code simplicity and because there are very few verts
-        // to actually transfer.
-        D3D12_HEAP_PROPERTIES heapProps;
-        heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-        heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-        heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        heapProps.CreationNodeMask = 1;
-        heapProps.VisibleNodeMask = 1;
-
-        D3D12_RESOURCE_DESC vertexBufferResourceDesc;
-        vertexBufferResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        vertexBufferResourceDesc.Alignment = 0;
-        vertexBufferResourceDesc.Width = vertexBufferSize;
-        vertexBufferResourceDesc.Height = 1;
-        vertexBufferResourceDesc.DepthOrArraySize = 1;
-        vertexBufferResourceDesc.MipLevels = 1;
-        vertexBufferResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-        vertexBufferResourceDesc.SampleDesc.Count = 1;
-        vertexBufferResourceDesc.SampleDesc.Quality = 0;
-        vertexBufferResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-        vertexBufferResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-        ThrowIfFailed(mDevice->CreateCommittedResource(
-            &heapProps, D3D12_HEAP_FLAG_NONE, &vertexBufferResourceDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-            IID_PPV_ARGS(&mVertexBuffer)));
-
-        // Copy the triangle data to the vertex buffer.
-        UINT8* pVertexDataBegin;
-
-        // We do not intend to read from this resource on the CPU.
-        D3D12_RANGE readRange;
-        readRange.Begin = 0;
-        readRange.End = 0;
-
-        ThrowIfFailed(mVertexBuffer->Map(
-            0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-        memcpy(pVertexDataBegin, mVertexBufferData, sizeof(mVertexBufferData));
-        mVertexBuffer->Unmap(0, nullptr);
-
-        // Initialize the vertex buffer view.
-        mVertexBufferView.BufferLocation =
-            mVertexBuffer->GetGPUVirtualAddress();
-        mVertexBufferView.StrideInBytes = sizeof(Vertex);
-        mVertexBufferView.SizeInBytes = vertexBufferSize;
-    }
-
-    // Create the index buffer.
-    {
-        const UINT indexBufferSize = sizeof(mIndexBufferData);
-
-        // Note: using upload heaps to transfer static data like vert buffers is
-        // not recommended. Every time the GPU needs it, the upload heap will be
-        // marshalled over. Please read up on Default Heap usage. An upload heap
-        // is used here for code simplicity and because there are very few verts
-        // to actually transfer.
-        D3D12_HEAP_PROPERTIES heapProps;
-        heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
-        heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
-        heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-        heapProps.CreationNodeMask = 1;
-        heapProps.VisibleNodeMask = 1;
-
-        D3D12_RESOURCE_DESC vertexBufferResourceDesc;
-        vertexBufferResourceDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-        vertexBufferResourceDesc.Alignment = 0;
-        vertexBufferResourceDesc.Width = indexBufferSize;
-        vertexBufferResourceDesc.Height = 1;
-        vertexBufferResourceDesc.DepthOrArraySize = 1;
-        vertexBufferResourceDesc.MipLevels = 1;
-        vertexBufferResourceDesc.Format = DXGI_FORMAT_UNKNOWN;
-        vertexBufferResourceDesc.SampleDesc.Count = 1;
-        vertexBufferResourceDesc.SampleDesc.Quality = 0;
-        vertexBufferResourceDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-        vertexBufferResourceDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-
-        ThrowIfFailed(mDevice->CreateCommittedResource(
-            &heapProps, D3D12_HEAP_FLAG_NONE, &vertexBufferResourceDesc,
-            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-            IID_PPV_ARGS(&mIndexBuffer)));
-
-        // Copy the triangle data to the vertex buffer.
-        UINT8* pVertexDataBegin;
-
-        // We do not intend to read from this resource on the CPU.
-        D3D12_RANGE readRange;
-        readRange.Begin = 0;
-        readRange.End = 0;
-
-        ThrowIfFailed(mIndexBuffer->Map(
-            0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-        memcpy(pVertexDataBegin, mIndexBufferData, sizeof(mIndexBufferData));
-        mIndexBuffer->Unmap(0, nullptr);
-
-        // Initialize the vertex buffer view.
-        mIndexBufferView.BufferLocation = mIndexBuffer->GetGPUVirtualAddress();
-        mIndexBufferView.Format = DXGI_FORMAT_R32_UINT;
-        mIndexBufferView.SizeInBytes = indexBufferSize;
-    }
-
-    // Create synchronization objects and wait until assets have been uploaded
-    // to the GPU.
-    {
-        mFenceValue = 1;
-
-        // Create an event handle to use for frame synchronization.
-        mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-        if (mFenceEvent == nullptr)
-        {
-            ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-        }
+    // Indirect draws only change draw arguments, so the signature needs no
+    // root signature.
+    {
+        D3D12_INDIRECT_ARGUMENT_DESC argumentDesc = {};
+        argumentDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+        D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+        signatureDesc.ByteStride = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+        signatureDesc.NumArgumentDescs = 1;
+        signatureDesc.pArgumentDescs = &argumentDesc;
+        ThrowIfFailed(mDevice->CreateCommandSignature(
+            &signatureDesc, nullptr, IID_PPV_ARGS(&mCommandSignature)));
+    }
 
-        // Wait for the command list to execute; we are reusing the same command
-        // list in our main loop but for now, we just want to wait for setup to
-        // complete before continuing.
-        // Signal and increment the fence value.
-        const UINT64 fence = mFenceValue;
-        ThrowIfFailed(mCommandQueue->Signal(mFence, fence));
-        mFenceValue++;
+    // Create the vertex and index buffers in default heaps, their data is
+    // staged and copied over on the copy queue.
+    {
+        mGeometryUploader.reset(
+            new GeometryUploader(mDevice, mGpuAllocator.get()));
 
-        // Wait until the previous frame is finished.
-        if (mFence->GetCompletedValue() < fence)
-        {
-            ThrowIfFailed(mFence->SetEventOnCompletion(fence, mFenceEvent));
-            WaitForSingleObject(mFenceEvent, INFINITE);
-        }
+        uploadMesh();
 
-        mFrameIndex = mSwapchain->GetCurrentBackBufferIndex();
+        // Both copies go out in one batch, and the direct queue waits for it
+        // on the GPU before drawing with them.
+        mGeometryUploader->waitOnQueue(mCommandQueue,
+                                       mGeometryUploader->flush());
     }
-}
 
-void Renderer::destroyResources()
-{
-    // Sync
-    CloseHandle(mFenceEvent);
-
-    if (mPipelineState)
+    // Wait until assets have been uploaded to the GPU.
     {
-        mPipelineState->Release();
-        mPipelineState = nullptr;
+        mPipelineState = mPipelineCache->wait(mPipeline);
+        mPipelineStates.push_back(mPipelineState);
+        mPipelineCache->save();
+
+        waitForGpu();
     }
+}
 
-    if (mRootSignature)
+void Renderer::openMesh(const std::string& path)
+{
+    const std::string cookedPath = getCookedMeshPath(path);
+    MeshCookOptions options;
+    options.vertexFormat = mDesc.compactVertices ? MeshVertexFormat::Compact
+                                                 : MeshVertexFormat::Standard;
+
+    // The cooked file is only rebuilt when it can't be used as is
+    auto start = std::chrono::steady_clock::now();
+    if (!mMeshFile.open(cookedPath) ||
+        mMeshFile.getHeader().vertexFormat != options.vertexFormat)
     {
-        mRootSignature->Release();
-        mRootSignature = nullptr;
+        mMeshFile.close();
+        std::string errors;
+        if (!cookMesh(path, cookedPath, options, errors) ||
+            !mMeshFile.open(cookedPath))
+        {
+            throw std::runtime_error("failed to cook mesh! " + errors);
+        }
+        mMeshLoadStats.cooks++;
+        mMeshLoadStats.cookTime += std::chrono::duration<double, std::milli>(
+                                       std::chrono::steady_clock::now() - start)
+                                       .count();
+        start = std::chrono::steady_clock::now();
     }
-
-    if (mVertexBuffer)
+    mMeshLoadStats.loads++;
+    mMeshLoadStats.bytesMapped += mMeshFile.getHeader().fileSize;
+    mMeshLoadStats.loadTime += std::chrono::duration<double, std::milli>(
+                                   std::chrono::steady_clock::now() - start)
+                                   .count();
+
+    const MeshFileHeader& header = mMeshFile.getHeader();
+    for (unsigned axis = 0; axis < 3; ++axis)
     {
-        mVertexBuffer->Release();
-        mVertexBuffer = nullptr;
+        mMeshConstants.positionScale[axis] = header.positionScale[axis];
+        mMeshConstants.positionOffset[axis] = header.positionOffset[axis];
     }
+    mMeshConstants.positionScale[3] = 0.0f;
+    mMeshConstants.positionOffset[3] = 1.0f;
+}
 
-    if (mIndexBuffer)
+void Renderer::uploadMesh()
+{
+    // Sections are staged straight from the mapping, which can be closed as
+    // soon as they're copied out
+    const auto start = std::chrono::steady_clock::now();
+    const MeshFileHeader& header = mMeshFile.getHeader();
+
+    const UINT vertexBufferSize = (UINT)mMeshFile.getVertexDataSize();
+    mVertexBuffer = mGeometryUploader->createBuffer(
+        mMeshFile.getVertexData(), vertexBufferSize, L"Vertex Buffer");
+
+    mVertexBufferView.BufferLocation =
+        mVertexBuffer->resource->GetGPUVirtualAddress();
+    mVertexBufferView.StrideInBytes = header.vertexStride;
+    mVertexBufferView.SizeInBytes = vertexBufferSize;
+
+    // Both buffers decay back to the common state after every frame, and
+    // their views are all that refer to them
+    mVertexBuffer->movable = true;
+    mVertexBuffer->onMoved = [this](GpuAllocation& allocation) {
+        mVertexBufferView.BufferLocation =
+            allocation.resource->GetGPUVirtualAddress();
+    };
+
+    const UINT indexBufferSize = (UINT)mMeshFile.getIndexDataSize();
+    mIndexBuffer = mGeometryUploader->createBuffer(
+        mMeshFile.getIndexData(), indexBufferSize, L"Index Buffer");
+
+    mIndexBufferView.BufferLocation =
+        mIndexBuffer->resource->GetGPUVirtualAddress();
+    mIndexBufferView.Format =
+        header.indexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    mIndexBufferView.SizeInBytes = indexBufferSize;
+    mIndexBuffer->movable = true;
+    mIndexBuffer->onMoved = [this](GpuAllocation& allocation) {
+        mIndexBufferView.BufferLocation =
+            allocation.resource->GetGPUVirtualAddress();
+    };
+    mMeshLoadStats.vertexBytes += vertexBufferSize;
+    mMeshLoadStats.indexBytes += indexBufferSize;
+
+    // Every submesh is a mesh of its own, they share these buffers so
+    // indirect draws never rebind them. Levels of detail are meshes too,
+    // after every submesh, drawn with their submesh's vertices and bounds.
+    const MeshSubmesh* submeshes = mMeshFile.getSubmeshes();
+    const MeshLod* lods = mMeshFile.getLods();
+    const uint32_t submeshCount = mMeshFile.getSubmeshCount();
+    for (uint32_t i = 0; i < submeshCount; ++i)
     {
-        mIndexBuffer->Release();
-        mIndexBuffer = nullptr;
+        MeshRange mesh;
+        mesh.indexCount = submeshes[i].indexCount;
+        mesh.firstIndex = submeshes[i].firstIndex;
+        mesh.baseVertex = submeshes[i].baseVertex;
+        std::copy(submeshes[i].boundsMin, submeshes[i].boundsMin + 3,
+                  mesh.boundsMin);
+        std::copy(submeshes[i].boundsMax, submeshes[i].boundsMax + 3,
+                  mesh.boundsMax);
+        mesh.firstMeshlet = submeshes[i].firstMeshlet;
+        mesh.meshletCount = submeshes[i].meshletCount;
+        mesh.firstLod = submeshCount + submeshes[i].firstLod;
+        mesh.lodCount = submeshes[i].lodCount;
+        mesh.error = 0.0f;
+        mMeshes.push_back(mesh);
     }
-
-    if (mUniformBuffer)
+    for (uint32_t i = 0; i < submeshCount; ++i)
     {
-        mUniformBuffer->Release();
-        mUniformBuffer = nullptr;
+        for (uint32_t level = 0; level < submeshes[i].lodCount; ++level)
+        {
+            const MeshLod& lod = lods[submeshes[i].firstLod + level];
+            MeshRange mesh = mMeshes[i];
+            mesh.indexCount = lod.indexCount;
+            mesh.firstIndex = lod.firstIndex;
+            mesh.firstMeshlet = lod.firstMeshlet;
+            mesh.meshletCount = lod.meshletCount;
+            mesh.firstLod = 0;
+            mesh.lodCount = 0;
+            mesh.error = lod.error;
+            mMeshes.push_back(mesh);
+        }
     }
+    mClusterCuller.setMeshlets(mMeshFile.getMeshlets(),
+                               mMeshFile.getMeshletCount());
+    mMeshFile.close();
+
+    mMeshLoadStats.uploadTime += std::chrono::duration<double, std::milli>(
+                                     std::chrono::steady_clock::now() - start)
+                                     .count();
+}
 
-    if (mUniformBufferHeap)
+void Renderer::destroyResources()
+{
+    // Pipelines are owned by the cache
+    mPipelineState = nullptr;
+    mPipelineStates.clear();
+    mPipeline = nullptr;
+    mPipelineCache.reset();
+
+    // Root signatures are owned by their cache
+    mRootSignature = nullptr;
+    mRootSignatureCache.reset();
+
+    if (mCommandSignature)
     {
-        mUniformBufferHeap->Release();
-        mUniformBufferHeap = nullptr;
+        mCommandSignature->Release();
+        mCommandSignature = nullptr;
     }
+
+    mGpuAllocator->release(mVertexBuffer);
+    mVertexBuffer = nullptr;
+
+    mGpuAllocator->release(mIndexBuffer);
+    mIndexBuffer = nullptr;
+    mMeshes.clear();
+
+    mUploadRing.reset();
+    mGeometryUploader.reset();
 }
 
 void Renderer::createCommands()
 {
-    // Create the command list.
-    ThrowIfFailed(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
-                                             mCommandAllocator, mPipelineState,
-                                             IID_PPV_ARGS(&mCommandList)));
-    mCommandList->SetName(L"Hello Triangle Command List");
+    // Every batch of draws is recorded into a command list of its own, on
+    // whichever thread of the job system picks it up.
+    mCommandRecorder.reset(new CommandRecorder(mDevice, *mJobSystem,
+                                               mDesc.framesInFlight));
 }
 
 void Renderer::setupCommands()
 {
     // Command list allocators can only be reset when the associated
-    // command lists have finished execution on the GPU; apps should use
-    // fences to determine GPU execution progress.
-    ThrowIfFailed(mCommandAllocator->Reset());
-
-    // However, when ExecuteCommandList() is called on a particular command
-    // list, that command list can then be reset at any time and must be before
-    // re-recording.
-    ThrowIfFailed(mCommandList->Reset(mCommandAllocator, mPipelineState));
-
-    // Set necessary state.
-    mCommandList->SetGraphicsRootSignature(mRootSignature);
-    mCommandList->RSSetViewports(1, &mViewport);
-    mCommandList->RSSetScissorRects(1, &mSurfaceSize);
-
-    ID3D12DescriptorHeap* pDescriptorHeaps[] = {mUniformBufferHeap};
-    mCommandList->SetDescriptorHeaps(_countof(pDescriptorHeaps),
-                                     pDescriptorHeaps);
-
-    D3D12_GPU_DESCRIPTOR_HANDLE srvHandle(
-        mUniformBufferHeap->GetGPUDescriptorHandleForHeapStart());
-    mCommandList->SetGraphicsRootDescriptorTable(0, srvHandle);
-
-    // Indicate that the back buffer will be used as a render target.
-    D3D12_RESOURCE_BARRIER renderTargetBarrier;
-    renderTargetBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    renderTargetBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    renderTargetBarrier.Transition.pResource = mRenderTargets[mFrameIndex];
-    renderTargetBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_PRESENT;
-    renderTargetBarrier.Transition.StateAfter =
-        D3D12_RESOURCE_STATE_RENDER_TARGET;
-    renderTargetBarrier.Transition.Subresource =
-        D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-
-    mCommandList->ResourceBarrier(1, &renderTargetBarrier);
-
-    D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle(
-        mRtvHeap->GetCPUDescriptorHandleForHeapStart());
-    rtvHandle.ptr = rtvHandle.ptr + (mFrameIndex * mRtvDescriptorSize);
-    mCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
-
-    // Record commands.
-    const float clearColor[] = {0.2f, 0.2f, 0.2f, 1.0f};
-    mCommandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-    mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    mCommandList->IASetVertexBuffers(0, 1, &mVertexBufferView);
-    mCommandList->IASetIndexBuffer(&mIndexBufferView);
-
-    mCommandList->DrawIndexedInstanced(3, 1, 0, 0, 0);
-
-    // Indicate that the back buffer will now be used to present.
-    D3D12_RESOURCE_BARRIER presentBarrier;
-    presentBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-    presentBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    presentBarrier.Transition.pResource = mRenderTargets[mFrameIndex];
-    presentBarrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
-    presentBarrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
-    presentBarrier.Transition.Subresource =
-        D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-
-    mCommandList->ResourceBarrier(1, &presentBarrier);
-
-    ThrowIfFailed(mCommandList->Close());
+    // command lists have finished execution on the GPU; render() waits on
+    // this frame's fence value before recording into it again.
+    mCommandRecorder->beginFrame(mFrameContextIndex);
+
+    // Compact buffers into free space below them in a list of its own, which
+    // executes before the scene. Recording waits for it, so moved buffers'
+    // views are recreated before any batch of draws reads them.
+    if (mDesc.defragmentBytes > 0 &&
+        mGpuAllocator->getStats().fragmentation > 0.0)
+    {
+        mCommandRecorder->record(
+            1, nullptr, [&](ID3D12GraphicsCommandList* commandList, uint32_t) {
+                mGpuAllocator->defragment(commandList, mDesc.defragmentBytes);
+            });
+    }
+
+    const uint32_t drawCount = (uint32_t)mClusterCuller.getDraws().size();
+    const uint32_t drawsPerBatch = std::max(mDesc.drawsPerBatch, 1u);
+    const uint32_t batchCount =
+        std::max((drawCount + drawsPerBatch - 1) / drawsPerBatch, 1u);
+
+    // The frame is a graph of passes, which derives the back buffer's
+    // transitions from how the passes use it
+    mRenderGraph->reset();
+    const RenderGraphResource backBuffer = mRenderGraph->importResource(
+        "Back Buffer", mRenderTargets[mFrameIndex],
+        D3D12_RESOURCE_STATE_PRESENT);
+    const RenderGraphPass scene = mRenderGraph->addPass(
+        "Scene", batchCount, mPipelineState,
+        [&](ID3D12GraphicsCommandList* commandList, uint32_t batch) {
+            const uint32_t firstDraw =
+                std::min(batch * drawsPerBatch, drawCount);
+            const uint32_t lastDraw =
+                std::min(firstDraw + drawsPerBatch, drawCount);
+            recordBatch(commandList, batch == 0, firstDraw, lastDraw);
+        });
+    mRenderGraph->write(scene, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    mRenderGraph->compile();
+    mRenderGraph->execute(*mCommandRecorder);
 }
 
-void Renderer::destroyCommands()
+void Renderer::recordBatch(ID3D12GraphicsCommandList* commandList,
+                           bool firstBatch, uint32_t firstDraw,
+                           uint32_t lastDraw)
 {
-    if (mCommandList)
+    // State doesn't carry over between command lists, so every batch sets
+    // everything it draws with.
+    commandList->SetGraphicsRootSignature(mRootSignature);
+    commandList->RSSetViewports(1, &mViewport);
+    commandList->RSSetScissorRects(1, &mSurfaceSize);
+
+    commandList->SetGraphicsRootConstantBufferView(mViewConstantsParameter,
+                                                   mUniformAddress);
+    setRootConstants(commandList, mMeshConstantsParameter, mMeshConstants);
+
+    const D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle =
+        mRtvDescriptors[mFrameIndex].cpu;
+    commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+
+    // Record commands. Lists execute in batch order, so the clear in the
+    // first one lands before any draw.
+    if (firstBatch)
+    {
+        const float clearColor[] = {0.2f, 0.2f, 0.2f, 1.0f};
+        commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+    }
+    commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    const D3D12_VERTEX_BUFFER_VIEW vertexBufferViews[] = {
+        mVertexBufferView, mInstanceBufferView};
+    commandList->IASetVertexBuffers(0, 2, vertexBufferViews);
+    commandList->IASetIndexBuffer(&mIndexBufferView);
+
+    // Draws are sorted by pipeline, so it only changes between runs. Lists
+    // start out with the state of pipeline 0.
+    const std::vector<ClusterDraw>& draws = mClusterCuller.getDraws();
+    uint32_t pipeline = 0;
+    for (uint32_t i = firstDraw; i < lastDraw;)
     {
-        mCommandList->Reset(mCommandAllocator, mPipelineState);
-        mCommandList->ClearState(mPipelineState);
-        ThrowIfFailed(mCommandList->Close());
-        ID3D12CommandList* ppCommandLists[] = {mCommandList};
-        mCommandQueue->ExecuteCommandLists(_countof(ppCommandLists),
-                                           ppCommandLists);
+        if (draws[i].pipeline != pipeline)
+        {
+            pipeline = draws[i].pipeline;
+            commandList->SetPipelineState(mPipelineStates[pipeline]);
+        }
+
+        uint32_t runEnd = i + 1;
+        while (runEnd < lastDraw && draws[runEnd].pipeline == pipeline)
+        {
+            ++runEnd;
+        }
 
-        // Wait for GPU to finish work
-        const UINT64 fence = mFenceValue;
-        ThrowIfFailed(mCommandQueue->Signal(mFence, fence));
-        mFenceValue++;
-        if (mFence->GetCompletedValue() < fence)
+        if (mDesc.indirectDraws)
+        {
+            commandList->ExecuteIndirect(
+                mCommandSignature, runEnd - i, mUploadRing->getResource(),
+                mArgumentOffset + i * sizeof(D3D12_DRAW_INDEXED_ARGUMENTS),
+                nullptr, 0);
+        }
+        else
         {
-            ThrowIfFailed(mFence->SetEventOnCompletion(fence, mFenceEvent));
-            WaitForSingleObject(mFenceEvent, INFINITE);
+            for (; i < runEnd; ++i)
+            {
+                commandList->DrawIndexedInstanced(
+                    draws[i].indexCount, draws[i].instanceCount,
+                    draws[i].firstIndex, draws[i].baseVertex,
+                    draws[i].firstInstance);
+            }
         }
+        i = runEnd;
+    }
+}
 
-        mCommandList->Release();
-        mCommandList = nullptr;
+void Renderer::destroyCommands()
+{
+    // Wait for GPU to finish work before releasing any allocator
+    if (mCommandRecorder)
+    {
+        waitForGpu();
+        mCommandRecorder.reset();
     }
 }
 
@@ -867,17 +831,38 @@ void Renderer::setupSwapchain(unsigned width, unsigned height)
     mViewport.MinDepth = .1f;
     mViewport.MaxDepth = 1000.f;
 
-    // Update Uniforms
-    float zoom = 2.5f;
-
-    // Update matrices
-    uboVS.projectionMatrix =
-        glm::perspective(45.0f, (float)mWidth / (float)mHeight, 0.01f, 1024.0f);
-
-    uboVS.viewMatrix =
-        glm::translate(glm::identity<mat4>(), vec3(0.0f, 0.0f, zoom));
+    if (mWindow == nullptr)
+    {
+        // Offscreen frames rotate through plain render targets, in the state
+        // swapchain buffers are in between frames
+        D3D12_RESOURCE_DESC targetDesc = {};
+        targetDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        targetDesc.Width = mWidth;
+        targetDesc.Height = mHeight;
+        targetDesc.DepthOrArraySize = 1;
+        targetDesc.MipLevels = 1;
+        targetDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        targetDesc.SampleDesc.Count = 1;
+        targetDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+        targetDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+
+        D3D12_CLEAR_VALUE clearValue = {};
+        clearValue.Format = targetDesc.Format;
+        clearValue.Color[0] = 0.2f;
+        clearValue.Color[1] = 0.2f;
+        clearValue.Color[2] = 0.2f;
+        clearValue.Color[3] = 1.0f;
 
-    uboVS.modelMatrix = glm::identity<mat4>();
+        for (UINT n = 0; n < backbufferCount; n++)
+        {
+            mOffscreenTargets[n] = mGpuAllocator->createResource(
+                D3D12_HEAP_TYPE_DEFAULT, targetDesc,
+                D3D12_RESOURCE_STATE_PRESENT, &clearValue,
+                L"Offscreen Target");
+        }
+        mFrameIndex = 0;
+        return;
+    }
 
     if (mSwapchain != nullptr)
     {
@@ -895,8 +880,15 @@ void Renderer::setupSwapchain(unsigned width, unsigned height)
         swapchainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
         swapchainDesc.SampleDesc.Count = 1;
 
+#if defined(XGFX_NOOP)
+        // There's no OS window to present to, so the swapchain is windowless
+        IDXGISwapChain1* swapchain = nullptr;
+        ThrowIfFailed(mFactory->CreateSwapChainForComposition(
+            mCommandQueue, &swapchainDesc, nullptr, &swapchain));
+#else
         IDXGISwapChain1* swapchain = xgfx::createSwapchain(
             mWindow, mFactory, mCommandQueue, &swapchainDesc);
+#endif
         HRESULT swapchainSupport = swapchain->QueryInterface(
             __uuidof(IDXGISwapChain3), (void**)&swapchain);
         if (SUCCEEDED(swapchainSupport))
@@ -907,86 +899,296 @@ void Renderer::setupSwapchain(unsigned width, unsigned height)
     mFrameIndex = mSwapchain->GetCurrentBackBufferIndex();
 }
 
+void Renderer::present()
+{
+    if (mSwapchain == nullptr)
+    {
+        mFrameIndex = (mFrameIndex + 1) % backbufferCount;
+        return;
+    }
+    mSwapchain->Present(1, 0);
+    mFrameIndex = mSwapchain->GetCurrentBackBufferIndex();
+}
+
 void Renderer::resize(unsigned width, unsigned height)
 {
     mWidth = clamp(width, 1u, 0xffffu);
     mHeight = clamp(height, 1u, 0xffffu);
 
-    // WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
-    // This is code implemented as such for simplicity. The
-    // D3D12HelloFrameBuffering sample illustrates how to use fences for
-    // efficient resource usage and to maximize GPU utilization.
+    // The swapchain buffers can't be released while any frame in flight
+    // still references them, so resizing drains the GPU.
+    waitForGpu();
 
-    // Signal and increment the fence value.
-    const UINT64 fence = mFenceValue;
-    ThrowIfFailed(mCommandQueue->Signal(mFence, fence));
-    mFenceValue++;
+    destroyFrameBuffer();
+    setupSwapchain(width, height);
+    initFrameBuffer();
+}
 
-    // Wait until the previous frame is finished.
-    if (mFence->GetCompletedValue() < fence)
+void Renderer::render(const FramePacket& packet)
+{
+    const int64_t frameStart = Profiler::now();
+    int64_t presentWait = 0;
     {
-        ThrowIfFailed(mFence->SetEventOnCompletion(fence, mFenceEvent));
-        WaitForSingleObjectEx(mFenceEvent, INFINITE, false);
+        PROFILE_SCOPE("Render");
+        renderFrame(packet, presentWait);
     }
 
-    destroyFrameBuffer();
-    setupSwapchain(width, height);
-    initFrameBuffer();
+    // Scopes are drained every frame so thread queues never fill up
+    profiler().addFrame((double)(Profiler::now() - frameStart) / 1e6,
+                        (double)presentWait / 1e6);
+    profiler().collect();
 }
 
-void Renderer::render()
+void Renderer::renderFrame(const FramePacket& packet, int64_t& presentWait)
 {
-    // Framelimit set to 60 fps
-    tEnd = std::chrono::high_resolution_clock::now();
-    float time =
-        std::chrono::duration<float, std::milli>(tEnd - tStart).count();
-    if (time < (1000.0f / 60.0f))
+    // The main thread asks for resizes, but only this thread touches the
+    // swapchain.
+    if (packet.resize)
     {
-        return;
+        resize(packet.width, packet.height);
+    }
+
+    // Only wait when the CPU has lapped the GPU, that is when the frame
+    // context we're about to reuse is still being executed. Its timestamps
+    // are ready once it has finished.
+    FrameContext& frame = mFrameContexts[mFrameContextIndex];
+    int64_t waitStart = Profiler::now();
+    {
+        PROFILE_SCOPE("Wait For Frame");
+        waitForFenceValue(frame.fenceValue);
+    }
+    presentWait += Profiler::now() - waitStart;
+    if (mGpuProfiler)
+    {
+        mGpuProfiler->beginFrame(mFrameContextIndex);
+    }
+
+    // Recycle upload ring memory from every frame the GPU has finished.
+    mUploadRing->retire(mFence->GetCompletedValue());
+    mGeometryUploader->retire();
+    mGpuAllocator->retire(mFence->GetCompletedValue());
+    mRenderGraph->retire(mFence->GetCompletedValue());
+    mDescriptorAllocator->retire(mFence->GetCompletedValue());
+
+    {
+        // Update Uniforms, copying into fresh ring memory since earlier
+        // copies may still be in use.
+        mViewConstants.viewProjectionMatrix =
+            packet.projectionMatrix * packet.viewMatrix;
+        mUniformAddress = mUploadRing->upload(mViewConstants).gpuAddress;
     }
-    tStart = std::chrono::high_resolution_clock::now();
 
+    // Skip everything outside the view, pick the level of detail of what's
+    // left, then collapse draws sharing a mesh and pipeline into instanced
+    // ones, cull the meshlets of single draws of large meshes, and write
+    // their instance data and arguments where the GPU reads them.
     {
-        // Update Uniforms
-        mElapsedTime += 0.001f * time;
-        mElapsedTime = fmodf(mElapsedTime, 6.283185307179586f);
+        for (const DrawItem& draw : packet.draws)
+        {
+            if (draw.mesh >= mMeshes.size() ||
+                draw.pipeline >= mPipelineStates.size())
+            {
+                throw std::runtime_error("draw item refers to a missing mesh "
+                                         "or pipeline!");
+            }
+        }
+        const std::vector<uint32_t>* visible = nullptr;
+        if (mDesc.frustumCulling)
+        {
+            PROFILE_SCOPE("Cull");
+            mCullingSystem->cull(packet.draws, mMeshes,
+                                 mViewConstants.viewProjectionMatrix);
+            visible = &mCullingSystem->getVisible();
+        }
 
-        uboVS.modelMatrix = glm::rotate(uboVS.modelMatrix, 0.001f * time,
-                                        vec3(0.0f, 1.0f, 0.0f));
+        // The camera sits at the view matrix's inverse translation
+        const glm::vec3 cameraPosition =
+            glm::vec3(glm::inverse(packet.viewMatrix)[3]);
+        const std::vector<uint32_t>* levels = nullptr;
+        if (mDesc.levelOfDetail)
+        {
+            PROFILE_SCOPE("Select Levels");
+            mLodSelector->select(
+                packet.draws, mMeshes, visible, cameraPosition,
+                packet.projectionMatrix[1][1] * (float)mHeight * 0.5f,
+                mDesc.lodPixelError);
+            levels = &mLodSelector->getMeshes();
+        }
+        {
+            PROFILE_SCOPE("Batch Draws");
+            mDrawBatcher.build(packet.draws, mDesc.instancing, visible,
+                               levels);
+
+            const UINT instanceBytes =
+                mDrawBatcher.getInstanceCount() * (UINT)sizeof(glm::mat4);
+            mInstanceBufferView = {};
+            mInstanceBufferView.StrideInBytes = sizeof(glm::mat4);
+            if (instanceBytes > 0)
+            {
+                UploadAllocation instances =
+                    mUploadRing->allocate(instanceBytes);
+                mDrawBatcher.writeInstances(packet.draws,
+                                            (glm::mat4*)instances.cpuAddress);
+                mInstanceBufferView.BufferLocation = instances.gpuAddress;
+                mInstanceBufferView.SizeInBytes = instanceBytes;
+            }
+        }
 
-        D3D12_RANGE readRange;
-        readRange.Begin = 0;
-        readRange.End = 0;
+        PROFILE_SCOPE("Cluster Cull");
+        mClusterCuller.build(mDrawBatcher, packet.draws, mMeshes,
+                             mViewConstants.viewProjectionMatrix,
+                             cameraPosition, mDesc.clusterCulling,
+                             mDesc.backfaceCulling);
 
-        ThrowIfFailed(mUniformBuffer->Map(
-            0, &readRange, reinterpret_cast<void**>(&mMappedUniformBuffer)));
-        memcpy(mMappedUniformBuffer, &uboVS, sizeof(uboVS));
-        mUniformBuffer->Unmap(0, &readRange);
+        const std::vector<ClusterDraw>& draws = mClusterCuller.getDraws();
+        if (mDesc.indirectDraws && !draws.empty())
+        {
+            UploadAllocation arguments = mUploadRing->allocate(
+                draws.size() * sizeof(D3D12_DRAW_INDEXED_ARGUMENTS));
+            mClusterCuller.writeIndirectArguments(
+                (D3D12_DRAW_INDEXED_ARGUMENTS*)arguments.cpuAddress);
+            mArgumentOffset = arguments.offset;
+        }
     }
 
-    // Record all the commands we need to render the scene into the command
-    // list.
-    setupCommands();
+    // Record all the commands we need to render the scene, batches are
+    // recorded in parallel.
+    {
+        PROFILE_SCOPE("Record");
+        setupCommands();
 
-    // Execute the command list.
-    ID3D12CommandList* ppCommandLists[] = {mCommandList};
-    mCommandQueue->ExecuteCommandLists(_countof(ppCommandLists),
-                                       ppCommandLists);
-    mSwapchain->Present(1, 0);
+        // Tables bound while recording are copied into the shader visible
+        // heap before anything reads them.
+        mDescriptorAllocator->flush();
+    }
 
-    // WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
+    // Execute every batch's command list, in order.
+    {
+        PROFILE_SCOPE("Submit");
+        mCommandRecorder->submit(mCommandQueue);
+    }
+    waitStart = Profiler::now();
+    {
+        PROFILE_SCOPE("Present");
+        present();
+    }
+    presentWait += Profiler::now() - waitStart;
+
+    // Mark this frame's resources as in use until the GPU reaches the fence,
+    // then move on to the next frame context without waiting.
+    frame.fenceValue = ++mFenceValue;
+    ThrowIfFailed(mCommandQueue->Signal(mFence, frame.fenceValue));
+    mUploadRing->finishFrame(frame.fenceValue);
+    mGpuAllocator->finishFrame(frame.fenceValue);
+    mRenderGraph->finishFrame(frame.fenceValue);
+    mDescriptorAllocator->finishFrame(frame.fenceValue);
+
+    mFrameContextIndex = (mFrameContextIndex + 1) % mDesc.framesInFlight;
+    mFrameCount++;
+}
 
-    // Signal and increment the fence value.
-    const UINT64 fence = mFenceValue;
-    ThrowIfFailed(mCommandQueue->Signal(mFence, fence));
-    mFenceValue++;
+void Renderer::createSynchronization()
+{
+    ThrowIfFailed(mDevice->CreateFence(mFenceValue, D3D12_FENCE_FLAG_NONE,
+                                       IID_PPV_ARGS(&mFence)));
 
-    // Wait until the previous frame is finished.
-    if (mFence->GetCompletedValue() < fence)
+    // Create an event handle to use for frame synchronization.
+    mFenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (mFenceEvent == nullptr)
     {
-        ThrowIfFailed(mFence->SetEventOnCompletion(fence, mFenceEvent));
+        ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+    }
+}
+
+void Renderer::waitForFenceValue(UINT64 value)
+{
+    if (mFence->GetCompletedValue() < value)
+    {
+        ThrowIfFailed(mFence->SetEventOnCompletion(value, mFenceEvent));
         WaitForSingleObject(mFenceEvent, INFINITE);
     }
+}
 
-    mFrameIndex = mSwapchain->GetCurrentBackBufferIndex();
+void Renderer::waitForGpu()
+{
+    // Signal and increment the fence value.
+    const UINT64 fence = ++mFenceValue;
+    ThrowIfFailed(mCommandQueue->Signal(mFence, fence));
+
+    // Wait until every frame in flight is finished.
+    waitForFenceValue(fence);
+}
+
+UINT64 Renderer::getFrameCount() const { return mFrameCount; }
+
+bool Renderer::isOffscreen() const { return mWindow == nullptr; }
+
+const GeometryUploadStats& Renderer::getGeometryUploadStats() const
+{
+    return mGeometryUploader->getStats();
+}
+
+GpuAllocatorStats Renderer::getGpuAllocatorStats() const
+{
+    return mGpuAllocator->getStats();
+}
+
+const ShaderCacheStats& Renderer::getShaderCacheStats() const
+{
+    return mShaderCache->getStats();
+}
+
+PipelineCacheStats Renderer::getPipelineCacheStats() const
+{
+    return mPipelineCache->getStats();
+}
+
+const CommandRecorderStats& Renderer::getCommandRecorderStats() const
+{
+    return mCommandRecorder->getStats();
+}
+
+const DrawBatcherStats& Renderer::getDrawBatcherStats() const
+{
+    return mDrawBatcher.getStats();
+}
+
+const CullingStats& Renderer::getCullingStats() const
+{
+    return mCullingSystem->getStats();
+}
+
+const ClusterCullingStats& Renderer::getClusterCullingStats() const
+{
+    return mClusterCuller.getStats();
+}
+
+const LodStats& Renderer::getLodStats() const
+{
+    return mLodSelector->getStats();
+}
+
+const DescriptorStats& Renderer::getDescriptorStats() const
+{
+    return mDescriptorAllocator->getStats();
+}
+
+const RootSignatureCacheStats& Renderer::getRootSignatureCacheStats() const
+{
+    return mRootSignatureCache->getStats();
+}
+
+const RenderGraphStats& Renderer::getRenderGraphStats() const
+{
+    return mRenderGraph->getStats();
+}
+
+const MeshLoadStats& Renderer::getMeshLoadStats() const
+{
+    return mMeshLoadStats;
+}
+
+JobSystemStats Renderer::getJobSystemStats() const
+{
+    return mJobSystem->getStats();
 }
\ No newline at end of file
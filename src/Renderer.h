@@ -1,7 +1,25 @@
 #pragma once
 
+#include "Backend/Backend.h"
+#include "ClusterCuller.h"
+#include "CommandRecorder.h"
+#include "CullingSystem.h"
+#include "DescriptorAllocator.h"
+#include "DrawBatcher.h"
+#include "FramePacket.h"
+#include "GeometryUploader.h"
+#include "GpuAllocator.h"
+#include "GpuProfiler.h"
+#include "JobSystem.h"
+#include "LodSelector.h"
+#include "MeshFile.h"
+#include "PipelineCache.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "RootSignatureCache.h"
+#include "ShaderCache.h"
+#include "UploadRing.h"
 #include "CrossWindow/CrossWindow.h"
-#include "CrossWindow/Graphics.h"
 
 #define GLM_FORCE_SSE42 1
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES 1
@@ -11,11 +29,21 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
+#if defined(_WIN32)
 #include <direct.h>
+#else
+#include <unistd.h>
+#endif
 
 // Common Utils
 
@@ -40,24 +68,213 @@ inline std::vector<char> readFile(const std::string& filename)
     return buffer;
 };
 
+inline std::string getWorkingDirectory()
+{
+    char buffer[1024];
+#if defined(_WIN32)
+    if (_getcwd(buffer, sizeof(buffer)) == nullptr)
+#else
+    if (getcwd(buffer, sizeof(buffer)) == nullptr)
+#endif
+    {
+        throw std::runtime_error("failed to get working directory!");
+    }
+    return buffer;
+}
+
+// Shader Constants
+// CPU side mirrors of what triangle.vert.hlsl reads. Constants are split by
+// how often they change: the view's are uploaded once per frame, while each
+// object's model matrix is an instance attribute, so a vertex costs two
+// vector-matrix products instead of multiplying three matrices together.
+
+// cbuffer view : register(b0)
+struct ViewConstants
+{
+    // Projection * view, computed once on the CPU
+    glm::mat4 viewProjectionMatrix; // packoffset(c0)
+};
+
+// A packoffset register is 16 bytes
+static_assert(offsetof(ViewConstants, viewProjectionMatrix) == 0 * 16,
+              "ViewConstants doesn't match its packoffsets");
+static_assert(sizeof(ViewConstants) == 4 * 16,
+              "ViewConstants doesn't match its packoffsets");
+
+// cbuffer mesh : register(b1), root constants
+struct MeshConstants
+{
+    // Model space position = offset + vertex position * scale, compact
+    // vertices store positions relative to their mesh's bounds
+    float positionScale[4];  // packoffset(c0)
+    float positionOffset[4]; // packoffset(c1)
+};
+
+static_assert(offsetof(MeshConstants, positionScale) == 0 * 16 &&
+                  offsetof(MeshConstants, positionOffset) == 1 * 16,
+              "MeshConstants doesn't match its packoffsets");
+static_assert(sizeof(MeshConstants) % 4 == 0,
+              "root constants are set 32 bits at a time");
+
+// MODEL0 to MODEL3, one float4 per matrix column at 16 byte steps
+static_assert(sizeof(glm::mat4) == 4 * 16 && alignof(glm::mat4) <= 16,
+              "instance data doesn't match the input layout");
+
 // Renderer
 
+struct RendererDesc
+{
+    // How many frames the CPU may record ahead of the GPU before it has to
+    // wait. Each frame in flight owns a command allocator.
+    unsigned framesInFlight = 2;
+
+    // Bytes of upload heap per-frame constants are sub-allocated from, it
+    // has to hold every frame in flight. Instance data takes 64 bytes a draw.
+    UINT64 uploadRingSize = 32 * 1024 * 1024;
+
+    // Heap size and memory budget of the allocator resources are placed with
+    GpuAllocatorDesc gpuAllocator;
+
+    // Bytes of geometry moved down into free space below it each frame while
+    // the allocator's heaps are fragmented, 0 never moves any
+    UINT64 defragmentBytes = 4 * 1024 * 1024;
+
+    // Sizes of the shader visible descriptor heap's bindless ranges and ring,
+    // and of the staging heaps views are created in
+    DescriptorAllocatorDesc descriptors;
+
+    // Compiled shaders are cached here, relative to the working directory
+    std::string shaderCachePath = "assets/shaders.cache";
+
+    // Serialized root signatures are cached here, relative to the working
+    // directory
+    std::string rootSignatureCachePath = "assets/rootsignatures.cache";
+
+    // Pipeline library file, and threads new pipelines are created on
+    std::string pipelineLibraryPath = "assets/pipelines.cache";
+    unsigned pipelineWorkers = 2;
+
+    // Time every render graph pass with timestamp queries, read back a few
+    // frames later into the profiler's GPU track and GPU frame times
+    bool gpuTimestamps = true;
+
+    // Threads commands are recorded on besides the one calling render()
+    unsigned workerThreads =
+        std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    // How many draws each command list records
+    uint32_t drawsPerBatch = 256;
+
+    // Merge draw items sharing a mesh and pipeline into instanced draws, and
+    // issue the draws through ExecuteIndirect instead of one call each
+    bool instancing = true;
+    bool indirectDraws = false;
+
+    // Only draw items whose bounds intersect the view frustum
+    bool frustumCulling = true;
+
+    // Split single draws of meshes with several meshlets into their visible
+    // meshlets
+    bool clusterCulling = true;
+
+    // Cull triangles facing away from the camera when rasterizing, which
+    // also lets whole meshlets facing away be culled before drawing
+    bool backfaceCulling = false;
+
+    // Draw items at the coarsest level of detail of their mesh whose error
+    // covers at most lodPixelError pixels on screen
+    bool levelOfDetail = true;
+    float lodPixelError = 1.0f;
+
+    // Source mesh whose submeshes draw items refer to, relative to the
+    // working directory. It's loaded from its cooked file next to it, which
+    // is cooked first if it's missing or from another format version.
+    std::string meshPath = "assets/triangle.obj";
+
+    // Cook meshes with quantized 16 byte vertices instead of 36 bytes of
+    // floats, the input layout and vertex shader follow whichever format the
+    // cooked file has
+    bool compactVertices = false;
+};
+
 class Renderer
 {
   public:
-    Renderer(xwin::Window& window);
+    Renderer(xwin::Window& window, const RendererDesc& desc = RendererDesc());
+
+    // Offscreen, without a window or swapchain. Frames are rendered into a
+    // virtual swapchain of plain render targets, and presenting only moves
+    // on to the next one.
+    Renderer(unsigned width, unsigned height,
+             const RendererDesc& desc = RendererDesc());
 
     ~Renderer();
 
-    // Render onto the render target
-    void render();
+    // Render a frame packet onto the render target, applying its resize
+    // first if it has one. Frame times go to the profiler.
+    void render(const FramePacket& packet);
 
     // Resize the window and internal data structures
     void resize(unsigned width, unsigned height);
 
+    // Number of frames submitted and presented so far
+    UINT64 getFrameCount() const;
+
+    // Whether frames go to offscreen render targets instead of a swapchain
+    bool isOffscreen() const;
+
+    // Bytes, batches and latency of static geometry uploads
+    const GeometryUploadStats& getGeometryUploadStats() const;
+
+    // Heap usage, fragmentation and budget of placed resources
+    GpuAllocatorStats getGpuAllocatorStats() const;
+
+    // Hits, misses and compile time of shader loading
+    const ShaderCacheStats& getShaderCacheStats() const;
+
+    // Deduplication, file hits and time spent creating root signatures
+    const RootSignatureCacheStats& getRootSignatureCacheStats() const;
+
+    // Deduplication, library hits and latency of pipeline creation
+    PipelineCacheStats getPipelineCacheStats() const;
+
+    // Batches and time spent recording command lists
+    const CommandRecorderStats& getCommandRecorderStats() const;
+
+    JobSystemStats getJobSystemStats() const;
+
+    // Items in, instanced draws out and time spent sorting them
+    const DrawBatcherStats& getDrawBatcherStats() const;
+
+    // Objects tested and rejected, and time spent culling them
+    const CullingStats& getCullingStats() const;
+
+    // Meshlets and triangles culled, and time spent culling them
+    const ClusterCullingStats& getClusterCullingStats() const;
+
+    // Triangles saved, level switches and time spent selecting levels
+    const LodStats& getLodStats() const;
+
+    // Tables bound, descriptors copied and staging heaps in use
+    const DescriptorStats& getDescriptorStats() const;
+
+    // Passes culled, barriers derived and transient memory aliased
+    const RenderGraphStats& getRenderGraphStats() const;
+
+    // Time spent cooking, mapping and uploading meshes
+    const MeshLoadStats& getMeshLoadStats() const;
+
   protected:
+    // A null window renders offscreen
+    Renderer(xwin::Window* window, unsigned width, unsigned height,
+             const RendererDesc& desc);
+
+    // Everything render() does, adding the time spent waiting on the GPU and
+    // presenting to presentWait in nanoseconds
+    void renderFrame(const FramePacket& packet, int64_t& presentWait);
+
     // Initialize your Graphics API
-    void initializeAPI(xwin::Window& window);
+    void initializeAPI(unsigned width, unsigned height);
 
     // Destroy any Graphics API data structures used in this example
     void destroyAPI();
@@ -74,6 +291,11 @@ class Renderer
     // Set up commands used when rendering frame by this app
     void setupCommands();
 
+    // Record draws [firstDraw, lastDraw), the first batch also clears the
+    // render target. The render graph transitions it around the batches.
+    void recordBatch(ID3D12GraphicsCommandList* commandList, bool firstBatch,
+                     uint32_t firstDraw, uint32_t lastDraw);
+
     // Destroy all commands
     void destroyCommands();
 
@@ -85,36 +307,38 @@ class Renderer
     // Set up the RenderPass
     void createRenderPass();
 
+    // Create the frame fence and the event used to wait on it
     void createSynchronization();
 
-    // Set up the swapchain
-    void setupSwapchain(unsigned width, unsigned height);
+    // Block until the GPU reaches the given fence value
+    void waitForFenceValue(UINT64 value);
 
-    struct Vertex
-    {
-        float position[3];
-        float color[3];
-    };
+    // Block until the GPU has finished all submitted work
+    void waitForGpu();
+
+    // Set up the swapchain, or the offscreen render targets standing in for
+    // it
+    void setupSwapchain(unsigned width, unsigned height);
 
-    Vertex mVertexBufferData[3] = {{{1.0f, -1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}},
-                                   {{-1.0f, -1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}},
-                                   {{0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}}};
+    // Present the frame and move on to the next back buffer, offscreen
+    // frames are only rotated
+    void present();
 
-    uint32_t mIndexBufferData[3] = {0, 1, 2};
+    // Map the cooked mesh, cooking it first if it's missing or isn't in
+    // the vertex format asked for
+    void openMesh(const std::string& path);
 
-    std::chrono::time_point<std::chrono::steady_clock> tStart, tEnd;
-    float mElapsedTime = 0.0f;
+    // Upload the mapped mesh and close it
+    void uploadMesh();
 
-    // Uniform data
-    struct
-    {
-        glm::mat4 projectionMatrix;
-        glm::mat4 modelMatrix;
-        glm::mat4 viewMatrix;
-    } uboVS;
+    // Uniform data, the model matrix comes from the instance buffer
+    ViewConstants mViewConstants;
+    MeshConstants mMeshConstants;
 
     static const UINT backbufferCount = 2;
 
+    RendererDesc mDesc;
+
     xwin::Window* mWindow;
     unsigned mWidth, mHeight;
 
@@ -127,36 +351,93 @@ class Renderer
 #endif
     ID3D12Device* mDevice;
     ID3D12CommandQueue* mCommandQueue;
-    ID3D12CommandAllocator* mCommandAllocator;
-    ID3D12GraphicsCommandList* mCommandList;
+    std::unique_ptr<GpuAllocator> mGpuAllocator;
+    // Views are created in staging heaps, and copied into the shader visible
+    // heap when they're bound
+    std::unique_ptr<DescriptorAllocator> mDescriptorAllocator;
+    // Commands are recorded in parallel batches on the job system
+    std::unique_ptr<JobSystem> mJobSystem;
+    std::unique_ptr<CommandRecorder> mCommandRecorder;
+    // Passes are recorded through the render graph, which places their
+    // barriers and transient resources
+    std::unique_ptr<RenderGraph> mRenderGraph;
+    // Times the render graph's passes, when GPU timestamps are on
+    std::unique_ptr<GpuProfiler> mGpuProfiler;
+
+    // Frames in Flight
+    struct FrameContext
+    {
+        // Fence value signaled once the GPU has finished this frame
+        UINT64 fenceValue;
+    };
+
+    std::vector<FrameContext> mFrameContexts;
+    UINT mFrameContextIndex;
 
-    // Current Frame
-    UINT mCurrentBuffer;
-    ID3D12DescriptorHeap* mRtvHeap;
+    // Back buffer views are allocated once and rewritten on resize
+    StagingDescriptor mRtvDescriptors[backbufferCount];
     ID3D12Resource* mRenderTargets[backbufferCount];
     IDXGISwapChain3* mSwapchain;
+    // The virtual swapchain's buffers when rendering offscreen
+    GpuAllocation* mOffscreenTargets[backbufferCount];
 
     // Resources
     D3D12_VIEWPORT mViewport;
     D3D12_RECT mSurfaceSize;
 
-    ID3D12Resource* mVertexBuffer;
-    ID3D12Resource* mIndexBuffer;
-
-    ID3D12Resource* mUniformBuffer;
-    ID3D12DescriptorHeap* mUniformBufferHeap;
-    UINT8* mMappedUniformBuffer;
+    // Static geometry lives in default heaps, filled through the uploader
+    std::unique_ptr<GeometryUploader> mGeometryUploader;
+    GpuAllocation* mVertexBuffer;
+    GpuAllocation* mIndexBuffer;
+
+    // Meshes in the vertex and index buffers, draw items refer to them by
+    // index
+    std::vector<MeshRange> mMeshes;
+    MeshFile mMeshFile;
+    MeshLoadStats mMeshLoadStats;
+
+    // Per-frame constants, the view constants are bound as a root CBV at
+    // their latest copy, and instance data and indirect arguments are
+    // written next to them
+    std::unique_ptr<UploadRing> mUploadRing;
+    D3D12_GPU_VIRTUAL_ADDRESS mUniformAddress;
+    D3D12_VERTEX_BUFFER_VIEW mInstanceBufferView;
+    UINT64 mArgumentOffset;
+
+    // Culls each frame's draw items and selects their levels of detail, then
+    // sorts and merges them, then culls the meshlets of what's left
+    std::unique_ptr<CullingSystem> mCullingSystem;
+    std::unique_ptr<LodSelector> mLodSelector;
+    DrawBatcher mDrawBatcher;
+    ClusterCuller mClusterCuller;
+    ID3D12CommandSignature* mCommandSignature;
 
     D3D12_VERTEX_BUFFER_VIEW mVertexBufferView;
     D3D12_INDEX_BUFFER_VIEW mIndexBufferView;
 
-    UINT mRtvDescriptorSize;
+    // Shaders are only compiled when no cached bytecode matches them
+    D3DShaderCompiler mShaderCompiler;
+    std::unique_ptr<ShaderCache> mShaderCache;
+
+    // Root signatures are owned by the cache, along with their parameter
+    // indices
+    std::unique_ptr<RootSignatureCache> mRootSignatureCache;
     ID3D12RootSignature* mRootSignature;
+    UINT mViewConstantsParameter;
+    UINT mMeshConstantsParameter;
+
+    // Pipelines are created asynchronously, the state is set once it's ready
+    std::unique_ptr<PipelineCache> mPipelineCache;
+    GraphicsPipeline* mPipeline;
     ID3D12PipelineState* mPipelineState;
 
+    // Pipelines draw items refer to by index
+    std::vector<ID3D12PipelineState*> mPipelineStates;
+
     // Sync
     UINT mFrameIndex;
     HANDLE mFenceEvent;
     ID3D12Fence* mFence;
     UINT64 mFenceValue;
+    UINT64 mFrameCount;
 };
\ No newline at end of file
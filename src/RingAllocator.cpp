@@ -0,0 +1,103 @@
+#include "RingAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+RingAllocator::RingAllocator(uint64_t capacity, bool validate)
+    : mValidate(validate)
+{
+    reset(capacity);
+}
+
+void RingAllocator::reset(uint64_t capacity)
+{
+    mCapacity = capacity;
+    mHead = 0;
+    mUsed = 0;
+    mFrames.clear();
+    mCurrent = Frame();
+    mLiveRanges.clear();
+}
+
+bool RingAllocator::allocate(uint64_t size, uint64_t alignment,
+                             uint64_t& offset)
+{
+    alignment = std::max<uint64_t>(alignment, 1);
+    uint64_t aligned = (mHead + alignment - 1) / alignment * alignment;
+
+    // Allocations never straddle the end, the tail of the ring is skipped
+    // instead and the allocation starts over at zero.
+    if (aligned + size > mCapacity)
+    {
+        aligned = 0;
+    }
+    const uint64_t padding =
+        aligned >= mHead ? aligned - mHead : mCapacity - mHead;
+
+    if (size == 0 || mUsed + padding + size > mCapacity)
+    {
+        mStats.failedAllocations++;
+        return false;
+    }
+
+    if (mValidate)
+    {
+        // Any live range starting before our end must end before our start
+        const uint64_t end = aligned + size;
+        auto next = mLiveRanges.lower_bound(aligned);
+        if (next != mLiveRanges.end() && next->first < end)
+        {
+            throw std::logic_error("ring allocation overlaps a live range");
+        }
+        if (next != mLiveRanges.begin() && std::prev(next)->second > aligned)
+        {
+            throw std::logic_error("ring allocation overlaps a live range");
+        }
+        mLiveRanges.emplace(aligned, end);
+        mCurrent.offsets.push_back(aligned);
+    }
+
+    offset = aligned;
+    mHead = aligned + size;
+    if (mHead == mCapacity)
+    {
+        mHead = 0;
+    }
+    mUsed += padding + size;
+    mCurrent.used += padding + size;
+
+    mStats.allocations++;
+    mStats.allocatedBytes += size;
+    mStats.paddingBytes += padding;
+    mStats.peakUsed = std::max(mStats.peakUsed, mUsed);
+    return true;
+}
+
+void RingAllocator::finishFrame(uint64_t fenceValue)
+{
+    mCurrent.fenceValue = fenceValue;
+    mFrames.push_back(std::move(mCurrent));
+    mCurrent = Frame();
+}
+
+void RingAllocator::retire(uint64_t completedFenceValue)
+{
+    while (!mFrames.empty() && mFrames.front().fenceValue <= completedFenceValue)
+    {
+        Frame& frame = mFrames.front();
+        mUsed -= frame.used;
+        for (uint64_t offset : frame.offsets)
+        {
+            mLiveRanges.erase(offset);
+        }
+        mFrames.pop_front();
+    }
+}
+
+uint64_t RingAllocator::getCapacity() const { return mCapacity; }
+
+uint64_t RingAllocator::getUsed() const { return mUsed; }
+
+const RingAllocatorStats& RingAllocator::getStats() const { return mStats; }
+
+void RingAllocator::resetStats() { mStats = RingAllocatorStats(); }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+// Ring Allocator
+// Hands out offsets into a fixed size ring for data that lives until the GPU
+// is done with the frame that used it. Allocations made between two calls to
+// finishFrame() are tagged with that frame's fence value and retired together
+// once the fence completes. The allocator only deals in offsets, so it can
+// back an upload heap, a staging buffer, or plain CPU memory.
+
+struct RingAllocatorStats
+{
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+
+    // Bytes skipped for alignment or to wrap around the end of the ring
+    uint64_t paddingBytes = 0;
+
+    // Allocations refused because the ring was full
+    uint64_t failedAllocations = 0;
+
+    // Most bytes ever in flight at once
+    uint64_t peakUsed = 0;
+};
+
+class RingAllocator
+{
+  public:
+    // Validation tracks every live range and throws if an allocation would
+    // ever overlap one, at the cost of a map insert per allocation
+    RingAllocator(uint64_t capacity = 0, bool validate = false);
+
+    // Drop every allocation and resize the ring
+    void reset(uint64_t capacity);
+
+    // Returns false if there's no room until older frames are retired
+    bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+
+    // Tag everything allocated since the last call with the fence value the
+    // GPU signals once it's done with it
+    void finishFrame(uint64_t fenceValue);
+
+    // Free every frame whose fence value has been reached
+    void retire(uint64_t completedFenceValue);
+
+    uint64_t getCapacity() const;
+
+    // Bytes in flight, including padding
+    uint64_t getUsed() const;
+
+    const RingAllocatorStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    struct Frame
+    {
+        uint64_t fenceValue;
+        uint64_t used;
+        std::vector<uint64_t> offsets;
+    };
+
+    uint64_t mCapacity;
+    uint64_t mHead;
+    uint64_t mUsed;
+
+    // Frames waiting on the GPU, oldest first
+    std::deque<Frame> mFrames;
+
+    // The frame currently being allocated from
+    Frame mCurrent;
+
+    bool mValidate;
+
+    // Offset to end of every live allocation, only kept when validating
+    std::map<uint64_t, uint64_t> mLiveRanges;
+
+    RingAllocatorStats mStats;
+};
@@ -0,0 +1,415 @@
+#include "RootSignatureCache.h"
+#include "Hash.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+// File layout: a header, then one record per entry, each followed by its
+// blob padded to 8 bytes. Records are only ever appended.
+const char kMagic[4] = {'X', 'R', 'S', 'C'};
+const uint32_t kVersion = 1;
+
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t version;
+};
+
+struct CacheRecord
+{
+    uint64_t key;
+    uint64_t size;
+};
+
+uint64_t alignRecord(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+RootParameterDesc makeParameter(D3D12_ROOT_PARAMETER_TYPE type,
+                                D3D12_SHADER_VISIBILITY visibility)
+{
+    RootParameterDesc parameter;
+    parameter.type = type;
+    parameter.visibility = visibility;
+    return parameter;
+}
+}
+
+// Description
+
+UINT RootSignatureDesc::addConstants(UINT shaderRegister, UINT num32BitValues,
+                                     D3D12_SHADER_VISIBILITY visibility,
+                                     UINT space)
+{
+    RootParameterDesc parameter = makeParameter(
+        D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, visibility);
+    parameter.shaderRegister = shaderRegister;
+    parameter.space = space;
+    parameter.num32BitValues = num32BitValues;
+    parameters.push_back(parameter);
+    return (UINT)parameters.size() - 1;
+}
+
+UINT RootSignatureDesc::addConstantBuffer(UINT shaderRegister,
+                                          D3D12_SHADER_VISIBILITY visibility,
+                                          D3D12_ROOT_DESCRIPTOR_FLAGS flags,
+                                          UINT space)
+{
+    RootParameterDesc parameter =
+        makeParameter(D3D12_ROOT_PARAMETER_TYPE_CBV, visibility);
+    parameter.shaderRegister = shaderRegister;
+    parameter.space = space;
+    parameter.flags = flags;
+    parameters.push_back(parameter);
+    return (UINT)parameters.size() - 1;
+}
+
+UINT RootSignatureDesc::addTable(const std::vector<RootDescriptorRange>& ranges,
+                                 D3D12_SHADER_VISIBILITY visibility)
+{
+    RootParameterDesc parameter =
+        makeParameter(D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE, visibility);
+    parameter.ranges = ranges;
+    parameters.push_back(parameter);
+    return (UINT)parameters.size() - 1;
+}
+
+UINT RootSignatureDesc::getCost() const
+{
+    UINT cost = 0;
+    for (const RootParameterDesc& parameter : parameters)
+    {
+        switch (parameter.type)
+        {
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            cost += parameter.num32BitValues;
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            cost += 1;
+            break;
+        default:
+            cost += 2;
+            break;
+        }
+    }
+    return cost;
+}
+
+// Stats
+
+void RootSignatureCacheStats::report(std::ostream& out) const
+{
+    out << "Root signature cache: " << requests << " requests, " << dedupHits
+        << " deduplicated, " << fileHits << " from file, " << serializations
+        << " serialized\n";
+    out << "  entries: " << entriesLoaded << " loaded, " << entriesWritten
+        << " written, ms: " << serializeTime << " serializing, " << createTime
+        << " creating\n";
+}
+
+// Cache
+
+RootSignatureCache::RootSignatureCache(ID3D12Device* device,
+                                       const std::string& path)
+    : mDevice(device), mPath(path), mFileValid(false)
+{
+    if (mFile.open(mPath))
+    {
+        mFileValid = load();
+    }
+}
+
+RootSignatureCache::~RootSignatureCache()
+{
+    try
+    {
+        save();
+    }
+    catch (const std::exception&)
+    {
+        // A cache that can't be written only costs serialization next run
+    }
+
+    for (auto& entry : mSignatures)
+    {
+        entry.second->signature->Release();
+    }
+}
+
+const RootSignature& RootSignatureCache::get(const RootSignatureDesc& desc,
+                                             LPCWSTR name)
+{
+    mStats.requests++;
+    const uint64_t key = computeKey(desc);
+    auto created = mSignatures.find(key);
+    if (created != mSignatures.end())
+    {
+        mStats.dedupHits++;
+        return *created->second;
+    }
+
+    if (desc.getCost() > kMaxRootSignatureCost)
+    {
+        throw std::runtime_error("root signature is over 64 DWORDs!");
+    }
+
+    auto found = mBlobs.find(key);
+    if (found != mBlobs.end())
+    {
+        mStats.fileHits++;
+    }
+    else
+    {
+        const auto serializeStart = std::chrono::steady_clock::now();
+        std::vector<uint8_t> blob;
+        serialize(desc, blob);
+        mStats.serializations++;
+        mStats.serializeTime += elapsedMilliseconds(serializeStart);
+
+        mSerialized.push_back(std::move(blob));
+        const std::vector<uint8_t>& stored = mSerialized.back();
+        mUnsaved.push_back({key, &stored});
+        found =
+            mBlobs.emplace(key, std::make_pair(stored.data(), stored.size()))
+                .first;
+    }
+
+    const auto createStart = std::chrono::steady_clock::now();
+    std::unique_ptr<RootSignature> signature(new RootSignature());
+    signature->key = key;
+    signature->blob = found->second.first;
+    signature->blobSize = found->second.second;
+    ThrowIfFailed(mDevice->CreateRootSignature(
+        0, signature->blob, signature->blobSize,
+        IID_PPV_ARGS(&signature->signature)));
+    if (name != nullptr)
+    {
+        signature->signature->SetName(name);
+    }
+    mStats.createTime += elapsedMilliseconds(createStart);
+
+    RootSignature& stored = *signature;
+    mSignatures.emplace(key, std::move(signature));
+    return stored;
+}
+
+uint64_t RootSignatureCache::computeKey(const RootSignatureDesc& desc) const
+{
+    uint64_t hash = kHashBasis;
+#if defined(XGFX_NOOP)
+    hashString(hash, "noop");
+#else
+    hashString(hash, "d3d12");
+#endif
+    hashValue(hash, D3D_ROOT_SIGNATURE_VERSION_1_1);
+    hashValue(hash, desc.flags);
+    hashValue(hash, (uint64_t)desc.parameters.size());
+    for (const RootParameterDesc& parameter : desc.parameters)
+    {
+        hashValue(hash, parameter.type);
+        hashValue(hash, parameter.visibility);
+        hashValue(hash, parameter.shaderRegister);
+        hashValue(hash, parameter.space);
+        hashValue(hash, parameter.num32BitValues);
+        hashValue(hash, parameter.flags);
+        hashValue(hash, (uint64_t)parameter.ranges.size());
+        for (const RootDescriptorRange& range : parameter.ranges)
+        {
+            hashValue(hash, range.type);
+            hashValue(hash, range.count);
+            hashValue(hash, range.baseRegister);
+            hashValue(hash, range.space);
+            hashValue(hash, range.flags);
+        }
+    }
+    return hash;
+}
+
+void RootSignatureCache::save()
+{
+    if (mUnsaved.empty())
+    {
+        return;
+    }
+
+    // Entries of an invalid file were never loaded, so start it over
+    std::ofstream out(mPath, std::ios::binary | (mFileValid ? std::ios::app
+                                                            : std::ios::trunc));
+    if (!out.is_open())
+    {
+        throw std::runtime_error(
+            "failed to open root signature cache for writing!");
+    }
+
+    if (!mFileValid)
+    {
+        CacheHeader header;
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        out.write((const char*)&header, sizeof(header));
+        mFileValid = true;
+    }
+
+    const char padding[8] = {};
+    for (const auto& unsaved : mUnsaved)
+    {
+        const std::vector<uint8_t>& blob = *unsaved.second;
+        CacheRecord record;
+        record.key = unsaved.first;
+        record.size = blob.size();
+        out.write((const char*)&record, sizeof(record));
+        out.write((const char*)blob.data(), blob.size());
+        out.write(padding, alignRecord(record.size) - record.size);
+        mStats.entriesWritten++;
+    }
+    mUnsaved.clear();
+}
+
+const RootSignatureCacheStats& RootSignatureCache::getStats() const
+{
+    return mStats;
+}
+
+void RootSignatureCache::resetStats() { mStats = RootSignatureCacheStats(); }
+
+bool RootSignatureCache::load()
+{
+    const uint8_t* data = mFile.data();
+    const size_t size = mFile.size();
+
+    CacheHeader header;
+    if (size < sizeof(header))
+    {
+        mFile.close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion)
+    {
+        mFile.close();
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+    while (offset + sizeof(CacheRecord) <= size)
+    {
+        CacheRecord record;
+        memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.size > size - offset)
+        {
+            break;
+        }
+        mBlobs[record.key] =
+            std::make_pair((const void*)(data + offset), (SIZE_T)record.size);
+        mStats.entriesLoaded++;
+        offset += (size_t)alignRecord(record.size);
+    }
+
+    // Appending after a partly written record would misalign every record
+    // after it, so a damaged file is started over instead
+    if (offset != size)
+    {
+        mBlobs.clear();
+        mStats.entriesLoaded = 0;
+        mFile.close();
+        return false;
+    }
+    return true;
+}
+
+void RootSignatureCache::serialize(const RootSignatureDesc& desc,
+                                   std::vector<uint8_t>& blob)
+{
+    D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+    featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    if (FAILED(mDevice->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE,
+                                            &featureData,
+                                            sizeof(featureData))) ||
+        featureData.HighestVersion < D3D_ROOT_SIGNATURE_VERSION_1_1)
+    {
+        throw std::runtime_error("root signature version 1.1 isn't "
+                                 "supported!");
+    }
+
+    // Ranges of every table, kept alive until serialized
+    std::vector<std::vector<D3D12_DESCRIPTOR_RANGE1>> ranges(
+        desc.parameters.size());
+    std::vector<D3D12_ROOT_PARAMETER1> parameters(desc.parameters.size());
+    for (size_t i = 0; i < desc.parameters.size(); ++i)
+    {
+        const RootParameterDesc& source = desc.parameters[i];
+        D3D12_ROOT_PARAMETER1& parameter = parameters[i];
+        parameter.ParameterType = source.type;
+        parameter.ShaderVisibility = source.visibility;
+        switch (source.type)
+        {
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+            for (const RootDescriptorRange& range : source.ranges)
+            {
+                D3D12_DESCRIPTOR_RANGE1 tableRange;
+                tableRange.RangeType = range.type;
+                tableRange.NumDescriptors = range.count;
+                tableRange.BaseShaderRegister = range.baseRegister;
+                tableRange.RegisterSpace = range.space;
+                tableRange.Flags = range.flags;
+                tableRange.OffsetInDescriptorsFromTableStart =
+                    D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+                ranges[i].push_back(tableRange);
+            }
+            parameter.DescriptorTable.NumDescriptorRanges =
+                (UINT)ranges[i].size();
+            parameter.DescriptorTable.pDescriptorRanges = ranges[i].data();
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            parameter.Constants.ShaderRegister = source.shaderRegister;
+            parameter.Constants.RegisterSpace = source.space;
+            parameter.Constants.Num32BitValues = source.num32BitValues;
+            break;
+        default:
+            parameter.Descriptor.ShaderRegister = source.shaderRegister;
+            parameter.Descriptor.RegisterSpace = source.space;
+            parameter.Descriptor.Flags = source.flags;
+            break;
+        }
+    }
+
+    D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+    rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+    rootSignatureDesc.Desc_1_1.Flags = desc.flags;
+    rootSignatureDesc.Desc_1_1.NumParameters = (UINT)parameters.size();
+    rootSignatureDesc.Desc_1_1.pParameters = parameters.data();
+    rootSignatureDesc.Desc_1_1.NumStaticSamplers = 0;
+    rootSignatureDesc.Desc_1_1.pStaticSamplers = nullptr;
+
+    ID3DBlob* signature = nullptr;
+    ID3DBlob* error = nullptr;
+    const HRESULT hr = D3D12SerializeVersionedRootSignature(
+        &rootSignatureDesc, &signature, &error);
+    if (error != nullptr)
+    {
+        std::cout << (const char*)error->GetBufferPointer();
+        error->Release();
+        error = nullptr;
+    }
+    if (FAILED(hr) || signature == nullptr)
+    {
+        throw std::runtime_error("failed to serialize root signature!");
+    }
+
+    const uint8_t* data = (const uint8_t*)signature->GetBufferPointer();
+    blob.assign(data, data + signature->GetBufferSize());
+    signature->Release();
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Root Signature Cache
+// Root signatures are described as plain data, keyed by a hash of that
+// description, and created once per key however often they're asked for.
+// Serialized blobs are kept in a memory mapped file like the shader cache's,
+// so later runs hand the driver the stored blob instead of serializing the
+// description again.
+
+// A root signature holds at most 64 DWORDs of arguments
+const UINT kMaxRootSignatureCost = 64;
+
+struct RootDescriptorRange
+{
+    D3D12_DESCRIPTOR_RANGE_TYPE type;
+    UINT count;
+    UINT baseRegister;
+    UINT space = 0;
+    D3D12_DESCRIPTOR_RANGE_FLAGS flags = D3D12_DESCRIPTOR_RANGE_FLAG_NONE;
+};
+
+struct RootParameterDesc
+{
+    D3D12_ROOT_PARAMETER_TYPE type;
+    D3D12_SHADER_VISIBILITY visibility;
+
+    // Register of constants and root descriptors
+    UINT shaderRegister = 0;
+    UINT space = 0;
+
+    // Constants only
+    UINT num32BitValues = 0;
+
+    // Root descriptors only
+    D3D12_ROOT_DESCRIPTOR_FLAGS flags = D3D12_ROOT_DESCRIPTOR_FLAG_NONE;
+
+    // Tables only, ranges follow each other in the table
+    std::vector<RootDescriptorRange> ranges;
+};
+
+struct RootSignatureDesc
+{
+    std::vector<RootParameterDesc> parameters;
+    D3D12_ROOT_SIGNATURE_FLAGS flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+    // Each returns the index the parameter is set at
+
+    // Constants are written into the command list, so small data that
+    // changes per draw costs no upload, descriptor or table
+    UINT addConstants(
+        UINT shaderRegister, UINT num32BitValues,
+        D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL,
+        UINT space = 0);
+
+    // A constant buffer bound by GPU address
+    UINT addConstantBuffer(
+        UINT shaderRegister,
+        D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL,
+        D3D12_ROOT_DESCRIPTOR_FLAGS flags = D3D12_ROOT_DESCRIPTOR_FLAG_NONE,
+        UINT space = 0);
+
+    UINT addTable(
+        const std::vector<RootDescriptorRange>& ranges,
+        D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL);
+
+    // DWORDs of arguments: one per constant, two per root descriptor and one
+    // per table
+    UINT getCost() const;
+};
+
+// Set a root constants parameter from a struct, the per-draw fast path
+template <typename T>
+void setRootConstants(ID3D12GraphicsCommandList* commandList, UINT parameter,
+                      const T& data)
+{
+    static_assert(sizeof(T) % 4 == 0 &&
+                      sizeof(T) / 4 <= kMaxRootSignatureCost,
+                  "root constants are set 32 bits at a time");
+    commandList->SetGraphicsRoot32BitConstants(parameter, sizeof(T) / 4, &data,
+                                               0);
+}
+
+// A root signature owned by the cache
+struct RootSignature
+{
+    ID3D12RootSignature* signature = nullptr;
+    uint64_t key = 0;
+
+    // Serialized blob, valid for the lifetime of the cache
+    const void* blob = nullptr;
+    SIZE_T blobSize = 0;
+};
+
+struct RootSignatureCacheStats
+{
+    // Calls to get(), and how many found a root signature already created
+    uint64_t requests = 0;
+    uint64_t dedupHits = 0;
+
+    // Blobs found in the cache file, and descriptions serialized
+    uint64_t fileHits = 0;
+    uint64_t serializations = 0;
+
+    // Entries found in the cache file when it was opened, and appended since
+    uint64_t entriesLoaded = 0;
+    uint64_t entriesWritten = 0;
+
+    // Time spent serializing and creating root signatures, in milliseconds
+    double serializeTime = 0.0;
+    double createTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+class RootSignatureCache
+{
+  public:
+    RootSignatureCache(ID3D12Device* device, const std::string& path);
+
+    // Saves anything serialized since the last save and releases every root
+    // signature
+    ~RootSignatureCache();
+
+    // Returns the root signature for a description, creating it if it's new.
+    // Throws if the description is over kMaxRootSignatureCost or fails to
+    // serialize.
+    const RootSignature& get(const RootSignatureDesc& desc,
+                             LPCWSTR name = nullptr);
+
+    // Hash of the backend and every field of the description
+    uint64_t computeKey(const RootSignatureDesc& desc) const;
+
+    // Append new entries to the cache file, rewriting it if it was missing or
+    // had an incompatible format
+    void save();
+
+    const RootSignatureCacheStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    // Load the entries of the mapped file, returns false if the file doesn't
+    // have a valid header
+    bool load();
+
+    // Serialize a description as root signature version 1.1
+    void serialize(const RootSignatureDesc& desc, std::vector<uint8_t>& blob);
+
+    ID3D12Device* mDevice;
+    std::string mPath;
+
+    MappedFile mFile;
+    bool mFileValid;
+
+    // Blobs by key, pointing into the mapping or into mSerialized
+    std::unordered_map<uint64_t, std::pair<const void*, SIZE_T>> mBlobs;
+
+    // Blobs serialized this session, and which keys haven't been saved yet
+    std::deque<std::vector<uint8_t>> mSerialized;
+    std::vector<std::pair<uint64_t, const std::vector<uint8_t>*>> mUnsaved;
+
+    std::unordered_map<uint64_t, std::unique_ptr<RootSignature>> mSignatures;
+
+    RootSignatureCacheStats mStats;
+};
@@ -0,0 +1,348 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace
+{
+// File layout: a header, then one record per entry, each followed by its
+// bytecode padded to 8 bytes. Records are only ever appended.
+const char kMagic[4] = {'X', 'S', 'H', 'C'};
+const uint32_t kVersion = 1;
+
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t version;
+};
+
+struct CacheRecord
+{
+    uint64_t key;
+    uint64_t size;
+};
+
+uint64_t alignRecord(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+
+bool readText(const std::string& path, std::string& text)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    text.assign((std::istreambuf_iterator<char>(file)),
+                std::istreambuf_iterator<char>());
+    return true;
+}
+
+std::string getDirectory(const std::string& path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string()
+                                      : path.substr(0, slash + 1);
+}
+
+// Hash a source file and every file it includes, depth first. Includes are
+// found textually, so ones inside inactive #if blocks are hashed as well,
+// which can only cause extra misses, never stale hits.
+void hashSource(uint64_t& hash, const std::string& path,
+                const std::string& text,
+                std::unordered_set<std::string>& visited)
+{
+    hashString(hash, text);
+
+    const std::string directory = getDirectory(path);
+    size_t lineStart = 0;
+    while (lineStart < text.size())
+    {
+        size_t lineEnd = text.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+        {
+            lineEnd = text.size();
+        }
+
+        size_t i = text.find_first_not_of(" \t", lineStart);
+        if (i < lineEnd && text.compare(i, 8, "#include") == 0)
+        {
+            const size_t open = text.find_first_of("\"<", i + 8);
+            const size_t close =
+                open < lineEnd
+                    ? text.find_first_of(text[open] == '"' ? "\"" : ">",
+                                         open + 1)
+                    : std::string::npos;
+            if (close < lineEnd)
+            {
+                const std::string name =
+                    text.substr(open + 1, close - open - 1);
+                const std::string includePath = directory + name;
+                hashString(hash, name);
+
+                // Files that can't be found, such as system headers, only
+                // contribute their name
+                std::string includeText;
+                if (visited.insert(includePath).second &&
+                    readText(includePath, includeText))
+                {
+                    hashSource(hash, includePath, includeText, visited);
+                }
+            }
+        }
+        lineStart = lineEnd + 1;
+    }
+}
+}
+
+// Compiler
+
+const char* D3DShaderCompiler::getId() const
+{
+#if defined(XGFX_NOOP)
+    return "noop";
+#else
+    return "d3dcompiler_47";
+#endif
+}
+
+bool D3DShaderCompiler::compile(const ShaderDesc& desc,
+                                std::vector<uint8_t>& bytecode,
+                                std::string& errors)
+{
+    const std::wstring path(desc.path.begin(), desc.path.end());
+
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (const auto& define : desc.defines)
+    {
+        macros.push_back({define.first.c_str(), define.second.c_str()});
+    }
+    macros.push_back({nullptr, nullptr});
+
+    ID3DBlob* code = nullptr;
+    ID3DBlob* errorBlob = nullptr;
+    const HRESULT hr = D3DCompileFromFile(
+        path.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+        desc.entryPoint.c_str(), desc.target.c_str(), desc.flags, 0, &code,
+        &errorBlob);
+
+    if (errorBlob)
+    {
+        errors = (const char*)errorBlob->GetBufferPointer();
+        errorBlob->Release();
+        errorBlob = nullptr;
+    }
+
+    if (FAILED(hr) || code == nullptr)
+    {
+        return false;
+    }
+
+    const uint8_t* data = (const uint8_t*)code->GetBufferPointer();
+    bytecode.assign(data, data + code->GetBufferSize());
+    code->Release();
+    return true;
+}
+
+// Stats
+
+void ShaderCacheStats::report(std::ostream& out) const
+{
+    out << "Shader cache: " << hits << " hits, " << misses << " misses, "
+        << compileFailures << " failures\n";
+    out << "  entries: " << entriesLoaded << " loaded, " << entriesWritten
+        << " written, " << bytesMapped << " bytes mapped\n";
+    out << "  ms: " << keyTime << " hashing keys, " << compileTime
+        << " compiling\n";
+}
+
+// Cache
+
+ShaderCache::ShaderCache(const std::string& path, ShaderCompiler& compiler)
+    : mPath(path), mCompiler(compiler), mFileValid(false)
+{
+    if (mFile.open(mPath))
+    {
+        mFileValid = load();
+    }
+}
+
+ShaderCache::~ShaderCache()
+{
+    try
+    {
+        save();
+    }
+    catch (const std::exception&)
+    {
+        // A cache that can't be written only costs compile time next run
+    }
+}
+
+D3D12_SHADER_BYTECODE ShaderCache::getShader(const ShaderDesc& desc)
+{
+    const auto keyStart = std::chrono::steady_clock::now();
+    const uint64_t key = computeKey(desc);
+    mStats.keyTime += std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - keyStart)
+                          .count();
+
+    auto found = mEntries.find(key);
+    if (found != mEntries.end())
+    {
+        mStats.hits++;
+        return found->second;
+    }
+    mStats.misses++;
+
+    const auto compileStart = std::chrono::steady_clock::now();
+    std::vector<uint8_t> bytecode;
+    std::string errors;
+    const bool compiled = mCompiler.compile(desc, bytecode, errors);
+    mStats.compileTime += std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - compileStart)
+                              .count();
+
+    if (!compiled)
+    {
+        mStats.compileFailures++;
+        std::cout << errors;
+        throw std::runtime_error("failed to compile shader!");
+    }
+
+    mCompiled.push_back(std::move(bytecode));
+    const std::vector<uint8_t>& stored = mCompiled.back();
+    mUnsaved.push_back({key, &stored});
+
+    D3D12_SHADER_BYTECODE entry;
+    entry.pShaderBytecode = stored.data();
+    entry.BytecodeLength = stored.size();
+    mEntries[key] = entry;
+    return entry;
+}
+
+uint64_t ShaderCache::computeKey(const ShaderDesc& desc) const
+{
+    uint64_t hash = kHashBasis;
+    hashString(hash, mCompiler.getId());
+
+    std::string source;
+    if (!readText(desc.path, source))
+    {
+        throw std::runtime_error("failed to open shader source!");
+    }
+    std::unordered_set<std::string> visited;
+    visited.insert(desc.path);
+    hashSource(hash, desc.path, source, visited);
+
+    hashValue(hash, (uint64_t)desc.defines.size());
+    for (const auto& define : desc.defines)
+    {
+        hashString(hash, define.first);
+        hashString(hash, define.second);
+    }
+    hashString(hash, desc.entryPoint);
+    hashString(hash, desc.target);
+    hashValue(hash, desc.flags);
+    return hash;
+}
+
+void ShaderCache::save()
+{
+    if (mUnsaved.empty())
+    {
+        return;
+    }
+
+    // Entries of an invalid file were never loaded, so start it over
+    std::ofstream out(mPath, std::ios::binary | (mFileValid ? std::ios::app
+                                                            : std::ios::trunc));
+    if (!out.is_open())
+    {
+        throw std::runtime_error("failed to open shader cache for writing!");
+    }
+
+    if (!mFileValid)
+    {
+        CacheHeader header;
+        memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        out.write((const char*)&header, sizeof(header));
+        mFileValid = true;
+    }
+
+    const char padding[8] = {};
+    for (const auto& unsaved : mUnsaved)
+    {
+        const std::vector<uint8_t>& bytecode = *unsaved.second;
+        CacheRecord record;
+        record.key = unsaved.first;
+        record.size = bytecode.size();
+        out.write((const char*)&record, sizeof(record));
+        out.write((const char*)bytecode.data(), bytecode.size());
+        out.write(padding, alignRecord(record.size) - record.size);
+        mStats.entriesWritten++;
+    }
+    mUnsaved.clear();
+}
+
+const ShaderCacheStats& ShaderCache::getStats() const { return mStats; }
+
+void ShaderCache::resetStats() { mStats = ShaderCacheStats(); }
+
+bool ShaderCache::load()
+{
+    const uint8_t* data = mFile.data();
+    const size_t size = mFile.size();
+
+    CacheHeader header;
+    if (size < sizeof(header))
+    {
+        mFile.close();
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+        header.version != kVersion)
+    {
+        mFile.close();
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+    while (offset + sizeof(CacheRecord) <= size)
+    {
+        CacheRecord record;
+        memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.size > size - offset)
+        {
+            break;
+        }
+
+        // Later records win, though equal keys should hold equal bytecode
+        D3D12_SHADER_BYTECODE entry;
+        entry.pShaderBytecode = data + offset;
+        entry.BytecodeLength = (SIZE_T)record.size;
+        mEntries[record.key] = entry;
+        mStats.entriesLoaded++;
+
+        offset += (size_t)alignRecord(record.size);
+    }
+
+    // Appending after a partly written record would misalign every record
+    // after it, so a damaged file is started over instead
+    if (offset != size)
+    {
+        mEntries.clear();
+        mStats.entriesLoaded = 0;
+        mFile.close();
+        return false;
+    }
+    mStats.bytesMapped = size;
+    return true;
+}
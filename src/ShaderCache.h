@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Shader Cache
+// Content addressed store of compiled shader bytecode. The key is a hash of
+// everything that affects the output: the compiler, the source and every file
+// it includes, the defines, the entry point, the target profile and the
+// compile flags. The cache file is memory mapped, so a hit hands out bytecode
+// straight from the mapping without compiling or copying anything, and new
+// bytecode is appended to the file when the cache is saved.
+
+struct ShaderDesc
+{
+    // Path of the source file, includes are resolved relative to it
+    std::string path;
+
+    std::string entryPoint = "main";
+
+    // Target profile, such as vs_5_0
+    std::string target;
+
+    // Name and value of every preprocessor define
+    std::vector<std::pair<std::string, std::string>> defines;
+
+    UINT flags = 0;
+};
+
+// Turns shader source into bytecode, replaceable so the cache can be
+// exercised without a real compiler
+class ShaderCompiler
+{
+  public:
+    virtual ~ShaderCompiler() {}
+
+    // Identifies the compiler and its version, it's part of every key so
+    // bytecode from another compiler is never handed out
+    virtual const char* getId() const = 0;
+
+    // Returns false and fills in errors if compilation fails
+    virtual bool compile(const ShaderDesc& desc, std::vector<uint8_t>& bytecode,
+                         std::string& errors) = 0;
+};
+
+// Compiles with D3DCompileFromFile, under the NOOP backend that returns the
+// source as is
+class D3DShaderCompiler : public ShaderCompiler
+{
+  public:
+    const char* getId() const override;
+
+    bool compile(const ShaderDesc& desc, std::vector<uint8_t>& bytecode,
+                 std::string& errors) override;
+};
+
+struct ShaderCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t compileFailures = 0;
+
+    // Entries found in the cache file when it was opened, and appended since
+    uint64_t entriesLoaded = 0;
+    uint64_t entriesWritten = 0;
+    uint64_t bytesMapped = 0;
+
+    // Time spent hashing sources for keys, and compiling misses, in
+    // milliseconds
+    double keyTime = 0.0;
+    double compileTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+class ShaderCache
+{
+  public:
+    // The compiler has to outlive the cache
+    ShaderCache(const std::string& path, ShaderCompiler& compiler);
+
+    // Saves anything compiled since the last save
+    ~ShaderCache();
+
+    // Returns cached bytecode, compiling and caching it on a miss. The
+    // bytecode stays valid for the lifetime of the cache. Throws if the
+    // shader fails to compile.
+    D3D12_SHADER_BYTECODE getShader(const ShaderDesc& desc);
+
+    // Hash of the compiler, the source and its includes, and the options
+    uint64_t computeKey(const ShaderDesc& desc) const;
+
+    // Append new entries to the cache file, rewriting it if it was missing or
+    // had an incompatible format
+    void save();
+
+    const ShaderCacheStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    // Load the entries of the mapped file, returns false if the file doesn't
+    // have a valid header
+    bool load();
+
+    std::string mPath;
+    ShaderCompiler& mCompiler;
+
+    MappedFile mFile;
+    bool mFileValid;
+
+    // Bytecode by key, pointing into the mapping or into mCompiled
+    std::unordered_map<uint64_t, D3D12_SHADER_BYTECODE> mEntries;
+
+    // Bytecode compiled this session, and which keys haven't been saved yet
+    std::deque<std::vector<uint8_t>> mCompiled;
+    std::vector<std::pair<uint64_t, const std::vector<uint8_t>*>> mUnsaved;
+
+    ShaderCacheStats mStats;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+// SIMD Support
+// Which x86 vector instructions code can use. SSE is part of every x86-64
+// CPU, so it's always compiled in. AVX2 code is compiled per function with
+// XGFX_TARGET_AVX2, and must only run once cpuSupportsAvx2() says so, which
+// keeps the build free of architecture flags.
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) ||            \
+    defined(_M_IX86)
+#define XGFX_SIMD_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+// MSVC allows any intrinsic in any function
+#define XGFX_TARGET_AVX2
+#else
+#include <immintrin.h>
+#define XGFX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+inline bool cpuSupportsAvx2()
+{
+#if !defined(XGFX_SIMD_X86)
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // The OS also has to save the upper halves of the registers
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// SPSC Queue
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. Each side only writes its own index, and the two indices live on
+// separate cache lines so the threads don't fight over one.
+
+template <typename T, size_t Capacity> class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                  "capacity has to be a power of two");
+
+  public:
+    SpscQueue() : mHead(0), mTail(0) {}
+
+    // Producer only, returns false if the queue is full
+    bool push(const T& value)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        mSlots[tail & (Capacity - 1)] = value;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only, returns false if the queue is empty
+    bool pop(T& value)
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = mSlots[head & (Capacity - 1)];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a hint while the other side is running
+    bool empty() const
+    {
+        return mHead.load(std::memory_order_acquire) ==
+               mTail.load(std::memory_order_acquire);
+    }
+
+  protected:
+    alignas(64) std::atomic<size_t> mHead;
+    alignas(64) std::atomic<size_t> mTail;
+    alignas(64) T mSlots[Capacity];
+};
@@ -0,0 +1,457 @@
+#include "TlsfAllocator.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+unsigned floorLog2(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (unsigned)index;
+#else
+    return 63u - (unsigned)__builtin_clzll(value);
+#endif
+}
+
+unsigned lowestBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctzll(value);
+#endif
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+}
+
+double TlsfStats::fragmentation() const
+{
+    return freeBytes > 0
+               ? 1.0 - (double)largestFreeBlock / (double)freeBytes
+               : 0.0;
+}
+
+TlsfAllocator::TlsfAllocator(uint64_t capacity) { reset(capacity); }
+
+void TlsfAllocator::reset(uint64_t capacity)
+{
+    mCapacity = capacity;
+    mBlocks.clear();
+    mUnusedBlocks.clear();
+    mFirstBlock = kNull;
+    mFirstLevelBitmap = 0;
+    for (unsigned fl = 0; fl < kFirstLevelCount; ++fl)
+    {
+        mSecondLevelBitmap[fl] = 0;
+        for (unsigned sl = 0; sl < kSecondLevelCount; ++sl)
+        {
+            mFreeLists[fl][sl] = kNull;
+        }
+    }
+    mAllocatedBytes = 0;
+    mAllocationCount = 0;
+
+    if (capacity > 0)
+    {
+        mFirstBlock = newBlock();
+        Block& block = mBlocks[mFirstBlock];
+        block.offset = 0;
+        block.size = capacity;
+        insertFree(mFirstBlock);
+    }
+}
+
+bool TlsfAllocator::allocate(uint64_t size, uint64_t alignment,
+                             TlsfAllocation& allocation)
+{
+    size = std::max<uint64_t>(size, 1);
+    alignment = std::max<uint64_t>(alignment, 1);
+
+    // Blocks are usually aligned already, so try the bin for the exact size
+    // first. Only if its block can't be aligned search for one with room to
+    // align within, otherwise exact fits of aligned sizes would never reuse
+    // the holes they leave.
+    unsigned fl, sl;
+    uint32_t block = kNull;
+    if (mapSearch(size, fl, sl))
+    {
+        block = findFree(fl, sl);
+        if (block != kNull)
+        {
+            const Block& candidate = mBlocks[block];
+            const uint64_t aligned = alignUp(candidate.offset, alignment);
+            if (aligned - candidate.offset + size > candidate.size)
+            {
+                block = kNull;
+            }
+        }
+    }
+    if (block == kNull)
+    {
+        const uint64_t padding = alignment - 1;
+        if (size > UINT64_MAX - padding || !mapSearch(size + padding, fl, sl))
+        {
+            return false;
+        }
+        block = findFree(fl, sl);
+        if (block == kNull)
+        {
+            return false;
+        }
+    }
+    carve(block, size, alignment, allocation);
+    return true;
+}
+
+void TlsfAllocator::carve(uint32_t block, uint64_t size, uint64_t alignment,
+                          TlsfAllocation& allocation)
+{
+    removeFree(block);
+
+    // Leading padding stays behind as a free block of its own, the block at
+    // the lower offset keeps its index so mFirstBlock never changes
+    const uint64_t offset = mBlocks[block].offset;
+    const uint64_t aligned = alignUp(offset, alignment);
+    if (aligned > offset)
+    {
+        const uint32_t pad = block;
+        block = newBlock();
+        Block& padBlock = mBlocks[pad];
+        Block& alignedBlock = mBlocks[block];
+        alignedBlock.offset = aligned;
+        alignedBlock.size = padBlock.size - (aligned - offset);
+        alignedBlock.prevPhysical = pad;
+        alignedBlock.nextPhysical = padBlock.nextPhysical;
+        if (padBlock.nextPhysical != kNull)
+        {
+            mBlocks[padBlock.nextPhysical].prevPhysical = block;
+        }
+        padBlock.nextPhysical = block;
+        padBlock.size = aligned - offset;
+        insertFree(pad);
+    }
+
+    if (mBlocks[block].size > size)
+    {
+        splitTail(block, size);
+    }
+
+    Block& used = mBlocks[block];
+    used.free = false;
+    used.alignment = alignment;
+    used.userData = nullptr;
+    mAllocatedBytes += used.size;
+    mAllocationCount++;
+
+    allocation.offset = used.offset;
+    allocation.size = used.size;
+    allocation.block = block;
+}
+
+void TlsfAllocator::free(uint32_t block)
+{
+    Block* freed = &mBlocks[block];
+    mAllocatedBytes -= freed->size;
+    mAllocationCount--;
+    freed->free = true;
+    freed->userData = nullptr;
+
+    // Merge with free neighbors, the lower block always survives
+    const uint32_t next = freed->nextPhysical;
+    if (next != kNull && mBlocks[next].free)
+    {
+        removeFree(next);
+        freed->size += mBlocks[next].size;
+        freed->nextPhysical = mBlocks[next].nextPhysical;
+        if (freed->nextPhysical != kNull)
+        {
+            mBlocks[freed->nextPhysical].prevPhysical = block;
+        }
+        releaseBlock(next);
+    }
+
+    const uint32_t prev = freed->prevPhysical;
+    if (prev != kNull && mBlocks[prev].free)
+    {
+        removeFree(prev);
+        mBlocks[prev].size += freed->size;
+        mBlocks[prev].nextPhysical = freed->nextPhysical;
+        if (freed->nextPhysical != kNull)
+        {
+            mBlocks[freed->nextPhysical].prevPhysical = prev;
+        }
+        releaseBlock(block);
+        block = prev;
+    }
+
+    insertFree(block);
+}
+
+void TlsfAllocator::setUserData(uint32_t block, void* userData)
+{
+    mBlocks[block].userData = userData;
+}
+
+void* TlsfAllocator::getUserData(uint32_t block) const
+{
+    return mBlocks[block].userData;
+}
+
+void TlsfAllocator::planDefragment(uint64_t maxBytes,
+                                   const std::function<bool(void*)>& isMovable,
+                                   std::vector<TlsfMove>& moves)
+{
+    std::vector<uint32_t> allocated;
+    for (uint32_t block = mFirstBlock; block != kNull;
+         block = mBlocks[block].nextPhysical)
+    {
+        if (!mBlocks[block].free)
+        {
+            allocated.push_back(block);
+        }
+    }
+
+    uint64_t planned = 0;
+    for (auto it = allocated.rbegin(); it != allocated.rend(); ++it)
+    {
+        // Copy out what's needed, carving may grow mBlocks
+        const Block source = mBlocks[*it];
+        if (planned + source.size > maxBytes ||
+            (isMovable && !isMovable(source.userData)))
+        {
+            continue;
+        }
+
+        // Unlike allocate() this is first fit by address, which is what
+        // compacts allocations toward the start of the range
+        uint32_t target = kNull;
+        for (uint32_t block = mFirstBlock;
+             block != kNull && mBlocks[block].offset < source.offset;
+             block = mBlocks[block].nextPhysical)
+        {
+            const Block& candidate = mBlocks[block];
+            const uint64_t aligned =
+                alignUp(candidate.offset, source.alignment);
+            if (candidate.free &&
+                aligned - candidate.offset + source.size <= candidate.size)
+            {
+                target = block;
+                break;
+            }
+        }
+        if (target == kNull)
+        {
+            continue;
+        }
+
+        TlsfAllocation to;
+        carve(target, source.size, source.alignment, to);
+        setUserData(to.block, source.userData);
+
+        TlsfMove move;
+        move.from.offset = source.offset;
+        move.from.size = source.size;
+        move.from.block = *it;
+        move.to = to;
+        move.userData = source.userData;
+        moves.push_back(move);
+        planned += source.size;
+    }
+}
+
+uint64_t TlsfAllocator::getCapacity() const { return mCapacity; }
+
+bool TlsfAllocator::isEmpty() const { return mAllocationCount == 0; }
+
+TlsfStats TlsfAllocator::getStats() const
+{
+    TlsfStats stats;
+    stats.capacity = mCapacity;
+    stats.allocatedBytes = mAllocatedBytes;
+    stats.freeBytes = mCapacity - mAllocatedBytes;
+    stats.allocationCount = mAllocationCount;
+    for (uint32_t block = mFirstBlock; block != kNull;
+         block = mBlocks[block].nextPhysical)
+    {
+        if (mBlocks[block].free)
+        {
+            stats.freeBlockCount++;
+            stats.largestFreeBlock =
+                std::max(stats.largestFreeBlock, mBlocks[block].size);
+        }
+    }
+    return stats;
+}
+
+void TlsfAllocator::mapInsert(uint64_t size, unsigned& firstLevel,
+                              unsigned& secondLevel)
+{
+    if (size < kSmallBlockSize)
+    {
+        firstLevel = 0;
+        secondLevel = (unsigned)size;
+        return;
+    }
+    const unsigned log2 = floorLog2(size);
+    secondLevel = (unsigned)(size >> (log2 - kSecondLevelLog2)) ^
+                  kSecondLevelCount;
+    firstLevel = log2 - kSecondLevelLog2 + 1;
+}
+
+bool TlsfAllocator::mapSearch(uint64_t size, unsigned& firstLevel,
+                              unsigned& secondLevel)
+{
+    // Round up to the next bin boundary, so any block in the bin fits
+    if (size >= kSmallBlockSize)
+    {
+        const uint64_t round =
+            (1ull << (floorLog2(size) - kSecondLevelLog2)) - 1;
+        if (size > UINT64_MAX - round)
+        {
+            return false;
+        }
+        size += round;
+    }
+    mapInsert(size, firstLevel, secondLevel);
+    return true;
+}
+
+uint32_t TlsfAllocator::newBlock()
+{
+    uint32_t block;
+    if (!mUnusedBlocks.empty())
+    {
+        block = mUnusedBlocks.back();
+        mUnusedBlocks.pop_back();
+    }
+    else
+    {
+        block = (uint32_t)mBlocks.size();
+        mBlocks.emplace_back();
+    }
+
+    Block& fresh = mBlocks[block];
+    fresh.offset = 0;
+    fresh.size = 0;
+    fresh.alignment = 1;
+    fresh.prevPhysical = kNull;
+    fresh.nextPhysical = kNull;
+    fresh.prevFree = kNull;
+    fresh.nextFree = kNull;
+    fresh.free = false;
+    fresh.userData = nullptr;
+    return block;
+}
+
+void TlsfAllocator::releaseBlock(uint32_t block)
+{
+    mUnusedBlocks.push_back(block);
+}
+
+void TlsfAllocator::insertFree(uint32_t block)
+{
+    Block& inserted = mBlocks[block];
+    unsigned fl, sl;
+    mapInsert(inserted.size, fl, sl);
+
+    inserted.free = true;
+    inserted.prevFree = kNull;
+    inserted.nextFree = mFreeLists[fl][sl];
+    if (inserted.nextFree != kNull)
+    {
+        mBlocks[inserted.nextFree].prevFree = block;
+    }
+    mFreeLists[fl][sl] = block;
+    mFirstLevelBitmap |= 1ull << fl;
+    mSecondLevelBitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::removeFree(uint32_t block)
+{
+    Block& removed = mBlocks[block];
+    unsigned fl, sl;
+    mapInsert(removed.size, fl, sl);
+
+    if (removed.prevFree != kNull)
+    {
+        mBlocks[removed.prevFree].nextFree = removed.nextFree;
+    }
+    else
+    {
+        mFreeLists[fl][sl] = removed.nextFree;
+    }
+    if (removed.nextFree != kNull)
+    {
+        mBlocks[removed.nextFree].prevFree = removed.prevFree;
+    }
+
+    if (mFreeLists[fl][sl] == kNull)
+    {
+        mSecondLevelBitmap[fl] &= ~(1u << sl);
+        if (mSecondLevelBitmap[fl] == 0)
+        {
+            mFirstLevelBitmap &= ~(1ull << fl);
+        }
+    }
+    removed.free = false;
+    removed.prevFree = kNull;
+    removed.nextFree = kNull;
+}
+
+uint32_t TlsfAllocator::findFree(unsigned firstLevel,
+                                 unsigned secondLevel) const
+{
+    if (firstLevel >= kFirstLevelCount)
+    {
+        return kNull;
+    }
+
+    uint32_t secondLevelMap =
+        mSecondLevelBitmap[firstLevel] & (~0u << secondLevel);
+    if (secondLevelMap == 0)
+    {
+        // Nothing left in this power of two, take the next larger one
+        const uint64_t firstLevelMap =
+            firstLevel + 1 < 64 ? mFirstLevelBitmap & (~0ull << (firstLevel + 1))
+                                : 0;
+        if (firstLevelMap == 0)
+        {
+            return kNull;
+        }
+        firstLevel = lowestBit(firstLevelMap);
+        secondLevelMap = mSecondLevelBitmap[firstLevel];
+    }
+    return mFreeLists[firstLevel][lowestBit(secondLevelMap)];
+}
+
+void TlsfAllocator::splitTail(uint32_t block, uint64_t size)
+{
+    const uint32_t tail = newBlock();
+    Block& head = mBlocks[block];
+    Block& rest = mBlocks[tail];
+    rest.offset = head.offset + size;
+    rest.size = head.size - size;
+    rest.prevPhysical = block;
+    rest.nextPhysical = head.nextPhysical;
+    if (head.nextPhysical != kNull)
+    {
+        mBlocks[head.nextPhysical].prevPhysical = tail;
+    }
+    head.nextPhysical = tail;
+    head.size = size;
+
+    // The block after the original was in use, free blocks never touch
+    insertFree(tail);
+}
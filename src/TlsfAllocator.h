@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// TLSF Allocator
+// Two level segregated fit allocator over a fixed size range of offsets.
+// Free blocks are binned by the power of two of their size and then by a
+// linear subdivision of that power, with a bitmap per level, so finding a
+// fitting block and freeing one (merging with its neighbors) are both O(1).
+// It only deals in offsets, so it can manage GPU heaps, staging memory, or
+// anything else that is addressed from a base.
+
+struct TlsfAllocation
+{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+
+    // Identifies the allocation when freeing it
+    uint32_t block = UINT32_MAX;
+};
+
+struct TlsfStats
+{
+    uint64_t capacity = 0;
+    uint64_t allocatedBytes = 0;
+    uint64_t freeBytes = 0;
+    uint64_t allocationCount = 0;
+    uint64_t freeBlockCount = 0;
+    uint64_t largestFreeBlock = 0;
+
+    // 0 when every free byte is in one block, approaching 1 as free memory is
+    // split up into blocks too small to be useful
+    double fragmentation() const;
+};
+
+// A planned relocation, the destination is already allocated and the source
+// stays allocated until the caller has copied the data and freed it
+struct TlsfMove
+{
+    TlsfAllocation from;
+    TlsfAllocation to;
+    void* userData;
+};
+
+class TlsfAllocator
+{
+  public:
+    TlsfAllocator(uint64_t capacity = 0);
+
+    // Drop every allocation and resize the range
+    void reset(uint64_t capacity);
+
+    // Alignment must be a power of two, returns false if no free block fits
+    bool allocate(uint64_t size, uint64_t alignment,
+                  TlsfAllocation& allocation);
+
+    void free(uint32_t block);
+
+    // Opaque pointer carried along with an allocation, handed back in moves
+    void setUserData(uint32_t block, void* userData);
+
+    void* getUserData(uint32_t block) const;
+
+    // Plan moves of allocations from the top of the range into lower free
+    // blocks, highest offsets first, until maxBytes have been planned.
+    // Sources aren't freed, so no planned destination overlaps another move.
+    void planDefragment(uint64_t maxBytes,
+                        const std::function<bool(void*)>& isMovable,
+                        std::vector<TlsfMove>& moves);
+
+    uint64_t getCapacity() const;
+
+    bool isEmpty() const;
+
+    TlsfStats getStats() const;
+
+  protected:
+    static const uint32_t kNull = UINT32_MAX;
+    static const unsigned kSecondLevelLog2 = 5;
+    static const unsigned kSecondLevelCount = 1u << kSecondLevelLog2;
+
+    // Sizes below this are binned linearly in the first level
+    static const uint64_t kSmallBlockSize = 1ull << kSecondLevelLog2;
+    static const unsigned kFirstLevelCount = 64 - kSecondLevelLog2 + 1;
+
+    struct Block
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint64_t alignment;
+
+        // Neighbors in address order
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+
+        // Neighbors in the free list of the same bin
+        uint32_t prevFree;
+        uint32_t nextFree;
+
+        bool free;
+        void* userData;
+    };
+
+    // Bin a block of the given size belongs to
+    static void mapInsert(uint64_t size, unsigned& firstLevel,
+                          unsigned& secondLevel);
+
+    // Smallest bin whose blocks are all at least the given size
+    static bool mapSearch(uint64_t size, unsigned& firstLevel,
+                          unsigned& secondLevel);
+
+    uint32_t newBlock();
+
+    void releaseBlock(uint32_t block);
+
+    void insertFree(uint32_t block);
+
+    void removeFree(uint32_t block);
+
+    // Free block from the first non-empty bin at or above the given one
+    uint32_t findFree(unsigned firstLevel, unsigned secondLevel) const;
+
+    // Allocate from a specific free block that's known to fit
+    void carve(uint32_t block, uint64_t size, uint64_t alignment,
+               TlsfAllocation& allocation);
+
+    // Split the tail of a block off into a new free block
+    void splitTail(uint32_t block, uint64_t size);
+
+    uint64_t mCapacity;
+
+    std::vector<Block> mBlocks;
+    std::vector<uint32_t> mUnusedBlocks;
+
+    // The block at offset 0, it's never merged into another block
+    uint32_t mFirstBlock;
+
+    uint64_t mFirstLevelBitmap;
+    uint32_t mSecondLevelBitmap[kFirstLevelCount];
+    uint32_t mFreeLists[kFirstLevelCount][kSecondLevelCount];
+
+    uint64_t mAllocatedBytes;
+    uint64_t mAllocationCount;
+};
@@ -0,0 +1,449 @@
+#include "TransformSystem.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ostream>
+
+namespace
+{
+// Where computeMatrices() reads from and writes to
+struct TransformArrays
+{
+    const float* positionX;
+    const float* positionY;
+    const float* positionZ;
+    const float* rotationX;
+    const float* rotationY;
+    const float* rotationZ;
+    const float* rotationW;
+    const float* scaleX;
+    const float* scaleY;
+    const float* scaleZ;
+
+    // Column major, or null
+    const float* viewProjection;
+
+    uint8_t* destination;
+    size_t stride;
+};
+
+// Every kernel uses the same operations in the same order, so they agree
+// exactly as long as the compiler doesn't fuse them
+void computeScalar(const TransformArrays& t, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const float x2 = t.rotationX[i] * 2.0f;
+        const float y2 = t.rotationY[i] * 2.0f;
+        const float z2 = t.rotationZ[i] * 2.0f;
+        const float xx = t.rotationX[i] * x2;
+        const float yy = t.rotationY[i] * y2;
+        const float zz = t.rotationZ[i] * z2;
+        const float xy = t.rotationX[i] * y2;
+        const float xz = t.rotationX[i] * z2;
+        const float yz = t.rotationY[i] * z2;
+        const float wx = t.rotationW[i] * x2;
+        const float wy = t.rotationW[i] * y2;
+        const float wz = t.rotationW[i] * z2;
+
+        // Translation * rotation * scale
+        const float model[16] = {
+            (1.0f - (yy + zz)) * t.scaleX[i],
+            (xy + wz) * t.scaleX[i],
+            (xz - wy) * t.scaleX[i],
+            0.0f,
+            (xy - wz) * t.scaleY[i],
+            (1.0f - (xx + zz)) * t.scaleY[i],
+            (yz + wx) * t.scaleY[i],
+            0.0f,
+            (xz + wy) * t.scaleZ[i],
+            (yz - wx) * t.scaleZ[i],
+            (1.0f - (xx + yy)) * t.scaleZ[i],
+            0.0f,
+            t.positionX[i],
+            t.positionY[i],
+            t.positionZ[i],
+            1.0f};
+
+        float* out = (float*)(t.destination + i * t.stride);
+        if (t.viewProjection == nullptr)
+        {
+            memcpy(out, model, sizeof(model));
+            continue;
+        }
+
+        const float* vp = t.viewProjection;
+        for (int c = 0; c < 3; ++c)
+        {
+            for (int r = 0; r < 4; ++r)
+            {
+                out[c * 4 + r] = vp[0 * 4 + r] * model[c * 4 + 0] +
+                                 vp[1 * 4 + r] * model[c * 4 + 1] +
+                                 vp[2 * 4 + r] * model[c * 4 + 2];
+            }
+        }
+        for (int r = 0; r < 4; ++r)
+        {
+            out[12 + r] = vp[0 * 4 + r] * model[12] +
+                          vp[1 * 4 + r] * model[13] +
+                          vp[2 * 4 + r] * model[14] + vp[3 * 4 + r];
+        }
+    }
+}
+
+#if defined(XGFX_SIMD_X86)
+// Four objects per iteration, each register holds one matrix element of all
+// four, then the columns are transposed back into one matrix per object
+void computeSse(const TransformArrays& t, size_t begin, size_t end)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(t.rotationX + i);
+        const __m128 y = _mm_loadu_ps(t.rotationY + i);
+        const __m128 z = _mm_loadu_ps(t.rotationZ + i);
+        const __m128 w = _mm_loadu_ps(t.rotationW + i);
+        const __m128 x2 = _mm_mul_ps(x, two);
+        const __m128 y2 = _mm_mul_ps(y, two);
+        const __m128 z2 = _mm_mul_ps(z, two);
+        const __m128 xx = _mm_mul_ps(x, x2);
+        const __m128 yy = _mm_mul_ps(y, y2);
+        const __m128 zz = _mm_mul_ps(z, z2);
+        const __m128 xy = _mm_mul_ps(x, y2);
+        const __m128 xz = _mm_mul_ps(x, z2);
+        const __m128 yz = _mm_mul_ps(y, z2);
+        const __m128 wx = _mm_mul_ps(w, x2);
+        const __m128 wy = _mm_mul_ps(w, y2);
+        const __m128 wz = _mm_mul_ps(w, z2);
+        const __m128 sx = _mm_loadu_ps(t.scaleX + i);
+        const __m128 sy = _mm_loadu_ps(t.scaleY + i);
+        const __m128 sz = _mm_loadu_ps(t.scaleZ + i);
+
+        // By column, then row
+        __m128 m[4][4] = {
+            {_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx),
+             _mm_mul_ps(_mm_add_ps(xy, wz), sx),
+             _mm_mul_ps(_mm_sub_ps(xz, wy), sx), zero},
+            {_mm_mul_ps(_mm_sub_ps(xy, wz), sy),
+             _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy),
+             _mm_mul_ps(_mm_add_ps(yz, wx), sy), zero},
+            {_mm_mul_ps(_mm_add_ps(xz, wy), sz),
+             _mm_mul_ps(_mm_sub_ps(yz, wx), sz),
+             _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), zero},
+            {_mm_loadu_ps(t.positionX + i), _mm_loadu_ps(t.positionY + i),
+             _mm_loadu_ps(t.positionZ + i), one}};
+
+        if (t.viewProjection != nullptr)
+        {
+            const float* vp = t.viewProjection;
+            __m128 mvp[4][4];
+            for (int c = 0; c < 4; ++c)
+            {
+                for (int r = 0; r < 4; ++r)
+                {
+                    __m128 sum = _mm_add_ps(
+                        _mm_add_ps(
+                            _mm_mul_ps(_mm_set1_ps(vp[0 * 4 + r]), m[c][0]),
+                            _mm_mul_ps(_mm_set1_ps(vp[1 * 4 + r]), m[c][1])),
+                        _mm_mul_ps(_mm_set1_ps(vp[2 * 4 + r]), m[c][2]));
+                    if (c == 3)
+                    {
+                        sum = _mm_add_ps(sum, _mm_set1_ps(vp[3 * 4 + r]));
+                    }
+                    mvp[c][r] = sum;
+                }
+            }
+            memcpy(m, mvp, sizeof(m));
+        }
+
+        uint8_t* out = t.destination + i * t.stride;
+        for (int c = 0; c < 4; ++c)
+        {
+            __m128 r0 = m[c][0], r1 = m[c][1], r2 = m[c][2], r3 = m[c][3];
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps((float*)(out + 0 * t.stride) + c * 4, r0);
+            _mm_storeu_ps((float*)(out + 1 * t.stride) + c * 4, r1);
+            _mm_storeu_ps((float*)(out + 2 * t.stride) + c * 4, r2);
+            _mm_storeu_ps((float*)(out + 3 * t.stride) + c * 4, r3);
+        }
+    }
+
+    computeScalar(t, i, end);
+}
+
+// Eight objects per iteration, transposed as two groups of four
+XGFX_TARGET_AVX2 void computeAvx2(const TransformArrays& t, size_t begin,
+                                  size_t end)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(t.rotationX + i);
+        const __m256 y = _mm256_loadu_ps(t.rotationY + i);
+        const __m256 z = _mm256_loadu_ps(t.rotationZ + i);
+        const __m256 w = _mm256_loadu_ps(t.rotationW + i);
+        const __m256 x2 = _mm256_mul_ps(x, two);
+        const __m256 y2 = _mm256_mul_ps(y, two);
+        const __m256 z2 = _mm256_mul_ps(z, two);
+        const __m256 xx = _mm256_mul_ps(x, x2);
+        const __m256 yy = _mm256_mul_ps(y, y2);
+        const __m256 zz = _mm256_mul_ps(z, z2);
+        const __m256 xy = _mm256_mul_ps(x, y2);
+        const __m256 xz = _mm256_mul_ps(x, z2);
+        const __m256 yz = _mm256_mul_ps(y, z2);
+        const __m256 wx = _mm256_mul_ps(w, x2);
+        const __m256 wy = _mm256_mul_ps(w, y2);
+        const __m256 wz = _mm256_mul_ps(w, z2);
+        const __m256 sx = _mm256_loadu_ps(t.scaleX + i);
+        const __m256 sy = _mm256_loadu_ps(t.scaleY + i);
+        const __m256 sz = _mm256_loadu_ps(t.scaleZ + i);
+
+        __m256 m[4][4] = {
+            {_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx),
+             _mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+             _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx), zero},
+            {_mm256_mul_ps(_mm256_sub_ps(xy, wz), sy),
+             _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+             _mm256_mul_ps(_mm256_add_ps(yz, wx), sy), zero},
+            {_mm256_mul_ps(_mm256_add_ps(xz, wy), sz),
+             _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+             _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz),
+             zero},
+            {_mm256_loadu_ps(t.positionX + i), _mm256_loadu_ps(t.positionY + i),
+             _mm256_loadu_ps(t.positionZ + i), one}};
+
+        if (t.viewProjection != nullptr)
+        {
+            const float* vp = t.viewProjection;
+            __m256 mvp[4][4];
+            for (int c = 0; c < 4; ++c)
+            {
+                for (int r = 0; r < 4; ++r)
+                {
+                    __m256 sum = _mm256_add_ps(
+                        _mm256_add_ps(
+                            _mm256_mul_ps(_mm256_set1_ps(vp[0 * 4 + r]),
+                                          m[c][0]),
+                            _mm256_mul_ps(_mm256_set1_ps(vp[1 * 4 + r]),
+                                          m[c][1])),
+                        _mm256_mul_ps(_mm256_set1_ps(vp[2 * 4 + r]), m[c][2]));
+                    if (c == 3)
+                    {
+                        sum = _mm256_add_ps(sum, _mm256_set1_ps(vp[3 * 4 + r]));
+                    }
+                    mvp[c][r] = sum;
+                }
+            }
+            memcpy(m, mvp, sizeof(m));
+        }
+
+        uint8_t* out = t.destination + i * t.stride;
+        for (int c = 0; c < 4; ++c)
+        {
+            for (int half = 0; half < 2; ++half)
+            {
+                __m128 r0 = half == 0 ? _mm256_castps256_ps128(m[c][0])
+                                      : _mm256_extractf128_ps(m[c][0], 1);
+                __m128 r1 = half == 0 ? _mm256_castps256_ps128(m[c][1])
+                                      : _mm256_extractf128_ps(m[c][1], 1);
+                __m128 r2 = half == 0 ? _mm256_castps256_ps128(m[c][2])
+                                      : _mm256_extractf128_ps(m[c][2], 1);
+                __m128 r3 = half == 0 ? _mm256_castps256_ps128(m[c][3])
+                                      : _mm256_extractf128_ps(m[c][3], 1);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+                uint8_t* objects = out + half * 4 * t.stride;
+                _mm_storeu_ps((float*)(objects + 0 * t.stride) + c * 4, r0);
+                _mm_storeu_ps((float*)(objects + 1 * t.stride) + c * 4, r1);
+                _mm_storeu_ps((float*)(objects + 2 * t.stride) + c * 4, r2);
+                _mm_storeu_ps((float*)(objects + 3 * t.stride) + c * 4, r3);
+            }
+        }
+    }
+
+    computeSse(t, i, end);
+}
+#endif
+
+double elapsedMilliseconds(std::chrono::steady_clock::time_point start,
+                           std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+}
+
+TransformKernel getBestTransformKernel()
+{
+#if defined(XGFX_SIMD_X86)
+    static const TransformKernel best =
+        cpuSupportsAvx2() ? TransformKernel::Avx2 : TransformKernel::Sse;
+    return best;
+#else
+    return TransformKernel::Scalar;
+#endif
+}
+
+const char* getTransformKernelName(TransformKernel kernel)
+{
+    switch (kernel)
+    {
+    case TransformKernel::Sse:
+        return "SSE";
+    case TransformKernel::Avx2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+void TransformStats::report(std::ostream& out) const
+{
+    out << "Transforms: " << matrices << " matrices over " << updates
+        << " updates, " << updateTime << " ms";
+    if (updateTime > 0.0)
+    {
+        out << ", " << (double)matrices / updateTime << " per ms";
+    }
+    out << "\n";
+}
+
+TransformSystem::TransformSystem(TransformKernel kernel)
+{
+    setKernel(kernel);
+}
+
+uint32_t TransformSystem::add(const glm::vec3& position,
+                              const glm::quat& rotation, const glm::vec3& scale)
+{
+    mPositionX.push_back(position.x);
+    mPositionY.push_back(position.y);
+    mPositionZ.push_back(position.z);
+    mRotationX.push_back(rotation.x);
+    mRotationY.push_back(rotation.y);
+    mRotationZ.push_back(rotation.z);
+    mRotationW.push_back(rotation.w);
+    mScaleX.push_back(scale.x);
+    mScaleY.push_back(scale.y);
+    mScaleZ.push_back(scale.z);
+    return (uint32_t)(mPositionX.size() - 1);
+}
+
+size_t TransformSystem::size() const { return mPositionX.size(); }
+
+void TransformSystem::clear()
+{
+    for (std::vector<float>* values :
+         {&mPositionX, &mPositionY, &mPositionZ, &mRotationX, &mRotationY,
+          &mRotationZ, &mRotationW, &mScaleX, &mScaleY, &mScaleZ})
+    {
+        values->clear();
+    }
+}
+
+void TransformSystem::setPosition(uint32_t index, const glm::vec3& position)
+{
+    mPositionX[index] = position.x;
+    mPositionY[index] = position.y;
+    mPositionZ[index] = position.z;
+}
+
+void TransformSystem::setRotation(uint32_t index, const glm::quat& rotation)
+{
+    mRotationX[index] = rotation.x;
+    mRotationY[index] = rotation.y;
+    mRotationZ[index] = rotation.z;
+    mRotationW[index] = rotation.w;
+}
+
+void TransformSystem::setScale(uint32_t index, const glm::vec3& scale)
+{
+    mScaleX[index] = scale.x;
+    mScaleY[index] = scale.y;
+    mScaleZ[index] = scale.z;
+}
+
+void TransformSystem::rotateAll(const glm::quat& rotation)
+{
+    // rotation * current, laid out so the compiler can vectorize it
+    const float rx = rotation.x, ry = rotation.y, rz = rotation.z,
+                rw = rotation.w;
+    float* qx = mRotationX.data();
+    float* qy = mRotationY.data();
+    float* qz = mRotationZ.data();
+    float* qw = mRotationW.data();
+    const size_t count = size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float x = rw * qx[i] + rx * qw[i] + ry * qz[i] - rz * qy[i];
+        const float y = rw * qy[i] + ry * qw[i] + rz * qx[i] - rx * qz[i];
+        const float z = rw * qz[i] + rz * qw[i] + rx * qy[i] - ry * qx[i];
+        const float w = rw * qw[i] - rx * qx[i] - ry * qy[i] - rz * qz[i];
+        qx[i] = x;
+        qy[i] = y;
+        qz[i] = z;
+        qw[i] = w;
+    }
+}
+
+void TransformSystem::computeMatrices(void* destination, size_t stride,
+                                      const glm::mat4* viewProjection)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    TransformArrays arrays;
+    arrays.positionX = mPositionX.data();
+    arrays.positionY = mPositionY.data();
+    arrays.positionZ = mPositionZ.data();
+    arrays.rotationX = mRotationX.data();
+    arrays.rotationY = mRotationY.data();
+    arrays.rotationZ = mRotationZ.data();
+    arrays.rotationW = mRotationW.data();
+    arrays.scaleX = mScaleX.data();
+    arrays.scaleY = mScaleY.data();
+    arrays.scaleZ = mScaleZ.data();
+    arrays.viewProjection = reinterpret_cast<const float*>(viewProjection);
+    arrays.destination = (uint8_t*)destination;
+    arrays.stride = stride;
+
+    switch (mKernel)
+    {
+#if defined(XGFX_SIMD_X86)
+    case TransformKernel::Avx2:
+        computeAvx2(arrays, 0, size());
+        break;
+    case TransformKernel::Sse:
+        computeSse(arrays, 0, size());
+        break;
+#endif
+    default:
+        computeScalar(arrays, 0, size());
+        break;
+    }
+
+    mStats.updates++;
+    mStats.matrices += size();
+    mStats.updateTime +=
+        elapsedMilliseconds(start, std::chrono::steady_clock::now());
+}
+
+void TransformSystem::setKernel(TransformKernel kernel)
+{
+    // Kernels are ordered by the instructions they need
+    mKernel = std::min(kernel, getBestTransformKernel());
+}
+
+TransformKernel TransformSystem::getKernel() const { return mKernel; }
+
+const TransformStats& TransformSystem::getStats() const { return mStats; }
+
+void TransformSystem::resetStats() { mStats = TransformStats(); }
@@ -0,0 +1,91 @@
+#pragma once
+
+#define GLM_FORCE_SSE42 1
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES 1
+#define GLM_FORCE_LEFT_HANDED
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Transform System
+// Object transforms stored as a structure of arrays, a position, rotation and
+// scale per object, so the matrices built from them can be computed several
+// objects at a time with SSE or AVX2. Matrices are written to any strided
+// destination, such as the draw items of a frame packet, optionally
+// premultiplied by a view projection matrix. The scalar kernel produces the
+// same matrices on CPUs without either.
+
+enum class TransformKernel
+{
+    Scalar,
+    Sse,
+    Avx2
+};
+
+// The fastest kernel this CPU supports
+TransformKernel getBestTransformKernel();
+
+const char* getTransformKernelName(TransformKernel kernel);
+
+struct TransformStats
+{
+    uint64_t updates = 0;
+    uint64_t matrices = 0;
+
+    // Time spent in computeMatrices(), in milliseconds
+    double updateTime = 0.0;
+
+    void report(std::ostream& out) const;
+};
+
+class TransformSystem
+{
+  public:
+    // Kernels the CPU doesn't support fall back to the best one it does
+    TransformSystem(TransformKernel kernel = getBestTransformKernel());
+
+    // Returns the index of the new object
+    uint32_t add(const glm::vec3& position,
+                 const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                 const glm::vec3& scale = glm::vec3(1.0f));
+
+    size_t size() const;
+
+    void clear();
+
+    void setPosition(uint32_t index, const glm::vec3& position);
+
+    void setRotation(uint32_t index, const glm::quat& rotation);
+
+    void setScale(uint32_t index, const glm::vec3& scale);
+
+    // Rotate every object about its own origin, after its current rotation
+    void rotateAll(const glm::quat& rotation);
+
+    // Write every object's model matrix, or its model view projection matrix
+    // when a view projection is given, to destination with stride bytes
+    // between matrices
+    void computeMatrices(void* destination, size_t stride,
+                         const glm::mat4* viewProjection = nullptr);
+
+    void setKernel(TransformKernel kernel);
+
+    TransformKernel getKernel() const;
+
+    const TransformStats& getStats() const;
+
+    void resetStats();
+
+  protected:
+    TransformKernel mKernel;
+
+    std::vector<float> mPositionX, mPositionY, mPositionZ;
+    std::vector<float> mRotationX, mRotationY, mRotationZ, mRotationW;
+    std::vector<float> mScaleX, mScaleY, mScaleZ;
+
+    TransformStats mStats;
+};
@@ -0,0 +1,82 @@
+#include "UploadRing.h"
+
+#include <stdexcept>
+
+UploadRing::UploadRing(GpuAllocator* gpuAllocator, UINT64 capacity,
+                       bool validate)
+    : mAllocator(capacity, validate), mGpuAllocator(gpuAllocator),
+      mBuffer(nullptr), mMappedData(nullptr), mGpuAddress(0)
+{
+    if (gpuAllocator == nullptr)
+    {
+        mCpuData.resize((size_t)capacity);
+        mMappedData = mCpuData.data();
+        return;
+    }
+
+    mBuffer = mGpuAllocator->createBuffer(D3D12_HEAP_TYPE_UPLOAD, capacity,
+                                          D3D12_RESOURCE_STATE_GENERIC_READ,
+                                          L"Upload Ring");
+
+    // Upload heaps can stay mapped for their whole lifetime. We do not intend
+    // to read from this resource on the CPU.
+    D3D12_RANGE readRange;
+    readRange.Begin = 0;
+    readRange.End = 0;
+    ThrowIfFailed(mBuffer->resource->Map(
+        0, &readRange, reinterpret_cast<void**>(&mMappedData)));
+    mGpuAddress = mBuffer->resource->GetGPUVirtualAddress();
+}
+
+UploadRing::~UploadRing()
+{
+    if (mBuffer)
+    {
+        mBuffer->resource->Unmap(0, nullptr);
+        mGpuAllocator->release(mBuffer);
+        mBuffer = nullptr;
+    }
+}
+
+UploadAllocation UploadRing::allocate(UINT64 size, UINT64 alignment)
+{
+    UploadAllocation allocation;
+    if (!tryAllocate(size, alignment, allocation))
+    {
+        throw std::runtime_error("upload ring is out of memory!");
+    }
+    return allocation;
+}
+
+bool UploadRing::tryAllocate(UINT64 size, UINT64 alignment,
+                             UploadAllocation& allocation)
+{
+    UINT64 offset = 0;
+    if (!mAllocator.allocate(size, alignment, offset))
+    {
+        return false;
+    }
+
+    allocation.cpuAddress = mMappedData + offset;
+    allocation.gpuAddress = mGpuAddress + offset;
+    allocation.offset = offset;
+    allocation.size = size;
+    return true;
+}
+
+void UploadRing::finishFrame(UINT64 fenceValue)
+{
+    mAllocator.finishFrame(fenceValue);
+}
+
+void UploadRing::retire(UINT64 completedFenceValue)
+{
+    mAllocator.retire(completedFenceValue);
+}
+
+ID3D12Resource* UploadRing::getResource() const
+{
+    return mBuffer != nullptr ? mBuffer->resource : nullptr;
+}
+
+const RingAllocator& UploadRing::getAllocator() const { return mAllocator; }
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Backend/Backend.h"
+#include "GpuAllocator.h"
+#include "RingAllocator.h"
+
+#include <cstring>
+#include <vector>
+
+// Upload Ring
+// A persistently mapped upload heap buffer that per-frame data such as
+// constant buffers is sub-allocated from. Every allocation is 256 byte
+// aligned by default so it can be bound directly as a root CBV, and is
+// recycled once the fence of the frame that wrote it completes.
+
+struct UploadAllocation
+{
+    UINT8* cpuAddress;
+    D3D12_GPU_VIRTUAL_ADDRESS gpuAddress;
+    UINT64 offset;
+    UINT64 size;
+};
+
+class UploadRing
+{
+  public:
+    // Without a GPU allocator the ring is backed by CPU memory, so allocation
+    // patterns can be validated on machines without a GPU
+    UploadRing(GpuAllocator* gpuAllocator, UINT64 capacity,
+               bool validate = false);
+
+    ~UploadRing();
+
+    // Throws if the ring is full, size it for every frame in flight
+    UploadAllocation
+    allocate(UINT64 size,
+             UINT64 alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+    // Returns false instead of throwing when the ring is full
+    bool tryAllocate(UINT64 size, UINT64 alignment,
+                     UploadAllocation& allocation);
+
+    // Allocate and copy in one go
+    template <typename T> UploadAllocation upload(const T& data)
+    {
+        UploadAllocation allocation = allocate(sizeof(T));
+        memcpy(allocation.cpuAddress, &data, sizeof(T));
+        return allocation;
+    }
+
+    // Tag this frame's allocations with the fence value of its submission
+    void finishFrame(UINT64 fenceValue);
+
+    // Recycle the allocations of every frame the GPU has finished
+    void retire(UINT64 completedFenceValue);
+
+    ID3D12Resource* getResource() const;
+
+    const RingAllocator& getAllocator() const;
+
+  protected:
+    RingAllocator mAllocator;
+    GpuAllocator* mGpuAllocator;
+    GpuAllocation* mBuffer;
+    UINT8* mMappedData;
+    D3D12_GPU_VIRTUAL_ADDRESS mGpuAddress;
+
+    // Backing memory when there's no device
+    std::vector<UINT8> mCpuData;
+};
@@ -0,0 +1,294 @@
+#include "../src/DescriptorAllocator.h"
+#include "Test.h"
+
+#include <thread>
+#include <vector>
+
+// Descriptor Allocator Tests
+// A small shader visible heap on the NOOP device, which checks every copy
+// reads from staging heaps and writes inside the shader visible one. Tables
+// bound again in a frame reuse their copy and get a fresh one the next
+// frame, ring and bindless space comes back only once its frame's fence is
+// retired, staging descriptors are reused only after a flush, and each
+// flush is one CopyDescriptors call however many copies were staged.
+
+namespace
+{
+const uint32_t kBindless = 16;
+const uint32_t kRing = 48;
+
+UINT64 getCalls(NoopApiCall call)
+{
+    return noopStats().calls[(unsigned)call].load();
+}
+
+DescriptorAllocatorDesc getDesc()
+{
+    DescriptorAllocatorDesc desc;
+    desc.shaderVisibleDescriptors = kBindless + kRing;
+    desc.bindlessDescriptors = kBindless;
+    desc.stagingHeapSize = 32;
+    return desc;
+}
+
+ID3D12Device* createDevice()
+{
+    ID3D12Device* device = nullptr;
+    CHECK(SUCCEEDED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0,
+                                      IID_PPV_ARGS(&device))));
+    return device;
+}
+
+std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>
+allocateViews(DescriptorAllocator& allocator, size_t count)
+{
+    std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> views;
+    for (size_t i = 0; i < count; ++i)
+    {
+        views.push_back(
+            allocator.allocateStaging(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV)
+                .cpu);
+    }
+    return views;
+}
+
+// Index of a shader visible descriptor from its GPU handle
+uint32_t getIndex(ID3D12Device* device, DescriptorAllocator& allocator,
+                  D3D12_GPU_DESCRIPTOR_HANDLE handle)
+{
+    const UINT increment = device->GetDescriptorHandleIncrementSize(
+        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    const D3D12_GPU_DESCRIPTOR_HANDLE start =
+        allocator.getShaderVisibleHeap()->GetGPUDescriptorHandleForHeapStart();
+    return (uint32_t)((handle.ptr - start.ptr) / increment);
+}
+
+void testTableReuse()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        DescriptorAllocator allocator(device, getDesc());
+        const auto views = allocateViews(allocator, 4);
+
+        // The same descriptors again are the same table
+        const D3D12_GPU_DESCRIPTOR_HANDLE table =
+            allocator.bindTable(views.data(), 3);
+        CHECK(getIndex(device, allocator, table) >= kBindless);
+        CHECK(allocator.bindTable(views.data(), 3).ptr == table.ptr);
+
+        // Anything else is a copy of its own
+        const D3D12_CPU_DESCRIPTOR_HANDLE reordered[] = {views[1], views[0],
+                                                         views[2]};
+        const D3D12_GPU_DESCRIPTOR_HANDLE other[] = {
+            allocator.bindTable(reordered, 3),
+            allocator.bindTable(views.data(), 2),
+            allocator.bindTable(views.data() + 1, 3)};
+        for (const D3D12_GPU_DESCRIPTOR_HANDLE& handle : other)
+        {
+            CHECK(handle.ptr != table.ptr);
+        }
+        CHECK(allocator.getStats().tables == 5);
+        CHECK(allocator.getStats().reusedTables == 1);
+        allocator.finishFrame(1);
+        CHECK(allocator.getStats().frameDescriptorsCopied == 11);
+
+        // Tables aren't reused across frames, the last copy may still be in
+        // flight, so the table takes a fresh ring slot
+        const D3D12_GPU_DESCRIPTOR_HANDLE next =
+            allocator.bindTable(views.data(), 3);
+        CHECK(next.ptr != table.ptr);
+        for (const D3D12_GPU_DESCRIPTOR_HANDLE& handle : other)
+        {
+            CHECK(next.ptr != handle.ptr);
+        }
+        CHECK(allocator.bindTable(views.data(), 3).ptr == next.ptr);
+        CHECK(allocator.getStats().reusedTables == 2);
+        allocator.finishFrame(2);
+        CHECK(allocator.getStats().frameDescriptorsCopied == 3);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+
+void testRingRetirement()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        DescriptorAllocator allocator(device, getDesc());
+        const auto views = allocateViews(allocator, kRing / 3);
+
+        // Three frames in flight fill the ring
+        std::vector<D3D12_GPU_DESCRIPTOR_HANDLE> tables;
+        for (UINT64 fenceValue = 1; fenceValue <= 3; ++fenceValue)
+        {
+            tables.push_back(
+                allocator.bindTable(views.data(), (uint32_t)views.size()));
+            allocator.finishFrame(fenceValue);
+        }
+        CHECK(allocator.getStats().peakRingDescriptors == kRing);
+        CHECK_THROWS(allocator.bindTable(views.data(), 1),
+                     std::runtime_error);
+
+        // Nothing comes back until the first frame's fence is reached
+        allocator.retire(0);
+        CHECK_THROWS(allocator.bindTable(views.data(), 1),
+                     std::runtime_error);
+        allocator.retire(1);
+        const D3D12_GPU_DESCRIPTOR_HANDLE reused =
+            allocator.bindTable(views.data(), (uint32_t)views.size());
+        CHECK(reused.ptr == tables[0].ptr);
+        CHECK_THROWS(allocator.bindTable(views.data(), 1),
+                     std::runtime_error);
+        allocator.finishFrame(4);
+
+        // A later fence frees every frame up to it
+        allocator.retire(3);
+        const D3D12_GPU_DESCRIPTOR_HANDLE wrapped =
+            allocator.bindTable(views.data(), (uint32_t)views.size());
+        CHECK(wrapped.ptr == tables[1].ptr);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+
+void testBindlessDeferredFree()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        DescriptorAllocator allocator(device, getDesc());
+        const auto views = allocateViews(allocator, kBindless);
+
+        const DescriptorRange range = allocator.allocateBindless(kBindless);
+        CHECK(range.index == 0);
+        CHECK(allocator.getStats().bindlessDescriptors == kBindless);
+        allocator.copyBindless(range, 0, views.data(), kBindless);
+        CHECK_THROWS(allocator.copyBindless(range, 1, views.data(), kBindless),
+                     std::runtime_error);
+        CHECK_THROWS(allocator.allocateBindless(1), std::runtime_error);
+
+        // Shaders of the frame being recorded may still index it
+        allocator.freeBindless(range);
+        CHECK(allocator.getStats().bindlessDescriptors == 0);
+        CHECK_THROWS(allocator.allocateBindless(1), std::runtime_error);
+        allocator.finishFrame(1);
+        CHECK_THROWS(allocator.allocateBindless(1), std::runtime_error);
+        allocator.retire(0);
+        CHECK_THROWS(allocator.allocateBindless(1), std::runtime_error);
+
+        allocator.retire(1);
+        const DescriptorRange again = allocator.allocateBindless(kBindless);
+        CHECK(again.index == 0);
+        CHECK(again.gpu.ptr == range.gpu.ptr);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+
+void testStagingReuseAfterFlush()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        DescriptorAllocatorDesc desc = getDesc();
+        desc.stagingHeapSize = 4;
+        DescriptorAllocator allocator(device, desc);
+        const D3D12_DESCRIPTOR_HEAP_TYPE type =
+            D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+
+        std::vector<StagingDescriptor> views;
+        for (int i = 0; i < 4; ++i)
+        {
+            views.push_back(allocator.allocateStaging(type));
+        }
+        CHECK(allocator.getStats().stagingHeaps == 1);
+
+        // A table still copying from a freed descriptor keeps it from being
+        // handed out until the copy is issued
+        allocator.bindTable(&views[2].cpu, 1);
+        allocator.freeStaging(type, views[2]);
+        const StagingDescriptor grown = allocator.allocateStaging(type);
+        CHECK(grown.index == 4);
+        CHECK(allocator.getStats().stagingHeaps == 2);
+        CHECK(allocator.getStats().stagingDescriptors == 5);
+
+        allocator.flush();
+        CHECK(allocator.getStats().stagingDescriptors == 4);
+        const StagingDescriptor reused = allocator.allocateStaging(type);
+        CHECK(reused.index == views[2].index);
+        CHECK(reused.cpu.ptr == views[2].cpu.ptr);
+
+        // Types have pools of their own
+        const StagingDescriptor rtv =
+            allocator.allocateStaging(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+        CHECK(rtv.index == 0);
+        CHECK(allocator.getStats().stagingHeaps == 3);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+
+void testMergedCopies()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        DescriptorAllocator allocator(device, getDesc());
+        const auto views = allocateViews(allocator, 8);
+        const DescriptorRange range = allocator.allocateBindless(8);
+
+        // Nothing staged is no call at all
+        const UINT64 calls = getCalls(NoopApiCall::CopyDescriptors);
+        allocator.flush();
+        CHECK(getCalls(NoopApiCall::CopyDescriptors) == calls);
+
+        // Tables from several threads, and bindless copies, adjacent and not
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&, t] {
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    allocator.bindTable(views.data() + t, 1 + i);
+                }
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        allocator.copyBindless(range, 0, views.data(), 4);
+        allocator.copyBindless(range, 6, views.data() + 2, 2);
+        const D3D12_CPU_DESCRIPTOR_HANDLE scattered[] = {views[7], views[0],
+                                                         views[5]};
+        allocator.copyBindless(range, 4, scattered, 2);
+
+        const UINT64 copied = noopStats().copiedDescriptors;
+        allocator.finishFrame(1);
+        CHECK(getCalls(NoopApiCall::CopyDescriptors) == calls + 1);
+        CHECK(noopStats().copiedDescriptors == copied + 4 * 10 + 8);
+        CHECK(allocator.getStats().copyCalls == 1);
+        CHECK(allocator.getStats().descriptorsCopied == 4 * 10 + 8);
+        CHECK(allocator.getStats().tables == 16);
+
+        // A frame with nothing new to copy makes no call
+        allocator.finishFrame(2);
+        CHECK(getCalls(NoopApiCall::CopyDescriptors) == calls + 1);
+        CHECK(allocator.getStats().frameDescriptorsCopied == 0);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+} // namespace
+
+void addDescriptorAllocatorTests(TestSuite& suite)
+{
+    suite.add("descriptors/table_reuse", testTableReuse);
+    suite.add("descriptors/ring_retirement", testRingRetirement);
+    suite.add("descriptors/bindless_deferred_free", testBindlessDeferredFree);
+    suite.add("descriptors/staging_reuse_after_flush",
+              testStagingReuseAfterFlush);
+    suite.add("descriptors/merged_copies", testMergedCopies);
+}
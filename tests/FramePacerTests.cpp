@@ -0,0 +1,155 @@
+#include "../src/FramePacer.h"
+#include "Test.h"
+
+#include <chrono>
+#include <vector>
+
+// Frame Pacer Tests
+// Pacing on a simulated clock, whose sleeps overshoot by a fixed amount
+// plus seeded jitter, so every run waits the same way. Frames simulate
+// their CPU work by advancing the clock.
+
+namespace
+{
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+const double kPeriodMs = 1000.0 / 60.0;
+
+double toMilliseconds(PacingDuration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Pace frames that each take the given CPU time, returns when each frame's
+// work began and ended
+void runFrames(FramePacer& pacer, SimulatedPacingClock& clock,
+               unsigned frameCount, PacingDuration work,
+               std::vector<PacingDuration>* starts = nullptr,
+               std::vector<PacingDuration>* ends = nullptr)
+{
+    for (unsigned i = 0; i < frameCount; ++i)
+    {
+        pacer.beginFrame();
+        if (starts)
+        {
+            starts->push_back(clock.now());
+        }
+        clock.advance(work);
+        pacer.endFrame();
+        if (ends)
+        {
+            ends->push_back(clock.now());
+        }
+    }
+}
+
+void testMeanInterval()
+{
+    SimulatedPacingClock clock(microseconds(1000), microseconds(500));
+    FramePacer pacer(FramePacerDesc(), &clock);
+    runFrames(pacer, clock, 600, milliseconds(4));
+
+    // Sleeps stop short of the deadline and spin out the rest, so the
+    // oversleep doesn't show up in the intervals
+    const FramePacerStats& stats = pacer.getStats();
+    CHECK(stats.frames == 600);
+    CHECK(stats.missedDeadlines == 0);
+    CHECK_NEAR(stats.intervalMean, kPeriodMs, 0.001);
+    CHECK(stats.maxJitter < 0.01);
+    CHECK(stats.sleepTime > stats.spinTime);
+}
+
+void testMissedDeadlineResyncs()
+{
+    SimulatedPacingClock clock(microseconds(200), microseconds(200));
+    FramePacer pacer(FramePacerDesc(), &clock);
+    runFrames(pacer, clock, 60, milliseconds(4));
+    CHECK(pacer.getStats().missedDeadlines == 0);
+
+    // One frame overruns by three periods, only it misses its deadline
+    runFrames(pacer, clock, 1, milliseconds(50));
+    CHECK(pacer.getStats().missedDeadlines == 1);
+
+    // Frames after it are paced from where it ended, rather than catching
+    // up with a burst of short frames
+    pacer.resetStats();
+    runFrames(pacer, clock, 60, milliseconds(4));
+    const FramePacerStats& stats = pacer.getStats();
+    CHECK(stats.missedDeadlines == 0);
+    CHECK_NEAR(stats.intervalMin, kPeriodMs, 0.01);
+    CHECK_NEAR(stats.intervalMax, kPeriodMs, 0.01);
+}
+
+void testSpinThresholdAdapts()
+{
+    // Sleeps overshooting by 5ms push the threshold out to twice that, so
+    // wake ups stop being late once it has adapted
+    SimulatedPacingClock lateClock(milliseconds(5));
+    FramePacer latePacer(FramePacerDesc(), &lateClock);
+    CHECK(latePacer.getSpinThreshold() == milliseconds(2));
+    runFrames(latePacer, lateClock, 120, milliseconds(4));
+    CHECK_NEAR(toMilliseconds(latePacer.getSpinThreshold()), 10.0, 0.5);
+    CHECK(latePacer.getStats().wakeErrorMax > 1.0);
+
+    latePacer.resetStats();
+    runFrames(latePacer, lateClock, 60, milliseconds(4));
+    CHECK(latePacer.getStats().wakeErrorMax < 0.01);
+    CHECK(latePacer.getStats().missedDeadlines == 0);
+
+    // Exact sleeps shrink it to the minimum, spinning as little as it can
+    SimulatedPacingClock exactClock;
+    FramePacer exactPacer(FramePacerDesc(), &exactClock);
+    runFrames(exactPacer, exactClock, 120, milliseconds(4));
+    CHECK(exactPacer.getSpinThreshold() == microseconds(50));
+    CHECK(exactPacer.getStats().spinTime <= 0.05 * 120);
+}
+
+void testAdaptiveLatency()
+{
+    const unsigned frameCount = 120;
+    const unsigned warmupFrames = (unsigned)FramePacer::kWarmupFrames;
+    SimulatedPacingClock clock(microseconds(200), microseconds(200));
+    FramePacerDesc desc;
+    desc.adaptiveLatency = true;
+    FramePacer pacer(desc, &clock);
+    std::vector<PacingDuration> starts;
+    std::vector<PacingDuration> ends;
+    runFrames(pacer, clock, frameCount, milliseconds(4), &starts, &ends);
+    CHECK(pacer.getStats().missedDeadlines == 0);
+
+    // Without misses, frame i is due one period after frame i - 1, and the
+    // first frame is due a period after it started
+    const PacingDuration period =
+        PacingDuration((int64_t)(kPeriodMs * 1e6));
+    auto getSlack = [&](unsigned frame) {
+        return toMilliseconds(starts[0] + period * (frame + 1) - ends[frame]);
+    };
+
+    // Until the prediction is trusted, frames start right after the last
+    // deadline and finish with most of the period to spare
+    for (unsigned i = 1; i < warmupFrames; ++i)
+    {
+        CHECK_NEAR(getSlack(i), kPeriodMs - 4.0, 0.01);
+    }
+
+    // Then they start as late as the predicted work allows, finishing just
+    // ahead of their deadline
+    CHECK(starts[warmupFrames] - starts[warmupFrames - 1] >
+          period + milliseconds(8));
+    for (unsigned i = 2 * warmupFrames; i < frameCount; ++i)
+    {
+        CHECK(getSlack(i) > 0.0);
+        CHECK(getSlack(i) < 2.0);
+    }
+    CHECK_NEAR(toMilliseconds(pacer.getPredictedWork()), 4.0, 0.5);
+}
+} // namespace
+
+void addFramePacerTests(TestSuite& suite)
+{
+    suite.add("frame_pacer/mean_interval", testMeanInterval);
+    suite.add("frame_pacer/missed_deadline_resyncs", testMissedDeadlineResyncs);
+    suite.add("frame_pacer/spin_threshold_adapts", testSpinThresholdAdapts);
+    suite.add("frame_pacer/adaptive_latency", testAdaptiveLatency);
+}
@@ -0,0 +1,254 @@
+#include "../src/GeometryUploader.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Geometry Uploader Tests
+// Uploads into default heap buffers on the NOOP device, which replays the
+// copies when a batch executes, so buffer contents are checked afterwards.
+// Queued copies are submitted as one batch per flush, split into chunks of
+// a quarter of the staging ring, stall when the ring fills with copies still
+// in flight, and land in the order they were queued.
+
+namespace
+{
+const UINT64 kKilobyte = 1024;
+
+UINT64 getCalls(NoopApiCall call)
+{
+    return noopStats().calls[(unsigned)call].load();
+}
+
+std::vector<uint8_t> getRandomBytes(TestRandom& random, size_t size)
+{
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t& byte : bytes)
+    {
+        byte = (uint8_t)random.next();
+    }
+    return bytes;
+}
+
+bool hasContents(ID3D12Resource* buffer, UINT64 offset,
+                 const std::vector<uint8_t>& bytes)
+{
+    return memcmp(buffer->getData() + offset, bytes.data(), bytes.size()) ==
+           0;
+}
+
+ID3D12Device* createDevice()
+{
+    ID3D12Device* device = nullptr;
+    CHECK(SUCCEEDED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0,
+                                      IID_PPV_ARGS(&device))));
+    return device;
+}
+
+void testBatchPerFlush()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        GpuAllocator allocator(device);
+        GeometryUploader uploader(device, &allocator, 256 * kKilobyte);
+        TestRandom random(5);
+
+        // Every copy queued before a flush goes out in one submission
+        std::vector<GpuAllocation*> buffers;
+        std::vector<std::vector<uint8_t>> contents;
+        const UINT64 executes = getCalls(NoopApiCall::ExecuteCommandLists);
+        for (int i = 0; i < 5; ++i)
+        {
+            contents.push_back(getRandomBytes(random, 1000 + i * 300));
+            buffers.push_back(uploader.createBuffer(contents.back().data(),
+                                                    contents.back().size()));
+        }
+        CHECK(getCalls(NoopApiCall::ExecuteCommandLists) == executes);
+        const UINT64 fenceValue = uploader.flush();
+        CHECK(getCalls(NoopApiCall::ExecuteCommandLists) == executes + 1);
+        CHECK(uploader.getStats().batches == 1);
+        CHECK(uploader.getStats().copies == 5);
+        CHECK(uploader.getStats().uploads == 5);
+
+        // Flushing with nothing queued submits nothing
+        CHECK(uploader.flush() == fenceValue);
+        CHECK(getCalls(NoopApiCall::ExecuteCommandLists) == executes + 1);
+        CHECK(uploader.getStats().batches == 1);
+
+        uploader.waitForBatch(fenceValue);
+        CHECK(uploader.isComplete(fenceValue));
+        CHECK(uploader.getStats().completedBatches == 1);
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            CHECK(hasContents(buffers[i]->resource, 0, contents[i]));
+
+            // Promoted to a copy destination and decayed back
+            CHECK(buffers[i]->resource->getState() ==
+                  D3D12_RESOURCE_STATE_COMMON);
+            allocator.release(buffers[i]);
+        }
+
+        // A second round is a second batch, on a recycled allocator
+        const UINT64 allocators = getCalls(NoopApiCall::CreateCommandAllocator);
+        contents[0] = getRandomBytes(random, 4000);
+        buffers[0] =
+            uploader.createBuffer(contents[0].data(), contents[0].size());
+        uploader.waitForBatch(uploader.flush());
+        CHECK(uploader.getStats().batches == 2);
+        CHECK(getCalls(NoopApiCall::CreateCommandAllocator) == allocators);
+        CHECK(hasContents(buffers[0]->resource, 0, contents[0]));
+        allocator.release(buffers[0]);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+
+void testChunking()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        // A quarter of the ring is the largest single copy
+        const UINT64 stagingSize = 64 * kKilobyte;
+        const UINT64 chunk = stagingSize / 4;
+        GpuAllocator allocator(device);
+        GeometryUploader uploader(device, &allocator, stagingSize);
+        TestRandom random(6);
+
+        const std::vector<uint8_t> exact = getRandomBytes(random, chunk);
+        GpuAllocation* single =
+            uploader.createBuffer(exact.data(), exact.size());
+        CHECK(uploader.getStats().copies == 1);
+
+        // Two and a half chunks, into the middle of a buffer
+        const std::vector<uint8_t> large =
+            getRandomBytes(random, chunk * 5 / 2);
+        const UINT64 offset = 100;
+        GpuAllocation* buffer = allocator.createBuffer(
+            D3D12_HEAP_TYPE_DEFAULT, offset + large.size(),
+            D3D12_RESOURCE_STATE_COMMON);
+        const UINT64 copies = getCalls(NoopApiCall::CopyBufferRegion);
+        uploader.upload(buffer->resource, offset, large.data(), large.size());
+        CHECK(getCalls(NoopApiCall::CopyBufferRegion) == copies + 3);
+
+        const GeometryUploadStats& stats = uploader.getStats();
+        CHECK(stats.uploads == 2);
+        CHECK(stats.copies == 4);
+        CHECK(stats.bytesUploaded == exact.size() + large.size());
+        CHECK(stats.stagingStalls == 0);
+
+        uploader.waitForBatch(uploader.flush());
+        CHECK(stats.batches == 1);
+        CHECK(hasContents(single->resource, 0, exact));
+        CHECK(hasContents(buffer->resource, offset, large));
+        allocator.release(single);
+        allocator.release(buffer);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+
+void testStagingStalls()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        const UINT64 stagingSize = 64 * kKilobyte;
+        const UINT64 chunk = stagingSize / 4;
+        GpuAllocator allocator(device);
+        GeometryUploader uploader(device, &allocator, stagingSize);
+        const GeometryUploadStats& stats = uploader.getStats();
+        TestRandom random(7);
+
+        // Four rings' worth in one upload. Each time the ring is full of
+        // copies nothing has submitted, they're flushed and waited on.
+        const std::vector<uint8_t> large =
+            getRandomBytes(random, 4 * stagingSize);
+        GpuAllocation* buffer =
+            uploader.createBuffer(large.data(), large.size());
+        CHECK(stats.copies == 16);
+        CHECK(stats.stagingStalls == 3);
+        CHECK(stats.batches == 3);
+        uploader.waitForBatch(uploader.flush());
+        CHECK(stats.batches == 4);
+        CHECK(stats.completedBatches == 4);
+        CHECK(hasContents(buffer->resource, 0, large));
+
+        // With a batch in flight, the upload that doesn't fit behind it
+        // waits for it rather than submitting its own copies early
+        uploader.resetStats();
+        const std::vector<uint8_t> first = getRandomBytes(random, 3 * chunk);
+        const std::vector<uint8_t> second = getRandomBytes(random, 2 * chunk);
+        GpuAllocation* firstBuffer =
+            uploader.createBuffer(first.data(), first.size());
+        const UINT64 fenceValue = uploader.flush();
+        GpuAllocation* secondBuffer =
+            uploader.createBuffer(second.data(), second.size());
+        CHECK(stats.stagingStalls == 1);
+        CHECK(stats.batches == 1);
+        CHECK(uploader.isComplete(fenceValue));
+        uploader.waitForBatch(uploader.flush());
+        CHECK(stats.batches == 2);
+        CHECK(hasContents(firstBuffer->resource, 0, first));
+        CHECK(hasContents(secondBuffer->resource, 0, second));
+
+        allocator.release(buffer);
+        allocator.release(firstBuffer);
+        allocator.release(secondBuffer);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+
+void testLaterUploadWins()
+{
+    ID3D12Device* device = createDevice();
+    const UINT64 validationErrors = noopStats().validationErrors;
+    {
+        const UINT64 stagingSize = 64 * kKilobyte;
+        GpuAllocator allocator(device);
+        GeometryUploader uploader(device, &allocator, stagingSize);
+        TestRandom random(8);
+
+        // Overlapping uploads in one batch, the second spanning chunks. Both
+        // fit in the ring, so nothing is flushed early.
+        const UINT64 size = stagingSize / 2;
+        GpuAllocation* buffer = allocator.createBuffer(
+            D3D12_HEAP_TYPE_DEFAULT, size, D3D12_RESOURCE_STATE_COMMON);
+        std::vector<uint8_t> expected = getRandomBytes(random, (size_t)size);
+        uploader.upload(buffer->resource, 0, expected.data(), expected.size());
+        const UINT64 offset = 1000;
+        const std::vector<uint8_t> overwrite =
+            getRandomBytes(random, stagingSize / 4 + 1000);
+        uploader.upload(buffer->resource, offset, overwrite.data(),
+                        overwrite.size());
+        std::copy(overwrite.begin(), overwrite.end(),
+                  expected.begin() + offset);
+
+        // And one more in the next batch, queued before the first executes
+        const UINT64 fenceValue = uploader.flush();
+        const std::vector<uint8_t> last = getRandomBytes(random, 5000);
+        uploader.upload(buffer->resource, offset + 2000, last.data(),
+                        last.size());
+        std::copy(last.begin(), last.end(),
+                  expected.begin() + offset + 2000);
+        CHECK(uploader.flush() == fenceValue + 1);
+
+        uploader.waitForBatch(fenceValue + 1);
+        CHECK(hasContents(buffer->resource, 0, expected));
+        allocator.release(buffer);
+    }
+    CHECK(noopStats().validationErrors == validationErrors);
+    device->Release();
+}
+} // namespace
+
+void addGeometryUploaderTests(TestSuite& suite)
+{
+    suite.add("geometry_uploader/batch_per_flush", testBatchPerFlush);
+    suite.add("geometry_uploader/chunking", testChunking);
+    suite.add("geometry_uploader/staging_stalls", testStagingStalls);
+    suite.add("geometry_uploader/later_upload_wins", testLaterUploadWins);
+}
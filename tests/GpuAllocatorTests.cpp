@@ -0,0 +1,175 @@
+#include "../src/GpuAllocator.h"
+#include "Test.h"
+
+#include <vector>
+
+// GPU Allocator Tests
+// Defragmentation against the NOOP device, which executes the recorded
+// copies and checks every buffer is in the state a barrier or copy expects.
+// Movable buffers are compacted with their contents, views and states kept,
+// buffers that didn't opt in stay put, and old placements are only freed
+// once the frame that copied from them is retired.
+
+namespace
+{
+const UINT64 kKilobyte = 1024;
+
+// Smaller than a placement, so a copy of the placement's size would read
+// past the resource
+const UINT64 kBufferSize = 48 * kKilobyte;
+const UINT64 kPlacement = 64 * kKilobyte;
+
+struct Buffer
+{
+    GpuAllocation* allocation;
+    uint8_t seed;
+
+    // Republished by the owner whenever the buffer moves
+    D3D12_VERTEX_BUFFER_VIEW view;
+    int moves;
+};
+
+void fill(Buffer& buffer)
+{
+    uint8_t* data = buffer.allocation->resource->getData();
+    for (UINT64 i = 0; i < kBufferSize; ++i)
+    {
+        data[i] = (uint8_t)(buffer.seed + i * 7);
+    }
+}
+
+bool hasContents(const Buffer& buffer)
+{
+    const uint8_t* data = buffer.allocation->resource->getData();
+    for (UINT64 i = 0; i < kBufferSize; ++i)
+    {
+        if (data[i] != (uint8_t)(buffer.seed + i * 7))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void testDefragment()
+{
+    ID3D12Device* device = nullptr;
+    CHECK(SUCCEEDED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0,
+                                      IID_PPV_ARGS(&device))));
+
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+    ID3D12CommandQueue* queue = nullptr;
+    ID3D12CommandAllocator* commandAllocator = nullptr;
+    ID3D12GraphicsCommandList* commandList = nullptr;
+    CHECK(SUCCEEDED(
+        device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&queue))));
+    CHECK(SUCCEEDED(device->CreateCommandAllocator(
+        D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&commandAllocator))));
+    CHECK(SUCCEEDED(device->CreateCommandList(
+        0, D3D12_COMMAND_LIST_TYPE_DIRECT, commandAllocator, nullptr,
+        IID_PPV_ARGS(&commandList))));
+    const UINT64 validationErrors = noopStats().validationErrors;
+
+    // Eight buffers in one heap, buffer 6 isn't movable
+    GpuAllocatorDesc desc;
+    desc.heapSize = 16 * kPlacement;
+    GpuAllocator allocator(device, desc);
+    std::vector<Buffer> buffers(8);
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        Buffer& buffer = buffers[i];
+        buffer.allocation = allocator.createBuffer(
+            D3D12_HEAP_TYPE_DEFAULT, kBufferSize,
+            D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+        buffer.seed = (uint8_t)(i * 31 + 1);
+        buffer.moves = 0;
+        buffer.view.BufferLocation =
+            buffer.allocation->resource->GetGPUVirtualAddress();
+        fill(buffer);
+
+        buffer.allocation->movable = i != 6;
+        buffer.allocation->state =
+            D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+        buffer.allocation->onMoved = [&buffer](GpuAllocation& allocation) {
+            buffer.view.BufferLocation =
+                allocation.resource->GetGPUVirtualAddress();
+            buffer.moves++;
+        };
+    }
+
+    // Free the first half, leaving the live buffers at the top of the heap
+    for (size_t i = 0; i < 4; ++i)
+    {
+        allocator.release(buffers[i].allocation);
+    }
+    allocator.finishFrame(1);
+    allocator.retire(1);
+    ID3D12Resource* pinned = buffers[6].allocation->resource;
+    ID3D12Resource* before[8] = {};
+    for (size_t i = 4; i < buffers.size(); ++i)
+    {
+        before[i] = buffers[i].allocation->resource;
+    }
+
+    // Nothing to move without a budget, then only as much as fits in one
+    CHECK(allocator.defragment(commandList, 0) == 0);
+    CHECK(allocator.defragment(commandList, kPlacement) == 1);
+    CHECK(buffers[7].moves == 1);
+    CHECK(allocator.defragment(commandList, 16 * kPlacement) == 2);
+    commandList->Close();
+    ID3D12CommandList* lists[] = {commandList};
+    queue->ExecuteCommandLists(1, lists);
+
+    // Highest first into the lowest free space, skipping the pinned buffer
+    CHECK(buffers[6].moves == 0);
+    CHECK(buffers[6].allocation->resource == pinned);
+    for (size_t i = 4; i < buffers.size(); ++i)
+    {
+        const Buffer& buffer = buffers[i];
+        ID3D12Resource* resource = buffer.allocation->resource;
+        CHECK(hasContents(buffer));
+        CHECK(resource->getState() ==
+              D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
+        CHECK(buffer.view.BufferLocation == resource->GetGPUVirtualAddress());
+        CHECK(i == 6 || (buffer.moves == 1 && resource != before[i]));
+    }
+    CHECK(buffers[7].view.BufferLocation < buffers[5].view.BufferLocation);
+    CHECK(buffers[5].view.BufferLocation < buffers[4].view.BufferLocation);
+    CHECK(buffers[4].view.BufferLocation < buffers[6].view.BufferLocation);
+    CHECK(noopStats().validationErrors == validationErrors);
+
+    // The command list read from the old placements, so they stay allocated
+    // until its frame is retired
+    GpuAllocatorStats stats = allocator.getStats();
+    CHECK(stats.defragMoves == 3);
+    CHECK(stats.defragBytes == 3 * kPlacement);
+    CHECK(stats.allocatedBytes == 7 * kPlacement);
+    allocator.finishFrame(2);
+    allocator.retire(1);
+    CHECK(allocator.getStats().allocatedBytes == 7 * kPlacement);
+    allocator.retire(2);
+    stats = allocator.getStats();
+    CHECK(stats.allocatedBytes == 4 * kPlacement);
+    CHECK(stats.allocationCount == 4);
+
+    // Moved buffers are released like any other
+    for (size_t i = 4; i < buffers.size(); ++i)
+    {
+        allocator.release(buffers[i].allocation);
+    }
+    allocator.finishFrame(3);
+    allocator.retire(3);
+    CHECK(allocator.getStats().allocatedBytes == 0);
+
+    commandList->Release();
+    commandAllocator->Release();
+    queue->Release();
+    device->Release();
+}
+} // namespace
+
+void addGpuAllocatorTests(TestSuite& suite)
+{
+    suite.add("gpu_allocator/defragment", testDefragment);
+}
@@ -0,0 +1,92 @@
+#include "../src/JobSystem.h"
+#include "Test.h"
+
+#include <atomic>
+
+// Job System Tests
+// Jobs submitting jobs of their own from worker threads while others steal
+// them, checking the count of queued jobs workers sleep on never wraps
+// around, and systems destroyed right after being given work finishing all
+// of it before their workers stop.
+
+namespace
+{
+class CountingJobSystem : public JobSystem
+{
+  public:
+    CountingJobSystem(unsigned workerCount) : JobSystem(workerCount) {}
+
+    uint32_t getQueuedJobs() const { return mQueuedJobs.load(); }
+};
+
+void recordMax(std::atomic<uint32_t>& max, uint32_t value)
+{
+    uint32_t seen = max.load();
+    while (value > seen && !max.compare_exchange_weak(seen, value))
+    {
+    }
+}
+
+void testNestedJobs()
+{
+    const uint32_t outerJobs = 16;
+    const uint32_t innerJobs = 16;
+    CountingJobSystem system(4);
+    std::atomic<uint32_t> finished{0};
+    std::atomic<uint32_t> maxQueued{0};
+
+    for (int round = 0; round < 200; ++round)
+    {
+        finished = 0;
+        JobGroup group;
+        for (uint32_t i = 0; i < outerJobs; ++i)
+        {
+            system.run(group, [&](unsigned) {
+                // Queued on the worker's own queue, where the other
+                // workers and the waiting thread steal them from
+                JobGroup inner;
+                for (uint32_t j = 0; j < innerJobs; ++j)
+                {
+                    system.run(inner, [&](unsigned) {
+                        recordMax(maxQueued, system.getQueuedJobs());
+                        finished.fetch_add(1);
+                    });
+                }
+                system.wait(inner);
+            });
+        }
+        system.wait(group);
+        CHECK(finished.load() == outerJobs * innerJobs);
+        CHECK(system.getQueuedJobs() == 0);
+    }
+
+    // A decrement before its increment would read as billions queued
+    CHECK(maxQueued.load() <= outerJobs * innerJobs + outerJobs);
+    CHECK(system.getStats().steals > 0);
+}
+
+void testStopFinishesQueuedJobs()
+{
+    for (int round = 0; round < 100; ++round)
+    {
+        std::atomic<uint32_t> finished{0};
+        JobGroup group;
+        {
+            JobSystem system(3);
+            for (int i = 0; i < 1000; ++i)
+            {
+                system.run(group, [&](unsigned) { finished.fetch_add(1); });
+            }
+        }
+        CHECK(finished.load() == 1000);
+        CHECK(group.pending.load() == 0);
+    }
+}
+} // namespace
+
+void addJobSystemTests(TestSuite& suite)
+{
+    suite.add("job_system/nested_jobs", testNestedJobs);
+    suite.add("job_system/stop_finishes_queued_jobs",
+              testStopFinishesQueuedJobs);
+}
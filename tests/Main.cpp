@@ -0,0 +1,81 @@
+#include "Test.h"
+
+#include <iostream>
+#include <string>
+
+// Tests
+// Checks the renderer's systems on the CPU, against the NOOP backend:
+//
+//   DirectX12SeedTests [--filter=name] [--list=1]
+//
+// --filter runs only the tests whose name contains it, which is how ctest
+// runs each group. Exits with 1 if any test failed, or none matched.
+
+namespace
+{
+// Returns the value of a `--name=value` command line argument
+std::string getArgument(int argc, const char** argv, const std::string& name,
+                        const std::string& defaultValue)
+{
+    const std::string prefix = "--" + name + "=";
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.compare(0, prefix.size(), prefix) == 0)
+        {
+            return arg.substr(prefix.size());
+        }
+    }
+    return defaultValue;
+}
+} // namespace
+
+int main(int argc, const char** argv)
+{
+    TestSuite suite;
+    addFramePacerTests(suite);
+    addRingAllocatorTests(suite);
+    addProfilerTests(suite);
+    addRenderGraphTests(suite);
+    addRenderThreadTests(suite);
+    addTlsfAllocatorTests(suite);
+    addTransformSystemTests(suite);
+    addJobSystemTests(suite);
+    addGpuAllocatorTests(suite);
+    addGeometryUploaderTests(suite);
+    addShaderCacheTests(suite);
+    addPipelineCacheTests(suite);
+    addDescriptorAllocatorTests(suite);
+    addMeshCookerTests(suite);
+    addMeshOptimizerTests(suite);
+
+    if (getArgument(argc, argv, "list", "0") != "0")
+    {
+        for (const std::string& name : suite.getNames())
+        {
+            std::cout << name << "\n";
+        }
+        return 0;
+    }
+
+    const std::string filter = getArgument(argc, argv, "filter", "");
+    size_t matched = 0;
+    for (const std::string& name : suite.getNames())
+    {
+        matched += filter.empty() || name.find(filter) != std::string::npos;
+    }
+    if (matched == 0)
+    {
+        std::cout << "no tests match " << filter << "\n";
+        return 1;
+    }
+
+    const std::vector<std::string> failures = suite.run(filter);
+    std::cout << matched - failures.size() << " of " << matched
+              << " tests passed\n";
+    for (const std::string& name : failures)
+    {
+        std::cout << "  failed: " << name << "\n";
+    }
+    return failures.empty() ? 0 : 1;
+}
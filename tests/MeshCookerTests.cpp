@@ -0,0 +1,268 @@
+#include "../src/MeshCooker.h"
+#include "../src/MeshFile.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Mesh Cooker Tests
+// Compact vertices against the error bounds the format promises, for meshes
+// far from the origin, flat along an axis, and with colors out of range.
+// Normals survive the octahedral round trip from every direction, including
+// the axes and the seams the lower half is folded along, and cooked files
+// get 16 bit indices exactly when every vertex can be addressed with them.
+
+namespace
+{
+const float kPi = 3.14159265f;
+
+void normalizeVector(float v[3])
+{
+    const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+        v[axis] /= length;
+    }
+}
+
+float getAngle(const float a[3], const float b[3])
+{
+    const double cross[3] = {(double)a[1] * b[2] - (double)a[2] * b[1],
+                             (double)a[2] * b[0] - (double)a[0] * b[2],
+                             (double)a[0] * b[1] - (double)a[1] * b[0]};
+    const double sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] +
+                                  cross[2] * cross[2]);
+    const double cosine =
+        (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+    return (float)(std::atan2(sine, cosine) * 180.0 / 3.14159265358979);
+}
+
+// A latitude longitude sphere, every vertex's normal points out of it
+CookedMesh getSphere(const float center[3], float radius, uint32_t rings,
+                     uint32_t segments)
+{
+    CookedMesh mesh;
+    for (uint32_t ring = 0; ring <= rings; ++ring)
+    {
+        const float theta = kPi * (float)ring / (float)rings;
+        for (uint32_t segment = 0; segment <= segments; ++segment)
+        {
+            const float phi = 2.0f * kPi * (float)segment / (float)segments;
+            MeshVertex vertex;
+            vertex.normal[0] = std::sin(theta) * std::cos(phi);
+            vertex.normal[1] = std::cos(theta);
+            vertex.normal[2] = std::sin(theta) * std::sin(phi);
+            normalizeVector(vertex.normal);
+            for (unsigned axis = 0; axis < 3; ++axis)
+            {
+                vertex.position[axis] =
+                    center[axis] + radius * vertex.normal[axis];
+                vertex.color[axis] = 0.5f + 0.5f * vertex.normal[axis];
+            }
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    for (uint32_t ring = 0; ring < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            const uint32_t a = ring * (segments + 1) + segment;
+            const uint32_t b = a + segments + 1;
+            mesh.indices.insert(mesh.indices.end(),
+                                {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+
+    MeshSubmesh submesh = {};
+    submesh.indexCount = (uint32_t)mesh.indices.size();
+    mesh.submeshes.push_back(submesh);
+    computeSubmeshBounds(mesh);
+    return mesh;
+}
+
+void testQuantizationBounds()
+{
+    std::vector<CookedMesh> meshes;
+    const float origin[3] = {0.0f, 0.0f, 0.0f};
+    const float distant[3] = {-12000.0f, 350.0f, 48000.0f};
+    meshes.push_back(getSphere(origin, 1.0f, 32, 64));
+    meshes.push_back(getSphere(distant, 250.0f, 64, 128));
+
+    // Flat along y, so its scale on that axis is zero
+    CookedMesh flat = getSphere(origin, 10.0f, 16, 16);
+    for (MeshVertex& vertex : flat.vertices)
+    {
+        vertex.position[1] = 3.0f;
+    }
+    meshes.push_back(flat);
+
+    // Random normals and colors, some outside [0, 1] which are clamped
+    TestRandom random(16);
+    CookedMesh scattered = getSphere(origin, 1.0f, 8, 8);
+    for (MeshVertex& vertex : scattered.vertices)
+    {
+        for (unsigned axis = 0; axis < 3; ++axis)
+        {
+            vertex.position[axis] = random.range(-5.0f, 5.0f);
+            vertex.normal[axis] = random.range(-1.0f, 1.0f);
+            vertex.color[axis] = random.range(-0.25f, 1.25f);
+        }
+        normalizeVector(vertex.normal);
+    }
+    meshes.push_back(scattered);
+
+    for (const CookedMesh& mesh : meshes)
+    {
+        const MeshCompressionReport report = measureCompression(mesh);
+        CHECK(report.isWithinBounds());
+        CHECK(report.vertexCount == mesh.vertices.size());
+
+        // Within bounds because of rounding, not because they're loose.
+        // Far from the origin the bound also allows for float precision.
+        float offset[3];
+        float scale[3];
+        getPositionQuantization(mesh, offset, scale);
+        const float step =
+            std::max(std::max(scale[0], scale[1]), scale[2]) / 65535.0f;
+        CHECK(report.positionError > 0.0f);
+        CHECK(report.positionErrorBound < 2.0f * step);
+        CHECK(report.colorError > 0.0f);
+        CHECK(report.colorErrorBound < 1.0f / 255.0f);
+    }
+
+    // The flat axis decodes to exactly where it was
+    float offset[3];
+    float scale[3];
+    getPositionQuantization(flat, offset, scale);
+    CHECK(scale[1] == 0.0f);
+    for (const MeshVertex& vertex : flat.vertices)
+    {
+        const MeshVertex decoded = decompressVertex(
+            compressVertex(vertex, offset, scale), offset, scale);
+        CHECK(decoded.position[1] == 3.0f);
+    }
+}
+
+void testOctahedralNormals()
+{
+    // Axes, diagonals, and directions on or next to the z = 0 seam, where
+    // the lower half of the octahedron is folded
+    std::vector<std::vector<float>> normals = {
+        {1, 0, 0},  {-1, 0, 0},      {0, 1, 0},         {0, -1, 0},
+        {0, 0, 1},  {0, 0, -1},      {1, 1, 1},         {-1, -1, -1},
+        {1, -1, 0}, {-1, 1, 1e-6f},  {1, 1, -1e-6f},    {0.3f, -0.7f, 0},
+        {1, 0, -1}, {0, -1, -1e-7f}, {-1e-7f, 1e-7f, -1}};
+    TestRandom random(17);
+    for (int i = 0; i < 100000; ++i)
+    {
+        normals.push_back({random.range(-1.0f, 1.0f),
+                           random.range(-1.0f, 1.0f),
+                           random.range(-1.0f, 1.0f)});
+    }
+
+    const float offset[3] = {0.0f, 0.0f, 0.0f};
+    const float scale[3] = {1.0f, 1.0f, 1.0f};
+    float maxError = 0.0f;
+    for (std::vector<float>& normal : normals)
+    {
+        MeshVertex vertex = {};
+        std::copy(normal.begin(), normal.end(), vertex.normal);
+        if (vertex.normal[0] == 0.0f && vertex.normal[1] == 0.0f &&
+            vertex.normal[2] == 0.0f)
+        {
+            continue;
+        }
+        normalizeVector(vertex.normal);
+
+        const MeshVertex decoded = decompressVertex(
+            compressVertex(vertex, offset, scale), offset, scale);
+        const float* n = decoded.normal;
+        CHECK_NEAR(n[0] * n[0] + n[1] * n[1] + n[2] * n[2], 1.0f, 1e-5f);
+        maxError = std::max(maxError, getAngle(vertex.normal, n));
+    }
+
+    // 16 bits per component rounds to within 0.004 degrees
+    CHECK(maxError < 0.005f);
+    CHECK(maxError < measureCompression(CookedMesh()).normalErrorBound);
+}
+
+// A strip of triangles over every vertex, the last one uses the highest
+void checkIndexSize(uint32_t vertexCount, uint32_t expectedSize)
+{
+    CookedMesh mesh;
+    mesh.vertices.resize(vertexCount);
+    for (uint32_t i = 0; i < vertexCount; ++i)
+    {
+        MeshVertex& vertex = mesh.vertices[i];
+        vertex.position[0] = (float)(i % 256);
+        vertex.position[1] = (float)(i / 256);
+        vertex.position[2] = 0.0f;
+        vertex.normal[0] = vertex.normal[1] = 0.0f;
+        vertex.normal[2] = 1.0f;
+        vertex.color[0] = vertex.color[1] = vertex.color[2] = 1.0f;
+    }
+    for (uint32_t i = 0; i + 2 < vertexCount; i += 3)
+    {
+        mesh.indices.insert(mesh.indices.end(), {i, i + 1, i + 2});
+    }
+    mesh.indices.insert(mesh.indices.end(),
+                        {0, vertexCount / 2, vertexCount - 1});
+    MeshSubmesh submesh = {};
+    submesh.indexCount = (uint32_t)mesh.indices.size();
+    mesh.submeshes.push_back(submesh);
+    computeSubmeshBounds(mesh);
+
+    const MeshCompressionReport report = measureCompression(mesh);
+    CHECK(report.compactBytes ==
+          vertexCount * sizeof(MeshCompactVertex) +
+              mesh.indices.size() * expectedSize);
+
+    const char* directory = std::getenv("TMPDIR");
+    if (directory == nullptr)
+    {
+        directory = std::getenv("TEMP");
+    }
+    const std::string path = std::string(directory != nullptr ? directory
+                                                              : ".") +
+                             "/xgfx_mesh_cooker_indices.mesh";
+    std::string errors;
+    CHECK(writeMeshFile(path, mesh, MeshVertexFormat::Compact, errors));
+    {
+        MeshFile file;
+        CHECK(file.open(path));
+        CHECK(file.getHeader().indexSize == expectedSize);
+        CHECK(file.getIndexDataSize() == mesh.indices.size() * expectedSize);
+
+        // Read back exactly, the highest vertex included
+        const void* data = file.getIndexData();
+        for (size_t i = 0; i < mesh.indices.size(); ++i)
+        {
+            const uint32_t index =
+                expectedSize == 2
+                    ? static_cast<const uint16_t*>(data)[i]
+                    : static_cast<const uint32_t*>(data)[i];
+            CHECK(index == mesh.indices[i]);
+        }
+    }
+    std::remove(path.c_str());
+}
+
+void testIndexSize()
+{
+    checkIndexSize(3, 2);
+    checkIndexSize(0x10000, 2);
+    checkIndexSize(0x10001, 4);
+    checkIndexSize(0x30000, 4);
+}
+} // namespace
+
+void addMeshCookerTests(TestSuite& suite)
+{
+    suite.add("mesh_cooker/quantization_bounds", testQuantizationBounds);
+    suite.add("mesh_cooker/octahedral_normals", testOctahedralNormals);
+    suite.add("mesh_cooker/index_size", testIndexSize);
+}
@@ -0,0 +1,341 @@
+#include "../src/MeshOptimizer.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// Mesh Optimizer Tests
+// A grid with its triangles shuffled, and a sphere, as the orders the cooker
+// meets at worst and at best. Cache ordering brings the shuffled grid's ACMR
+// and ATVR down, cluster ordering is only kept within its ACMR threshold,
+// fetch ordering never fetches more, and every stage draws exactly the
+// triangles it was given, each with its corners in their original order.
+
+namespace
+{
+const float kPi = 3.14159265f;
+
+// A triangle by what its corners are, so vertex reordering doesn't change it
+typedef std::array<float, 9> Triangle;
+
+void addSubmesh(CookedMesh& mesh, size_t firstIndex)
+{
+    MeshSubmesh submesh = {};
+    submesh.firstIndex = (uint32_t)firstIndex;
+    submesh.indexCount = (uint32_t)(mesh.indices.size() - firstIndex);
+    mesh.submeshes.push_back(submesh);
+}
+
+// Quads of a flat grid in the xy plane, split in two triangles each
+void addGrid(CookedMesh& mesh, uint32_t size, float z)
+{
+    const size_t firstIndex = mesh.indices.size();
+    const uint32_t base = (uint32_t)mesh.vertices.size();
+    for (uint32_t y = 0; y <= size; ++y)
+    {
+        for (uint32_t x = 0; x <= size; ++x)
+        {
+            MeshVertex vertex = {};
+            vertex.position[0] = (float)x;
+            vertex.position[1] = (float)y;
+            vertex.position[2] = z;
+            vertex.normal[2] = 1.0f;
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        for (uint32_t x = 0; x < size; ++x)
+        {
+            const uint32_t a = base + y * (size + 1) + x;
+            const uint32_t b = a + size + 1;
+            mesh.indices.insert(mesh.indices.end(),
+                                {a, a + 1, b, a + 1, b + 1, b});
+        }
+    }
+    addSubmesh(mesh, firstIndex);
+}
+
+// A latitude longitude sphere, so clusters face every way
+void addSphere(CookedMesh& mesh, uint32_t rings, uint32_t segments)
+{
+    const size_t firstIndex = mesh.indices.size();
+    const uint32_t base = (uint32_t)mesh.vertices.size();
+    for (uint32_t ring = 0; ring <= rings; ++ring)
+    {
+        const float theta = kPi * (float)ring / (float)rings;
+        for (uint32_t segment = 0; segment <= segments; ++segment)
+        {
+            const float phi = 2.0f * kPi * (float)segment / (float)segments;
+            MeshVertex vertex = {};
+            vertex.normal[0] = std::sin(theta) * std::cos(phi);
+            vertex.normal[1] = std::cos(theta);
+            vertex.normal[2] = std::sin(theta) * std::sin(phi);
+            std::copy(vertex.normal, vertex.normal + 3, vertex.position);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    for (uint32_t ring = 0; ring < rings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < segments; ++segment)
+        {
+            const uint32_t a = base + ring * (segments + 1) + segment;
+            const uint32_t b = a + segments + 1;
+            mesh.indices.insert(mesh.indices.end(),
+                                {a, b, a + 1, a + 1, b, b + 1});
+        }
+    }
+    addSubmesh(mesh, firstIndex);
+}
+
+// Shuffle the triangles of every submesh, keeping each one's winding
+void shuffleTriangles(CookedMesh& mesh, TestRandom& random)
+{
+    for (const MeshSubmesh& submesh : mesh.submeshes)
+    {
+        uint32_t* indices = &mesh.indices[submesh.firstIndex];
+        for (uint32_t i = submesh.indexCount / 3; i > 1; --i)
+        {
+            const uint32_t j = random.below(i);
+            std::swap_ranges(indices + (i - 1) * 3, indices + i * 3,
+                             indices + j * 3);
+        }
+    }
+}
+
+// Shuffle the vertices, keeping the triangles they make
+void shuffleVertices(CookedMesh& mesh, TestRandom& random)
+{
+    std::vector<uint32_t> remap(mesh.vertices.size());
+    for (uint32_t i = 0; i < remap.size(); ++i)
+    {
+        remap[i] = i;
+    }
+    for (uint32_t i = (uint32_t)remap.size(); i > 1; --i)
+    {
+        std::swap(remap[i - 1], remap[random.below(i)]);
+    }
+
+    std::vector<MeshVertex> vertices(mesh.vertices.size());
+    for (size_t i = 0; i < remap.size(); ++i)
+    {
+        vertices[remap[i]] = mesh.vertices[i];
+    }
+    mesh.vertices.swap(vertices);
+    for (uint32_t& index : mesh.indices)
+    {
+        index = remap[index];
+    }
+}
+
+// The submesh's triangles sorted, the corners of each stay in order
+std::vector<Triangle> getTriangles(const CookedMesh& mesh,
+                                   const MeshSubmesh& submesh)
+{
+    std::vector<Triangle> triangles(submesh.indexCount / 3);
+    for (size_t i = 0; i < submesh.indexCount; ++i)
+    {
+        const MeshVertex& vertex =
+            mesh.vertices[mesh.indices[submesh.firstIndex + i]];
+        std::copy(vertex.position, vertex.position + 3,
+                  triangles[i / 3].begin() + (i % 3) * 3);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+std::vector<std::vector<Triangle>> getTriangles(const CookedMesh& mesh)
+{
+    std::vector<std::vector<Triangle>> triangles;
+    for (const MeshSubmesh& submesh : mesh.submeshes)
+    {
+        triangles.push_back(getTriangles(mesh, submesh));
+    }
+    return triangles;
+}
+
+VertexCacheStats getCacheStats(const CookedMesh& mesh)
+{
+    return analyzeVertexCache(mesh.indices.data(), mesh.indices.size(),
+                              mesh.vertices.size(), kSimulatedCacheSize);
+}
+
+VertexFetchStats getFetchStats(const CookedMesh& mesh)
+{
+    return analyzeVertexFetch(mesh.indices.data(), mesh.indices.size(),
+                              mesh.vertices.size(), sizeof(MeshVertex));
+}
+
+void testCacheOrder()
+{
+    CookedMesh mesh;
+    addGrid(mesh, 64, 0.0f);
+    const VertexCacheStats ordered = getCacheStats(mesh);
+    TestRandom random(17);
+    shuffleTriangles(mesh, random);
+    const std::vector<std::vector<Triangle>> triangles = getTriangles(mesh);
+
+    // Shuffled, nearly every corner misses
+    const VertexCacheStats before = getCacheStats(mesh);
+    CHECK(before.acmr > 2.5);
+    CHECK(before.atvr > 5.0);
+
+    optimizeVertexCache(mesh.indices.data(), mesh.indices.size());
+    const VertexCacheStats after = getCacheStats(mesh);
+    CHECK(after.triangles == before.triangles);
+    CHECK(after.vertices == before.vertices);
+
+    // Better than the grid's own row order, and within reach of the best
+    CHECK(after.acmr < ordered.acmr);
+    CHECK(after.acmr < 0.75);
+    CHECK(after.atvr < ordered.atvr);
+    CHECK(after.atvr < 1.5);
+    CHECK(getTriangles(mesh) == triangles);
+
+    // A single triangle is left as it is
+    uint32_t single[] = {2, 0, 1};
+    optimizeVertexCache(single, 3);
+    CHECK(single[0] == 2 && single[1] == 0 && single[2] == 1);
+}
+
+void testOverdrawThreshold()
+{
+    CookedMesh sphere;
+    addSphere(sphere, 32, 64);
+    optimizeVertexCache(sphere.indices.data(), sphere.indices.size());
+    const std::vector<std::vector<Triangle>> triangles = getTriangles(sphere);
+    const VertexCacheStats before = getCacheStats(sphere);
+
+    // Kept orders stay within the threshold, refused ones leave the indices
+    // alone. Sorting costs the sphere about 5% of its ACMR, so the tightest
+    // thresholds refuse it.
+    unsigned kept = 0;
+    for (float threshold : {0.5f, 1.0f, 1.01f, 1.05f, 1.25f, 2.0f})
+    {
+        CookedMesh mesh = sphere;
+        const bool ordered = optimizeOverdraw(
+            mesh.indices.data(), mesh.indices.size(), mesh.vertices.data(),
+            threshold);
+        const VertexCacheStats after = getCacheStats(mesh);
+        if (ordered)
+        {
+            kept++;
+            CHECK(after.acmr <= before.acmr * threshold);
+        }
+        else
+        {
+            CHECK(mesh.indices == sphere.indices);
+        }
+        CHECK(getTriangles(mesh) == triangles);
+    }
+    CHECK(kept == 3);
+
+    // The default threshold is 1.05, and the order it keeps does cost some
+    CookedMesh mesh = sphere;
+    CHECK(optimizeOverdraw(mesh.indices.data(), mesh.indices.size(),
+                           mesh.vertices.data()));
+    const double acmr = getCacheStats(mesh).acmr;
+    CHECK(acmr > before.acmr);
+    CHECK(acmr <= before.acmr * 1.05);
+
+    // Shuffled triangles have little efficiency to lose, their clusters are
+    // sorted too
+    CookedMesh shuffled = sphere;
+    TestRandom random(18);
+    shuffleTriangles(shuffled, random);
+    const VertexCacheStats shuffledBefore = getCacheStats(shuffled);
+    CHECK(optimizeOverdraw(shuffled.indices.data(), shuffled.indices.size(),
+                           shuffled.vertices.data()));
+    CHECK(getCacheStats(shuffled).acmr <= shuffledBefore.acmr * 1.05);
+    CHECK(getTriangles(shuffled) == triangles);
+}
+
+void testFetchOrder()
+{
+    // Two submeshes, with vertices no triangle uses in between
+    CookedMesh mesh;
+    addGrid(mesh, 32, 0.0f);
+    addSphere(mesh, 16, 32);
+    addGrid(mesh, 8, 1.0f);
+    mesh.submeshes.pop_back();
+    mesh.indices.resize(mesh.submeshes.back().firstIndex +
+                        mesh.submeshes.back().indexCount);
+    const size_t usedVertices = mesh.vertices.size() - 9 * 9;
+
+    TestRandom random(19);
+    shuffleVertices(mesh, random);
+    for (const MeshSubmesh& submesh : mesh.submeshes)
+    {
+        optimizeVertexCache(&mesh.indices[submesh.firstIndex],
+                            submesh.indexCount);
+    }
+    const std::vector<std::vector<Triangle>> triangles = getTriangles(mesh);
+    const VertexCacheStats cacheBefore = getCacheStats(mesh);
+    const VertexFetchStats before = getFetchStats(mesh);
+
+    optimizeVertexFetch(mesh);
+    const VertexFetchStats after = getFetchStats(mesh);
+    CHECK(mesh.vertices.size() == usedVertices);
+    CHECK(after.bytesFetched <= before.bytesFetched);
+    CHECK(after.overfetch <= before.overfetch);
+    CHECK(after.overfetch < 1.5);
+    CHECK(getTriangles(mesh) == triangles);
+
+    // Only vertices are renamed, so the cache behaves the same
+    const VertexCacheStats cacheAfter = getCacheStats(mesh);
+    CHECK(cacheAfter.misses == cacheBefore.misses);
+
+    // Vertices are in order of first use
+    uint32_t next = 0;
+    for (uint32_t index : mesh.indices)
+    {
+        CHECK(index <= next);
+        next = std::max(next, index + 1);
+    }
+
+    // Already in order, nothing changes
+    const std::vector<uint32_t> indices = mesh.indices;
+    optimizeVertexFetch(mesh);
+    CHECK(mesh.indices == indices);
+    CHECK(getFetchStats(mesh).bytesFetched == after.bytesFetched);
+}
+
+void testOptimizeMesh()
+{
+    CookedMesh mesh;
+    addGrid(mesh, 48, 0.0f);
+    addSphere(mesh, 24, 48);
+    TestRandom random(20);
+    shuffleTriangles(mesh, random);
+    shuffleVertices(mesh, random);
+    const std::vector<MeshSubmesh> submeshes = mesh.submeshes;
+    const std::vector<std::vector<Triangle>> triangles = getTriangles(mesh);
+
+    const MeshOptimizeReport report = optimizeMesh(mesh);
+    CHECK(report.submeshes == 2);
+    CHECK(report.cacheAfter.acmr < report.cacheBefore.acmr * 0.5);
+    CHECK(report.cacheAfter.atvr < report.cacheBefore.atvr * 0.5);
+    CHECK(report.fetchAfter.overfetch <= report.fetchBefore.overfetch);
+    CHECK(report.cacheAfter.acmr == getCacheStats(mesh).acmr);
+    CHECK(report.fetchAfter.bytesFetched == getFetchStats(mesh).bytesFetched);
+
+    // Submeshes keep their ranges and their triangles
+    CHECK(mesh.submeshes.size() == submeshes.size());
+    for (size_t i = 0; i < submeshes.size(); ++i)
+    {
+        CHECK(mesh.submeshes[i].firstIndex == submeshes[i].firstIndex);
+        CHECK(mesh.submeshes[i].indexCount == submeshes[i].indexCount);
+    }
+    CHECK(getTriangles(mesh) == triangles);
+}
+} // namespace
+
+void addMeshOptimizerTests(TestSuite& suite)
+{
+    suite.add("mesh_optimizer/cache_order", testCacheOrder);
+    suite.add("mesh_optimizer/overdraw_threshold", testOverdrawThreshold);
+    suite.add("mesh_optimizer/fetch_order", testFetchOrder);
+    suite.add("mesh_optimizer/optimize_mesh", testOptimizeMesh);
+}
@@ -0,0 +1,340 @@
+#include "../src/PipelineCache.h"
+#include "Test.h"
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pipeline Cache Tests
+// Pipelines created on the NOOP device, counting how many the driver was
+// asked to compile. Identical descriptions in different memory are one
+// pipeline, changing any field is another, concurrent requests for one
+// pipeline all wait on the same compile, and a second cache opening the
+// saved pipeline library loads every pipeline instead of compiling it.
+
+namespace
+{
+UINT64 getCalls(NoopApiCall call)
+{
+    return noopStats().calls[(unsigned)call].load();
+}
+
+std::string getTempPath(const std::string& name)
+{
+    const char* directory = std::getenv("TMPDIR");
+    if (directory == nullptr)
+    {
+        directory = std::getenv("TEMP");
+    }
+    return std::string(directory != nullptr ? directory : ".") +
+           "/xgfx_pipeline_cache_" + name;
+}
+
+// A device, a root signature the cache knows about, and the shaders and
+// input layout descriptions point at. Every description is built from fresh
+// copies, so only their contents can match.
+struct PipelineSetup
+{
+    PipelineSetup()
+        : device(nullptr), rootSignature(nullptr), blob(nullptr),
+          vertexShader{'v', 's', 0, 1}, pixelShader{'p', 's', 0, 1}
+    {
+        CHECK(SUCCEEDED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0,
+                                          IID_PPV_ARGS(&device))));
+        D3D12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc = {};
+        rootSignatureDesc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+        CHECK(SUCCEEDED(D3D12SerializeVersionedRootSignature(
+            &rootSignatureDesc, &blob, nullptr)));
+        CHECK(SUCCEEDED(device->CreateRootSignature(
+            0, blob->GetBufferPointer(), blob->GetBufferSize(),
+            IID_PPV_ARGS(&rootSignature))));
+    }
+
+    ~PipelineSetup()
+    {
+        rootSignature->Release();
+        blob->Release();
+        device->Release();
+    }
+
+    void addRootSignature(PipelineCache& cache)
+    {
+        cache.addRootSignature(rootSignature, blob->GetBufferPointer(),
+                               blob->GetBufferSize());
+    }
+
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC getDesc()
+    {
+        shaders.push_back(vertexShader);
+        const std::vector<uint8_t>& vs = shaders.back();
+        shaders.push_back(pixelShader);
+        const std::vector<uint8_t>& ps = shaders.back();
+        semanticNames.push_back("POSITION");
+        elements.push_back(std::vector<D3D12_INPUT_ELEMENT_DESC>(
+            1, {semanticNames.back().c_str(), 0,
+                DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
+                D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}));
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
+        desc.pRootSignature = rootSignature;
+        desc.VS = {vs.data(), vs.size()};
+        desc.PS = {ps.data(), ps.size()};
+        desc.InputLayout = {elements.back().data(), 1};
+        desc.RasterizerState.FillMode = D3D12_FILL_MODE_SOLID;
+        desc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
+        desc.RasterizerState.DepthClipEnable = TRUE;
+        desc.BlendState.RenderTarget[0].RenderTargetWriteMask =
+            D3D12_COLOR_WRITE_ENABLE_ALL;
+        desc.DepthStencilState.DepthEnable = TRUE;
+        desc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
+        desc.SampleMask = UINT_MAX;
+        desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        desc.NumRenderTargets = 1;
+        desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+        desc.SampleDesc.Count = 1;
+        return desc;
+    }
+
+    ID3D12Device* device;
+    ID3D12RootSignature* rootSignature;
+    ID3DBlob* blob;
+    std::vector<uint8_t> vertexShader;
+    std::vector<uint8_t> pixelShader;
+
+    // Deques, so what earlier descriptions point at never moves
+    std::deque<std::vector<uint8_t>> shaders;
+    std::deque<std::string> semanticNames;
+    std::deque<std::vector<D3D12_INPUT_ELEMENT_DESC>> elements;
+};
+
+void testDeduplication()
+{
+    PipelineSetup setup;
+    const std::string libraryPath = getTempPath("dedup.bin");
+    std::remove(libraryPath.c_str());
+    {
+        PipelineCache cache(setup.device, libraryPath);
+        setup.addRootSignature(cache);
+        const UINT64 compiles =
+            getCalls(NoopApiCall::CreateGraphicsPipelineState);
+
+        GraphicsPipeline* first = cache.request(setup.getDesc());
+        GraphicsPipeline* second = cache.request(setup.getDesc());
+        CHECK(second == first);
+        ID3D12PipelineState* state = cache.wait(first);
+        CHECK(state != nullptr);
+        CHECK(cache.wait(second) == state);
+        CHECK(first->status.load() == PipelineStatus::Ready);
+
+        // Still the same pipeline once it's ready
+        CHECK(cache.request(setup.getDesc()) == first);
+        const PipelineCacheStats stats = cache.getStats();
+        CHECK(stats.requests == 3);
+        CHECK(stats.dedupHits == 2);
+        CHECK(stats.compiles == 1);
+        CHECK(getCalls(NoopApiCall::CreateGraphicsPipelineState) ==
+              compiles + 1);
+
+        // Root signatures the cache wasn't told about can't be keyed
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC unknown = setup.getDesc();
+        unknown.pRootSignature = nullptr;
+        CHECK_THROWS(cache.request(unknown), std::runtime_error);
+    }
+    std::remove(libraryPath.c_str());
+}
+
+void testFieldChanges()
+{
+    PipelineSetup setup;
+    const std::string libraryPath = getTempPath("fields.bin");
+    std::remove(libraryPath.c_str());
+    {
+        PipelineCache cache(setup.device, libraryPath);
+        setup.addRootSignature(cache);
+        const uint64_t key = cache.computeKey(setup.getDesc());
+
+        // One field of each part of the description
+        std::vector<D3D12_GRAPHICS_PIPELINE_STATE_DESC> changed;
+        for (int i = 0; i < 9; ++i)
+        {
+            changed.push_back(setup.getDesc());
+        }
+        changed[0].RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+        changed[1].RTVFormats[0] = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        changed[2].DepthStencilState.DepthFunc =
+            D3D12_COMPARISON_FUNC_LESS_EQUAL;
+        changed[3].BlendState.RenderTarget[0].BlendEnable = TRUE;
+        changed[4].SampleDesc.Count = 4;
+        changed[5].DSVFormat = DXGI_FORMAT_UNKNOWN;
+        changed[6].PrimitiveTopologyType =
+            D3D12_PRIMITIVE_TOPOLOGY_TYPE_LINE;
+
+        // The last two own copies of the input layout and shaders, which
+        // are edited in place
+        setup.elements[setup.elements.size() - 2][0].Format =
+            DXGI_FORMAT_R32G32B32A32_FLOAT;
+        setup.shaders.back()[0] = 'q';
+
+        std::vector<uint64_t> keys = {key};
+        for (const auto& desc : changed)
+        {
+            const uint64_t changedKey = cache.computeKey(desc);
+            for (const uint64_t other : keys)
+            {
+                CHECK(changedKey != other);
+            }
+            keys.push_back(changedKey);
+            cache.wait(cache.request(desc));
+        }
+        CHECK(cache.getStats().compiles == changed.size());
+        CHECK(cache.getStats().dedupHits == 0);
+
+        // Formats past the render target count aren't used, so don't count
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC unused = setup.getDesc();
+        unused.RTVFormats[3] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        CHECK(cache.computeKey(unused) == key);
+    }
+    std::remove(libraryPath.c_str());
+}
+
+void testConcurrentRequests()
+{
+    PipelineSetup setup;
+    const std::string libraryPath = getTempPath("concurrent.bin");
+    std::remove(libraryPath.c_str());
+
+    // Long enough for every thread to arrive while it's compiling
+    const auto compileTime = noopConfig().pipelineCompileTime;
+    noopConfig().pipelineCompileTime = std::chrono::milliseconds(50);
+    {
+        PipelineCache cache(setup.device, libraryPath, 4);
+        setup.addRootSignature(cache);
+        const UINT64 compiles =
+            getCalls(NoopApiCall::CreateGraphicsPipelineState);
+
+        std::vector<D3D12_GRAPHICS_PIPELINE_STATE_DESC> descs;
+        for (int i = 0; i < 8; ++i)
+        {
+            descs.push_back(setup.getDesc());
+        }
+        std::vector<ID3D12PipelineState*> states(descs.size(), nullptr);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < descs.size(); ++i)
+        {
+            threads.emplace_back([&, i] {
+                states[i] = cache.wait(cache.request(descs[i]));
+            });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (ID3D12PipelineState* state : states)
+        {
+            CHECK(state != nullptr && state == states[0]);
+        }
+        const PipelineCacheStats stats = cache.getStats();
+        CHECK(stats.requests == descs.size());
+        CHECK(stats.dedupHits == descs.size() - 1);
+        CHECK(stats.compiles == 1);
+        CHECK(stats.waitTime > 0.0);
+        CHECK(getCalls(NoopApiCall::CreateGraphicsPipelineState) ==
+              compiles + 1);
+    }
+    noopConfig().pipelineCompileTime = compileTime;
+    std::remove(libraryPath.c_str());
+}
+
+void testWarmStart()
+{
+    PipelineSetup setup;
+    const std::string libraryPath = getTempPath("warm.bin");
+    std::remove(libraryPath.c_str());
+
+    std::vector<D3D12_GRAPHICS_PIPELINE_STATE_DESC> descs;
+    for (int i = 0; i < 3; ++i)
+    {
+        descs.push_back(setup.getDesc());
+        descs.back().RasterizerState.CullMode = (D3D12_CULL_MODE)(i + 1);
+    }
+
+    // Saved by the destructor
+    {
+        PipelineCache cache(setup.device, libraryPath);
+        setup.addRootSignature(cache);
+        for (const auto& desc : descs)
+        {
+            cache.wait(cache.request(desc));
+        }
+        CHECK(cache.getStats().compiles == descs.size());
+    }
+
+    const UINT64 compiles = getCalls(NoopApiCall::CreateGraphicsPipelineState);
+    {
+        PipelineCache cache(setup.device, libraryPath);
+        setup.addRootSignature(cache);
+        for (const auto& desc : descs)
+        {
+            CHECK(cache.wait(cache.request(desc)) != nullptr);
+        }
+        PipelineCacheStats stats = cache.getStats();
+        CHECK(stats.libraryHits == descs.size());
+        CHECK(stats.compiles == 0);
+        CHECK(stats.hitRate() == 1.0);
+        CHECK(getCalls(NoopApiCall::CreateGraphicsPipelineState) == compiles);
+
+        // New pipelines still compile, and are added to the library
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC added = setup.getDesc();
+        added.SampleDesc.Count = 4;
+        cache.wait(cache.request(added));
+        CHECK(cache.getStats().compiles == 1);
+        descs.push_back(added);
+    }
+
+    {
+        PipelineCache cache(setup.device, libraryPath);
+        setup.addRootSignature(cache);
+        for (const auto& desc : descs)
+        {
+            cache.wait(cache.request(desc));
+        }
+        CHECK(cache.getStats().libraryHits == descs.size());
+        CHECK(cache.getStats().compiles == 0);
+    }
+
+    // A library the driver rejects is started over
+    {
+        std::ofstream file(libraryPath, std::ios::binary | std::ios::trunc);
+        file << "not a pipeline library";
+    }
+    {
+        PipelineCache cache(setup.device, libraryPath);
+        setup.addRootSignature(cache);
+        cache.wait(cache.request(descs[0]));
+        CHECK(cache.getStats().libraryHits == 0);
+        CHECK(cache.getStats().compiles == 1);
+    }
+    {
+        PipelineCache cache(setup.device, libraryPath);
+        setup.addRootSignature(cache);
+        cache.wait(cache.request(descs[0]));
+        CHECK(cache.getStats().libraryHits == 1);
+    }
+    std::remove(libraryPath.c_str());
+}
+} // namespace
+
+void addPipelineCacheTests(TestSuite& suite)
+{
+    suite.add("pipeline_cache/deduplication", testDeduplication);
+    suite.add("pipeline_cache/field_changes", testFieldChanges);
+    suite.add("pipeline_cache/concurrent_requests", testConcurrentRequests);
+    suite.add("pipeline_cache/warm_start", testWarmStart);
+}
@@ -0,0 +1,427 @@
+#include "../src/Profiler.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Profiler Tests
+// Scopes timed on two threads exported as a Chrome trace, which has to parse
+// as JSON with a named track per thread and every scope at its nesting
+// depth, and frame time percentiles over a known set of samples.
+
+namespace
+{
+// Just enough of a JSON parser to check the trace, it throws on anything
+// that isn't valid JSON
+struct JsonValue
+{
+    enum Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Null;
+    double number = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::map<std::string, JsonValue> members;
+
+    const JsonValue& operator[](const std::string& key) const
+    {
+        auto member = members.find(key);
+        if (type != Object || member == members.end())
+        {
+            throw TestFailure("JSON has no member " + key);
+        }
+        return member->second;
+    }
+};
+
+class JsonParser
+{
+  public:
+    JsonParser(const std::string& text) : mText(text), mPosition(0) {}
+
+    JsonValue parseDocument()
+    {
+        JsonValue value = parseValue();
+        skipSpace();
+        if (mPosition != mText.size())
+        {
+            fail("trailing characters");
+        }
+        return value;
+    }
+
+  protected:
+    void fail(const std::string& message)
+    {
+        throw TestFailure("invalid JSON at " + std::to_string(mPosition) +
+                          ": " + message);
+    }
+
+    void skipSpace()
+    {
+        while (mPosition < mText.size() && std::isspace(mText[mPosition]))
+        {
+            ++mPosition;
+        }
+    }
+
+    void expect(char c)
+    {
+        skipSpace();
+        if (mPosition >= mText.size() || mText[mPosition] != c)
+        {
+            fail(std::string("expected ") + c);
+        }
+        ++mPosition;
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+        if (mPosition < mText.size() && mText[mPosition] == c)
+        {
+            ++mPosition;
+            return true;
+        }
+        return false;
+    }
+
+    bool consumeWord(const char* word)
+    {
+        const std::string text = word;
+        if (mText.compare(mPosition, text.size(), text) == 0)
+        {
+            mPosition += text.size();
+            return true;
+        }
+        return false;
+    }
+
+    std::string parseString()
+    {
+        expect('"');
+        std::string text;
+        while (true)
+        {
+            if (mPosition >= mText.size())
+            {
+                fail("unterminated string");
+            }
+            const char c = mText[mPosition++];
+            if (c == '"')
+            {
+                return text;
+            }
+            if ((unsigned char)c < 0x20)
+            {
+                fail("unescaped control character");
+            }
+            if (c != '\\')
+            {
+                text += c;
+                continue;
+            }
+            if (mPosition >= mText.size())
+            {
+                fail("unterminated escape");
+            }
+            const char escape = mText[mPosition++];
+            switch (escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                text += escape;
+                break;
+            case 'n':
+                text += '\n';
+                break;
+            case 't':
+                text += '\t';
+                break;
+            case 'r':
+                text += '\r';
+                break;
+            case 'b':
+                text += '\b';
+                break;
+            case 'f':
+                text += '\f';
+                break;
+            case 'u':
+            {
+                // Only the control characters the profiler escapes
+                if (mPosition + 4 > mText.size())
+                {
+                    fail("short unicode escape");
+                }
+                const unsigned code = (unsigned)std::stoul(
+                    mText.substr(mPosition, 4), nullptr, 16);
+                if (code >= 0x80)
+                {
+                    fail("unexpected unicode escape");
+                }
+                text += (char)code;
+                mPosition += 4;
+                break;
+            }
+            default:
+                fail("unknown escape");
+            }
+        }
+    }
+
+    JsonValue parseValue()
+    {
+        skipSpace();
+        if (mPosition >= mText.size())
+        {
+            fail("expected a value");
+        }
+
+        JsonValue value;
+        const char c = mText[mPosition];
+        if (c == '{')
+        {
+            value.type = JsonValue::Object;
+            ++mPosition;
+            if (consume('}'))
+            {
+                return value;
+            }
+            do
+            {
+                skipSpace();
+                const std::string key = parseString();
+                expect(':');
+                value.members[key] = parseValue();
+            } while (consume(','));
+            expect('}');
+        }
+        else if (c == '[')
+        {
+            value.type = JsonValue::Array;
+            ++mPosition;
+            if (consume(']'))
+            {
+                return value;
+            }
+            do
+            {
+                value.items.push_back(parseValue());
+            } while (consume(','));
+            expect(']');
+        }
+        else if (c == '"')
+        {
+            value.type = JsonValue::String;
+            value.text = parseString();
+        }
+        else if (consumeWord("true") || consumeWord("false"))
+        {
+            value.type = JsonValue::Bool;
+        }
+        else if (consumeWord("null"))
+        {
+            value.type = JsonValue::Null;
+        }
+        else
+        {
+            value.type = JsonValue::Number;
+            const size_t start = mPosition;
+            while (mPosition < mText.size() &&
+                   (std::isdigit(mText[mPosition]) ||
+                    std::string("+-.eE").find(mText[mPosition]) !=
+                        std::string::npos))
+            {
+                ++mPosition;
+            }
+            if (start == mPosition)
+            {
+                fail("unexpected character");
+            }
+            value.number = std::stod(mText.substr(start, mPosition - start));
+        }
+        return value;
+    }
+
+    const std::string& mText;
+    size_t mPosition;
+};
+
+// Names with characters the trace has to escape
+const char* const kThreadNames[] = {"Worker \"A\"", "Worker \\B\\"};
+const char* const kOuterScope = "Outer \"frame\"";
+const char* const kInnerScope = "Inner\tpass";
+
+void recordScopes(const char* threadName)
+{
+    profiler().setThreadName(threadName);
+    for (int i = 0; i < 3; ++i)
+    {
+        PROFILE_SCOPE(kOuterScope);
+        {
+            PROFILE_SCOPE(kInnerScope);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+}
+
+void testChromeTrace()
+{
+    // Drop whatever other tests left queued on the global profiler
+    Profiler& trace = profiler();
+    trace.collect();
+    trace.reset();
+    trace.setEnabled(true);
+    std::thread first(recordScopes, kThreadNames[0]);
+    std::thread second(recordScopes, kThreadNames[1]);
+    first.join();
+    second.join();
+    trace.setEnabled(false);
+    trace.collect();
+
+    std::ostringstream out;
+    trace.writeChromeTrace(out);
+    const std::string text = out.str();
+    CHECK(text.find("\"Outer \\\"frame\\\"\"") != std::string::npos);
+    CHECK(text.find("\"Inner\\u0009pass\"") != std::string::npos);
+    const JsonValue document = JsonParser(text).parseDocument();
+    const JsonValue& events = document["traceEvents"];
+    CHECK(events.type == JsonValue::Array);
+
+    // One track per thread, named as it was with its quotes unescaped
+    std::vector<double> tids;
+    for (const char* name : kThreadNames)
+    {
+        size_t tracks = 0;
+        for (const JsonValue& event : events.items)
+        {
+            if (event["ph"].text == "M" && event["args"]["name"].text == name)
+            {
+                CHECK(event["name"].text == "thread_name");
+                tids.push_back(event["tid"].number);
+                ++tracks;
+            }
+        }
+        CHECK(tracks == 1);
+    }
+    CHECK(tids[0] != tids[1]);
+
+    // Every scope is a complete event on its thread's track, inner scopes
+    // one level deeper and within their outer scope, give or take the
+    // rounding of times to nanoseconds
+    for (const double tid : tids)
+    {
+        std::vector<const JsonValue*> outer;
+        std::vector<const JsonValue*> inner;
+        for (const JsonValue& event : events.items)
+        {
+            if (event["ph"].text != "X" || event["tid"].number != tid)
+            {
+                continue;
+            }
+            CHECK(event["dur"].number >= 0.0);
+            if (event["name"].text == kOuterScope)
+            {
+                CHECK(event["args"]["depth"].number == 0.0);
+                outer.push_back(&event);
+            }
+            else
+            {
+                CHECK(event["name"].text == kInnerScope);
+                CHECK(event["args"]["depth"].number == 1.0);
+                inner.push_back(&event);
+            }
+        }
+        CHECK(outer.size() == 3);
+        CHECK(inner.size() == 3);
+        for (const JsonValue* scope : inner)
+        {
+            const double start = (*scope)["ts"].number;
+            const double end = start + (*scope)["dur"].number;
+            CHECK(std::any_of(outer.begin(), outer.end(),
+                              [&](const JsonValue* parent) {
+                                  const double parentStart =
+                                      (*parent)["ts"].number;
+                                  return parentStart <= start &&
+                                         end <= parentStart +
+                                                    (*parent)["dur"].number +
+                                                    0.002;
+                              }));
+        }
+    }
+
+    CHECK(trace.getFrameStats().events == 12);
+    CHECK(trace.getFrameStats().droppedEvents == 0);
+    trace.reset();
+}
+
+void testFramePercentiles()
+{
+    // 1 to 100 milliseconds, shuffled, so nearest rank picks those exactly
+    Profiler frames;
+    TestRandom random(23);
+    std::vector<double> samples;
+    for (int i = 1; i <= 100; ++i)
+    {
+        samples.push_back((double)i);
+    }
+    for (size_t i = samples.size(); i > 1; --i)
+    {
+        std::swap(samples[i - 1], samples[random.below((uint32_t)i)]);
+    }
+    for (const double sample : samples)
+    {
+        frames.addFrame(sample, sample / 10.0);
+        frames.addGpuFrame(101.0 - sample);
+    }
+
+    FrameTimeStats stats = frames.getFrameStats();
+    CHECK(stats.frames == 100);
+    CHECK(stats.gpuFrames == 100);
+    CHECK(stats.cpuFrame.p50 == 50.0);
+    CHECK(stats.cpuFrame.p95 == 95.0);
+    CHECK(stats.cpuFrame.p99 == 99.0);
+    CHECK(stats.cpuFrame.max == 100.0);
+    CHECK(stats.gpuFrame.p50 == 50.0);
+    CHECK(stats.gpuFrame.p99 == 99.0);
+    CHECK_NEAR(stats.presentWait.p95, 9.5, 1e-9);
+
+    // Only the last window of frames counts, the slow ones before it don't
+    frames.reset();
+    for (size_t i = 0; i < 1000 - Profiler::kFrameWindow; ++i)
+    {
+        frames.addFrame(1000.0, 0.0);
+    }
+    for (size_t i = 1; i <= Profiler::kFrameWindow; ++i)
+    {
+        frames.addFrame((double)i, 0.0);
+    }
+    stats = frames.getFrameStats();
+    CHECK(stats.frames == 1000);
+    CHECK(stats.cpuFrame.p50 == 256.0);
+    CHECK(stats.cpuFrame.p99 == 507.0);
+    CHECK(stats.cpuFrame.max == 512.0);
+}
+} // namespace
+
+void addProfilerTests(TestSuite& suite)
+{
+    suite.add("profiler/chrome_trace", testChromeTrace);
+    suite.add("profiler/frame_percentiles", testFramePercentiles);
+}
@@ -0,0 +1,293 @@
+#include "../src/RenderGraph.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <vector>
+
+// Render Graph Tests
+// Small graphs compiled without a device, checking the passes culled, the
+// barriers derived before each pass and after the last one, and where
+// transients are placed in their heap.
+
+namespace
+{
+const UINT64 kTargetSize = 8 * 1024 * 1024;
+
+const RecordBatchFunction kRecordNothing = [](ID3D12GraphicsCommandList*,
+                                              uint32_t) {};
+
+D3D12_RESOURCE_DESC getTargetDesc()
+{
+    D3D12_RESOURCE_DESC desc = {};
+    desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    desc.Width = 1920;
+    desc.Height = 1080;
+    desc.DepthOrArraySize = 1;
+    desc.MipLevels = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
+    return desc;
+}
+
+// Without a device, transients are given their size
+RenderGraphResource createTarget(RenderGraph& graph, const char* name)
+{
+    return graph.createTransient(name, getTargetDesc(), nullptr, kTargetSize,
+                                 D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+}
+
+RenderGraphPass addPass(RenderGraph& graph, const char* name)
+{
+    return graph.addPass(name, 1, nullptr, kRecordNothing);
+}
+
+bool isTransition(const RenderGraphBarrier& barrier,
+                  RenderGraphResource resource, D3D12_RESOURCE_STATES before,
+                  D3D12_RESOURCE_STATES after)
+{
+    return barrier.type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION &&
+           barrier.resource == resource && barrier.stateBefore == before &&
+           barrier.stateAfter == after;
+}
+
+size_t countAliasingBarriers(const RenderGraph& graph,
+                             const std::vector<RenderGraphPass>& passes)
+{
+    size_t count = 0;
+    for (const RenderGraphPass pass : passes)
+    {
+        for (const RenderGraphBarrier& barrier : graph.getBarriers(pass))
+        {
+            count += barrier.type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+        }
+    }
+    return count;
+}
+
+void testUnreadPassIsCulled()
+{
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource(
+        "Back Buffer", nullptr, D3D12_RESOURCE_STATE_PRESENT);
+
+    // Writes a target nothing reads
+    const RenderGraphPass unread = addPass(graph, "Unread");
+    graph.write(unread, createTarget(graph, "Unread Target"),
+                D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    // Also unread, but kept for its side effects
+    const RenderGraphPass kept = addPass(graph, "Side Effects");
+    graph.write(kept, createTarget(graph, "Kept Target"),
+                D3D12_RESOURCE_STATE_RENDER_TARGET);
+    graph.setSideEffects(kept);
+
+    // Imported resources outlive the frame, so writing one is enough
+    const RenderGraphPass draw = addPass(graph, "Draw");
+    graph.write(draw, backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    graph.compile();
+
+    CHECK(graph.isCulled(unread));
+    CHECK(!graph.isCulled(kept));
+    CHECK(!graph.isCulled(draw));
+    CHECK(graph.getBarriers(unread).empty());
+    CHECK(graph.getStats().culledPasses == 1);
+
+    // Only live transients take memory
+    CHECK(graph.getStats().transientResources == 1);
+    CHECK(graph.getStats().heapBytes == kTargetSize);
+
+    CHECK(graph.getBarriers(draw).size() == 1);
+    CHECK(isTransition(graph.getBarriers(draw)[0], backBuffer,
+                       D3D12_RESOURCE_STATE_PRESENT,
+                       D3D12_RESOURCE_STATE_RENDER_TARGET));
+}
+
+void testReadStatesAreMerged()
+{
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource(
+        "Back Buffer", nullptr, D3D12_RESOURCE_STATE_PRESENT);
+    const RenderGraphResource target = createTarget(graph, "Target");
+
+    const RenderGraphPass write = addPass(graph, "Write");
+    graph.write(write, target, D3D12_RESOURCE_STATE_RENDER_TARGET);
+
+    // Three passes read the target in different states, one of them in two
+    const RenderGraphPass pixelRead = addPass(graph, "Pixel Read");
+    graph.read(pixelRead, target, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    graph.setSideEffects(pixelRead);
+    const RenderGraphPass bothRead = addPass(graph, "Both Read");
+    graph.read(bothRead, target, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    graph.read(bothRead, target,
+               D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    graph.setSideEffects(bothRead);
+    const RenderGraphPass copy = addPass(graph, "Copy");
+    graph.read(copy, target, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    graph.write(copy, backBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
+    graph.compile();
+
+    // The first read transitions straight into every state the run of reads
+    // needs, and the rest need nothing
+    const D3D12_RESOURCE_STATES merged = (D3D12_RESOURCE_STATES)(
+        D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE |
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE |
+        D3D12_RESOURCE_STATE_COPY_SOURCE);
+    CHECK(graph.getBarriers(write).empty());
+    CHECK(graph.getBarriers(pixelRead).size() == 1);
+    CHECK(isTransition(graph.getBarriers(pixelRead)[0], target,
+                       D3D12_RESOURCE_STATE_RENDER_TARGET, merged));
+    CHECK(graph.getBarriers(bothRead).empty());
+    CHECK(graph.getBarriers(copy).size() == 1);
+    CHECK(isTransition(graph.getBarriers(copy)[0], backBuffer,
+                       D3D12_RESOURCE_STATE_PRESENT,
+                       D3D12_RESOURCE_STATE_COPY_DEST));
+
+    // After the last pass the transient goes back to the state it's created
+    // in and the back buffer to the state it was imported in
+    const std::vector<RenderGraphBarrier>& finalBarriers =
+        graph.getFinalBarriers();
+    CHECK(finalBarriers.size() == 2);
+    CHECK(isTransition(finalBarriers[0], target, merged,
+                       D3D12_RESOURCE_STATE_RENDER_TARGET));
+    CHECK(isTransition(finalBarriers[1], backBuffer,
+                       D3D12_RESOURCE_STATE_COPY_DEST,
+                       D3D12_RESOURCE_STATE_PRESENT));
+
+    const RenderGraphStats& stats = graph.getStats();
+    CHECK(stats.barriers == 4);
+    CHECK(stats.barrierBatches == 3);
+}
+
+// A chain of passes each reading the target of the one before it, so the
+// first and last targets are never alive at the same time
+std::vector<RenderGraphPass> addChain(RenderGraph& graph,
+                                      std::vector<RenderGraphResource>& targets)
+{
+    const RenderGraphResource backBuffer = graph.importResource(
+        "Back Buffer", nullptr, D3D12_RESOURCE_STATE_PRESENT);
+    targets.clear();
+    targets.push_back(createTarget(graph, "First"));
+    targets.push_back(createTarget(graph, "Second"));
+    targets.push_back(createTarget(graph, "Third"));
+
+    std::vector<RenderGraphPass> passes;
+    passes.push_back(addPass(graph, "First"));
+    graph.write(passes[0], targets[0], D3D12_RESOURCE_STATE_RENDER_TARGET);
+    for (size_t i = 1; i < targets.size(); ++i)
+    {
+        passes.push_back(addPass(graph, "Next"));
+        graph.read(passes[i], targets[i - 1],
+                   D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        graph.write(passes[i], targets[i], D3D12_RESOURCE_STATE_RENDER_TARGET);
+    }
+    passes.push_back(addPass(graph, "Present"));
+    graph.read(passes.back(), targets.back(),
+               D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    graph.write(passes.back(), backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    return passes;
+}
+
+bool hasAliasingBarrier(const std::vector<RenderGraphBarrier>& barriers,
+                        RenderGraphResource resource)
+{
+    return std::any_of(barriers.begin(), barriers.end(),
+                       [&](const RenderGraphBarrier& barrier) {
+                           return barrier.type ==
+                                      D3D12_RESOURCE_BARRIER_TYPE_ALIASING &&
+                                  barrier.resource == resource;
+                       });
+}
+
+void testDisjointTransientsAlias()
+{
+    RenderGraph graph;
+    std::vector<RenderGraphResource> targets;
+    const std::vector<RenderGraphPass> passes = addChain(graph, targets);
+    const RenderGraphResource first = targets[0];
+    const RenderGraphResource second = targets[1];
+    const RenderGraphResource third = targets[2];
+    graph.compile();
+
+    CHECK(graph.getOffset(third) == graph.getOffset(first));
+    CHECK(graph.getOffset(second) != graph.getOffset(first));
+    const RenderGraphStats& stats = graph.getStats();
+    CHECK(stats.transientBytes == 3 * kTargetSize);
+    CHECK(stats.heapBytes == 2 * kTargetSize);
+    CHECK(stats.heapBytes < stats.transientBytes);
+
+    // The first target is returned to its creation state before the third
+    // takes its memory over, which the third's first pass begins with
+    const std::vector<RenderGraphBarrier>& barriers =
+        graph.getBarriers(passes[2]);
+    CHECK(countAliasingBarriers(graph, passes) == 2);
+    CHECK(hasAliasingBarrier(barriers, third));
+    CHECK(std::any_of(barriers.begin(), barriers.end(),
+                      [&](const RenderGraphBarrier& barrier) {
+                          return isTransition(
+                              barrier, first,
+                              D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE,
+                              D3D12_RESOURCE_STATE_RENDER_TARGET);
+                      }));
+}
+
+void testAliasingAcrossFrames()
+{
+    // The heap carries over into the next frame, so the first target takes
+    // its memory over from the last one of the frame before, every frame
+    RenderGraph graph;
+    std::vector<RenderGraphResource> targets;
+    for (int frame = 0; frame < 2; ++frame)
+    {
+        graph.reset();
+        const std::vector<RenderGraphPass> passes = addChain(graph, targets);
+        graph.compile();
+
+        CHECK(graph.getOffset(targets[0]) == graph.getOffset(targets[2]));
+        CHECK(hasAliasingBarrier(graph.getBarriers(passes[0]), targets[0]));
+        CHECK(hasAliasingBarrier(graph.getBarriers(passes[2]), targets[2]));
+
+        // The second target has its memory to itself
+        CHECK(countAliasingBarriers(graph, passes) == 2);
+    }
+}
+
+void testOverlappingTransientsDontAlias()
+{
+    // Both targets are written by one pass and read by the next
+    RenderGraph graph;
+    const RenderGraphResource backBuffer = graph.importResource(
+        "Back Buffer", nullptr, D3D12_RESOURCE_STATE_PRESENT);
+    const RenderGraphResource color = createTarget(graph, "Color");
+    const RenderGraphResource normals = createTarget(graph, "Normals");
+
+    std::vector<RenderGraphPass> passes;
+    passes.push_back(addPass(graph, "Geometry"));
+    graph.write(passes[0], color, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    graph.write(passes[0], normals, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    passes.push_back(addPass(graph, "Lighting"));
+    graph.read(passes[1], color, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    graph.read(passes[1], normals, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    graph.write(passes[1], backBuffer, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    graph.compile();
+
+    const UINT64 colorOffset = graph.getOffset(color);
+    const UINT64 normalsOffset = graph.getOffset(normals);
+    CHECK(colorOffset + kTargetSize <= normalsOffset ||
+          normalsOffset + kTargetSize <= colorOffset);
+    const RenderGraphStats& stats = graph.getStats();
+    CHECK(stats.heapBytes == stats.transientBytes);
+    CHECK(countAliasingBarriers(graph, passes) == 0);
+}
+} // namespace
+
+void addRenderGraphTests(TestSuite& suite)
+{
+    suite.add("render_graph/unread_pass_is_culled", testUnreadPassIsCulled);
+    suite.add("render_graph/read_states_are_merged", testReadStatesAreMerged);
+    suite.add("render_graph/disjoint_transients_alias",
+              testDisjointTransientsAlias);
+    suite.add("render_graph/aliasing_across_frames", testAliasingAcrossFrames);
+    suite.add("render_graph/overlapping_transients_dont_alias",
+              testOverlappingTransientsDontAlias);
+}
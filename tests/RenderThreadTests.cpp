@@ -0,0 +1,143 @@
+#include "../src/RenderThread.h"
+#include "../src/Renderer.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Render Thread Tests
+// The app's renderer, offscreen against the NOOP backend, fed a fixed number
+// of draws a frame through the render thread. Once every pooled packet has
+// seen a full frame, filling packets mustn't allocate, and packets must
+// reach the render thread within a bounded time of being submitted.
+// The renderer loads its assets from the working directory.
+
+namespace
+{
+const size_t kDrawCount = 2000;
+const unsigned kPacketCount = 3;
+
+// Fill a packet with the same grid of draws every frame
+void fillPacket(FramePacket& packet)
+{
+    packet.projectionMatrix = glm::perspective(45.0f, 16.0f / 9.0f, 0.01f,
+                                               1024.0f);
+    packet.viewMatrix = glm::translate(glm::identity<glm::mat4>(),
+                                       glm::vec3(0.0f, 0.0f, 2.5f));
+    packet.draws.resize(kDrawCount);
+    for (size_t i = 0; i < kDrawCount; ++i)
+    {
+        packet.draws[i].modelMatrix = glm::translate(
+            glm::identity<glm::mat4>(),
+            glm::vec3((float)(i % 50) * 3.0f, 0.0f, (float)(i / 50) * 3.0f));
+    }
+}
+
+void waitForFrames(const RenderThread& renderThread, uint64_t frames)
+{
+    while (renderThread.getRenderedFrames() < frames)
+    {
+        std::this_thread::yield();
+    }
+}
+
+double getMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void testPacketReuse()
+{
+    const uint64_t warmupFrames = 2 * kPacketCount;
+    const uint64_t frameCount = 120;
+    Renderer renderer(640, 360);
+    RenderThread renderThread(renderer, kPacketCount);
+
+    // Packets come back in the order they were submitted, so the warm-up
+    // fills every one of them at least once
+    std::vector<const DrawItem*> drawLists;
+    for (uint64_t frame = 0; frame < warmupFrames; ++frame)
+    {
+        FramePacket* packet = renderThread.beginPacket();
+        fillPacket(*packet);
+        if (std::find(drawLists.begin(), drawLists.end(),
+                      packet->draws.data()) == drawLists.end())
+        {
+            drawLists.push_back(packet->draws.data());
+        }
+        renderThread.submitPacket(packet);
+    }
+    waitForFrames(renderThread, warmupFrames);
+    CHECK(drawLists.size() == kPacketCount);
+    CHECK(renderThread.getStats().packetGrowths == kPacketCount);
+
+    // The main thread runs ahead as far as the pool lets it
+    renderThread.resetStats();
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t frame = 0; frame < frameCount; ++frame)
+    {
+        FramePacket* packet = renderThread.beginPacket();
+        fillPacket(*packet);
+        CHECK(std::find(drawLists.begin(), drawLists.end(),
+                        packet->draws.data()) != drawLists.end());
+        renderThread.submitPacket(packet);
+    }
+    waitForFrames(renderThread, warmupFrames + frameCount);
+    const double frameTime = getMilliseconds(start) / (double)frameCount;
+    renderThread.stop();
+
+    const RenderThreadStats stats = renderThread.getStats();
+    stats.report(std::cout);
+    CHECK(stats.packets == frameCount);
+    CHECK(stats.packetGrowths == 0);
+    CHECK(renderer.getFrameCount() == warmupFrames + frameCount);
+
+    // A packet waits at most for the ones queued ahead of it, give or take
+    // the time it takes to wake the render thread
+    CHECK(stats.handoffMean <= kPacketCount * frameTime + 10.0);
+    CHECK(stats.handoffMax >= stats.handoffMean);
+}
+
+void testIdleHandoff()
+{
+    const uint64_t frameCount = 60;
+    Renderer renderer(640, 360);
+    RenderThread renderThread(renderer, kPacketCount);
+
+    // Each frame is submitted once the last one is done, so the render
+    // thread is idle, and often asleep, when a packet arrives. The handoff
+    // is then only the time it takes to wake it.
+    for (uint64_t frame = 0; frame < frameCount; ++frame)
+    {
+        FramePacket* packet = renderThread.beginPacket();
+        fillPacket(*packet);
+        renderThread.submitPacket(packet);
+        waitForFrames(renderThread, frame + 1);
+
+        // Give the render thread time to fall asleep now and then
+        if (frame % 8 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+    renderThread.stop();
+
+    const RenderThreadStats stats = renderThread.getStats();
+    stats.report(std::cout);
+    CHECK(stats.packets == frameCount);
+    CHECK(stats.producerStalls == 0);
+    CHECK(stats.handoffMean < 10.0);
+    CHECK(stats.handoffMax < 100.0);
+}
+} // namespace
+
+void addRenderThreadTests(TestSuite& suite)
+{
+    suite.add("render_thread/packet_reuse", testPacketReuse);
+    suite.add("render_thread/idle_handoff", testIdleHandoff);
+}
@@ -0,0 +1,196 @@
+#include "../src/RingAllocator.h"
+#include "../src/UploadRing.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <utility>
+#include <vector>
+
+// Ring Allocator Tests
+// Per-frame constants allocated at draw call rates with overlap validation
+// on, while the frames they belong to are retired in whatever order their
+// fences are seen to complete, and odd sizes and alignments wrapping around
+// a small ring.
+
+namespace
+{
+// Every allocation is stamped with its frame and index, and the stamps of a
+// frame are checked right before it's retired. Anything allocated over a
+// range still in flight would have overwritten one.
+struct FrameStamps
+{
+    UINT64 fenceValue;
+    std::vector<UINT8*> addresses;
+};
+
+uint64_t getStamp(UINT64 fenceValue, size_t index)
+{
+    return (fenceValue << 32) | index;
+}
+
+void checkStamps(const FrameStamps& frame)
+{
+    for (size_t i = 0; i < frame.addresses.size(); ++i)
+    {
+        uint64_t stamp = 0;
+        memcpy(&stamp, frame.addresses[i], sizeof(stamp));
+        CHECK(stamp == getStamp(frame.fenceValue, i));
+    }
+}
+
+void testUploadRingDrawRates()
+{
+    const UINT64 allocationsPerFrame = 100000;
+    const UINT64 allocationSize = 256;
+    const UINT64 framesInFlight = 3;
+    const UINT64 frameCount = 8;
+
+    // Room for every frame in flight plus the one being recorded, backed by
+    // CPU memory, so allocations have no GPU address of their own
+    UploadRing ring(nullptr,
+                    (framesInFlight + 1) * allocationsPerFrame * allocationSize,
+                    true);
+    const UINT8* base = ring.allocate(allocationSize).cpuAddress;
+    ring.finishFrame(0);
+    ring.retire(0);
+
+    TestRandom random(4);
+    std::deque<FrameStamps> inFlight;
+    UINT64 completed = 0;
+    for (UINT64 fenceValue = 1; fenceValue <= frameCount; ++fenceValue)
+    {
+        FrameStamps frame;
+        frame.fenceValue = fenceValue;
+        for (UINT64 i = 0; i < allocationsPerFrame; ++i)
+        {
+            const UploadAllocation allocation = ring.allocate(allocationSize);
+            CHECK(allocation.offset % 256 == 0);
+            CHECK(allocation.gpuAddress % 256 == 0);
+            CHECK(allocation.cpuAddress == base + allocation.offset);
+            const uint64_t stamp = getStamp(fenceValue, (size_t)i);
+            memcpy(allocation.cpuAddress, &stamp, sizeof(stamp));
+            frame.addresses.push_back(allocation.cpuAddress);
+        }
+        ring.finishFrame(fenceValue);
+        inFlight.push_back(std::move(frame));
+        for (const FrameStamps& live : inFlight)
+        {
+            checkStamps(live);
+        }
+
+        // The GPU gets up to two frames behind, and waiting on it once the
+        // limit is hit completes exactly enough of them to make room
+        const UINT64 behind =
+            std::min<UINT64>(random.below(framesInFlight), framesInFlight - 1);
+        const UINT64 reached = fenceValue - std::min(behind, fenceValue);
+        if (reached <= completed)
+        {
+            continue;
+        }
+
+        // Frames aren't retired in fence order. The newest fence seen is
+        // retired first, which frees every older frame with it, and the
+        // older ones are then seen late, which must not free anything more.
+        std::vector<UINT64> seen;
+        for (UINT64 value = completed + 1; value <= reached; ++value)
+        {
+            seen.push_back(value);
+        }
+        std::reverse(seen.begin(), seen.end());
+        for (const UINT64 value : seen)
+        {
+            while (!inFlight.empty() && inFlight.front().fenceValue <= value)
+            {
+                checkStamps(inFlight.front());
+                inFlight.pop_front();
+            }
+            ring.retire(value);
+        }
+        completed = reached;
+    }
+
+    CHECK(ring.getAllocator().getStats().failedAllocations == 0);
+    ring.retire(frameCount);
+    CHECK(ring.getAllocator().getUsed() == 0);
+}
+
+void testMixedSizesAndAlignments()
+{
+    const uint64_t capacity = 1024 * 1024;
+    const uint64_t alignments[] = {1, 4, 16, 256, 4096, 65536};
+    RingAllocator ring(capacity, true);
+    TestRandom random(44);
+
+    uint64_t fenceValue = 0;
+    uint64_t completed = 0;
+    uint64_t retries = 0;
+    for (uint32_t i = 0; i < 200000; ++i)
+    {
+        const uint64_t size = 1 + random.below(8192);
+        const uint64_t alignment = alignments[random.below(6)];
+        uint64_t offset = 0;
+        while (!ring.allocate(size, alignment, offset))
+        {
+            // Full, so wait for the oldest frame still in flight, submitting
+            // the current one first if it's the only one
+            if (completed == fenceValue)
+            {
+                ring.finishFrame(++fenceValue);
+            }
+            ring.retire(++completed);
+            ++retries;
+        }
+        CHECK(offset % alignment == 0);
+        CHECK(offset + size <= capacity);
+
+        if (random.below(64) == 0)
+        {
+            ring.finishFrame(++fenceValue);
+        }
+    }
+    CHECK(retries > 0);
+
+    ring.finishFrame(++fenceValue);
+    ring.retire(fenceValue);
+    CHECK(ring.getUsed() == 0);
+}
+
+// Forgets everything in flight without retiring it, the kind of bookkeeping
+// bug validation is there to catch
+class LeakyRingAllocator : public RingAllocator
+{
+  public:
+    using RingAllocator::RingAllocator;
+
+    void forgetUsed()
+    {
+        mHead = 0;
+        mUsed = 0;
+    }
+};
+
+void testValidationCatchesOverlap()
+{
+    LeakyRingAllocator ring(4096, true);
+    uint64_t offset = 0;
+    CHECK(ring.allocate(1024, 256, offset));
+    ring.forgetUsed();
+    CHECK_THROWS(ring.allocate(256, 256, offset), std::logic_error);
+
+    // Without validation the overlap goes unnoticed
+    LeakyRingAllocator unchecked(4096, false);
+    CHECK(unchecked.allocate(1024, 256, offset));
+    unchecked.forgetUsed();
+    CHECK(unchecked.allocate(256, 256, offset));
+    CHECK(offset == 0);
+}
+} // namespace
+
+void addRingAllocatorTests(TestSuite& suite)
+{
+    suite.add("ring/upload_draw_rates", testUploadRingDrawRates);
+    suite.add("ring/mixed_sizes_and_alignments", testMixedSizesAndAlignments);
+    suite.add("ring/validation_catches_overlap", testValidationCatchesOverlap);
+}
@@ -0,0 +1,320 @@
+#include "../src/ShaderCache.h"
+#include "Test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Shader Cache Tests
+// Keys and cache files with a stub compiler that counts its compiles. A
+// repeated shader is a hit, editing an include or changing any option is a
+// new key, and a saved file reopens with its entries mapped instead of
+// compiled. Truncated, damaged and outdated files are started over, and
+// entries appended by later saves are found the next time it's opened.
+
+namespace
+{
+// Bytecode is the shader's options, so entries are told apart by content
+class CountingCompiler : public ShaderCompiler
+{
+  public:
+    CountingCompiler() : compiles(0) {}
+
+    const char* getId() const override { return "counting"; }
+
+    bool compile(const ShaderDesc& desc, std::vector<uint8_t>& bytecode,
+                 std::string& errors) override
+    {
+        compiles++;
+        if (desc.target.empty())
+        {
+            errors = "no target\n";
+            return false;
+        }
+        const std::string text = getBytecode(desc);
+        bytecode.assign(text.begin(), text.end());
+        return true;
+    }
+
+    static std::string getBytecode(const ShaderDesc& desc)
+    {
+        std::string text = desc.entryPoint + " " + desc.target + " " +
+                           std::to_string(desc.flags);
+        for (const auto& define : desc.defines)
+        {
+            text += " " + define.first + "=" + define.second;
+        }
+        return text;
+    }
+
+    int compiles;
+};
+
+// Files go in the temp directory, not wherever the tests are run from
+std::string getTempPath(const std::string& name)
+{
+    const char* directory = std::getenv("TMPDIR");
+    if (directory == nullptr)
+    {
+        directory = std::getenv("TEMP");
+    }
+    return std::string(directory != nullptr ? directory : ".") +
+           "/xgfx_shader_cache_" + name;
+}
+
+void writeFile(const std::string& path, const std::string& text)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    CHECK(file.is_open());
+    file << text;
+}
+
+std::string readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+}
+
+bool hasBytecode(const D3D12_SHADER_BYTECODE& bytecode,
+                 const ShaderDesc& desc)
+{
+    const std::string expected = CountingCompiler::getBytecode(desc);
+    return bytecode.BytecodeLength == expected.size() &&
+           memcmp(bytecode.pShaderBytecode, expected.data(),
+                  expected.size()) == 0;
+}
+
+// A shader including a header next to it, and a cache file, all removed
+// again once a test is done with them
+struct ShaderFiles
+{
+    ShaderFiles(const std::string& name)
+        : shader(getTempPath(name + ".hlsl")),
+          include(getTempPath(name + ".hlsli")),
+          cache(getTempPath(name + ".cache"))
+    {
+        writeFile(shader, "#include \"xgfx_shader_cache_" + name +
+                              ".hlsli\"\nfloat4 main() : SV_Target { "
+                              "return color; }\n");
+        writeFile(include, "static const float4 color = 1.0;\n");
+        std::remove(cache.c_str());
+    }
+
+    ~ShaderFiles()
+    {
+        std::remove(shader.c_str());
+        std::remove(include.c_str());
+        std::remove(cache.c_str());
+    }
+
+    ShaderDesc getDesc(const std::string& target) const
+    {
+        ShaderDesc desc;
+        desc.path = shader;
+        desc.target = target;
+        return desc;
+    }
+
+    std::string shader;
+    std::string include;
+    std::string cache;
+};
+
+void testMissThenHit()
+{
+    ShaderFiles files("hit");
+    CountingCompiler compiler;
+    ShaderCache cache(files.cache, compiler);
+    const ShaderDesc desc = files.getDesc("ps_5_0");
+
+    const D3D12_SHADER_BYTECODE first = cache.getShader(desc);
+    CHECK(compiler.compiles == 1);
+    CHECK(hasBytecode(first, desc));
+    const D3D12_SHADER_BYTECODE second = cache.getShader(desc);
+    CHECK(compiler.compiles == 1);
+    CHECK(second.pShaderBytecode == first.pShaderBytecode);
+    CHECK(cache.getStats().misses == 1);
+    CHECK(cache.getStats().hits == 1);
+
+    // Failures aren't cached, so they're retried
+    const ShaderDesc broken = files.getDesc("");
+    CHECK_THROWS(cache.getShader(broken), std::runtime_error);
+    CHECK_THROWS(cache.getShader(broken), std::runtime_error);
+    CHECK(compiler.compiles == 3);
+    CHECK(cache.getStats().compileFailures == 2);
+
+    ShaderDesc missing = desc;
+    missing.path = getTempPath("missing.hlsl");
+    CHECK_THROWS(cache.getShader(missing), std::runtime_error);
+}
+
+void testKeyChanges()
+{
+    ShaderFiles files("keys");
+    CountingCompiler compiler;
+    ShaderCache cache(files.cache, compiler);
+    ShaderDesc desc = files.getDesc("ps_5_0");
+    desc.defines.push_back({"SHADOWS", "1"});
+    const uint64_t key = cache.computeKey(desc);
+    cache.getShader(desc);
+
+    // The include is part of the key even though the shader is unchanged
+    writeFile(files.include, "static const float4 color = 0.5;\n");
+    const uint64_t edited = cache.computeKey(desc);
+    CHECK(edited != key);
+    cache.getShader(desc);
+    CHECK(compiler.compiles == 2);
+
+    // Every option changes the key on its own
+    std::vector<ShaderDesc> changed(5, desc);
+    changed[0].defines[0].second = "0";
+    changed[1].defines.push_back({"FOG", "1"});
+    changed[2].target = "ps_5_1";
+    changed[3].flags = 1;
+    changed[4].entryPoint = "shadowMain";
+    std::vector<uint64_t> keys = {key, edited};
+    for (const ShaderDesc& option : changed)
+    {
+        const uint64_t optionKey = cache.computeKey(option);
+        for (const uint64_t other : keys)
+        {
+            CHECK(optionKey != other);
+        }
+        keys.push_back(optionKey);
+        CHECK(hasBytecode(cache.getShader(option), option));
+    }
+    CHECK(compiler.compiles == 7);
+
+    // Undoing the edit finds the first entry again
+    writeFile(files.include, "static const float4 color = 1.0;\n");
+    CHECK(cache.computeKey(desc) == key);
+    cache.getShader(desc);
+    CHECK(compiler.compiles == 7);
+}
+
+void testReopenMapsEntries()
+{
+    ShaderFiles files("reopen");
+    const std::vector<ShaderDesc> descs = {files.getDesc("vs_5_0"),
+                                           files.getDesc("ps_5_0")};
+    {
+        CountingCompiler compiler;
+        ShaderCache cache(files.cache, compiler);
+        for (const ShaderDesc& desc : descs)
+        {
+            cache.getShader(desc);
+        }
+        cache.save();
+        CHECK(cache.getStats().entriesWritten == 2);
+    }
+
+    CountingCompiler compiler;
+    ShaderCache cache(files.cache, compiler);
+    CHECK(cache.getStats().entriesLoaded == 2);
+    CHECK(cache.getStats().bytesMapped == readFile(files.cache).size());
+    for (const ShaderDesc& desc : descs)
+    {
+        CHECK(hasBytecode(cache.getShader(desc), desc));
+    }
+    CHECK(compiler.compiles == 0);
+    CHECK(cache.getStats().hits == 2);
+
+    // Nothing new, so nothing is written
+    cache.save();
+    CHECK(cache.getStats().entriesWritten == 0);
+}
+
+void testDamagedFilesStartOver()
+{
+    ShaderFiles files("damaged");
+    const ShaderDesc desc = files.getDesc("ps_5_0");
+    {
+        CountingCompiler compiler;
+        ShaderCache cache(files.cache, compiler);
+        cache.getShader(desc);
+        cache.getShader(files.getDesc("vs_5_0"));
+    }
+    const std::string saved = readFile(files.cache);
+
+    // A partly written last record, a bad version, a bad magic, a file too
+    // short for a header, and an empty one
+    std::vector<std::string> damaged(5, saved);
+    damaged[0].resize(saved.size() - 3);
+    damaged[1][4]++;
+    damaged[2][0] = 'Y';
+    damaged[3].resize(5);
+    damaged[4].clear();
+    for (const std::string& file : damaged)
+    {
+        writeFile(files.cache, file);
+        {
+            CountingCompiler compiler;
+            ShaderCache cache(files.cache, compiler);
+            CHECK(cache.getStats().entriesLoaded == 0);
+            CHECK(hasBytecode(cache.getShader(desc), desc));
+            CHECK(compiler.compiles == 1);
+        }
+
+        // Rewritten from scratch rather than appended to
+        CountingCompiler compiler;
+        ShaderCache cache(files.cache, compiler);
+        CHECK(cache.getStats().entriesLoaded == 1);
+        cache.getShader(desc);
+        CHECK(compiler.compiles == 0);
+    }
+}
+
+void testAppendedRecordsSurvive()
+{
+    ShaderFiles files("append");
+    std::vector<ShaderDesc> descs;
+    for (const char* target : {"vs_5_0", "ps_5_0", "cs_5_0", "gs_5_0"})
+    {
+        descs.push_back(files.getDesc(target));
+    }
+    {
+        CountingCompiler compiler;
+        ShaderCache cache(files.cache, compiler);
+        cache.getShader(descs[0]);
+        cache.save();
+        cache.getShader(descs[1]);
+        cache.save();
+        CHECK(cache.getStats().entriesWritten == 2);
+    }
+
+    // Appended to while mapped, then by the destructor
+    {
+        CountingCompiler compiler;
+        ShaderCache cache(files.cache, compiler);
+        CHECK(cache.getStats().entriesLoaded == 2);
+        cache.getShader(descs[2]);
+        cache.save();
+        cache.getShader(descs[3]);
+        CHECK(compiler.compiles == 2);
+    }
+
+    CountingCompiler compiler;
+    ShaderCache cache(files.cache, compiler);
+    CHECK(cache.getStats().entriesLoaded == 4);
+    for (const ShaderDesc& desc : descs)
+    {
+        CHECK(hasBytecode(cache.getShader(desc), desc));
+    }
+    CHECK(compiler.compiles == 0);
+}
+} // namespace
+
+void addShaderCacheTests(TestSuite& suite)
+{
+    suite.add("shader_cache/miss_then_hit", testMissThenHit);
+    suite.add("shader_cache/key_changes", testKeyChanges);
+    suite.add("shader_cache/reopen_maps_entries", testReopenMapsEntries);
+    suite.add("shader_cache/damaged_files_start_over",
+              testDamagedFilesStartOver);
+    suite.add("shader_cache/appended_records_survive",
+              testAppendedRecordsSurvive);
+}
@@ -0,0 +1,98 @@
+#include "Test.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+TestFailure::TestFailure(const std::string& message)
+    : std::runtime_error(message)
+{
+}
+
+void checkThat(bool condition, const char* expression, const char* file,
+               int line)
+{
+    if (!condition)
+    {
+        std::ostringstream message;
+        message << file << ":" << line << ": CHECK(" << expression
+                << ") failed";
+        throw TestFailure(message.str());
+    }
+}
+
+void checkNear(double a, double b, double tolerance, const char* expressionA,
+               const char* expressionB, const char* file, int line)
+{
+    // NaNs compare unequal to everything, so they fail too
+    if (!(std::fabs(a - b) <= tolerance))
+    {
+        std::ostringstream message;
+        message << file << ":" << line << ": CHECK_NEAR(" << expressionA
+                << ", " << expressionB << ") failed, " << a << " and " << b
+                << " differ by more than " << tolerance;
+        throw TestFailure(message.str());
+    }
+}
+
+TestRandom::TestRandom(uint64_t seed)
+    : mState(seed != 0 ? seed : 0x9e3779b97f4a7c15ull)
+{
+}
+
+uint64_t TestRandom::next()
+{
+    mState ^= mState >> 12;
+    mState ^= mState << 25;
+    mState ^= mState >> 27;
+    return mState * 0x2545f4914f6cdd1dull;
+}
+
+uint32_t TestRandom::below(uint32_t count)
+{
+    return count == 0 ? 0 : (uint32_t)((next() >> 32) % count);
+}
+
+float TestRandom::range(float minimum, float maximum)
+{
+    const float unit = (float)(next() >> 40) / (float)(1 << 24);
+    return minimum + (maximum - minimum) * unit;
+}
+
+void TestSuite::add(const std::string& name, const TestFunction& test)
+{
+    mNames.push_back(name);
+    mTests.push_back(test);
+}
+
+const std::vector<std::string>& TestSuite::getNames() const { return mNames; }
+
+std::vector<std::string> TestSuite::run(const std::string& filter) const
+{
+    std::vector<std::string> failures;
+    for (size_t i = 0; i < mTests.size(); ++i)
+    {
+        if (!filter.empty() && mNames[i].find(filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        std::cout << mNames[i] << "... " << std::flush;
+        const auto start = std::chrono::steady_clock::now();
+        try
+        {
+            mTests[i]();
+            std::cout << "ok ("
+                      << std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count()
+                      << " s)\n";
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "FAILED\n  " << e.what() << "\n";
+            failures.push_back(mNames[i]);
+        }
+    }
+    return failures;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Test
+// The harness the tests run on. A test is a function that throws when one
+// of its checks fails, the failure naming the check and where it is. Tests
+// are built against the NOOP backend, so they run without a GPU or a window
+// system, and are registered with ctest one group at a time.
+
+class TestFailure : public std::runtime_error
+{
+  public:
+    TestFailure(const std::string& message);
+};
+
+// Throws a TestFailure naming the expression if the condition doesn't hold
+#define CHECK(condition)                                                       \
+    checkThat((condition), #condition, __FILE__, __LINE__)
+
+// Throws if a and b differ by more than the tolerance, naming both values
+#define CHECK_NEAR(a, b, tolerance)                                            \
+    checkNear((double)(a), (double)(b), (double)(tolerance), #a, #b, __FILE__, \
+              __LINE__)
+
+// Throws unless evaluating the expression throws an exception of that type
+#define CHECK_THROWS(expression, exception)                                    \
+    do                                                                         \
+    {                                                                          \
+        bool thrown = false;                                                   \
+        try                                                                    \
+        {                                                                      \
+            expression;                                                        \
+        }                                                                      \
+        catch (const exception&)                                               \
+        {                                                                      \
+            thrown = true;                                                     \
+        }                                                                      \
+        checkThat(thrown, #expression " throws " #exception, __FILE__,         \
+                  __LINE__);                                                   \
+    } while (false)
+
+void checkThat(bool condition, const char* expression, const char* file,
+               int line);
+
+void checkNear(double a, double b, double tolerance, const char* expressionA,
+               const char* expressionB, const char* file, int line);
+
+// xorshift64*, so every platform generates the same inputs from a seed
+class TestRandom
+{
+  public:
+    TestRandom(uint64_t seed);
+
+    uint64_t next();
+
+    // Uniform in [0, count)
+    uint32_t below(uint32_t count);
+
+    // Uniform in [minimum, maximum)
+    float range(float minimum, float maximum);
+
+  protected:
+    uint64_t mState;
+};
+
+typedef std::function<void()> TestFunction;
+
+class TestSuite
+{
+  public:
+    void add(const std::string& name, const TestFunction& test);
+
+    const std::vector<std::string>& getNames() const;
+
+    // Run every test whose name contains the filter, reporting each on
+    // stdout. Returns the names of those that failed.
+    std::vector<std::string> run(const std::string& filter) const;
+
+  protected:
+    std::vector<std::string> mNames;
+    std::vector<TestFunction> mTests;
+};
+
+// Tests of each part of the renderer, in the file of the same name
+void addFramePacerTests(TestSuite& suite);
+void addRingAllocatorTests(TestSuite& suite);
+void addProfilerTests(TestSuite& suite);
+void addRenderGraphTests(TestSuite& suite);
+void addRenderThreadTests(TestSuite& suite);
+void addTlsfAllocatorTests(TestSuite& suite);
+void addTransformSystemTests(TestSuite& suite);
+void addJobSystemTests(TestSuite& suite);
+void addGpuAllocatorTests(TestSuite& suite);
+void addGeometryUploaderTests(TestSuite& suite);
+void addShaderCacheTests(TestSuite& suite);
+void addPipelineCacheTests(TestSuite& suite);
+void addDescriptorAllocatorTests(TestSuite& suite);
+void addMeshCookerTests(TestSuite& suite);
+void addMeshOptimizerTests(TestSuite& suite);
@@ -0,0 +1,208 @@
+#include "../src/TlsfAllocator.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <vector>
+
+// TLSF Allocator Tests
+// Freed blocks merging with their neighbors until the whole range is one
+// block again, the fragmentation metric on known layouts, and allocations
+// at every alignment a heap sees landing aligned without overlapping.
+
+namespace
+{
+const uint64_t kKilobyte = 1024;
+
+// Sorted by offset, no allocation may run into the next one
+void checkDisjoint(std::vector<TlsfAllocation> allocations, uint64_t capacity)
+{
+    std::sort(allocations.begin(), allocations.end(),
+              [](const TlsfAllocation& a, const TlsfAllocation& b) {
+                  return a.offset < b.offset;
+              });
+    for (size_t i = 0; i < allocations.size(); ++i)
+    {
+        const uint64_t end = allocations[i].offset + allocations[i].size;
+        CHECK(end <= capacity);
+        CHECK(i + 1 == allocations.size() || end <= allocations[i + 1].offset);
+    }
+}
+
+void testCoalescing()
+{
+    const uint64_t quarter = 256 * kKilobyte;
+    TlsfAllocator allocator(4 * quarter);
+    TlsfAllocation blocks[4];
+    for (TlsfAllocation& block : blocks)
+    {
+        CHECK(allocator.allocate(quarter, 1, block));
+    }
+    TlsfAllocation extra;
+    CHECK(!allocator.allocate(1, 1, extra));
+
+    // Two free quarters that aren't neighbors can't hold half the range
+    allocator.free(blocks[1].block);
+    allocator.free(blocks[3].block);
+    CHECK(allocator.getStats().freeBlockCount == 2);
+    CHECK(!allocator.allocate(2 * quarter, 1, extra));
+
+    // Freeing the quarter between them merges all three
+    allocator.free(blocks[2].block);
+    TlsfStats stats = allocator.getStats();
+    CHECK(stats.freeBlockCount == 1);
+    CHECK(stats.largestFreeBlock == 3 * quarter);
+    CHECK(allocator.allocate(3 * quarter, 1, extra));
+    CHECK(extra.offset == quarter);
+    allocator.free(extra.block);
+    allocator.free(blocks[0].block);
+    CHECK(allocator.isEmpty());
+
+    // After any mix of allocations and frees, freeing what's left gives the
+    // whole range back as one block
+    TestRandom random(6);
+    std::vector<TlsfAllocation> live;
+    for (int i = 0; i < 20000; ++i)
+    {
+        TlsfAllocation allocation;
+        if (random.below(3) != 0 &&
+            allocator.allocate(1 + random.below(16 * kKilobyte),
+                               1ull << random.below(13), allocation))
+        {
+            live.push_back(allocation);
+        }
+        else if (!live.empty())
+        {
+            const size_t index = random.below((uint32_t)live.size());
+            allocator.free(live[index].block);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+    checkDisjoint(live, allocator.getCapacity());
+    for (const TlsfAllocation& allocation : live)
+    {
+        allocator.free(allocation.block);
+    }
+
+    stats = allocator.getStats();
+    CHECK(allocator.isEmpty());
+    CHECK(stats.allocatedBytes == 0);
+    CHECK(stats.freeBlockCount == 1);
+    CHECK(stats.largestFreeBlock == allocator.getCapacity());
+    CHECK(allocator.allocate(allocator.getCapacity(), 1, extra));
+    CHECK(extra.offset == 0);
+}
+
+void testFragmentation()
+{
+    const uint64_t blockSize = 4 * kKilobyte;
+    const size_t blockCount = 64;
+    TlsfAllocator allocator(blockCount * blockSize);
+    CHECK(allocator.getStats().fragmentation() == 0.0);
+
+    std::vector<TlsfAllocation> blocks(blockCount);
+    for (TlsfAllocation& block : blocks)
+    {
+        CHECK(allocator.allocate(blockSize, 1, block));
+    }
+
+    // Nothing free isn't fragmented either
+    TlsfStats stats = allocator.getStats();
+    CHECK(stats.freeBytes == 0);
+    CHECK(stats.fragmentation() == 0.0);
+
+    // Every other block free, so the largest is one of 32
+    for (size_t i = 0; i < blockCount; i += 2)
+    {
+        allocator.free(blocks[i].block);
+    }
+    stats = allocator.getStats();
+    CHECK(stats.freeBlockCount == blockCount / 2);
+    CHECK(stats.largestFreeBlock == blockSize);
+    CHECK_NEAR(stats.fragmentation(), 1.0 - 1.0 / (blockCount / 2), 1e-12);
+
+    // Freeing the rest of the first half merges it and the free block after
+    // it into one, leaving 15 single blocks in the second half
+    for (size_t i = 1; i < blockCount / 2; i += 2)
+    {
+        allocator.free(blocks[i].block);
+    }
+    stats = allocator.getStats();
+    CHECK(stats.freeBlockCount == 16);
+    CHECK(stats.largestFreeBlock == 33 * blockSize);
+    CHECK_NEAR(stats.fragmentation(), 1.0 - 33.0 / 48.0, 1e-12);
+
+    for (size_t i = blockCount / 2 + 1; i < blockCount; i += 2)
+    {
+        allocator.free(blocks[i].block);
+    }
+    CHECK(allocator.getStats().fragmentation() == 0.0);
+}
+
+void testAlignmentClasses()
+{
+    // Sizes from the linearly binned small blocks up to a few megabytes, at
+    // every alignment from bytes to MSAA render targets
+    const uint64_t capacity = 256 * kKilobyte * kKilobyte;
+    TlsfAllocator allocator(capacity);
+    TestRandom random(12);
+    std::vector<TlsfAllocation> live;
+    for (int i = 0; i < 10000; ++i)
+    {
+        const uint64_t alignment = 1ull << random.below(23);
+        const uint64_t size =
+            random.below(2) != 0 ? 1 + random.below(32)
+                                 : 1 + random.below(4 * kKilobyte * kKilobyte);
+        TlsfAllocation allocation;
+        if (!allocator.allocate(size, alignment, allocation))
+        {
+            // Make room rather than stop, so the range keeps churning
+            for (const TlsfAllocation& old : live)
+            {
+                allocator.free(old.block);
+            }
+            live.clear();
+            CHECK(allocator.allocate(size, alignment, allocation));
+        }
+        CHECK(allocation.offset % alignment == 0);
+        CHECK(allocation.size >= size);
+        live.push_back(allocation);
+    }
+    checkDisjoint(live, capacity);
+    for (const TlsfAllocation& allocation : live)
+    {
+        allocator.free(allocation.block);
+    }
+    CHECK(allocator.getStats().freeBlockCount == 1);
+
+    // The hole left by a 64KB placed resource takes the next one, even
+    // though no free block has room for it at every possible offset
+    const uint64_t placement = 64 * kKilobyte;
+    allocator.reset(4 * placement);
+    TlsfAllocation placed[4];
+    for (TlsfAllocation& block : placed)
+    {
+        CHECK(allocator.allocate(placement, placement, block));
+    }
+    allocator.free(placed[1].block);
+    TlsfAllocation reused;
+    CHECK(allocator.allocate(placement, placement, reused));
+    CHECK(reused.offset == placement);
+
+    // Padding skipped to align an allocation stays free for smaller ones
+    allocator.reset(capacity);
+    TlsfAllocation first, aligned, padding;
+    CHECK(allocator.allocate(100, 1, first));
+    CHECK(allocator.allocate(4 * kKilobyte, 4 * kKilobyte, aligned));
+    CHECK(aligned.offset == 4 * kKilobyte);
+    CHECK(allocator.allocate(2 * kKilobyte, 4, padding));
+    CHECK(padding.offset == 100);
+}
+} // namespace
+
+void addTlsfAllocatorTests(TestSuite& suite)
+{
+    suite.add("tlsf/coalescing", testCoalescing);
+    suite.add("tlsf/fragmentation", testFragmentation);
+    suite.add("tlsf/alignment_classes", testAlignmentClasses);
+}
@@ -0,0 +1,147 @@
+#include "../src/TransformSystem.h"
+#include "Test.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Transform System Tests
+// Every kernel the CPU supports against the same matrices built by glm, for
+// random transforms written to a padded stride, both as model matrices and
+// premultiplied by a view projection.
+
+namespace
+{
+// A few past a multiple of eight, so the SIMD kernels finish on their
+// scalar tail
+const size_t kObjectCount = 100003;
+
+struct Transform
+{
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+// Padded like a draw item, so a kernel ignoring the stride writes over the
+// next matrix
+struct StridedMatrix
+{
+    glm::mat4 matrix;
+    float padding[4];
+};
+
+std::vector<Transform> getRandomTransforms()
+{
+    TestRandom random(12);
+    std::vector<Transform> transforms(kObjectCount);
+    for (Transform& transform : transforms)
+    {
+        transform.position =
+            glm::vec3(random.range(-500.0f, 500.0f),
+                      random.range(-50.0f, 50.0f),
+                      random.range(-500.0f, 500.0f));
+        transform.rotation = glm::normalize(glm::quat(
+            random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f),
+            random.range(-1.0f, 1.0f), random.range(-1.0f, 1.0f)));
+        transform.scale = glm::vec3(random.range(0.5f, 2.0f),
+                                    random.range(0.5f, 2.0f),
+                                    random.range(0.5f, 2.0f));
+    }
+    return transforms;
+}
+
+glm::mat4 getModelMatrix(const Transform& transform)
+{
+    return glm::translate(glm::mat4(1.0f), transform.position) *
+           glm::mat4_cast(transform.rotation) *
+           glm::scale(glm::mat4(1.0f), transform.scale);
+}
+
+// Elements are compared relative to the largest in the matrix, since those
+// summed from large terms can cancel out to near zero
+void checkMatrix(const glm::mat4& actual, const glm::mat4& expected)
+{
+    float largest = 1.0f;
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            largest = std::max(largest, std::fabs(expected[c][r]));
+        }
+    }
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            CHECK_NEAR(actual[c][r], expected[c][r], 1e-5f * largest);
+        }
+    }
+}
+
+void checkKernels(const glm::mat4* viewProjection)
+{
+    const std::vector<Transform> transforms = getRandomTransforms();
+    std::vector<glm::mat4> expected(kObjectCount);
+    for (size_t i = 0; i < kObjectCount; ++i)
+    {
+        expected[i] = getModelMatrix(transforms[i]);
+        if (viewProjection != nullptr)
+        {
+            expected[i] = *viewProjection * expected[i];
+        }
+    }
+
+    size_t kernelsChecked = 0;
+    for (const TransformKernel kernel :
+         {TransformKernel::Scalar, TransformKernel::Sse, TransformKernel::Avx2})
+    {
+        // Unsupported kernels would fall back to another one
+        TransformSystem system(kernel);
+        if (system.getKernel() != kernel)
+        {
+            continue;
+        }
+        for (const Transform& transform : transforms)
+        {
+            system.add(transform.position, transform.rotation,
+                       transform.scale);
+        }
+
+        std::vector<StridedMatrix> matrices(kObjectCount);
+        for (StridedMatrix& matrix : matrices)
+        {
+            std::fill(matrix.padding, matrix.padding + 4, -1.0f);
+        }
+        system.computeMatrices(&matrices[0].matrix, sizeof(StridedMatrix),
+                               viewProjection);
+        for (size_t i = 0; i < kObjectCount; ++i)
+        {
+            checkMatrix(matrices[i].matrix, expected[i]);
+            CHECK(std::all_of(matrices[i].padding, matrices[i].padding + 4,
+                              [](float value) { return value == -1.0f; }));
+        }
+        CHECK(system.getStats().matrices == kObjectCount);
+        ++kernelsChecked;
+    }
+    CHECK(kernelsChecked >= 1);
+}
+
+void testModelMatrices() { checkKernels(nullptr); }
+
+void testViewProjection()
+{
+    const glm::mat4 viewProjection =
+        glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f) *
+        glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -10.0f, 600.0f));
+    checkKernels(&viewProjection);
+}
+} // namespace
+
+void addTransformSystemTests(TestSuite& suite)
+{
+    suite.add("transforms/model_matrices", testModelMatrices);
+    suite.add("transforms/view_projection", testViewProjection);
+}